@@ -227,6 +227,7 @@ struct InputMessage {
 /*
  * An input channel consists of a local unix domain socket used to send and receive
  * input messages across processes.  Each channel has a descriptive name for debugging purposes.
+ * Optionally, the messages travel through shared memory, and the socket only carries wakeups.
  *
  * Each endpoint has its own InputChannel object that specifies its file descriptor.
  * For parceling, this relies on android::os::InputChannelCore, defined in aidl.
@@ -249,7 +250,22 @@ public:
                                          std::unique_ptr<InputChannel>& outServerChannel,
                                          std::unique_ptr<InputChannel>& outClientChannel);
 
+    /**
+     * Same as above, but if 'useSharedRing' is set, the messages are exchanged through rings in
+     * shared memory. The socket is then only written to when the receiving side is waiting for
+     * messages, or when a ring is full, so that most messages can be sent and received without a
+     * syscall. The fd of the channel can still be polled for incoming messages, for room to send
+     * more messages, and for the peer hanging up.
+     *
+     * Each end of such a channel supports a single sender and a single receiver at a time.
+     */
+    static status_t openInputChannelPair(const std::string& name,
+                                         std::unique_ptr<InputChannel>& outServerChannel,
+                                         std::unique_ptr<InputChannel>& outClientChannel,
+                                         bool useSharedRing);
+
     inline std::string getName() const { return name; }
+    inline bool usesSharedRing() const { return mRing != nullptr; }
     inline int getFd() const { return fd.get(); }
 
     /* Send a message to the other endpoint.
@@ -324,10 +340,24 @@ public:
     sp<IBinder> getConnectionToken() const;
 
 private:
+    class SharedRing;
+
     static std::unique_ptr<InputChannel> create(const std::string& name,
-                                                android::base::unique_fd fd, sp<IBinder> token);
+                                                android::base::unique_fd fd, sp<IBinder> token,
+                                                std::unique_ptr<SharedRing> ring = nullptr);
+
+    InputChannel(const std::string name, android::base::unique_fd fd, sp<IBinder> token,
+                 std::unique_ptr<SharedRing> ring);
+
+    status_t sendSocketMessage(const InputMessage* msg);
+    status_t sendRingMessage(const InputMessage* msg);
+    // Skips the wakeups of a shared ring, which don't carry a message.
+    status_t receiveSocketMessage(InputMessage* msg);
+    status_t receiveRingMessage(InputMessage* msg);
+    void traceReceivedMessage(const InputMessage& msg) const;
 
-    InputChannel(const std::string name, android::base::unique_fd fd, sp<IBinder> token);
+    // Set if the messages are exchanged in shared memory rather than through the socket.
+    std::unique_ptr<SharedRing> mRing;
 };
 
 /*
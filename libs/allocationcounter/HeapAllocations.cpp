@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <allocationcounter/HeapAllocations.h>
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+static std::atomic<size_t> gHeapAllocations;
+
+static void* countedAlloc(size_t size) {
+    gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    // malloc(0) may return null, but operator new must return a unique pointer.
+    return malloc(size == 0 ? 1 : size);
+}
+
+static void* countedAlignedAlloc(size_t size, std::align_val_t alignment) {
+    gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    // posix_memalign needs at least the alignment of a pointer.
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, align, size == 0 ? 1 : size) != 0) {
+        return nullptr;
+    }
+    return ptr;
+}
+
+// The benchmarks are built without exceptions, so failing to allocate aborts like std::bad_alloc
+// would.
+static void* checked(void* ptr) {
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void* operator new(size_t size) {
+    return checked(countedAlloc(size));
+}
+
+void* operator new[](size_t size) {
+    return checked(countedAlloc(size));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return checked(countedAlignedAlloc(size, alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return checked(countedAlignedAlloc(size, alignment));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAlloc(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAlloc(size, alignment);
+}
+
+// Every form of operator new above allocates with malloc or posix_memalign, so all the forms of
+// operator delete free the same way.
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+namespace android {
+
+size_t getHeapAllocations() {
+    return gHeapAllocations.load(std::memory_order_relaxed);
+}
+
+} // namespace android
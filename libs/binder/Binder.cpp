@@ -27,6 +27,9 @@
 #include <binder/Parcel.h>
 #include <binder/RecordedTransaction.h>
 #include <binder/RpcServer.h>
+#ifndef BINDER_DISABLE_TRANSACTION_STATS
+#include <binder/TransactionStats.h>
+#endif
 #include <binder/unique_fd.h>
 #include <pthread.h>
 
@@ -46,6 +49,7 @@ namespace android {
 using android::binder::unique_fd;
 
 constexpr uid_t kUidRoot = 0;
+constexpr uid_t kUidShell = 2000;
 
 // Service implementations inherit from BBinder and IBinder, and this is frozen
 // in prebuilts.
@@ -365,6 +369,12 @@ status_t BBinder::transact(
         reply->markSensitive();
     }
 
+#ifndef BINDER_DISABLE_TRANSACTION_STATS
+    using android::binder::debug::TransactionStats;
+    const bool recordStats = TransactionStats::isEnabled();
+    const int64_t startNs = recordStats ? TransactionStats::now() : 0;
+#endif
+
     status_t err = NO_ERROR;
     switch (code) {
         case PING_TRANSACTION:
@@ -402,6 +412,13 @@ status_t BBinder::transact(
         }
     }
 
+#ifndef BINDER_DISABLE_TRANSACTION_STATS
+    if (recordStats) [[unlikely]] {
+        TransactionStats::record(TransactionStats::Direction::INCOMING, data, code,
+                                 TransactionStats::now() - startNs, reply, err);
+    }
+#endif
+
     if (kEnableKernelIpc && mRecordingOn && code != START_RECORDING_TRANSACTION) [[unlikely]] {
         Extras* e = mExtras.load(std::memory_order_acquire);
         RpcMutexUniqueLock lock(e->mLock);
@@ -744,6 +761,26 @@ BBinder::~BBinder()
     if (e) delete e;
 }
 
+// The stats cover every transaction of the process, so unlike a service's own
+// dump(), they are only handed out to the shell and root.
+static status_t dumpTransactionStats(int fd) {
+#ifdef BINDER_DISABLE_TRANSACTION_STATS
+    (void)fd;
+    return INVALID_OPERATION;
+#else
+    if (!kEnableKernelIpc) {
+        ALOGW("Transaction stats dump disallowed because kernel binder is not enabled");
+        return INVALID_OPERATION;
+    }
+    uid_t uid = IPCThreadState::self()->getCallingUid();
+    if (uid != kUidRoot && uid != kUidShell) {
+        ALOGE("Transaction stats dump not allowed because client %" PRIu32
+              " is not shell or root", uid);
+        return PERMISSION_DENIED;
+    }
+    return binder::debug::TransactionStats::dump(fd);
+#endif
+}
 
 // NOLINTNEXTLINE(google-default-arguments)
 status_t BBinder::onTransact(
@@ -762,6 +799,9 @@ status_t BBinder::onTransact(
             for (int i = 0; i < argc && data.dataAvail() > 0; i++) {
                args.add(data.readString16());
             }
+            if (args.size() == 1 && args[0] == String16("--binder-transaction-stats")) {
+                return dumpTransactionStats(fd);
+            }
             return dump(fd, args);
         }
 
@@ -23,6 +23,9 @@
 #include <binder/IResultReceiver.h>
 #include <binder/RpcSession.h>
 #include <binder/Stability.h>
+#ifndef BINDER_DISABLE_TRANSACTION_STATS
+#include <binder/TransactionStats.h>
+#endif
 
 #include <stdio.h>
 
@@ -372,6 +375,12 @@ status_t BpBinder::transact(
             }
         }
 
+#ifndef BINDER_DISABLE_TRANSACTION_STATS
+        using android::binder::debug::TransactionStats;
+        const bool recordStats = TransactionStats::isEnabled();
+        const int64_t startNs = recordStats ? TransactionStats::now() : 0;
+#endif
+
         status_t status;
         if (isRpcBinder()) [[unlikely]] {
             status = rpcSession()->transact(sp<IBinder>::fromExisting(this), code, data, reply,
@@ -384,6 +393,12 @@ status_t BpBinder::transact(
 
             status = IPCThreadState::self()->transact(binderHandle(), code, data, reply, flags);
         }
+#ifndef BINDER_DISABLE_TRANSACTION_STATS
+        if (recordStats) [[unlikely]] {
+            TransactionStats::record(TransactionStats::Direction::OUTGOING, data, code,
+                                     TransactionStats::now() - startNs, reply, status);
+        }
+#endif
         if (data.dataSize() > LOG_TRANSACTIONS_OVER_SIZE) {
             RpcMutexUniqueLock _l(mLock);
             ALOGW("Large outgoing transaction of %zu bytes, interface descriptor %s, code %d",
@@ -74,11 +74,12 @@ status_t FdTrigger::triggerablePoll(const android::RpcTransportFd& transportFd,
 #endif
     };
 
-    LOG_ALWAYS_FATAL_IF(transportFd.isInPollingState() == true,
-                        "Only one thread should be polling on Fd!");
-
-    transportFd.setPollingState(true);
-    auto pollingStateGuard = make_scope_guard([&]() { transportFd.setPollingState(false); });
+    // One thread may poll to read while another polls to write, on transports
+    // which support it (see RpcTransport::supportsConcurrentReadAndWrite).
+    int16_t alreadyPolling = transportFd.beginPolling(event);
+    auto pollingStateGuard = make_scope_guard([&]() { transportFd.endPolling(event); });
+    LOG_ALWAYS_FATAL_IF((alreadyPolling & event) != 0,
+                        "Only one thread should be polling on Fd for events %d!", event);
 
     int ret = TEMP_FAILURE_RETRY(poll(pfd, countof(pfd), -1));
     if (ret < 0) {
@@ -57,6 +57,14 @@ public:
     [[nodiscard]] status_t triggerablePoll(const android::RpcTransportFd& transportFd,
                                            int16_t event);
 
+#ifndef BINDER_RPC_SINGLE_THREADED
+    /**
+     * The end of the pipe which receives POLLHUP when this is triggered, in
+     * order to wait for it along with other FDs (e.g. in an epoll set).
+     */
+    [[nodiscard]] binder::borrowed_fd readFd() const { return mRead; }
+#endif
+
 private:
 #ifdef BINDER_RPC_SINGLE_THREADED
     bool mTriggered = false;
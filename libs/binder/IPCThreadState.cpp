@@ -27,9 +27,11 @@
 #include <utils/Log.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
 #include <atomic>
 #include <errno.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
@@ -642,18 +644,27 @@ status_t IPCThreadState::getAndExecuteCommand()
             ALOGI("%s", message.c_str());
         }
 
+        // The driver starts every read with a BR_NOOP, and a thread woken up
+        // by ProcessState::wakeWaitingThreads only gets that, so it doesn't
+        // make the thread busy.
+        if (cmd == BR_NOOP) return executeCommand(cmd);
+
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
         }
+        bool spawnThread = mProcess->mAdaptive && mProcess->reserveAdaptiveThreadLocked();
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
 
+        if (spawnThread) mProcess->spawnAdaptiveThread();
+
         result = executeCommand(cmd);
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount--;
+        mProcess->mFinishedCommandsCount++;
         if (mProcess->mExecutingThreadsCount < mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs != 0) {
             int64_t starvationTimeMs = uptimeMillis() - mProcess->mStarvationStartTimeMs;
@@ -662,6 +673,10 @@ status_t IPCThreadState::getAndExecuteCommand()
                       mProcess->mMaxThreads, starvationTimeMs);
             }
             mProcess->mStarvationStartTimeMs = 0;
+            mProcess->mStarvationCount++;
+            mProcess->mTotalStarvationTimeMs += starvationTimeMs;
+            mProcess->mMaxStarvationTimeMs =
+                    std::max(mProcess->mMaxStarvationTimeMs, starvationTimeMs);
         }
 
         // Cond broadcast can be expensive, so don't send it every time a binder
@@ -669,7 +684,10 @@ status_t IPCThreadState::getAndExecuteCommand()
         if (mProcess->mWaitingForThreads > 0) {
             pthread_cond_broadcast(&mProcess->mThreadCountDecrement);
         }
+        bool wakeThreads = mProcess->mAdaptive && mProcess->shouldWakeAdaptiveThreadsLocked();
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
+        if (wakeThreads) mProcess->wakeWaitingThreads();
     }
 
     return result;
@@ -726,17 +744,46 @@ void IPCThreadState::processPostWriteDerefs()
 }
 
 void IPCThreadState::joinThreadPool(bool isMain)
+{
+    joinThreadPoolInternal(isMain, false /*isAdaptive*/);
+}
+
+void IPCThreadState::joinThreadPoolInternal(bool isMain, bool isAdaptive)
 {
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS JOINING THE THREAD POOL\n", (void*)pthread_self(), getpid());
     pthread_mutex_lock(&mProcess->mThreadCountLock);
     mProcess->mCurrentThreads++;
+    if (isAdaptive) mProcess->mPendingAdaptiveThreads--;
     pthread_mutex_unlock(&mProcess->mThreadCountLock);
-    mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
+    // The kernel didn't request adaptive threads, so they can't register.
+    mOut.writeInt32(isMain || isAdaptive ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
 
     mIsLooper = true;
+    bool retired = false;
     status_t result;
     do {
         processPendingDerefs();
+
+        // A thread blocked in the driver only leaves it for a command or a
+        // wakeup, so adaptive threads wait for commands with the idle
+        // timeout, and leave if the pool has been idle for long enough.
+        if (isAdaptive && mIn.dataPosition() >= mIn.dataSize()) {
+            result = waitForCommand(mProcess->mIdleTimeoutMs);
+            if (result == TIMED_OUT) {
+                if (mProcess->retireAdaptiveThread()) {
+                    retired = true;
+                    break;
+                }
+                continue;
+            }
+            if (result == WOULD_BLOCK) {
+                continue;
+            }
+            if (result < NO_ERROR) {
+                break;
+            }
+        }
+
         // now get the next command to be processed, waiting if necessary
         result = getAndExecuteCommand();
 
@@ -758,6 +805,7 @@ void IPCThreadState::joinThreadPool(bool isMain)
     mOut.writeInt32(BC_EXIT_LOOPER);
     mIsLooper = false;
     talkWithDriver(false);
+    if (retired) return; // already left the count in retireAdaptiveThread
     pthread_mutex_lock(&mProcess->mThreadCountLock);
     LOG_ALWAYS_FATAL_IF(mProcess->mCurrentThreads == 0,
                         "Threadpool thread count = 0. Thread cannot exist and exit in empty "
@@ -767,6 +815,42 @@ void IPCThreadState::joinThreadPool(bool isMain)
     pthread_mutex_unlock(&mProcess->mThreadCountLock);
 }
 
+status_t IPCThreadState::waitForCommand(int timeoutMs)
+{
+    // The driver only hands work to threads that have entered the looper,
+    // and that have nothing left to send.
+    if (mOut.dataSize() > 0) {
+        status_t result = talkWithDriver(false);
+        if (result < NO_ERROR) return result;
+    }
+
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    uint64_t finishedCommands = mProcess->mFinishedCommandsCount;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
+    struct pollfd pfd = {.fd = mProcess->mDriverFD, .events = POLLIN};
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeoutMs));
+    if (ret < 0) return -errno;
+    if (ret == 0) return TIMED_OUT;
+
+    // Every polling thread is woken up for a command, and those which don't
+    // get it block in the driver, where they can't time out. The thread which
+    // got it wakes them up when it finishes, if the pool has idle threads to
+    // spare. If it finished before this thread is counted, poll again.
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    bool raced = mProcess->mFinishedCommandsCount != finishedCommands;
+    if (!raced) mProcess->mAdaptiveThreadsInDriver++;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+    if (raced) return WOULD_BLOCK;
+
+    status_t result = talkWithDriver();
+
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    mProcess->mAdaptiveThreadsInDriver--;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+    return result;
+}
+
 status_t IPCThreadState::setupPolling(int* fd)
 {
     if (mProcess->mDriverFD < 0) {
@@ -110,6 +110,126 @@ static_assert(sizeof(Parcel) == 60);
 static std::atomic<size_t> gParcelGlobalAllocCount;
 static std::atomic<size_t> gParcelGlobalAllocSize;
 
+// See Parcel::setBufferRecyclingEnabled
+static std::atomic<bool> gParcelBufferRecycling;
+static std::atomic<size_t> gParcelGlobalRecycledAllocCount;
+static std::atomic<size_t> gParcelGlobalCachedSize;
+
+namespace {
+// Data buffers released by Parcels on one thread, kept for the next Parcels
+// which allocate on that thread. Buffers are plain malloc allocations, so a
+// buffer may be freed or realloc'd like any other, and recycled on another
+// thread than it was allocated on.
+class ParcelBufferCache {
+public:
+    // Typical transactions fit in the first two. Capacities are rounded up
+    // to these while recycling is enabled.
+    static constexpr size_t kSizeClasses[] = {128, 512, 2048, 8192};
+    static constexpr size_t kNumSizeClasses = sizeof(kSizeClasses) / sizeof(kSizeClasses[0]);
+    static constexpr size_t kMaxBuffersPerClass = 4;
+
+    explicit ParcelBufferCache(bool* destroyed) : mDestroyed(destroyed) {}
+    ~ParcelBufferCache() {
+        clear();
+        *mDestroyed = true;
+    }
+
+    // The cache of the calling thread, or nullptr if it was already destroyed.
+    // Parcels may be freed after that, e.g. IPCThreadState's, which are freed
+    // by a pthread key destructor, after thread_local destructors run. Those
+    // bypass the cache.
+    static ParcelBufferCache* self() {
+        // trivially destructible, so it stays valid until the thread exits
+#ifdef BINDER_RPC_SINGLE_THREADED
+        static bool destroyed = false;
+#else
+        thread_local bool destroyed = false;
+#endif
+        if (destroyed) return nullptr;
+#ifdef BINDER_RPC_SINGLE_THREADED
+        static ParcelBufferCache cache(&destroyed);
+#else
+        thread_local ParcelBufferCache cache(&destroyed);
+#endif
+        return &cache;
+    }
+
+    // Index of the size class for 'capacity', or kNumSizeClasses if it is
+    // too big.
+    static size_t sizeClassFor(size_t capacity) {
+        size_t i = 0;
+        while (i < kNumSizeClasses && kSizeClasses[i] < capacity) i++;
+        return i;
+    }
+
+    uint8_t* take(size_t sizeClass) {
+        Bin& bin = mBins[sizeClass];
+        if (bin.count == 0) return nullptr;
+        gParcelGlobalCachedSize -= kSizeClasses[sizeClass];
+        gParcelGlobalRecycledAllocCount++;
+        return bin.buffers[--bin.count];
+    }
+
+    // false if the buffer must be freed instead
+    bool put(uint8_t* data, size_t capacity) {
+        size_t sizeClass = sizeClassFor(capacity);
+        if (sizeClass == kNumSizeClasses || kSizeClasses[sizeClass] != capacity) return false;
+        Bin& bin = mBins[sizeClass];
+        if (bin.count == kMaxBuffersPerClass) return false;
+        bin.buffers[bin.count++] = data;
+        gParcelGlobalCachedSize += capacity;
+        return true;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < kNumSizeClasses; i++) {
+            while (mBins[i].count > 0) {
+                free(mBins[i].buffers[--mBins[i].count]);
+                gParcelGlobalCachedSize -= kSizeClasses[i];
+            }
+        }
+    }
+
+    size_t cachedSize() const {
+        size_t size = 0;
+        for (size_t i = 0; i < kNumSizeClasses; i++) {
+            size += mBins[i].count * kSizeClasses[i];
+        }
+        return size;
+    }
+
+private:
+    struct Bin {
+        uint8_t* buffers[kMaxBuffersPerClass];
+        size_t count = 0;
+    };
+    Bin mBins[kNumSizeClasses];
+    bool* mDestroyed;
+};
+} // namespace
+
+// Allocates a data buffer of at least '*capacity' bytes, and updates
+// '*capacity' to its actual size.
+static uint8_t* allocParcelData(size_t* capacity) {
+    if (gParcelBufferRecycling.load(std::memory_order_relaxed)) {
+        size_t sizeClass = ParcelBufferCache::sizeClassFor(*capacity);
+        if (sizeClass < ParcelBufferCache::kNumSizeClasses) {
+            *capacity = ParcelBufferCache::kSizeClasses[sizeClass];
+            ParcelBufferCache* cache = ParcelBufferCache::self();
+            if (uint8_t* data = cache ? cache->take(sizeClass) : nullptr) return data;
+        }
+    }
+    return static_cast<uint8_t*>(malloc(*capacity));
+}
+
+static void freeParcelData(uint8_t* data, size_t capacity) {
+    if (gParcelBufferRecycling.load(std::memory_order_relaxed)) {
+        ParcelBufferCache* cache = ParcelBufferCache::self();
+        if (cache && cache->put(data, capacity)) return;
+    }
+    free(data);
+}
+
 // Maximum number of file descriptors per Parcel.
 constexpr size_t kMaxFds = 1024;
 
@@ -408,8 +528,29 @@ size_t Parcel::getGlobalAllocCount() {
     return gParcelGlobalAllocCount.load();
 }
 
+void Parcel::setBufferRecyclingEnabled(bool enabled) {
+    gParcelBufferRecycling = enabled;
+    if (!enabled) {
+        if (ParcelBufferCache* cache = ParcelBufferCache::self()) cache->clear();
+    }
+}
+
+size_t Parcel::getGlobalRecycledAllocCount() {
+    return gParcelGlobalRecycledAllocCount.load();
+}
+
+size_t Parcel::getGlobalCachedSize() {
+    return gParcelGlobalCachedSize.load();
+}
+
+size_t Parcel::getThreadCachedSize() {
+    const ParcelBufferCache* cache = ParcelBufferCache::self();
+    return cache ? cache->cachedSize() : 0;
+}
+
 const uint8_t* Parcel::data() const
 {
+    copyInExternalRegions();
     return mData;
 }
 
@@ -449,6 +590,8 @@ status_t Parcel::setDataSize(size_t size)
         return BAD_VALUE;
     }
 
+    releaseExternalRegions();
+
     status_t err;
     err = continueWrite(size);
     if (err == NO_ERROR) {
@@ -466,6 +609,9 @@ void Parcel::setDataPosition(size_t pos) const
         LOG_ALWAYS_FATAL("pos too big: %zu", pos);
     }
 
+    // reading back or overwriting data which hasn't been copied in yet
+    copyInExternalRegions();
+
     mDataPos = pos;
     if (const auto* kernelFields = maybeKernelFields()) {
         kernelFields->mNextObjectHint = 0;
@@ -515,6 +661,8 @@ status_t Parcel::appendFrom(const Parcel* parcel, size_t offset, size_t len) {
         return BAD_TYPE;
     }
 
+    parcel->copyInExternalRegions();
+
     status_t err;
     const uint8_t* data = parcel->mData;
     int startPos = mDataPos;
@@ -683,6 +831,8 @@ status_t Parcel::appendFrom(const Parcel* parcel, size_t offset, size_t len) {
 }
 
 int Parcel::compareData(const Parcel& other) {
+    // data() copies in external regions, so the reserved space is never
+    // compared uninitialized
     size_t size = dataSize();
     if (size != other.dataSize()) {
         return size < other.dataSize() ? -1 : 1;
@@ -1128,6 +1278,19 @@ restart_write:
     return err;
 }
 
+void Parcel::widenToInt32(int32_t* __restrict out, const char16_t* __restrict in, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = static_cast<int32_t>(in[i]);
+    }
+}
+
+void Parcel::narrowFromInt32(char16_t* __restrict out, const int32_t* __restrict in,
+                             size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = static_cast<char16_t>(in[i]);
+    }
+}
+
 status_t Parcel::write(const void* data, size_t len)
 {
     if (len > INT32_MAX) {
@@ -1382,6 +1545,80 @@ status_t Parcel::writeByteArray(size_t len, const uint8_t *val) {
     return ret;
 }
 
+status_t Parcel::writeExternalByteArray(size_t len, const uint8_t* val,
+                                        std::shared_ptr<const void> keepAlive) {
+    // Below this size, keeping track of the region costs more than the copy.
+    constexpr size_t kMinExternalRegionSize = 4096;
+    // Each region splits the data into more iovecs, which are limited by
+    // transports (e.g. IOV_MAX).
+    constexpr size_t kMaxExternalRegions = 64;
+
+    auto* rpcFields = maybeRpcFields();
+    // Once the data was read in-process, the regions that were copied in are
+    // no longer used, so new ones need a fresh list.
+    if (rpcFields != nullptr && rpcFields->mExternalRegions != nullptr &&
+        rpcFields->mExternalRegions->state.load(std::memory_order_acquire) !=
+                RpcFields::ExternalRegions::PENDING) {
+        releaseExternalRegions();
+    }
+    // Regions can only be appended, which keeps them sorted.
+    if (rpcFields == nullptr || val == nullptr || len < kMinExternalRegionSize ||
+        len > INT32_MAX ||
+        (rpcFields->mExternalRegions != nullptr &&
+         rpcFields->mExternalRegions->regions.size() >= kMaxExternalRegions) ||
+        mDataPos != mDataSize) {
+        return writeByteArray(len, val);
+    }
+
+    status_t ret = writeInt32(static_cast<uint32_t>(len));
+    if (ret != NO_ERROR) return ret;
+
+    // Reserve the space (and write the padding), but leave it unwritten.
+    uint8_t* reserved = reinterpret_cast<uint8_t*>(writeInplace(len));
+    if (reserved == nullptr) return mError;
+
+    if (rpcFields->mExternalRegions == nullptr) {
+        rpcFields->mExternalRegions = std::make_unique<RpcFields::ExternalRegions>();
+    }
+    rpcFields->mExternalRegions->regions.push_back(RpcFields::ExternalRegion{
+            .offset = static_cast<size_t>(reserved - mData),
+            .size = len,
+            .data = val,
+            .keepAlive = std::move(keepAlive),
+    });
+    return NO_ERROR;
+}
+
+void Parcel::copyInExternalRegions() const {
+    const auto* rpcFields = maybeRpcFields();
+    if (rpcFields == nullptr || rpcFields->mExternalRegions == nullptr) return;
+
+    using Regions = RpcFields::ExternalRegions;
+    Regions& regions = *rpcFields->mExternalRegions;
+    Regions::State state = regions.state.load(std::memory_order_acquire);
+    if (state == Regions::PENDING &&
+        regions.state.compare_exchange_strong(state, Regions::COPYING,
+                                              std::memory_order_acquire)) {
+        for (const auto& region : regions.regions) {
+            memcpy(mData + region.offset, region.data, region.size);
+        }
+        regions.state.store(Regions::COPIED, std::memory_order_release);
+        return;
+    }
+    // Another thread is copying them in. This is only a few memcpys, and only
+    // happens when the same Parcel is first read by several threads at once.
+    while (state != Regions::COPIED) {
+        state = regions.state.load(std::memory_order_acquire);
+    }
+}
+
+void Parcel::releaseExternalRegions() {
+    copyInExternalRegions();
+    if (auto* rpcFields = maybeRpcFields()) {
+        rpcFields->mExternalRegions.reset();
+    }
+}
+
 status_t Parcel::writeBool(bool val)
 {
     return writeInt32(int32_t(val));
@@ -1924,6 +2161,34 @@ const void* Parcel::readInplace(size_t len) const
     return nullptr;
 }
 
+template <typename T>
+static status_t readArrayInplaceImpl(const Parcel* parcel, const T** outData, size_t* outSize) {
+    *outData = nullptr;
+    *outSize = 0;
+
+    int32_t count;
+    if (status_t status = parcel->readInt32(&count); status != OK) return status;
+    if (count < 0) return UNEXPECTED_NULL;
+
+    int32_t byteSize;
+    if (__builtin_smul_overflow(sizeof(T), count, &byteSize)) return BAD_VALUE;
+
+    const void* data = parcel->readInplace(byteSize);
+    if (data == nullptr) return BAD_VALUE;
+
+    *outData = static_cast<const T*>(data);
+    *outSize = count;
+    return OK;
+}
+
+status_t Parcel::readByteArrayInplace(const uint8_t** outData, size_t* outSize) const {
+    return readArrayInplaceImpl(this, outData, outSize);
+}
+
+status_t Parcel::readInt32ArrayInplace(const int32_t** outData, size_t* outSize) const {
+    return readArrayInplaceImpl(this, outData, outSize);
+}
+
 status_t Parcel::readOutVectorSizeWithCheck(size_t elmSize, int32_t* size) const {
     if (status_t status = readInt32(size); status != OK) return status;
     if (*size < 0) return OK; // may be null, client to handle
@@ -2230,6 +2495,18 @@ const char* Parcel::readString8Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString8Inplace(std::string_view* str) const
+{
+    size_t len;
+    const char* data = readString8Inplace(&len);
+    if (data == nullptr) {
+        *str = std::string_view();
+        return UNEXPECTED_NULL;
+    }
+    *str = std::string_view(data, len);
+    return OK;
+}
+
 String16 Parcel::readString16() const
 {
     size_t len;
@@ -2275,6 +2552,18 @@ const char16_t* Parcel::readString16Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString16Inplace(std::u16string_view* str) const
+{
+    size_t len;
+    const char16_t* data = readString16Inplace(&len);
+    if (data == nullptr) {
+        *str = std::u16string_view();
+        return UNEXPECTED_NULL;
+    }
+    *str = std::u16string_view(data, len);
+    return OK;
+}
+
 status_t Parcel::readStrongBinder(sp<IBinder>* val) const
 {
     status_t status = readNullableStrongBinder(val);
@@ -2651,6 +2940,7 @@ void Parcel::closeFileDescriptors() {
 
 uintptr_t Parcel::ipcData() const
 {
+    copyInExternalRegions();
     return reinterpret_cast<uintptr_t>(mData);
 }
 
@@ -2879,7 +3169,7 @@ void Parcel::freeDataNoInit()
             if (mDeallocZero) {
                 zeroMemory(mData, mDataSize);
             }
-            free(mData);
+            freeParcelData(mData, mDataCapacity);
         }
         auto* kernelFields = maybeKernelFields();
         if (kernelFields && kernelFields->mObjects) free(kernelFields->mObjects);
@@ -2917,6 +3207,26 @@ static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t newCap
     return newData;
 }
 
+// Like reallocZeroFree, but may round up '*newCapacity' (see allocParcelData).
+static uint8_t* reallocParcelData(uint8_t* data, size_t oldCapacity, size_t* newCapacity,
+                                  bool zero) {
+    if (!gParcelBufferRecycling.load(std::memory_order_relaxed) ||
+        ParcelBufferCache::sizeClassFor(*newCapacity) == ParcelBufferCache::kNumSizeClasses) {
+        return reallocZeroFree(data, oldCapacity, *newCapacity, zero);
+    }
+    uint8_t* newData = allocParcelData(newCapacity);
+    if (!newData) {
+        return nullptr;
+    }
+
+    memcpy(newData, data, std::min(oldCapacity, *newCapacity));
+    if (zero) {
+        zeroMemory(data, oldCapacity);
+    }
+    freeParcelData(data, oldCapacity);
+    return newData;
+}
+
 status_t Parcel::restartWrite(size_t desired)
 {
     if (desired > INT32_MAX) {
@@ -2968,6 +3278,7 @@ status_t Parcel::restartWrite(size_t desired)
     } else if (auto* rpcFields = maybeRpcFields()) {
         rpcFields->mObjectPositions.clear();
         rpcFields->mFds.reset();
+        rpcFields->mExternalRegions.reset();
     }
     mAllowFds = true;
 
@@ -3120,7 +3431,7 @@ status_t Parcel::continueWrite(size_t desired)
 
         // We own the data, so we can just do a realloc().
         if (desired > mDataCapacity) {
-            uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
+            uint8_t* data = reallocParcelData(mData, mDataCapacity, &desired, mDeallocZero);
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
                         desired);
@@ -3145,7 +3456,7 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = allocParcelData(&desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -28,6 +28,7 @@
 #include <utils/AndroidThreads.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
+#include <utils/SystemClock.h>
 #include <utils/Thread.h>
 
 #include "Static.h"
@@ -66,19 +67,20 @@ using android::binder::unique_fd;
 class PoolThread : public Thread
 {
 public:
-    explicit PoolThread(bool isMain)
-        : mIsMain(isMain)
+    explicit PoolThread(bool isMain, bool isAdaptive = false)
+        : mIsMain(isMain), mIsAdaptive(isAdaptive)
     {
     }
 
 protected:
     virtual bool threadLoop()
     {
-        IPCThreadState::self()->joinThreadPool(mIsMain);
+        IPCThreadState::self()->joinThreadPoolInternal(mIsMain, mIsAdaptive);
         return false;
     }
 
     const bool mIsMain;
+    const bool mIsAdaptive;
 };
 
 sp<ProcessState> ProcessState::self()
@@ -418,11 +420,151 @@ void ProcessState::spawnPooledThread(bool isMain)
     // to return too high of a value.
 }
 
+bool ProcessState::reserveAdaptiveThreadLocked() {
+    if (!mThreadPoolStarted) return false;
+    int64_t now = uptimeMillis();
+
+    size_t idle = idleThreadsLocked();
+    if (idle == 0) mLastSaturatedTimeMs = now;
+
+    // after the pool was saturated, keep an extra thread ready for a while
+    size_t spare = mSpareThreads;
+    if (mLastSaturatedTimeMs != 0 && now - mLastSaturatedTimeMs < mIdleTimeoutMs) spare++;
+
+    if (idle >= spare) return false;
+    mLastBusyTimeMs = now;
+
+    // same limit as getThreadPoolMaxTotalThreadCount: startThreadPool's
+    // thread, plus mMaxThreads more
+    if (idle + mPendingAdaptiveThreads >= spare || mKernelStartedThreads >= mMaxThreads + 1) {
+        return false;
+    }
+
+    mPendingAdaptiveThreads++;
+    mKernelStartedThreads++;
+    mAdaptiveThreadsSpawned++;
+    return true;
+}
+
+void ProcessState::spawnAdaptiveThread() {
+    String8 name = makeBinderThreadName();
+    ALOGV("Spawning new adaptive pooled thread, name=%s\n", name.c_str());
+    sp<Thread> t = sp<PoolThread>::make(false /*isMain*/, true /*isAdaptive*/);
+    if (status_t status = t->run(name.c_str()); status != OK) {
+        ALOGE("Could not spawn adaptive binder thread: %s", statusToString(status).c_str());
+        pthread_mutex_lock(&mThreadCountLock);
+        mPendingAdaptiveThreads--;
+        mKernelStartedThreads--;
+        mAdaptiveThreadsSpawned--;
+        pthread_mutex_unlock(&mThreadCountLock);
+    }
+}
+
+bool ProcessState::retireAdaptiveThread() {
+    pthread_mutex_lock(&mThreadCountLock);
+    bool retire = idleThreadsLocked() > mSpareThreads &&
+            uptimeMillis() - mLastBusyTimeMs >= mIdleTimeoutMs;
+    if (retire) {
+        // leave the pool now, so that other threads don't retire on its behalf
+        mCurrentThreads--;
+        mKernelStartedThreads--;
+        mAdaptiveThreadsRetired++;
+    }
+    // threads blocked in the driver can't time out, so they are woken up
+    // here to do it, in case no command finishes to wake them up
+    bool wake = shouldWakeAdaptiveThreadsLocked();
+    pthread_mutex_unlock(&mThreadCountLock);
+
+    if (wake) wakeWaitingThreads();
+    return retire;
+}
+
+size_t ProcessState::idleThreadsLocked() const {
+    return mCurrentThreads > mExecutingThreadsCount ? mCurrentThreads - mExecutingThreadsCount
+                                                    : 0;
+}
+
+bool ProcessState::shouldWakeAdaptiveThreadsLocked() const {
+    return mAdaptiveThreadsInDriver > 0 && idleThreadsLocked() > mSpareThreads;
+}
+
+void ProcessState::wakeWaitingThreads() {
+    // The driver has no command to wake up another thread, but flushing the
+    // binder fd, which closing any duplicate of it does, makes every thread of
+    // this process return from BINDER_WRITE_READ once, with only a BR_NOOP.
+    int fd = fcntl(mDriverFD, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        ALOGE("Could not wake up binder threads: %s", statusToString(-errno).c_str());
+        return;
+    }
+    close(fd);
+}
+
+status_t ProcessState::setThreadPoolAdaptive(size_t spareThreads,
+                                             std::chrono::milliseconds idleTimeout) {
+    LOG_ALWAYS_FATAL_IF(mThreadPoolStarted,
+                        "Adaptive binder threadpool must be configured before starting it");
+    if (spareThreads == 0) {
+        ALOGE("Adaptive binder threadpool needs at least one spare thread");
+        return BAD_VALUE;
+    }
+
+    // libbinder starts all threads past the first one itself, so stop the
+    // kernel from requesting them.
+    size_t kernelMaxThreads = 0;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) == -1) {
+        status_t result = -errno;
+        ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
+        return result;
+    }
+
+    pthread_mutex_lock(&mThreadCountLock);
+    mAdaptive = true;
+    mSpareThreads = spareThreads;
+    mIdleTimeoutMs = idleTimeout.count();
+    pthread_mutex_unlock(&mThreadCountLock);
+    return NO_ERROR;
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() const {
+    pthread_mutex_lock(&mThreadCountLock);
+    auto unlockGuard = make_scope_guard([&]() { pthread_mutex_unlock(&mThreadCountLock); });
+
+    return ThreadPoolStats{
+            .maxThreads = mMaxThreads,
+            .currentThreads = mCurrentThreads,
+            .executingThreads = mExecutingThreadsCount,
+            .threadsSpawned = mAdaptiveThreadsSpawned,
+            .threadsRetired = mAdaptiveThreadsRetired,
+            .starvationCount = mStarvationCount,
+            .starvationTimeMs = mTotalStarvationTimeMs,
+            .maxStarvationTimeMs = mMaxStarvationTimeMs,
+    };
+}
+
+void ProcessState::dumpThreadPool(std::ostream& out) const {
+    ThreadPoolStats stats = getThreadPoolStats();
+    out << "Binder threadpool (" << (mAdaptive ? "adaptive" : "kernel-managed") << "):\n"
+        << "  max threads: " << stats.maxThreads << "\n"
+        << "  current threads: " << stats.currentThreads << " (" << stats.executingThreads
+        << " executing)\n";
+    if (mAdaptive) {
+        out << "  spare threads: " << mSpareThreads << ", idle timeout: " << mIdleTimeoutMs
+            << " ms\n"
+            << "  threads spawned: " << stats.threadsSpawned
+            << ", retired: " << stats.threadsRetired << "\n";
+    }
+    out << "  starved: " << stats.starvationCount << " times, " << stats.starvationTimeMs
+        << " ms total, " << stats.maxStarvationTimeMs << " ms max\n";
+}
+
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     LOG_ALWAYS_FATAL_IF(mThreadPoolStarted && maxThreads < mMaxThreads,
            "Binder threadpool cannot be shrunk after starting");
     status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+    // in adaptive mode, the kernel is kept from starting threads
+    size_t kernelMaxThreads = mAdaptive ? 0 : maxThreads;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) != -1) {
         mMaxThreads = maxThreads;
     } else {
         result = -errno;
@@ -561,6 +703,19 @@ ProcessState::ProcessState(const char* driver)
         mCurrentThreads(0),
         mKernelStartedThreads(0),
         mStarvationStartTimeMs(0),
+        mStarvationCount(0),
+        mTotalStarvationTimeMs(0),
+        mMaxStarvationTimeMs(0),
+        mAdaptive(false),
+        mSpareThreads(0),
+        mIdleTimeoutMs(0),
+        mPendingAdaptiveThreads(0),
+        mLastBusyTimeMs(0),
+        mLastSaturatedTimeMs(0),
+        mAdaptiveThreadsSpawned(0),
+        mAdaptiveThreadsRetired(0),
+        mAdaptiveThreadsInDriver(0),
+        mFinishedCommandsCount(0),
         mForked(false),
         mThreadPoolStarted(false),
         mThreadPoolSeq(1),
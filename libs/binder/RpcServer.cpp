@@ -22,6 +22,10 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#ifndef BINDER_RPC_SINGLE_THREADED
+#include <sys/epoll.h>
+#endif
+
 #include <thread>
 #include <vector>
 
@@ -33,6 +37,7 @@
 
 #include "BuildFlags.h"
 #include "FdTrigger.h"
+#include "JavaThreadAttacher.h"
 #include "OS.h"
 #include "RpcSocketAddress.h"
 #include "RpcState.h"
@@ -48,6 +53,121 @@ using namespace android::binder::impl;
 using android::binder::borrowed_fd;
 using android::binder::unique_fd;
 
+#ifndef BINDER_RPC_SINGLE_THREADED
+struct RpcServer::EventLoop {
+    // epoll data of the server's shutdown trigger. Level-triggered, so that
+    // every thread sees it. Everything else is one-shot.
+    static constexpr uint64_t kShutdownKey = 0;
+
+    unique_fd epollFd;
+    // guarded by RpcServer::mLock
+    size_t numThreads = 0;
+
+    RpcMutex mutex; // for below
+    RpcConditionVariable cv; // notified when registrations are removed
+
+    struct Registration {
+        sp<RpcSession> session;
+        // nullptr for the registration of the session's shutdown trigger
+        sp<RpcSession::RpcConnection> connection;
+        int fd = -1;
+        // a thread is serving this connection, so it isn't armed in the epoll
+        // set, and only that thread may remove it
+        bool busy = false;
+    };
+    std::map<uint64_t, Registration> registrations;
+    struct SessionRegistration {
+        uint64_t shutdownKey;
+        size_t numConnections = 0;
+    };
+    std::map<sp<RpcSession>, SessionRegistration> sessions;
+    uint64_t nextKey = kShutdownKey + 1;
+
+    status_t ctl(int op, int fd, uint64_t key, uint32_t events = EPOLLIN | EPOLLONESHOT) {
+        epoll_event event{.events = events, .data = {.u64 = key}};
+        if (0 != epoll_ctl(epollFd.get(), op, fd, &event)) {
+            int savedErrno = errno;
+            ALOGE("Failed epoll_ctl(%d) on fd %d: %s", op, fd, strerror(savedErrno));
+            return -savedErrno;
+        }
+        return OK;
+    }
+
+    status_t addLocked(const sp<RpcSession>& session, int sessionShutdownFd,
+                       const sp<RpcSession::RpcConnection>& connection, int fd) {
+        auto sessionIt = sessions.find(session);
+        if (sessionIt == sessions.end()) {
+            uint64_t shutdownKey = nextKey++;
+            if (status_t status = ctl(EPOLL_CTL_ADD, sessionShutdownFd, shutdownKey);
+                status != OK) {
+                return status;
+            }
+            registrations[shutdownKey] = Registration{.session = session, .fd = sessionShutdownFd};
+            sessionIt = sessions.emplace(session, SessionRegistration{.shutdownKey = shutdownKey})
+                                .first;
+        }
+
+        uint64_t key = nextKey++;
+        if (status_t status = ctl(EPOLL_CTL_ADD, fd, key); status != OK) {
+            if (sessionIt->second.numConnections == 0) removeSessionLocked(sessionIt);
+            return status;
+        }
+        registrations[key] = Registration{.session = session, .connection = connection, .fd = fd};
+        sessionIt->second.numConnections++;
+        return OK;
+    }
+
+    // Removed connections must be passed to RpcSession::endIncomingConnection
+    // once the lock is released.
+    void removeLocked(uint64_t key, std::vector<Registration>* closed) {
+        auto it = registrations.find(key);
+        LOG_ALWAYS_FATAL_IF(it == registrations.end() || it->second.connection == nullptr);
+        (void)epoll_ctl(epollFd.get(), EPOLL_CTL_DEL, it->second.fd, nullptr);
+
+        auto sessionIt = sessions.find(it->second.session);
+        LOG_ALWAYS_FATAL_IF(sessionIt == sessions.end());
+        closed->push_back(std::move(it->second));
+        registrations.erase(it);
+
+        if (--sessionIt->second.numConnections == 0) removeSessionLocked(sessionIt);
+    }
+
+    void removeSessionLocked(std::map<sp<RpcSession>, SessionRegistration>::iterator sessionIt) {
+        auto it = registrations.find(sessionIt->second.shutdownKey);
+        LOG_ALWAYS_FATAL_IF(it == registrations.end());
+        (void)epoll_ctl(epollFd.get(), EPOLL_CTL_DEL, it->second.fd, nullptr);
+        registrations.erase(it);
+        sessions.erase(sessionIt);
+    }
+
+    // Removes connections which aren't being served, either of one session,
+    // or of all sessions if 'session' is null.
+    void removeIdleLocked(const sp<RpcSession>& session, std::vector<Registration>* closed) {
+        std::vector<uint64_t> keys;
+        for (const auto& [key, registration] : registrations) {
+            if (registration.connection != nullptr && !registration.busy &&
+                (session == nullptr || registration.session == session)) {
+                keys.push_back(key);
+            }
+        }
+        for (uint64_t key : keys) removeLocked(key, closed);
+    }
+
+    void endConnections(std::vector<Registration>&& closed) {
+        if (closed.empty()) return;
+        for (Registration& registration : closed) {
+            RpcSession::endIncomingConnection(std::move(registration.session),
+                                              registration.connection);
+        }
+        cv.notify_all();
+    }
+};
+#else  // BINDER_RPC_SINGLE_THREADED
+struct RpcServer::EventLoop {
+    size_t numThreads = 0;
+};
+#endif // BINDER_RPC_SINGLE_THREADED
+
 RpcServer::RpcServer(std::unique_ptr<RpcTransportCtx> ctx) : mCtx(std::move(ctx)) {}
 RpcServer::~RpcServer() {
     RpcMutexUniqueLock _l(mLock);
@@ -124,6 +244,12 @@ size_t RpcServer::getMaxThreads() {
     return mMaxThreads;
 }
 
+void RpcServer::setEventLoopThreads(size_t threads) {
+    LOG_ALWAYS_FATAL_IF(!kEnableRpcThreads, "Event loop requires threads");
+    LOG_ALWAYS_FATAL_IF(mJoinThreadRunning, "Cannot set event loop threads while running");
+    mEventLoopThreads = threads;
+}
+
 bool RpcServer::setProtocolVersion(uint32_t version) {
     if (!RpcState::validateProtocolVersion(version)) {
         return false;
@@ -247,6 +373,25 @@ void RpcServer::join() {
         mJoinThreadRunning = true;
         mShutdownTrigger = FdTrigger::make();
         LOG_ALWAYS_FATAL_IF(mShutdownTrigger == nullptr, "Cannot create join signaler");
+
+#ifndef BINDER_RPC_SINGLE_THREADED
+        if (mEventLoopThreads > 0) {
+            mEventLoop = std::make_unique<EventLoop>();
+            mEventLoop->epollFd.reset(epoll_create1(EPOLL_CLOEXEC));
+            LOG_ALWAYS_FATAL_IF(!mEventLoop->epollFd.ok(), "Cannot create epoll set: %s",
+                                strerror(errno));
+            LOG_ALWAYS_FATAL_IF(OK !=
+                                        mEventLoop->ctl(EPOLL_CTL_ADD,
+                                                        mShutdownTrigger->readFd().get(),
+                                                        EventLoop::kShutdownKey, EPOLLIN),
+                                "Cannot add shutdown trigger to epoll set");
+            for (size_t i = 0; i < mEventLoopThreads; i++) {
+                RpcMaybeThread(&RpcServer::eventLoopThread, sp<RpcServer>::fromExisting(this))
+                        .detach();
+                mEventLoop->numThreads++;
+            }
+        }
+#endif
     }
 
     status_t status;
@@ -278,10 +423,18 @@ void RpcServer::join() {
 
         {
             RpcMutexLockGuard _l(mLock);
+            std::function<void(sp<RpcSession>&&, RpcSession::PreJoinSetupResult&&)> joinFn =
+                    RpcSession::join;
+            if (mEventLoop != nullptr) {
+                joinFn = [fd = clientSocket.fd.get()](sp<RpcSession>&& session,
+                                                      RpcSession::PreJoinSetupResult&& result) {
+                    joinEventLoop(fd, std::move(session), std::move(result));
+                };
+            }
             RpcMaybeThread thread =
                     RpcMaybeThread(&RpcServer::establishConnection,
                                    sp<RpcServer>::fromExisting(this), std::move(clientSocket), addr,
-                                   addrLen, RpcSession::join);
+                                   addrLen, std::move(joinFn));
 
             auto& threadRef = mConnectingThreads[thread.get_id()];
             threadRef = std::move(thread);
@@ -324,14 +477,18 @@ bool RpcServer::shutdown() {
         return true;
     }
 
-    while (mJoinThreadRunning || !mConnectingThreads.empty() || !mSessions.empty()) {
+    auto eventLoopThreads = [&] { return mEventLoop == nullptr ? 0 : mEventLoop->numThreads; };
+    while (mJoinThreadRunning || !mConnectingThreads.empty() || !mSessions.empty() ||
+           eventLoopThreads() > 0) {
         if (std::cv_status::timeout == mShutdownCv.wait_for(_l, std::chrono::seconds(1))) {
             ALOGE("Waiting for RpcServer to shut down (1s w/o progress). Join thread running: %d, "
                   "Connecting threads: "
-                  "%zu, Sessions: %zu. Is your server deadlocked?",
-                  mJoinThreadRunning, mConnectingThreads.size(), mSessions.size());
+                  "%zu, Sessions: %zu, Event loop threads: %zu. Is your server deadlocked?",
+                  mJoinThreadRunning, mConnectingThreads.size(), mSessions.size(),
+                  eventLoopThreads());
         }
     }
+    mEventLoop = nullptr;
 
     // At this point, we know join() is about to exit, but the thread that calls
     // join() may not have exited yet.
@@ -558,6 +715,141 @@ void RpcServer::establishConnection(
     joinFn(std::move(session), std::move(setupResult));
 }
 
+void RpcServer::joinEventLoop(int fd, sp<RpcSession>&& session,
+                              RpcSession::PreJoinSetupResult&& result) {
+#ifndef BINDER_RPC_SINGLE_THREADED
+    sp<RpcServer> server = session->server();
+    if (result.status != OK || server == nullptr) {
+        // reports the error and cleans up
+        RpcSession::join(std::move(session), std::move(result));
+        return;
+    }
+
+    session->releaseJoinThread(result.connection);
+
+    EventLoop& loop = *server->mEventLoop;
+    status_t status;
+    {
+        RpcMutexLockGuard _l(loop.mutex);
+        if (server->mShutdownTrigger->isTriggered() || session->mShutdownTrigger->isTriggered()) {
+            status = DEAD_OBJECT;
+        } else {
+            status = loop.addLocked(session, session->mShutdownTrigger->readFd().get(),
+                                    result.connection, fd);
+        }
+    }
+    if (status != OK) {
+        RpcSession::endIncomingConnection(std::move(session), result.connection);
+    }
+#else
+    RpcSession::join(std::move(session), std::move(result));
+    (void)fd;
+#endif
+}
+
+void RpcServer::eventLoopThread(sp<RpcServer>&& server) {
+#ifndef BINDER_RPC_SINGLE_THREADED
+    EventLoop& loop = *server->mEventLoop;
+    {
+        [[maybe_unused]] JavaThreadAttacher javaThreadAttacher;
+        while (true) {
+            epoll_event event;
+            int ret = TEMP_FAILURE_RETRY(epoll_wait(loop.epollFd.get(), &event, 1, -1));
+            LOG_ALWAYS_FATAL_IF(ret < 0, "Failed epoll_wait: %s", strerror(errno));
+            if (ret == 0) continue;
+            if (event.data.u64 == EventLoop::kShutdownKey) break;
+            server->serveEventLoopKey(event.data.u64);
+        }
+
+        // All sessions are also shutting down. Connections which are being
+        // served are closed by their threads, and new connections may still
+        // be racing with shutdown.
+        while (true) {
+            server->closeIdleEventLoopConnections();
+            RpcMutexUniqueLock _l(loop.mutex);
+            if (loop.registrations.empty()) break;
+            loop.cv.wait_for(_l, std::chrono::milliseconds(100));
+        }
+    }
+
+    {
+        RpcMutexLockGuard _l(server->mLock);
+        loop.numThreads--;
+    }
+    server->mShutdownCv.notify_all();
+#else
+    (void)server;
+#endif
+}
+
+void RpcServer::serveEventLoopKey(uint64_t key) {
+#ifndef BINDER_RPC_SINGLE_THREADED
+    EventLoop& loop = *mEventLoop;
+    sp<RpcSession> session;
+    sp<RpcSession::RpcConnection> connection;
+    std::vector<EventLoop::Registration> closed;
+    {
+        RpcMutexLockGuard _l(loop.mutex);
+        auto it = loop.registrations.find(key);
+        // removed after the event was reported
+        if (it == loop.registrations.end()) return;
+
+        if (it->second.connection == nullptr) {
+            // session shutdown trigger
+            loop.removeIdleLocked(it->second.session, &closed);
+        } else {
+            it->second.busy = true;
+            session = it->second.session;
+            connection = it->second.connection;
+        }
+    }
+
+    if (connection != nullptr) {
+        {
+            // so that nested transactions use this connection
+            RpcMutexLockGuard _l(session->mMutex);
+            connection->exclusiveTid = binder::os::GetThreadId();
+        }
+        status_t status;
+        do {
+            status = session->state()->drainCommands(connection, session,
+                                                     RpcState::CommandType::ANY);
+        } while (status == OK && connection->rpcTransport->prepareToPollRead() == OK);
+        if (status != OK) {
+            LOG_RPC_DETAIL("Binder connection closing w/ status %s",
+                           statusToString(status).c_str());
+        }
+        session->clearConnectionTid(connection);
+
+        RpcMutexLockGuard _l(loop.mutex);
+        auto it = loop.registrations.find(key);
+        LOG_ALWAYS_FATAL_IF(it == loop.registrations.end(),
+                            "Busy connection removed by another thread");
+        it->second.busy = false;
+        bool close = status != OK || session->mShutdownTrigger->isTriggered() ||
+                mShutdownTrigger->isTriggered();
+        if (!close && loop.ctl(EPOLL_CTL_MOD, it->second.fd, key) != OK) close = true;
+        if (close) loop.removeLocked(key, &closed);
+    }
+
+    loop.endConnections(std::move(closed));
+#else
+    (void)key;
+#endif
+}
+
+void RpcServer::closeIdleEventLoopConnections() {
+#ifndef BINDER_RPC_SINGLE_THREADED
+    EventLoop& loop = *mEventLoop;
+    std::vector<EventLoop::Registration> closed;
+    {
+        RpcMutexLockGuard _l(loop.mutex);
+        loop.removeIdleLocked(nullptr, &closed);
+    }
+    loop.endConnections(std::move(closed));
+#endif
+}
+
 status_t RpcServer::setupSocketServer(const RpcSocketAddress& addr) {
     LOG_RPC_DETAIL("Setting up socket server %s", addr.toString().c_str());
     LOG_ALWAYS_FATAL_IF(hasServer(), "Each RpcServer can only have one server.");
@@ -18,7 +18,6 @@
 
 #include <binder/RpcSession.h>
 
-#include <dlfcn.h>
 #include <inttypes.h>
 #include <netinet/tcp.h>
 #include <poll.h>
@@ -36,6 +35,7 @@
 
 #include "BuildFlags.h"
 #include "FdTrigger.h"
+#include "JavaThreadAttacher.h"
 #include "OS.h"
 #include "RpcSocketAddress.h"
 #include "RpcState.h"
@@ -43,11 +43,6 @@
 #include "RpcWireFormat.h"
 #include "Utils.h"
 
-#if defined(__ANDROID__) && !defined(__ANDROID_RECOVERY__)
-#include <jni.h>
-extern "C" JavaVM* AndroidRuntimeGetJavaVM();
-#endif
-
 namespace android {
 
 using namespace android::binder::impl;
@@ -62,6 +57,8 @@ RpcSession::RpcSession(std::unique_ptr<RpcTransportCtx> ctx) : mCtx(std::move(ct
 RpcSession::~RpcSession() {
     LOG_RPC_DETAIL("RpcSession destroyed %p", this);
 
+    stopDecStrongFlusher();
+
     RpcMutexLockGuard _l(mMutex);
     LOG_ALWAYS_FATAL_IF(mConnections.mIncoming.size() != 0,
                         "Should not be able to destroy a session with servers in use.");
@@ -254,6 +251,8 @@ bool RpcSession::shutdownAndWait(bool wait) {
 
     _l.unlock();
 
+    stopDecStrongFlusher();
+
     if (status_t res = state()->sendObituaries(sp<RpcSession>::fromExisting(this)); res != OK) {
         ALOGE("Failed to send obituaries as the RpcSession is shutting down: %s",
               statusToString(res).c_str());
@@ -283,6 +282,31 @@ status_t RpcSession::sendDecStrong(const BpBinder* binder) {
 }
 
 status_t RpcSession::sendDecStrongToTarget(uint64_t address, size_t target) {
+    bool batch = RpcState::batchesDecStrongs(sp<RpcSession>::fromExisting(this));
+    if (batch) {
+        // batches are flushed on outgoing connections, so without them, drops
+        // are sent right away on the connection this thread is serving
+        RpcMutexLockGuard _l(mMutex);
+        batch = !mConnections.mOutgoing.empty();
+    }
+    if (batch) {
+        RpcState::DecStrongFlush flush;
+        if (status_t status = state()->queueDecStrongToTarget(sp<RpcSession>::fromExisting(this),
+                                                              address, target, &flush);
+            status != OK) {
+            return status;
+        }
+        switch (flush) {
+            case RpcState::DecStrongFlush::NONE:
+                return OK;
+            case RpcState::DecStrongFlush::NOW:
+                return flushDecStrongs(false /*scheduled*/);
+            case RpcState::DecStrongFlush::LATER:
+                scheduleDecStrongFlush();
+                return OK;
+        }
+    }
+
     ExclusiveConnection connection;
     status_t status = ExclusiveConnection::find(sp<RpcSession>::fromExisting(this),
                                                 ConnectionUse::CLIENT_REFCOUNT, &connection);
@@ -291,6 +315,87 @@ status_t RpcSession::sendDecStrongToTarget(uint64_t address, size_t target) {
                                           address, target);
 }
 
+status_t RpcSession::flushDecStrongs(bool scheduled) {
+    ExclusiveConnection connection;
+    status_t status = ExclusiveConnection::find(sp<RpcSession>::fromExisting(this),
+                                                ConnectionUse::CLIENT_REFCOUNT, &connection);
+    if (status != OK) {
+        // the session is going away, and its refcounts with it
+        if (scheduled) state()->abandonDecStrongFlush();
+        return status;
+    }
+    return state()->flushDecStrongs(connection.get(), sp<RpcSession>::fromExisting(this),
+                                    scheduled);
+}
+
+void RpcSession::scheduleDecStrongFlush() {
+    std::shared_ptr<DecStrongFlusher> flusher;
+    {
+        RpcMutexLockGuard _l(mMutex);
+        if (mDecStrongFlusher == nullptr) {
+            mDecStrongFlusher = std::make_shared<DecStrongFlusher>();
+            mDecStrongFlusher->thread = RpcMaybeThread(&RpcSession::decStrongFlushLoop,
+                                                       wp<RpcSession>::fromExisting(this),
+                                                       std::shared_ptr(mDecStrongFlusher));
+        }
+        flusher = mDecStrongFlusher;
+    }
+
+    {
+        RpcMutexLockGuard _l(flusher->mutex);
+        flusher->scheduled = true;
+    }
+    flusher->cv.notify_one();
+}
+
+void RpcSession::stopDecStrongFlusher() {
+    std::shared_ptr<DecStrongFlusher> flusher;
+    {
+        RpcMutexLockGuard _l(mMutex);
+        flusher = std::move(mDecStrongFlusher);
+    }
+    if (flusher == nullptr) return;
+
+    {
+        RpcMutexLockGuard _l(flusher->mutex);
+        flusher->stopped = true;
+    }
+    flusher->cv.notify_one();
+
+    // A failed flush shuts the session down, and the last reference to the
+    // session may be dropped by the flusher. Either way, the flusher returns
+    // right after, without touching the session.
+    if (flusher->thread.get_id() == rpc_this_thread::get_id()) {
+        flusher->thread.detach();
+    } else {
+        flusher->thread.join();
+    }
+}
+
+void RpcSession::decStrongFlushLoop(wp<RpcSession> weakSession,
+                                    std::shared_ptr<DecStrongFlusher> flusher) {
+    // Refcounts dropped while this waits are sent together.
+    constexpr std::chrono::microseconds kDecStrongFlushDelay(500);
+
+    RpcMutexUniqueLock _l(flusher->mutex);
+    while (true) {
+        flusher->cv.wait(_l, [&] { return flusher->scheduled || flusher->stopped; });
+        if (!flusher->scheduled) break;
+        flusher->cv.wait_for(_l, kDecStrongFlushDelay, [&] { return flusher->stopped; });
+        flusher->scheduled = false;
+        _l.unlock();
+
+        // if the session is already gone, so are its refcounts
+        if (sp<RpcSession> session = weakSession.promote(); session != nullptr) {
+            if (status_t status = session->flushDecStrongs(true /*scheduled*/); status != OK) {
+                LOG_RPC_DETAIL("Failed to flush dec strongs: %s", statusToString(status).c_str());
+            }
+        }
+
+        _l.lock();
+    }
+}
+
 status_t RpcSession::readId() {
     {
         RpcMutexLockGuard _l(mMutex);
@@ -361,68 +466,6 @@ RpcSession::PreJoinSetupResult RpcSession::preJoinSetup(
     };
 }
 
-namespace {
-#if !defined(__ANDROID__) || defined(__ANDROID_RECOVERY__)
-class JavaThreadAttacher {};
-#else
-// RAII object for attaching / detaching current thread to JVM if Android Runtime exists. If
-// Android Runtime doesn't exist, no-op.
-class JavaThreadAttacher {
-public:
-    JavaThreadAttacher() {
-        // Use dlsym to find androidJavaAttachThread because libandroid_runtime is loaded after
-        // libbinder.
-        auto vm = getJavaVM();
-        if (vm == nullptr) return;
-
-        char threadName[16];
-        if (0 != pthread_getname_np(pthread_self(), threadName, sizeof(threadName))) {
-            constexpr const char* defaultThreadName = "UnknownRpcSessionThread";
-            memcpy(threadName, defaultThreadName,
-                   std::min<size_t>(sizeof(threadName), strlen(defaultThreadName) + 1));
-        }
-        LOG_RPC_DETAIL("Attaching current thread %s to JVM", threadName);
-        JavaVMAttachArgs args;
-        args.version = JNI_VERSION_1_2;
-        args.name = threadName;
-        args.group = nullptr;
-        JNIEnv* env;
-
-        LOG_ALWAYS_FATAL_IF(vm->AttachCurrentThread(&env, &args) != JNI_OK,
-                            "Cannot attach thread %s to JVM", threadName);
-        mAttached = true;
-    }
-    ~JavaThreadAttacher() {
-        if (!mAttached) return;
-        auto vm = getJavaVM();
-        LOG_ALWAYS_FATAL_IF(vm == nullptr,
-                            "Unable to detach thread. No JavaVM, but it was present before!");
-
-        LOG_RPC_DETAIL("Detaching current thread from JVM");
-        int ret = vm->DetachCurrentThread();
-        if (ret == JNI_OK) {
-            mAttached = false;
-        } else {
-            ALOGW("Unable to detach current thread from JVM (%d)", ret);
-        }
-    }
-
-private:
-    JavaThreadAttacher(const JavaThreadAttacher&) = delete;
-    void operator=(const JavaThreadAttacher&) = delete;
-
-    bool mAttached = false;
-
-    static JavaVM* getJavaVM() {
-        static auto fn = reinterpret_cast<decltype(&AndroidRuntimeGetJavaVM)>(
-                dlsym(RTLD_DEFAULT, "AndroidRuntimeGetJavaVM"));
-        if (fn == nullptr) return nullptr;
-        return fn();
-    }
-};
-#endif
-} // namespace
-
 void RpcSession::join(sp<RpcSession>&& session, PreJoinSetupResult&& setupResult) {
     sp<RpcConnection>& connection = setupResult.connection;
 
@@ -443,14 +486,33 @@ void RpcSession::join(sp<RpcSession>&& session, PreJoinSetupResult&& setupResult
               statusToString(setupResult.status).c_str());
     }
 
-    sp<RpcSession::EventListener> listener;
     {
         RpcMutexLockGuard _l(session->mMutex);
         auto it = session->mConnections.mThreads.find(rpc_this_thread::get_id());
         LOG_ALWAYS_FATAL_IF(it == session->mConnections.mThreads.end());
         it->second.detach();
         session->mConnections.mThreads.erase(it);
+    }
+
+    endIncomingConnection(std::move(session), connection);
+}
 
+void RpcSession::releaseJoinThread(const sp<RpcConnection>& connection) {
+    RpcMutexLockGuard _l(mMutex);
+    auto it = mConnections.mThreads.find(rpc_this_thread::get_id());
+    LOG_ALWAYS_FATAL_IF(it == mConnections.mThreads.end());
+    it->second.detach();
+    mConnections.mThreads.erase(it);
+
+    // not bound to any thread until a thread starts serving it
+    connection->exclusiveTid = std::nullopt;
+}
+
+void RpcSession::endIncomingConnection(sp<RpcSession>&& session,
+                                       const sp<RpcConnection>& connection) {
+    sp<RpcSession::EventListener> listener;
+    {
+        RpcMutexLockGuard _l(session->mMutex);
         listener = session->mEventListener.promote();
     }
 
@@ -763,6 +825,8 @@ status_t RpcSession::initShutdownTrigger() {
 
 status_t RpcSession::addOutgoingConnection(std::unique_ptr<RpcTransport> rpcTransport, bool init) {
     sp<RpcConnection> connection = sp<RpcConnection>::make();
+    connection->multiplexer = std::make_shared<RpcConnectionMultiplexer>();
+    connection->shareable = rpcTransport->supportsConcurrentReadAndWrite();
     {
         RpcMutexLockGuard _l(mMutex);
         connection->rpcTransport = std::move(rpcTransport);
@@ -821,6 +885,7 @@ sp<RpcSession::RpcConnection> RpcSession::assignIncomingConnectionToThisThread(
 
     sp<RpcConnection> session = sp<RpcConnection>::make();
     session->rpcTransport = std::move(rpcTransport);
+    session->multiplexer = std::make_shared<RpcConnectionMultiplexer>();
     session->exclusiveTid = binder::os::GetThreadId();
 
     mConnections.mIncoming.push_back(session);
@@ -847,6 +912,14 @@ bool RpcSession::removeIncomingConnection(const sp<RpcConnection>& connection) {
     return false;
 }
 
+void RpcSession::clearConnectionSharingTid(const sp<RpcConnection>& connection) {
+    RpcMutexLockGuard _l(mMutex);
+    auto& tids = connection->sharingTids;
+    auto it = std::find(tids.begin(), tids.end(), binder::os::GetThreadId());
+    LOG_ALWAYS_FATAL_IF(it == tids.end(), "Thread not sharing connection");
+    tids.erase(it);
+}
+
 void RpcSession::clearConnectionTid(const sp<RpcConnection>& connection) {
     RpcMutexUniqueLock _l(mMutex);
     connection->exclusiveTid = std::nullopt;
@@ -865,6 +938,7 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
     connection->mSession = session;
     connection->mConnection = nullptr;
     connection->mReentrant = false;
+    connection->mShared = false;
 
     uint64_t tid = binder::os::GetThreadId();
     RpcMutexUniqueLock _l(session->mMutex);
@@ -898,7 +972,7 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
         // USE SERVING SOCKET (e.g. nested transaction)
         if (use != ConnectionUse::CLIENT_ASYNC) {
             sp<RpcConnection> exclusiveIncoming;
-            // server connections are always assigned to a thread
+            // server connections are assigned to the thread serving them
             findConnection(tid, &exclusiveIncoming, nullptr /*available*/,
                            session->mConnections.mIncoming, 0 /* index hint */);
 
@@ -929,6 +1003,31 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
             break;
         }
 
+        // PIPELINE ON A BUSY CONNECTION
+        //
+        // Synchronous transactions carry an ID which lets the reply find its way
+        // back to the right thread, so rather than waiting for a connection to
+        // become available, share the least busy one. Only connections whose
+        // transport can be read by one thread while another writes to it are
+        // shared.
+        if (use == ConnectionUse::CLIENT &&
+            session->mProtocolVersion.value_or(0) >=
+                    RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID) {
+            sp<RpcConnection> shared;
+            for (const sp<RpcConnection>& outgoing : session->mConnections.mOutgoing) {
+                if (!outgoing->shareable) continue;
+                if (shared == nullptr || outgoing->sharingTids.size() < shared->sharingTids.size()) {
+                    shared = outgoing;
+                }
+            }
+            if (shared != nullptr) {
+                shared->sharingTids.push_back(tid);
+                connection->mConnection = shared;
+                connection->mShared = true;
+                break;
+            }
+        }
+
         if (session->mConnections.mOutgoing.size() == 0) {
             ALOGE("Session has no outgoing connections. This is required for an RPC server to make "
                   "any non-nested (e.g. oneway or on another thread) calls. Use code request "
@@ -974,7 +1073,10 @@ void RpcSession::ExclusiveConnection::findConnection(uint64_t tid, sp<RpcConnect
 
         // though, prefer to take connection which is already inuse by this thread
         // (nested transactions)
-        if (exclusive && socket->exclusiveTid == tid) {
+        if (exclusive &&
+            (socket->exclusiveTid == tid ||
+             std::find(socket->sharingTids.begin(), socket->sharingTids.end(), tid) !=
+                     socket->sharingTids.end())) {
             *exclusive = socket;
             break; // consistent with return above
         }
@@ -986,7 +1088,11 @@ RpcSession::ExclusiveConnection::~ExclusiveConnection() {
     // is using this fd, and it retains the right to it. So, we don't give up
     // exclusive ownership, and no thread is freed.
     if (!mReentrant && mConnection != nullptr) {
-        mSession->clearConnectionTid(mConnection);
+        if (mShared) {
+            mSession->clearConnectionSharingTid(mConnection);
+        } else {
+            mSession->clearConnectionTid(mConnection);
+        }
     }
 }
 
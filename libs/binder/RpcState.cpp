@@ -23,10 +23,13 @@
 #include <binder/IPCThreadState.h>
 #include <binder/RpcServer.h>
 
+#include "BuildFlags.h"
 #include "Debug.h"
+#include "OS.h"
 #include "RpcWireFormat.h"
 #include "Utils.h"
 
+#include <array>
 #include <random>
 #include <sstream>
 
@@ -69,6 +72,50 @@ static bool enableAncillaryFds(RpcSession::FileDescriptorTransportMode mode) {
 RpcState::RpcState() {}
 RpcState::~RpcState() {}
 
+bool RpcState::isMultiplexed(const sp<RpcSession>& session) {
+    return session->getProtocolVersion().value() >=
+            RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID;
+}
+
+bool RpcState::batchesDecStrongs(const sp<RpcSession>& session) {
+    return session->getProtocolVersion().value() >=
+            RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_DEC_STRONG_BATCH;
+}
+
+uint32_t RpcState::beginMultiplexedTransaction(const sp<RpcSession::RpcConnection>& connection,
+                                               uint32_t incomingTransactionId,
+                                               bool* isOutermost) {
+    RpcConnectionMultiplexer& mux = *connection->multiplexer;
+    uint64_t tid = binder::os::GetThreadId();
+
+    RpcMutexLockGuard _l(mux.mutex);
+    if (auto it = mux.transactionIdForTid.find(tid); it != mux.transactionIdForTid.end()) {
+        *isOutermost = false;
+        return it->second;
+    }
+
+    uint32_t transactionId = incomingTransactionId;
+    if (transactionId == 0) {
+        // IDs are only used to match up commands currently in flight, so
+        // wrapping is okay. Zero is reserved for commands outside of a
+        // transaction.
+        transactionId = mux.nextTransactionId;
+        mux.nextTransactionId = transactionId == std::numeric_limits<uint32_t>::max()
+                ? 1
+                : transactionId + 1;
+    }
+    mux.transactionIdForTid[tid] = transactionId;
+    *isOutermost = true;
+    return transactionId;
+}
+
+void RpcState::endMultiplexedTransaction(const sp<RpcSession::RpcConnection>& connection) {
+    RpcConnectionMultiplexer& mux = *connection->multiplexer;
+    RpcMutexLockGuard _l(mux.mutex);
+    LOG_ALWAYS_FATAL_IF(mux.transactionIdForTid.erase(binder::os::GetThreadId()) != 1,
+                        "Thread has no transaction in flight on this connection");
+}
+
 status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBinder>& binder,
                                    uint64_t* outAddress) {
     bool isRemote = binder->remoteBinder();
@@ -298,6 +345,7 @@ void RpcState::clear(RpcMutexUniqueLock nodeLock) {
     // mNodeMutex is no longer taken.
     auto temp = std::move(mNodeForAddress);
     mNodeForAddress.clear(); // RpcState isn't reusable, but for future/explicit
+    mPendingDecStrongs.clear();
 
     nodeLock.unlock();
     temp.clear(); // explicit
@@ -357,6 +405,31 @@ RpcState::CommandData::CommandData(size_t size) : mSize(size) {
     mData.reset(new (std::nothrow) uint8_t[size]);
 }
 
+std::vector<iovec> RpcState::expandExternalRegions(const Parcel& parcel, const iovec* iovs,
+                                                  int niovs, int dataIndex) {
+    const auto* rpcFields = parcel.maybeRpcFields();
+    if (rpcFields == nullptr || rpcFields->mExternalRegions == nullptr) return {};
+    // Once copied in, the data is sent as is. It may have been modified since.
+    const auto& regions = *rpcFields->mExternalRegions;
+    using Regions = Parcel::RpcFields::ExternalRegions;
+    if (regions.state.load(std::memory_order_acquire) != Regions::PENDING) return {};
+
+    std::vector<iovec> expanded(iovs, iovs + dataIndex);
+    expanded.reserve(niovs + 2 * regions.regions.size());
+
+    uint8_t* data = parcel.mData;
+    size_t pos = 0;
+    for (const auto& region : regions.regions) {
+        expanded.push_back({data + pos, region.offset - pos});
+        expanded.push_back({const_cast<uint8_t*>(region.data), region.size});
+        pos = region.offset + region.size;
+    }
+    expanded.push_back({data + pos, parcel.dataSize() - pos});
+
+    expanded.insert(expanded.end(), iovs + dataIndex + 1, iovs + niovs);
+    return expanded;
+}
+
 status_t RpcState::rpcSend(const sp<RpcSession::RpcConnection>& connection,
                            const sp<RpcSession>& session, const char* what, iovec* iovs, int niovs,
                            const std::optional<SmallFunction<status_t()>>& altPoll,
@@ -367,6 +440,11 @@ status_t RpcState::rpcSend(const sp<RpcSession::RpcConnection>& connection,
                        HexString(iovs[i].iov_base, iovs[i].iov_len).c_str());
     }
 
+    // connections may be shared between threads, see
+    // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID
+    std::optional<RpcMutexLockGuard> writeLock;
+    if (connection->multiplexer != nullptr) writeLock.emplace(connection->multiplexer->writeMutex);
+
     if (status_t status =
                 connection->rpcTransport->interruptableWriteFully(session->mShutdownTrigger.get(),
                                                                   iovs, niovs, altPoll,
@@ -574,9 +652,28 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
                                 __builtin_add_overflow(objectTableSpan.byteSize(), bodySize,
                                                        &bodySize),
                         "Too much data %zu", data.dataSize());
+
+    // Queued refcount drops are sent first, so that the other side sees them
+    // before anything which this transaction causes.
+    if (batchesDecStrongs(session)) {
+        if (status_t status = flushDecStrongs(connection, session, false /*scheduled*/);
+            status != OK)
+            return status;
+    }
+
+    uint32_t transactionId = 0;
+    bool isOutermostTransaction = false;
+    if (!(flags & IBinder::FLAG_ONEWAY) && isMultiplexed(session)) {
+        transactionId = beginMultiplexedTransaction(connection, 0, &isOutermostTransaction);
+    }
+    auto endTransaction = make_scope_guard([&]() {
+        if (isOutermostTransaction) endMultiplexedTransaction(connection);
+    });
+
     RpcWireHeader command{
             .command = RPC_COMMAND_TRANSACT,
             .bodySize = bodySize,
+            .transactionId = transactionId,
     };
 
     RpcWireTransaction transaction{
@@ -595,12 +692,14 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     constexpr size_t kWaitLogUs = 10000;
     size_t waitUs = 0;
 
+    // not data.data(), which would copy in external regions
     iovec iovs[]{
             {&command, sizeof(RpcWireHeader)},
             {&transaction, sizeof(RpcWireTransaction)},
-            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+            {data.mData, data.dataSize()},
             objectTableSpan.toIovec(),
     };
+    std::vector<iovec> expandedIovs = expandExternalRegions(data, iovs, countof(iovs), 2);
     auto altPoll = [&] {
         if (waitUs > kWaitLogUs) {
             ALOGE("Cannot send command, trying to process pending refcounts. Waiting "
@@ -617,8 +716,13 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
 
         return drainCommands(connection, session, CommandType::CONTROL_ONLY);
     };
-    if (status_t status = rpcSend(connection, session, "transaction", iovs, countof(iovs),
-                                  std::ref(altPoll), rpcFields->mFds.get());
+    if (status_t status =
+                expandedIovs.empty()
+                        ? rpcSend(connection, session, "transaction", iovs, countof(iovs),
+                                  std::ref(altPoll), rpcFields->mFds.get())
+                        : rpcSend(connection, session, "transaction", expandedIovs.data(),
+                                  static_cast<int>(expandedIovs.size()), std::ref(altPoll),
+                                  rpcFields->mFds.get());
         status != OK) {
         // rpcSend calls shutdownAndWait, so all refcounts should be reset. If we ever tolerate
         // errors here, then we may need to undo the binder-sent counts for the transaction as
@@ -636,6 +740,9 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
 
     LOG_ALWAYS_FATAL_IF(reply == nullptr, "Reply parcel must be used for synchronous transaction.");
 
+    if (transactionId != 0) {
+        return waitForMultiplexedReply(connection, session, transactionId, reply);
+    }
     return waitForReply(connection, session, reply);
 }
 
@@ -694,17 +801,167 @@ status_t RpcState::waitForReply(const sp<RpcSession::RpcConnection>& connection,
         status != OK)
         return status;
 
-    if (rpcReply.status != OK) return rpcReply.status;
+    return processReply(session, command.bodySize, rpcReply.status, rpcReply.parcelDataSize,
+                        std::move(data), std::move(ancillaryFds), reply);
+}
+
+status_t RpcState::waitForMultiplexedReply(const sp<RpcSession::RpcConnection>& connection,
+                                           const sp<RpcSession>& session, uint32_t transactionId,
+                                           Parcel* reply) {
+    RpcConnectionMultiplexer& mux = *connection->multiplexer;
+
+    while (true) {
+        std::optional<PendingCommand> ours;
+        {
+            RpcMutexUniqueLock _l(mux.mutex);
+            while (true) {
+                auto it = std::find_if(mux.pending.begin(), mux.pending.end(),
+                                       [&](const PendingCommand& pending) {
+                                           return pending.transactionId == transactionId;
+                                       });
+                if (it != mux.pending.end()) {
+                    ours = std::move(*it);
+                    mux.pending.erase(it);
+                    break;
+                }
+                // nothing for us yet, so become the reader of this connection
+                if (!mux.reading) {
+                    mux.reading = true;
+                    break;
+                }
+                mux.cv.wait(_l);
+            }
+        }
+
+        if (!ours.has_value()) {
+            PendingCommand command;
+            status_t status = readPendingCommand(connection, session, &command);
+            bool isRefcount = status == OK && isDecStrong(command);
+            {
+                RpcMutexLockGuard _l(mux.mutex);
+                mux.reading = false;
+                if (status == OK && !isRefcount) mux.pending.push_back(std::move(command));
+            }
+            // wake up whoever this command is for, or someone to take over
+            // reading if it was for us
+            mux.cv.notify_all();
+
+            if (status != OK) return status;
+            if (isRefcount) {
+                // command is not moved from for refcounts
+                status = processPendingDecStrong(session, command);
+                if (status != OK) return status;
+            }
+            continue;
+        }
+
+        if (ours->command == RPC_COMMAND_REPLY) {
+            return processReply(session, ours->bodySize, ours->replyStatus,
+                                ours->replyParcelDataSize, std::move(ours->data),
+                                std::move(ours->ancillaryFds), reply);
+        }
+
+        // a nested transaction, sent by the thread processing our transaction
+        if (status_t status =
+                    processTransactInternal(connection, session, std::move(ours->data),
+                                            std::move(ours->ancillaryFds), transactionId);
+            status != OK)
+            return status;
+    }
+}
+
+status_t RpcState::readPendingCommand(const sp<RpcSession::RpcConnection>& connection,
+                                      const sp<RpcSession>& session, PendingCommand* out) {
+    RpcWireHeader command;
+    iovec iov{&command, sizeof(command)};
+    if (status_t status = rpcRec(connection, session, "command header (multiplexed)", &iov, 1,
+                                 enableAncillaryFds(session->getFileDescriptorTransportMode())
+                                         ? &out->ancillaryFds
+                                         : nullptr);
+        status != OK)
+        return status;
+
+    out->command = command.command;
+    out->transactionId = command.transactionId;
+    out->bodySize = command.bodySize;
+
+    switch (command.command) {
+        case RPC_COMMAND_TRANSACT: {
+            out->data = CommandData(command.bodySize);
+            if (!out->data.valid()) return NO_MEMORY;
+            iovec bodyIov{out->data.data(), out->data.size()};
+            return rpcRec(connection, session, "transaction body", &bodyIov, 1, nullptr);
+        }
+        case RPC_COMMAND_REPLY: {
+            // multiplexing is only supported by protocol versions with the
+            // full size RpcWireReply
+            if (command.bodySize < sizeof(RpcWireReply)) {
+                ALOGE("Expecting %zu but got %" PRId32 " bytes for RpcWireReply. Terminating!",
+                      sizeof(RpcWireReply), command.bodySize);
+                (void)session->shutdownAndWait(false);
+                return BAD_VALUE;
+            }
+            RpcWireReply rpcReply;
+            out->data = CommandData(command.bodySize - sizeof(RpcWireReply));
+            if (!out->data.valid()) return NO_MEMORY;
+            iovec iovs[]{
+                    {&rpcReply, sizeof(RpcWireReply)},
+                    {out->data.data(), out->data.size()},
+            };
+            if (status_t status =
+                        rpcRec(connection, session, "reply body", iovs, countof(iovs), nullptr);
+                status != OK)
+                return status;
+            out->replyStatus = rpcReply.status;
+            out->replyParcelDataSize = rpcReply.parcelDataSize;
+            return OK;
+        }
+        case RPC_COMMAND_DEC_STRONG: {
+            if (command.bodySize != sizeof(RpcDecStrong)) {
+                ALOGE("Expecting %zu but got %" PRId32 " bytes for RpcDecStrong. Terminating!",
+                      sizeof(RpcDecStrong), command.bodySize);
+                (void)session->shutdownAndWait(false);
+                return BAD_VALUE;
+            }
+            out->data = CommandData(sizeof(RpcDecStrong));
+            if (!out->data.valid()) return NO_MEMORY;
+            iovec bodyIov{out->data.data(), out->data.size()};
+            return rpcRec(connection, session, "dec ref body", &bodyIov, 1, nullptr);
+        }
+        case RPC_COMMAND_DEC_STRONG_BATCH: {
+            if (status_t status = validateDecStrongBatch(session, command); status != OK) {
+                return status;
+            }
+            out->data = CommandData(command.bodySize);
+            if (!out->data.valid()) return NO_MEMORY;
+            iovec bodyIov{out->data.data(), out->data.size()};
+            return rpcRec(connection, session, "dec ref batch body", &bodyIov, 1, nullptr);
+        }
+    }
+
+    ALOGE("Unknown RPC command %d - terminating session", command.command);
+    (void)session->shutdownAndWait(false);
+    return DEAD_OBJECT;
+}
+
+status_t RpcState::processReply(const sp<RpcSession>& session, uint32_t bodySize,
+                                int32_t replyStatus, uint32_t replyParcelDataSize,
+                                CommandData data,
+                                std::vector<std::variant<unique_fd, borrowed_fd>>&& ancillaryFds,
+                                Parcel* reply) {
+    if (replyStatus != OK) return replyStatus;
+
+    const size_t rpcReplyWireSize = RpcWireReply::wireSize(session->getProtocolVersion().value());
 
     Span<const uint8_t> parcelSpan = {data.data(), data.size()};
     Span<const uint32_t> objectTableSpan;
     if (session->getProtocolVersion().value() >=
         RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_EXPLICIT_PARCEL_SIZE) {
         std::optional<Span<const uint8_t>> objectTableBytes =
-                parcelSpan.splitOff(rpcReply.parcelDataSize);
+                parcelSpan.splitOff(replyParcelDataSize);
         if (!objectTableBytes.has_value()) {
             ALOGE("Parcel size larger than available bytes: %" PRId32 " vs %zu. Terminating!",
-                  rpcReply.parcelDataSize, parcelSpan.byteSize());
+                  replyParcelDataSize, parcelSpan.byteSize());
             (void)session->shutdownAndWait(false);
             return BAD_VALUE;
         }
@@ -713,8 +970,7 @@ status_t RpcState::waitForReply(const sp<RpcSession::RpcConnection>& connection,
         if (!maybeSpan.has_value()) {
             ALOGE("Bad object table size inferred from RpcWireReply. Saw bodySize=%" PRId32
                   " sizeofHeader=%zu parcelSize=%" PRId32 " objectTableBytesSize=%zu. Terminating!",
-                  command.bodySize, rpcReplyWireSize, rpcReply.parcelDataSize,
-                  objectTableBytes->size);
+                  bodySize, rpcReplyWireSize, replyParcelDataSize, objectTableBytes->size);
             return BAD_VALUE;
         }
         objectTableSpan = *maybeSpan;
@@ -763,10 +1019,111 @@ status_t RpcState::sendDecStrongToTarget(const sp<RpcSession::RpcConnection>& co
     return rpcSend(connection, session, "dec ref", iovs, countof(iovs), std::nullopt);
 }
 
+status_t RpcState::queueDecStrongToTarget(const sp<RpcSession>& session, uint64_t addr,
+                                          size_t target, DecStrongFlush* flush) {
+    *flush = DecStrongFlush::NONE;
+
+    RpcMutexUniqueLock _l(mNodeMutex);
+    if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
+    auto it = mNodeForAddress.find(addr);
+    LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(),
+                        "Sending dec strong on unknown address %" PRIu64, addr);
+
+    LOG_ALWAYS_FATAL_IF(it->second.timesRecd < target, "Can't dec count of %zu to %zu.",
+                        it->second.timesRecd, target);
+
+    // see sendDecStrongToTarget
+    if (it->second.timesRecd == target) return OK;
+
+    // Amounts for the same address add up. The node may be erased before the
+    // drop is sent, but the other side keeps its binder until it is.
+    uint32_t& amount = mPendingDecStrongs[addr];
+    LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(amount, it->second.timesRecd - target, &amount),
+                        "Too many dec strongs queued for %" PRIu64, addr);
+    it->second.timesRecd = target;
+
+    if (!kEnableRpcThreads || mPendingDecStrongs.size() >= kRpcMaxDecStrongBatch) {
+        *flush = DecStrongFlush::NOW;
+    } else if (!mDecStrongFlushScheduled) {
+        mDecStrongFlushScheduled = true;
+        *flush = DecStrongFlush::LATER;
+    }
+
+    LOG_ALWAYS_FATAL_IF(nullptr != tryEraseNode(session, std::move(_l), it),
+                        "Bad state. RpcState shouldn't own received binder");
+    // LOCK ALREADY RELEASED
+    return OK;
+}
+
+status_t RpcState::flushDecStrongs(const sp<RpcSession::RpcConnection>& connection,
+                                   const sp<RpcSession>& session, bool scheduled) {
+    std::vector<RpcDecStrong> bodies;
+    {
+        RpcMutexLockGuard _l(mNodeMutex);
+        if (scheduled) mDecStrongFlushScheduled = false;
+        if (mTerminated) return DEAD_OBJECT;
+        if (mPendingDecStrongs.empty()) return OK;
+
+        bodies.reserve(mPendingDecStrongs.size());
+        for (const auto& [addr, amount] : mPendingDecStrongs) {
+            bodies.push_back(RpcDecStrong{
+                    .address = RpcWireAddress::fromRaw(addr),
+                    .amount = amount,
+            });
+        }
+        mPendingDecStrongs.clear();
+    }
+
+    for (size_t i = 0; i < bodies.size(); i += kRpcMaxDecStrongBatch) {
+        size_t count = std::min(kRpcMaxDecStrongBatch, bodies.size() - i);
+        RpcWireHeader cmd = {
+                .command = RPC_COMMAND_DEC_STRONG_BATCH,
+                .bodySize = static_cast<uint32_t>(count * sizeof(RpcDecStrong)),
+        };
+        iovec iovs[]{{&cmd, sizeof(cmd)}, {&bodies[i], count * sizeof(RpcDecStrong)}};
+        if (status_t status =
+                    rpcSend(connection, session, "dec ref batch", iovs, countof(iovs), std::nullopt);
+            status != OK) {
+            return status;
+        }
+    }
+    return OK;
+}
+
+void RpcState::abandonDecStrongFlush() {
+    RpcMutexLockGuard _l(mNodeMutex);
+    mDecStrongFlushScheduled = false;
+}
+
 status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& connection,
                                         const sp<RpcSession>& session, CommandType type) {
     LOG_RPC_DETAIL("getAndExecuteCommand on RpcTransport %p", connection->rpcTransport.get());
 
+    if (type == CommandType::ANY && isMultiplexed(session)) {
+        // Transactions which arrived while this thread was waiting for the
+        // reply to a nested transaction are processed before reading more.
+        std::optional<PendingCommand> pending;
+        {
+            RpcConnectionMultiplexer& mux = *connection->multiplexer;
+            RpcMutexLockGuard _l(mux.mutex);
+            if (!mux.pending.empty()) {
+                pending = std::move(mux.pending.front());
+                mux.pending.pop_front();
+            }
+        }
+        if (pending.has_value()) {
+            if (pending->command != RPC_COMMAND_TRANSACT) {
+                ALOGE("Unexpected RPC command %d for transaction %" PRIu32 " - terminating session",
+                      pending->command, pending->transactionId);
+                (void)session->shutdownAndWait(false);
+                return DEAD_OBJECT;
+            }
+            return processTransactInternal(connection, session, std::move(pending->data),
+                                           std::move(pending->ancillaryFds),
+                                           pending->transactionId);
+        }
+    }
+
     std::vector<std::variant<unique_fd, borrowed_fd>> ancillaryFds;
     RpcWireHeader command;
     iovec iov{&command, sizeof(command)};
@@ -782,6 +1139,70 @@ status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& con
 
 status_t RpcState::drainCommands(const sp<RpcSession::RpcConnection>& connection,
                                  const sp<RpcSession>& session, CommandType type) {
+    if (isMultiplexed(session)) {
+        RpcConnectionMultiplexer& mux = *connection->multiplexer;
+
+        if (type == CommandType::ANY) {
+            while (true) {
+                bool hasPending;
+                {
+                    RpcMutexLockGuard _l(mux.mutex);
+                    hasPending = !mux.pending.empty();
+                }
+                if (!hasPending) {
+                    status_t status = connection->rpcTransport->pollRead();
+                    if (status == WOULD_BLOCK) break;
+                    if (status != OK) return status;
+                }
+                status_t status = getAndExecuteCommand(connection, session, type);
+                if (status != OK) return status;
+            }
+            return OK;
+        }
+
+        {
+            RpcMutexLockGuard _l(mux.mutex);
+            // the thread currently reading will drain the connection
+            if (mux.reading) return OK;
+            mux.reading = true;
+        }
+
+        // Transactions and replies are left for the threads they belong to,
+        // but refcounts are processed here, once we are no longer reading.
+        std::vector<PendingCommand> decStrongs;
+        status_t status;
+        while (true) {
+            status = connection->rpcTransport->pollRead();
+            if (status == WOULD_BLOCK) {
+                status = OK;
+                break;
+            }
+            if (status != OK) break;
+
+            PendingCommand command;
+            status = readPendingCommand(connection, session, &command);
+            if (status != OK) break;
+
+            if (isDecStrong(command)) {
+                decStrongs.push_back(std::move(command));
+            } else {
+                RpcMutexLockGuard _l(mux.mutex);
+                mux.pending.push_back(std::move(command));
+            }
+        }
+        {
+            RpcMutexLockGuard _l(mux.mutex);
+            mux.reading = false;
+        }
+        mux.cv.notify_all();
+
+        for (PendingCommand& decStrong : decStrongs) {
+            if (status != OK) break;
+            status = processPendingDecStrong(session, decStrong);
+        }
+        return status;
+    }
+
     while (true) {
         status_t status = connection->rpcTransport->pollRead();
         if (status == WOULD_BLOCK) break;
@@ -822,6 +1243,8 @@ status_t RpcState::processCommand(
             return processTransact(connection, session, command, std::move(ancillaryFds));
         case RPC_COMMAND_DEC_STRONG:
             return processDecStrong(connection, session, command);
+        case RPC_COMMAND_DEC_STRONG_BATCH:
+            return processDecStrongBatch(connection, session, command);
     }
 
     // We should always know the version of the opposing side, and since the
@@ -849,7 +1272,8 @@ status_t RpcState::processTransact(
         return status;
 
     return processTransactInternal(connection, session, std::move(transactionData),
-                                   std::move(ancillaryFds));
+                                   std::move(ancillaryFds),
+                                   isMultiplexed(session) ? command.transactionId : 0);
 }
 
 static void do_nothing_to_transact_data(const uint8_t* data, size_t dataSize,
@@ -863,7 +1287,7 @@ static void do_nothing_to_transact_data(const uint8_t* data, size_t dataSize,
 status_t RpcState::processTransactInternal(
         const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
         CommandData transactionData,
-        std::vector<std::variant<unique_fd, borrowed_fd>>&& ancillaryFds) {
+        std::vector<std::variant<unique_fd, borrowed_fd>>&& ancillaryFds, uint32_t transactionId) {
     // for 'recursive' calls to this, we have already read and processed the
     // binder from the transaction data and taken reference counts into account,
     // so it is cached here.
@@ -993,12 +1417,24 @@ processTransactInternalTailCall:
 
         if (replyStatus == OK) {
             if (target) {
+                // several threads may process nested transactions on a shared
+                // connection, and allowNested only matters for incoming
+                // connections, which are never shared
                 bool origAllowNested = connection->allowNested;
-                connection->allowNested = !oneway;
+                if (!connection->shareable) connection->allowNested = !oneway;
+
+                // nested transactions made from this thread belong to the
+                // transaction being processed
+                bool isOutermostTransaction = false;
+                if (!oneway && transactionId != 0) {
+                    (void)beginMultiplexedTransaction(connection, transactionId,
+                                                      &isOutermostTransaction);
+                }
 
                 replyStatus = target->transact(transaction->code, data, &reply, transaction->flags);
 
-                connection->allowNested = origAllowNested;
+                if (isOutermostTransaction) endMultiplexedTransaction(connection);
+                if (!connection->shareable) connection->allowNested = origAllowNested;
             } else {
                 LOG_RPC_DETAIL("Got special transaction %u", transaction->code);
 
@@ -1128,6 +1564,7 @@ processTransactInternalTailCall:
     RpcWireHeader cmdReply{
             .command = RPC_COMMAND_REPLY,
             .bodySize = bodySize,
+            .transactionId = transactionId,
     };
     RpcWireReply rpcReply{
             .status = replyStatus,
@@ -1140,9 +1577,15 @@ processTransactInternalTailCall:
     iovec iovs[]{
             {&cmdReply, sizeof(RpcWireHeader)},
             {&rpcReply, rpcReplyWireSize},
-            {const_cast<uint8_t*>(reply.data()), reply.dataSize()},
+            {reply.mData, reply.dataSize()},
             objectTableSpan.toIovec(),
     };
+    std::vector<iovec> expandedIovs = expandExternalRegions(reply, iovs, countof(iovs), 2);
+    if (!expandedIovs.empty()) {
+        return rpcSend(connection, session, "reply", expandedIovs.data(),
+                       static_cast<int>(expandedIovs.size()), std::nullopt,
+                       rpcFields->mFds.get());
+    }
     return rpcSend(connection, session, "reply", iovs, countof(iovs), std::nullopt,
                    rpcFields->mFds.get());
 }
@@ -1164,6 +1607,68 @@ status_t RpcState::processDecStrong(const sp<RpcSession::RpcConnection>& connect
         status != OK)
         return status;
 
+    return processDecStrongBody(session, body);
+}
+
+status_t RpcState::validateDecStrongBatch(const sp<RpcSession>& session,
+                                          const RpcWireHeader& command) {
+    if (!batchesDecStrongs(session)) {
+        ALOGE("RPC_COMMAND_DEC_STRONG_BATCH unsupported by protocol version %" PRIu32
+              ". Terminating!",
+              session->getProtocolVersion().value());
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+    if (command.bodySize == 0 || command.bodySize % sizeof(RpcDecStrong) != 0 ||
+        command.bodySize > kRpcMaxDecStrongBatch * sizeof(RpcDecStrong)) {
+        ALOGE("Bad size %" PRIu32 " for RPC_COMMAND_DEC_STRONG_BATCH. Terminating!",
+              command.bodySize);
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+    return OK;
+}
+
+status_t RpcState::processDecStrongBatch(const sp<RpcSession::RpcConnection>& connection,
+                                         const sp<RpcSession>& session,
+                                         const RpcWireHeader& command) {
+    LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_DEC_STRONG_BATCH, "command: %d",
+                        command.command);
+
+    if (status_t status = validateDecStrongBatch(session, command); status != OK) return status;
+
+    std::array<RpcDecStrong, kRpcMaxDecStrongBatch> bodies;
+    iovec iov{bodies.data(), command.bodySize};
+    if (status_t status = rpcRec(connection, session, "dec ref batch body", &iov, 1, nullptr);
+        status != OK)
+        return status;
+
+    for (size_t i = 0; i < command.bodySize / sizeof(RpcDecStrong); i++) {
+        if (status_t status = processDecStrongBody(session, bodies[i]); status != OK) {
+            return status;
+        }
+    }
+    return OK;
+}
+
+bool RpcState::isDecStrong(const PendingCommand& command) {
+    return command.command == RPC_COMMAND_DEC_STRONG ||
+            command.command == RPC_COMMAND_DEC_STRONG_BATCH;
+}
+
+status_t RpcState::processPendingDecStrong(const sp<RpcSession>& session,
+                                           PendingCommand& command) {
+    // sizes were checked by readPendingCommand
+    const auto* bodies = reinterpret_cast<const RpcDecStrong*>(command.data.data());
+    for (size_t i = 0; i < command.data.size() / sizeof(RpcDecStrong); i++) {
+        if (status_t status = processDecStrongBody(session, bodies[i]); status != OK) {
+            return status;
+        }
+    }
+    return OK;
+}
+
+status_t RpcState::processDecStrongBody(const sp<RpcSession>& session, const RpcDecStrong& body) {
     uint64_t addr = RpcWireAddress::toRaw(body.address);
     RpcMutexUniqueLock _l(mNodeMutex);
     auto it = mNodeForAddress.find(addr);
@@ -22,6 +22,7 @@
 #include <binder/RpcThreads.h>
 #include <binder/unique_fd.h>
 
+#include <deque>
 #include <map>
 #include <optional>
 #include <queue>
@@ -30,6 +31,7 @@
 
 namespace android {
 
+struct RpcDecStrong;
 struct RpcWireHeader;
 
 /**
@@ -113,6 +115,36 @@ public:
                                                  const sp<RpcSession>& session, uint64_t address,
                                                  size_t target);
 
+    // Whether refcount drops are batched on this session (see
+    // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_DEC_STRONG_BATCH).
+    [[nodiscard]] static bool batchesDecStrongs(const sp<RpcSession>& session);
+
+    enum class DecStrongFlush {
+        // another flush is already scheduled
+        NONE,
+        // the batch is full, call flushDecStrongs
+        NOW,
+        // call flushDecStrongs with 'scheduled' soon
+        LATER,
+    };
+    /**
+     * Like sendDecStrongToTarget, but the refcount drop is only recorded, to
+     * be sent by flushDecStrongs together with others. Only for sessions where
+     * batchesDecStrongs is true.
+     */
+    [[nodiscard]] status_t queueDecStrongToTarget(const sp<RpcSession>& session, uint64_t address,
+                                                  size_t target, DecStrongFlush* flush);
+    /**
+     * Sends all queued refcount drops. 'scheduled' must be set by (only) the
+     * flush that a DecStrongFlush::LATER result asked for, and then a new
+     * one will be asked for by the next refcount drop.
+     */
+    [[nodiscard]] status_t flushDecStrongs(const sp<RpcSession::RpcConnection>& connection,
+                                           const sp<RpcSession>& session, bool scheduled);
+    // For a scheduled flush which can't be done, because the session is
+    // shutting down.
+    void abandonDecStrongFlush();
+
     enum class CommandType {
         ANY,
         CONTROL_ONLY,
@@ -171,6 +203,8 @@ public:
     void clear();
 
 private:
+    friend struct RpcConnectionMultiplexer;
+
     void clear(RpcMutexUniqueLock nodeLock);
     void dumpLocked();
 
@@ -188,6 +222,13 @@ private:
         size_t mSize;
     };
 
+    // If 'parcel' references external regions (see
+    // Parcel::writeExternalByteArray), returns a copy of 'iovs' where
+    // iovs[dataIndex], the data of 'parcel', is split so that the regions are
+    // sent directly from where they are. Otherwise, returns an empty vector.
+    static std::vector<iovec> expandExternalRegions(const Parcel& parcel, const iovec* iovs,
+                                                    int niovs, int dataIndex);
+
     [[nodiscard]] status_t rpcSend(
             const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
             const char* what, iovec* iovs, int niovs,
@@ -200,8 +241,50 @@ private:
                                   std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>*
                                           ancillaryFds = nullptr);
 
+    // A command read from a connection which is shared between threads, held
+    // until the thread it belongs to picks it up (see
+    // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID).
+    struct PendingCommand {
+        uint32_t command = 0;
+        uint32_t transactionId = 0;
+        uint32_t bodySize = 0;
+        // only for RPC_COMMAND_REPLY
+        int32_t replyStatus = 0;
+        uint32_t replyParcelDataSize = 0;
+        // whole body for RPC_COMMAND_TRANSACT, RPC_COMMAND_DEC_STRONG and
+        // RPC_COMMAND_DEC_STRONG_BATCH,
+        // everything after RpcWireReply for RPC_COMMAND_REPLY
+        CommandData data{0};
+        std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>> ancillaryFds;
+    };
+
+    // Whether synchronous transactions carry an ID on this session.
+    [[nodiscard]] static bool isMultiplexed(const sp<RpcSession>& session);
+    // Returns the transaction ID which this thread's synchronous transactions
+    // on 'connection' belong to. If this thread is already part of a
+    // transaction on this connection (e.g. it's nested), that ID is returned
+    // and '*isOutermost' is set to false. Otherwise, 'incomingTransactionId'
+    // is adopted, or a new ID is allocated if it is zero, and
+    // endMultiplexedTransaction must be called when the transaction is done.
+    uint32_t beginMultiplexedTransaction(const sp<RpcSession::RpcConnection>& connection,
+                                         uint32_t incomingTransactionId, bool* isOutermost);
+    void endMultiplexedTransaction(const sp<RpcSession::RpcConnection>& connection);
+
     [[nodiscard]] status_t waitForReply(const sp<RpcSession::RpcConnection>& connection,
                                         const sp<RpcSession>& session, Parcel* reply);
+    [[nodiscard]] status_t waitForMultiplexedReply(const sp<RpcSession::RpcConnection>& connection,
+                                                   const sp<RpcSession>& session,
+                                                   uint32_t transactionId, Parcel* reply);
+    // Reads one full command (header and body) from a shared connection. The
+    // caller must be the only thread reading from the connection.
+    [[nodiscard]] status_t readPendingCommand(const sp<RpcSession::RpcConnection>& connection,
+                                              const sp<RpcSession>& session,
+                                              PendingCommand* out);
+    [[nodiscard]] status_t processReply(
+            const sp<RpcSession>& session, uint32_t bodySize, int32_t replyStatus,
+            uint32_t replyParcelDataSize, CommandData data,
+            std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>&& ancillaryFds,
+            Parcel* reply);
     [[nodiscard]] status_t processCommand(
             const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
             const RpcWireHeader& command, CommandType type,
@@ -213,10 +296,25 @@ private:
     [[nodiscard]] status_t processTransactInternal(
             const sp<RpcSession::RpcConnection>& connection, const sp<RpcSession>& session,
             CommandData transactionData,
-            std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>&& ancillaryFds);
+            std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>&& ancillaryFds,
+            uint32_t transactionId);
     [[nodiscard]] status_t processDecStrong(const sp<RpcSession::RpcConnection>& connection,
                                             const sp<RpcSession>& session,
                                             const RpcWireHeader& command);
+    [[nodiscard]] status_t processDecStrongBody(const sp<RpcSession>& session,
+                                                const RpcDecStrong& body);
+    [[nodiscard]] status_t processDecStrongBatch(const sp<RpcSession::RpcConnection>& connection,
+                                                 const sp<RpcSession>& session,
+                                                 const RpcWireHeader& command);
+    // For RPC_COMMAND_DEC_STRONG and RPC_COMMAND_DEC_STRONG_BATCH read by
+    // readPendingCommand.
+    [[nodiscard]] static bool isDecStrong(const PendingCommand& command);
+    [[nodiscard]] status_t processPendingDecStrong(const sp<RpcSession>& session,
+                                                   PendingCommand& command);
+    // Validates the size of an RPC_COMMAND_DEC_STRONG_BATCH, and terminates
+    // the session if it is bad.
+    [[nodiscard]] static status_t validateDecStrongBatch(const sp<RpcSession>& session,
+                                                         const RpcWireHeader& command);
 
     // Whether `parcel` is compatible with `session`.
     [[nodiscard]] static status_t validateParcel(const sp<RpcSession>& session,
@@ -296,6 +394,43 @@ private:
     uint32_t mNextId = 0;
     // binders known by both sides of a session
     std::map<uint64_t, BinderNode> mNodeForAddress;
+    // refcount drops which haven't been sent yet, by address
+    std::map<uint64_t, uint32_t> mPendingDecStrongs;
+    bool mDecStrongFlushScheduled = false;
+};
+
+/**
+ * State shared by the threads using a single RpcSession::RpcConnection, when
+ * the session supports RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID.
+ *
+ * One thread at a time reads from the connection. Any command which belongs
+ * to a transaction ID other than the reader's is queued here, and the thread
+ * waiting on that transaction ID is woken up to process it.
+ *
+ * A connection is only shared if its transport supports concurrent reads and
+ * writes (see RpcSession::RpcConnection::shareable), so the reader never
+ * blocks writers: one thread reads, and one thread at a time writes.
+ */
+struct RpcConnectionMultiplexer {
+    // Held for the duration of every write to the connection, so that messages
+    // from different threads aren't interleaved.
+    RpcMutex writeMutex;
+
+    RpcMutex mutex; // for all below
+    RpcConditionVariable cv;
+
+    // whether a thread is currently reading from the connection
+    bool reading = false;
+
+    uint32_t nextTransactionId = 1;
+
+    // transaction ID that each thread with a synchronous transaction in flight
+    // (or being processed) on this connection is part of
+    std::map<uint64_t, uint32_t> transactionIdForTid;
+
+    // commands read by one thread on behalf of another, in the order that they
+    // were received
+    std::deque<RpcState::PendingCommand> pending;
 };
 
 } // namespace android
@@ -85,6 +85,9 @@ public:
 
     bool isWaiting() override { return mSocket.isInPollingState(); }
 
+    // Sockets can be read and written from different threads at once.
+    bool supportsConcurrentReadAndWrite() const override { return true; }
+
 private:
     android::RpcTransportFd mSocket;
 };
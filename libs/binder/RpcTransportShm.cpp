@@ -0,0 +1,643 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcShmTransport"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <new>
+
+#include <binder/RpcTransportShm.h>
+
+#include "FdTrigger.h"
+#include "OS.h"
+#include "RpcState.h"
+#include "RpcTransportUtils.h"
+
+namespace android {
+
+using namespace android::binder::impl;
+using android::binder::borrowed_fd;
+using android::binder::unique_fd;
+
+namespace {
+
+constexpr size_t kMinRingSize = 4 * 1024;
+constexpr size_t kMaxRingSize = 16 * 1024 * 1024;
+
+// Same as SCM_MAX_FD, see OS_unix_base.cpp
+constexpr uint32_t kMaxFdsPerFrame = 253;
+
+// How long a reader spins on an empty ring before sleeping on the socket.
+constexpr std::chrono::microseconds kSpinDuration(20);
+// How long a writer waits for a full ring to drain before it checks whether
+// it was shut down or the peer went away.
+constexpr std::chrono::milliseconds kFullRingWaitTimeout(10);
+
+// Sent by the client, along with the memfd, before anything else.
+struct ShmHandshake {
+    uint32_t magic;
+    uint32_t ringSize;
+};
+constexpr uint32_t kShmHandshakeMagic = 0x52534d31; // 'RSM1'
+
+// Socket bytes after the handshake. Their values are informational only.
+constexpr uint8_t kDoorbellByte = 'D';
+constexpr uint8_t kFdsByte = 'F';
+
+// Lives at the start of each ring in the shared memory. Counters increase
+// monotonically, and are reduced modulo the ring size to index it.
+struct RingControl {
+    // written by the producer
+    alignas(64) std::atomic<uint64_t> head;
+    // written by the consumer
+    alignas(64) std::atomic<uint64_t> tail;
+    // set by the consumer before it sleeps on the socket, and cleared by
+    // whoever wakes it up.
+    alignas(64) std::atomic<uint32_t> consumerSleeping;
+    // set by the producer before it waits on this futex for the ring to
+    // drain, and cleared by the consumer when it frees space.
+    alignas(64) std::atomic<uint32_t> producerSleeping;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+// Written into the ring before the data of each interruptableWriteFully call.
+struct FrameHeader {
+    uint32_t size;
+    // Number of FDs sent on the socket for this frame, which are sent before
+    // the frame is written to the ring.
+    uint32_t numFds;
+};
+
+constexpr size_t ringStride(size_t ringSize) {
+    return sizeof(RingControl) + ringSize;
+}
+constexpr size_t shmSize(size_t ringSize) {
+    return 2 * ringStride(ringSize);
+}
+
+bool isValidRingSize(size_t ringSize) {
+    return ringSize >= kMinRingSize && ringSize <= kMaxRingSize &&
+            (ringSize & (ringSize - 1)) == 0;
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+class Mapping {
+public:
+    Mapping() = default;
+    Mapping(void* addr, size_t size) : mAddr(addr), mSize(size) {}
+    Mapping(Mapping&& other) noexcept : mAddr(other.mAddr), mSize(other.mSize) {
+        other.mAddr = nullptr;
+    }
+    ~Mapping() {
+        if (mAddr != nullptr) munmap(mAddr, mSize);
+    }
+    uint8_t* get() const { return reinterpret_cast<uint8_t*>(mAddr); }
+
+private:
+    void* mAddr = nullptr;
+    size_t mSize = 0;
+};
+
+Mapping mapShm(borrowed_fd fd, size_t size) {
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Failed to mmap shared memory: %s", strerror(errno));
+        return Mapping();
+    }
+    return Mapping(addr, size);
+}
+
+} // namespace
+
+// RpcTransport which copies data through shared memory rings.
+class RpcTransportShm : public RpcTransport {
+public:
+    RpcTransportShm(android::RpcTransportFd socket, Mapping mapping, size_t ringSize,
+                    bool isServer)
+          : mSocket(std::move(socket)), mMapping(std::move(mapping)), mRingSize(ringSize) {
+        // ring 0 is client -> server, ring 1 is server -> client
+        uint8_t* rings[] = {mMapping.get(), mMapping.get() + ringStride(ringSize)};
+        mTx = rings[isServer ? 1 : 0];
+        mRx = rings[isServer ? 0 : 1];
+    }
+
+    status_t pollRead(void) override {
+        if (mRxFrameRemaining > 0 || rxAvailable() != 0) return OK;
+
+        if (status_t status = drainSocket(); status != OK) return status;
+        if (rxAvailable() != 0) return OK;
+        if (mPeerClosed) return DEAD_OBJECT;
+        return WOULD_BLOCK;
+    }
+
+    status_t prepareToPollRead() override {
+        // The caller is about to sleep on the socket, so the next write must
+        // ring the doorbell. The flag stays set until then, which only costs
+        // the writer a byte if the caller was woken up for something else.
+        control(mRx)->consumerSleeping.store(1, std::memory_order_seq_cst);
+        if (rxAvailable() != 0) {
+            control(mRx)->consumerSleeping.store(0, std::memory_order_relaxed);
+            return OK;
+        }
+        return WOULD_BLOCK;
+    }
+
+    status_t interruptableWriteFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<SmallFunction<status_t()>>& altPoll,
+            const std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) override {
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) return BAD_VALUE;
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+
+        size_t size = 0;
+        for (int i = 0; i < niovs; i++) {
+            if (__builtin_add_overflow(size, iovs[i].iov_len, &size)) return BAD_VALUE;
+        }
+        if (size == 0) return OK;
+        if (size > std::numeric_limits<uint32_t>::max()) return BAD_VALUE;
+
+        FrameHeader header{.size = static_cast<uint32_t>(size), .numFds = 0};
+        if (ancillaryFds != nullptr && !ancillaryFds->empty()) {
+            if (ancillaryFds->size() > kMaxFdsPerFrame) return BAD_VALUE;
+
+            // The FDs are queued on the socket before the frame is visible in
+            // the ring, so they are always there when the reader needs them.
+            uint8_t fdsByte = kFdsByte;
+            iovec iov{&fdsByte, sizeof(fdsByte)};
+            auto send = [&](iovec* iovs, int niovs) -> ssize_t {
+                return binder::os::sendMessageOnSocket(mSocket, iovs, niovs, ancillaryFds);
+            };
+            if (status_t status = interruptableReadOrWrite(mSocket, fdTrigger, &iov, 1, send,
+                                                           "sendmsg", POLLOUT, altPoll);
+                status != OK) {
+                return status;
+            }
+            header.numFds = static_cast<uint32_t>(ancillaryFds->size());
+        }
+
+        if (status_t status = writeToRing(fdTrigger, altPoll, &header, sizeof(header));
+            status != OK) {
+            return status;
+        }
+        for (int i = 0; i < niovs; i++) {
+            if (status_t status =
+                        writeToRing(fdTrigger, altPoll, iovs[i].iov_base, iovs[i].iov_len);
+                status != OK) {
+                return status;
+            }
+        }
+        return OK;
+    }
+
+    status_t interruptableReadFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<SmallFunction<status_t()>>& altPoll,
+            std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) override {
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) return BAD_VALUE;
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+
+        for (int i = 0; i < niovs; i++) {
+            uint8_t* data = reinterpret_cast<uint8_t*>(iovs[i].iov_base);
+            size_t remaining = iovs[i].iov_len;
+            while (remaining > 0) {
+                if (mRxFrameRemaining == 0) {
+                    if (status_t status = beginFrame(fdTrigger, altPoll, ancillaryFds);
+                        status != OK) {
+                        return status;
+                    }
+                    continue;
+                }
+
+                size_t size = std::min(remaining, mRxFrameRemaining);
+                if (status_t status = readFromRing(fdTrigger, altPoll, data, size);
+                    status != OK) {
+                    return status;
+                }
+                data += size;
+                remaining -= size;
+                mRxFrameRemaining -= size;
+            }
+        }
+        return OK;
+    }
+
+    bool isWaiting() override { return mWaiting || mSocket.isInPollingState(); }
+
+private:
+    RingControl* control(uint8_t* ring) const { return reinterpret_cast<RingControl*>(ring); }
+    uint8_t* ringData(uint8_t* ring) const { return ring + sizeof(RingControl); }
+
+    // Bytes which can be read. Only our own copy of the tail is trusted, and
+    // a head which is out of range is reported as corruption by readFromRing.
+    size_t rxAvailable() const {
+        return control(mRx)->head.load(std::memory_order_acquire) - mRxTail;
+    }
+
+    // Bytes which can be written. A corrupted tail reports some space, so
+    // that writeToRing goes on to report the corruption.
+    size_t txSpace() const {
+        uint64_t used = mTxHead - control(mTx)->tail.load(std::memory_order_acquire);
+        return used > mRingSize ? 1 : mRingSize - used;
+    }
+
+    status_t writeToRing(FdTrigger* fdTrigger,
+                         const std::optional<SmallFunction<status_t()>>& altPoll,
+                         const void* data, size_t size) {
+        RingControl* ctl = control(mTx);
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+
+        while (size > 0) {
+            uint64_t used = mTxHead - ctl->tail.load(std::memory_order_acquire);
+            if (used > mRingSize) {
+                ALOGE("Peer corrupted shared memory ring (tail)");
+                return BAD_VALUE;
+            }
+            size_t space = mRingSize - used;
+            if (space == 0) {
+                if (status_t status = waitForSpace(fdTrigger, altPoll); status != OK) {
+                    return status;
+                }
+                continue;
+            }
+
+            size_t chunk = std::min(size, space);
+            size_t offset = mTxHead & (mRingSize - 1);
+            size_t first = std::min(chunk, mRingSize - offset);
+            memcpy(ringData(mTx) + offset, src, first);
+            memcpy(ringData(mTx), src + first, chunk - first);
+            src += chunk;
+            size -= chunk;
+            mTxHead += chunk;
+
+            // seq_cst, so the consumer either sees the new head when it
+            // rechecks, or we see that it is sleeping.
+            ctl->head.store(mTxHead, std::memory_order_seq_cst);
+            ringDoorbell();
+        }
+        return OK;
+    }
+
+    void ringDoorbell() {
+        RingControl* ctl = control(mTx);
+        if (ctl->consumerSleeping.load(std::memory_order_seq_cst) == 0) return;
+        if (ctl->consumerSleeping.exchange(0) == 0) return;
+
+        uint8_t doorbell = kDoorbellByte;
+        ssize_t ret = TEMP_FAILURE_RETRY(
+                ::send(mSocket.fd.get(), &doorbell, sizeof(doorbell), MSG_DONTWAIT | MSG_NOSIGNAL));
+        // If the socket is full, the consumer already has doorbells to wake up for.
+        if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_RPC_DETAIL("RpcTransportShm doorbell: %s", strerror(errno));
+        }
+    }
+
+    // Waits on the producerSleeping futex until the consumer frees space. The
+    // wait is bounded, since neither the trigger nor the peer going away can
+    // wake it up.
+    status_t waitForSpace(FdTrigger* fdTrigger,
+                          const std::optional<SmallFunction<status_t()>>& altPoll) {
+        RingControl* ctl = control(mTx);
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+
+        pollfd pfd{.fd = mSocket.fd.get(), .events = POLLRDHUP, .revents = 0};
+        if (TEMP_FAILURE_RETRY(poll(&pfd, 1, 0)) < 0) return -errno;
+        if (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL)) return DEAD_OBJECT;
+
+        // The peer may be blocked writing to us, so process its commands
+        // instead, which backs off by itself.
+        if (altPoll) return (*altPoll)();
+
+        ctl->producerSleeping.store(1, std::memory_order_seq_cst);
+        if (txSpace() != 0) {
+            ctl->producerSleeping.store(0, std::memory_order_relaxed);
+            return OK;
+        }
+
+        timespec timeout{.tv_sec = 0,
+                         .tv_nsec = std::chrono::nanoseconds(kFullRingWaitTimeout).count()};
+        // Not FUTEX_PRIVATE_FLAG, since the ring is shared with the peer.
+        if (syscall(SYS_futex, reinterpret_cast<uint32_t*>(&ctl->producerSleeping), FUTEX_WAIT,
+                    1, &timeout, nullptr, 0) != 0 &&
+            errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+            int savedErrno = errno;
+            ctl->producerSleeping.store(0, std::memory_order_relaxed);
+            ALOGE("RpcTransportShm futex wait: %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+        ctl->producerSleeping.store(0, std::memory_order_relaxed);
+        return OK;
+    }
+
+    void wakeProducer() {
+        RingControl* ctl = control(mRx);
+        if (ctl->producerSleeping.load(std::memory_order_seq_cst) == 0) return;
+        if (ctl->producerSleeping.exchange(0) == 0) return;
+
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&ctl->producerSleeping), FUTEX_WAKE, 1,
+                nullptr, nullptr, 0);
+    }
+
+    status_t readFromRing(FdTrigger* fdTrigger,
+                          const std::optional<SmallFunction<status_t()>>& altPoll, void* data,
+                          size_t size) {
+        RingControl* ctl = control(mRx);
+        uint8_t* dst = reinterpret_cast<uint8_t*>(data);
+
+        while (size > 0) {
+            size_t available = rxAvailable();
+            if (available > mRingSize) {
+                ALOGE("Peer corrupted shared memory ring (head)");
+                return BAD_VALUE;
+            }
+            if (available == 0) {
+                if (status_t status = waitForData(fdTrigger, altPoll); status != OK) {
+                    return status;
+                }
+                continue;
+            }
+
+            size_t chunk = std::min(size, available);
+            size_t offset = mRxTail & (mRingSize - 1);
+            size_t first = std::min(chunk, mRingSize - offset);
+            memcpy(dst, ringData(mRx) + offset, first);
+            memcpy(dst + first, ringData(mRx), chunk - first);
+            dst += chunk;
+            size -= chunk;
+            mRxTail += chunk;
+
+            // seq_cst, so the producer either sees the new tail when it
+            // rechecks, or we see that it is sleeping.
+            ctl->tail.store(mRxTail, std::memory_order_seq_cst);
+            wakeProducer();
+        }
+        return OK;
+    }
+
+    status_t waitForData(FdTrigger* fdTrigger,
+                         const std::optional<SmallFunction<status_t()>>& altPoll) {
+        RingControl* ctl = control(mRx);
+
+        mWaiting = true;
+        auto waitingGuard = make_scope_guard([&] { mWaiting = false; });
+
+        auto spinUntil = std::chrono::steady_clock::now() + kSpinDuration;
+        for (size_t i = 1;; i++) {
+            if (rxAvailable() != 0) return OK;
+            cpuRelax();
+            if (i % 64 == 0 && std::chrono::steady_clock::now() >= spinUntil) break;
+        }
+
+        while (true) {
+            if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+            if (mPeerClosed) return DEAD_OBJECT;
+
+            ctl->consumerSleeping.store(1, std::memory_order_seq_cst);
+            if (rxAvailable() != 0) {
+                ctl->consumerSleeping.store(0, std::memory_order_relaxed);
+                return OK;
+            }
+
+            status_t status = altPoll ? (*altPoll)() : fdTrigger->triggerablePoll(mSocket, POLLIN);
+            ctl->consumerSleeping.store(0, std::memory_order_relaxed);
+            if (rxAvailable() != 0) return OK;
+            if (status != OK) return status;
+
+            if (status_t status = drainSocket(); status != OK) return status;
+        }
+    }
+
+    // Reads doorbells and FDs from the socket, without blocking.
+    status_t drainSocket() {
+        while (!mPeerClosed) {
+            uint8_t buf[64];
+            iovec iov{buf, sizeof(buf)};
+            std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+            ssize_t ret = binder::os::receiveMessageFromSocket(mSocket, &iov, 1, &fds);
+            if (ret < 0) {
+                int savedErrno = errno;
+                if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) break;
+                LOG_RPC_DETAIL("RpcTransportShm recvmsg(): %s", strerror(savedErrno));
+                return -savedErrno;
+            }
+            if (ret == 0) mPeerClosed = true;
+            for (auto& fd : fds) mRxFds.push_back(std::move(fd));
+        }
+        return OK;
+    }
+
+    status_t beginFrame(FdTrigger* fdTrigger,
+                        const std::optional<SmallFunction<status_t()>>& altPoll,
+                        std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) {
+        FrameHeader header;
+        if (status_t status = readFromRing(fdTrigger, altPoll, &header, sizeof(header));
+            status != OK) {
+            return status;
+        }
+        if (header.size == 0 || header.numFds > kMaxFdsPerFrame) {
+            ALOGE("Invalid shared memory frame: size %" PRIu32 " with %" PRIu32 " FDs",
+                  header.size, header.numFds);
+            return BAD_VALUE;
+        }
+
+        if (header.numFds > 0) {
+            if (mRxFds.size() < header.numFds) {
+                if (status_t status = drainSocket(); status != OK) return status;
+            }
+            if (mRxFds.size() < header.numFds) {
+                ALOGE("Expecting %" PRIu32 " FDs for frame, but only received %zu",
+                      header.numFds, mRxFds.size());
+                return BAD_VALUE;
+            }
+            for (uint32_t i = 0; i < header.numFds; i++) {
+                // if the caller doesn't want FDs, they are closed here
+                if (ancillaryFds != nullptr) ancillaryFds->push_back(std::move(mRxFds.front()));
+                mRxFds.pop_front();
+            }
+        }
+
+        mRxFrameRemaining = header.size;
+        return OK;
+    }
+
+    android::RpcTransportFd mSocket;
+    Mapping mMapping;
+    const size_t mRingSize;
+    uint8_t* mTx = nullptr;
+    uint8_t* mRx = nullptr;
+
+    // Our own copies of the counters we own. Values in shared memory are
+    // only trusted after validating them against these.
+    uint64_t mTxHead = 0;
+    uint64_t mRxTail = 0;
+
+    size_t mRxFrameRemaining = 0;
+    std::deque<std::variant<unique_fd, borrowed_fd>> mRxFds;
+    bool mPeerClosed = false;
+    std::atomic<bool> mWaiting = false;
+};
+
+class RpcTransportCtxShm : public RpcTransportCtx {
+public:
+    RpcTransportCtxShm(bool isServer, size_t ringSize)
+          : mIsServer(isServer), mRingSize(ringSize) {}
+
+    std::unique_ptr<RpcTransport> newTransport(android::RpcTransportFd socket,
+                                               FdTrigger* fdTrigger) const override {
+        return mIsServer ? newServerTransport(std::move(socket), fdTrigger)
+                         : newClientTransport(std::move(socket), fdTrigger);
+    }
+    std::vector<uint8_t> getCertificate(RpcCertificateFormat) const override { return {}; }
+
+private:
+    std::unique_ptr<RpcTransport> newClientTransport(android::RpcTransportFd socket,
+                                                     FdTrigger* fdTrigger) const {
+        unique_fd memfd(memfd_create("binder_rpc_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+        if (!memfd.ok()) {
+            ALOGE("Failed memfd_create: %s", strerror(errno));
+            return nullptr;
+        }
+        size_t size = shmSize(mRingSize);
+        if (TEMP_FAILURE_RETRY(ftruncate(memfd.get(), size)) != 0) {
+            ALOGE("Failed to size shared memory: %s", strerror(errno));
+            return nullptr;
+        }
+        // The server relies on the size not changing, since accessing a mapping
+        // past the end of a shrunk file is SIGBUS.
+        if (fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+            ALOGE("Failed to seal shared memory: %s", strerror(errno));
+            return nullptr;
+        }
+
+        Mapping mapping = mapShm(memfd, size);
+        if (mapping.get() == nullptr) return nullptr;
+        new (mapping.get()) RingControl();
+        new (mapping.get() + ringStride(mRingSize)) RingControl();
+
+        ShmHandshake handshake{.magic = kShmHandshakeMagic,
+                               .ringSize = static_cast<uint32_t>(mRingSize)};
+        iovec iov{&handshake, sizeof(handshake)};
+        std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+        fds.emplace_back(borrowed_fd(memfd.get()));
+        auto send = [&](iovec* iovs, int niovs) -> ssize_t {
+            return binder::os::sendMessageOnSocket(socket, iovs, niovs, &fds);
+        };
+        if (status_t status = interruptableReadOrWrite(socket, fdTrigger, &iov, 1, send,
+                                                       "sendmsg", POLLOUT, std::nullopt);
+            status != OK) {
+            ALOGE("Failed to send shared memory: %s", statusToString(status).c_str());
+            return nullptr;
+        }
+
+        return std::make_unique<RpcTransportShm>(std::move(socket), std::move(mapping), mRingSize,
+                                                 false /*isServer*/);
+    }
+
+    std::unique_ptr<RpcTransport> newServerTransport(android::RpcTransportFd socket,
+                                                     FdTrigger* fdTrigger) const {
+        ShmHandshake handshake{};
+        iovec iov{&handshake, sizeof(handshake)};
+        std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+        auto recv = [&](iovec* iovs, int niovs) -> ssize_t {
+            return binder::os::receiveMessageFromSocket(socket, iovs, niovs, &fds);
+        };
+        if (status_t status = interruptableReadOrWrite(socket, fdTrigger, &iov, 1, recv,
+                                                       "recvmsg", POLLIN, std::nullopt);
+            status != OK) {
+            ALOGE("Failed to receive shared memory: %s", statusToString(status).c_str());
+            return nullptr;
+        }
+
+        if (handshake.magic != kShmHandshakeMagic || !isValidRingSize(handshake.ringSize)) {
+            ALOGE("Invalid shared memory handshake: magic 0x%" PRIx32 ", ring size %" PRIu32,
+                  handshake.magic, handshake.ringSize);
+            return nullptr;
+        }
+        if (fds.size() != 1) {
+            ALOGE("Expecting one FD for shared memory, but got %zu", fds.size());
+            return nullptr;
+        }
+        const auto& memfd = std::get<unique_fd>(fds[0]);
+
+        size_t size = shmSize(handshake.ringSize);
+        struct stat st;
+        if (fstat(memfd.get(), &st) != 0 || static_cast<size_t>(st.st_size) != size) {
+            ALOGE("Shared memory is not the expected size %zu", size);
+            return nullptr;
+        }
+        int seals = fcntl(memfd.get(), F_GET_SEALS);
+        if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+            ALOGE("Shared memory can be shrunk by the client (seals %d)", seals);
+            return nullptr;
+        }
+
+        Mapping mapping = mapShm(memfd, size);
+        if (mapping.get() == nullptr) return nullptr;
+
+        return std::make_unique<RpcTransportShm>(std::move(socket), std::move(mapping),
+                                                 handshake.ringSize, true /*isServer*/);
+    }
+
+    bool mIsServer;
+    size_t mRingSize;
+};
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryShm::newServerCtx() const {
+    return std::make_unique<RpcTransportCtxShm>(true /*isServer*/, mRingSize);
+}
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryShm::newClientCtx() const {
+    return std::make_unique<RpcTransportCtxShm>(false /*isServer*/, mRingSize);
+}
+
+const char* RpcTransportCtxFactoryShm::toCString() const {
+    return "shm";
+}
+
+std::unique_ptr<RpcTransportCtxFactory> RpcTransportCtxFactoryShm::make(size_t ringSize) {
+    LOG_ALWAYS_FATAL_IF(!isValidRingSize(ringSize), "Invalid shared memory ring size %zu",
+                        ringSize);
+    return std::unique_ptr<RpcTransportCtxFactoryShm>(new RpcTransportCtxFactoryShm(ringSize));
+}
+
+} // namespace android
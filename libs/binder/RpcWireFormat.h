@@ -93,8 +93,17 @@ enum : uint32_t {
      * want to create a 'Parcel' object for every decref)
      */
     RPC_COMMAND_DEC_STRONG,
+    /**
+     * follows is an array of RpcDecStrong, at most kRpcMaxDecStrongBatch
+     *
+     * Only sent starting at protocol version
+     * RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_DEC_STRONG_BATCH.
+     */
+    RPC_COMMAND_DEC_STRONG_BATCH,
 };
 
+constexpr size_t kRpcMaxDecStrongBatch = 256;
+
 /**
  * These commands are used when the address in an RpcWireTransaction is zero'd
  * out (no address). This allows the transact/reply flow to be used for
@@ -118,7 +127,18 @@ struct RpcWireHeader {
     uint32_t command; // RPC_COMMAND_*
     uint32_t bodySize;
 
-    uint32_t reserved[2];
+    // -- Fields below only used starting at protocol version
+    // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID --
+
+    // Identifies the synchronous transaction (and any transactions nested
+    // inside of it, in either direction) that a RPC_COMMAND_TRANSACT or
+    // RPC_COMMAND_REPLY belongs to, so that several threads may have
+    // transactions in flight on a single connection. Replies and nested
+    // transactions carry the ID of the outermost transaction. Zero for oneway
+    // transactions and refcount commands.
+    uint32_t transactionId;
+
+    uint32_t reserved;
 };
 static_assert(sizeof(RpcWireHeader) == 16);
 
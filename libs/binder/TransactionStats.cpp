@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+
+#include <binder/TransactionStats.h>
+
+#include <binder/IBinder.h>
+#include <binder/RpcThreads.h>
+#include <utils/String8.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string_view>
+#include <tuple>
+
+#include <errno.h>
+
+#include "file.h"
+
+namespace android::binder::debug {
+
+using Direction = TransactionStats::Direction;
+using Histogram = TransactionStats::Histogram;
+
+static std::atomic<bool> gEnabled;
+
+namespace {
+
+// Only written by the thread which owns it, but read concurrently by
+// snapshot().
+struct AtomicHistogram {
+    void add(uint64_t value) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        if (value > max.load(std::memory_order_relaxed)) {
+            max.store(value, std::memory_order_relaxed);
+        }
+        buckets[Histogram::bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void mergeInto(Histogram* out) const {
+        out->count += count.load(std::memory_order_relaxed);
+        out->sum += sum.load(std::memory_order_relaxed);
+        out->max = std::max(out->max, max.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < Histogram::kNumBuckets; i++) {
+            out->buckets[i] += buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void clear() {
+        count = 0;
+        sum = 0;
+        max = 0;
+        for (auto& bucket : buckets) bucket = 0;
+    }
+
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<uint64_t> max = 0;
+    std::array<std::atomic<uint64_t>, Histogram::kNumBuckets> buckets = {};
+};
+
+struct Counters {
+    void mergeInto(TransactionStats::Entry* out) const {
+        latencyUs.mergeInto(&out->latencyUs);
+        dataSize.mergeInto(&out->dataSize);
+        replySize.mergeInto(&out->replySize);
+        out->errors += errors.load(std::memory_order_relaxed);
+    }
+
+    void clear() {
+        latencyUs.clear();
+        dataSize.clear();
+        replySize.clear();
+        errors = 0;
+    }
+
+    AtomicHistogram latencyUs;
+    AtomicHistogram dataSize;
+    AtomicHistogram replySize;
+    std::atomic<uint64_t> errors = 0;
+};
+
+using Key = std::tuple<Direction, std::u16string, uint32_t>;
+using KeyView = std::tuple<Direction, std::u16string_view, uint32_t>;
+
+// Bounds the memory used by a thread which sees many distinct (possibly
+// garbage) interface tokens.
+constexpr size_t kMaxKeysPerThread = 1024;
+
+class ThreadStats;
+
+struct GlobalStats {
+    RpcMutex lock;
+    std::set<ThreadStats*> threads;
+    // merged counters of threads which have exited
+    std::map<Key, TransactionStats::Entry> retired;
+};
+
+GlobalStats& globalStats() {
+    // never destroyed, since threads can exit after static destructors run
+    static GlobalStats* stats = new GlobalStats;
+    return *stats;
+}
+
+TransactionStats::Entry makeEntry(const Key& key) {
+    TransactionStats::Entry entry;
+    entry.direction = std::get<0>(key);
+    const std::u16string& interface = std::get<1>(key);
+    entry.interface = String8(interface.data(), interface.size()).c_str();
+    entry.code = std::get<2>(key);
+    return entry;
+}
+
+class ThreadStats {
+public:
+    static ThreadStats& self() {
+#ifdef BINDER_RPC_SINGLE_THREADED
+        static ThreadStats stats;
+#else
+        thread_local ThreadStats stats;
+#endif
+        return stats;
+    }
+
+    ThreadStats() {
+        GlobalStats& global = globalStats();
+        RpcMutexLockGuard _l(global.lock);
+        global.threads.insert(this);
+    }
+
+    ~ThreadStats() {
+        GlobalStats& global = globalStats();
+        RpcMutexLockGuard _l(global.lock);
+        global.threads.erase(this);
+        for (const auto& [key, counters] : mCounters) {
+            auto it = global.retired.try_emplace(key, makeEntry(key)).first;
+            counters->mergeInto(&it->second);
+        }
+    }
+
+    Counters* find(Direction direction, std::u16string_view interface, uint32_t code) {
+        // only this thread inserts, so it can search without the lock
+        auto it = mCounters.find(KeyView(direction, interface, code));
+        if (it != mCounters.end()) [[likely]] {
+            return it->second.get();
+        }
+        if (mCounters.size() >= kMaxKeysPerThread) return nullptr;
+
+        RpcMutexLockGuard _l(mLock);
+        return mCounters
+                .emplace(Key(direction, std::u16string(interface), code),
+                         std::make_unique<Counters>())
+                .first->second.get();
+    }
+
+    // Guards the shape of mCounters against concurrent readers. Must be
+    // acquired after GlobalStats::lock.
+    RpcMutex mLock;
+    std::map<Key, std::unique_ptr<Counters>, std::less<>> mCounters;
+};
+
+const char* directionString(Direction direction) {
+    switch (direction) {
+        case Direction::INCOMING:
+            return "incoming";
+        case Direction::OUTGOING:
+            return "outgoing";
+    }
+}
+
+void printHistogram(std::ostream& out, const char* name, const Histogram& histogram) {
+    if (histogram.count == 0) return;
+    out << "    " << name << ": mean " << histogram.sum / histogram.count << ", p50 "
+        << histogram.percentile(50) << ", p90 " << histogram.percentile(90) << ", p99 "
+        << histogram.percentile(99) << ", max " << histogram.max << "\n";
+}
+
+} // namespace
+
+size_t Histogram::bucketFor(uint64_t value) {
+    if (value < 4) return value;
+    size_t power = 63 - __builtin_clzll(value);
+    size_t bucket = (power - 1) * 4 + ((value >> (power - 2)) & 3);
+    return std::min(bucket, kNumBuckets - 1);
+}
+
+uint64_t Histogram::bucketLowerBound(size_t bucket) {
+    if (bucket < 4) return bucket;
+    size_t power = bucket / 4 + 1;
+    return static_cast<uint64_t>(4 + bucket % 4) << (power - 2);
+}
+
+uint64_t Histogram::percentile(double percentile) const {
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(count * percentile / 100));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        seen += buckets[i];
+        if (seen >= rank) return bucketLowerBound(i);
+    }
+    return bucketLowerBound(kNumBuckets - 1);
+}
+
+void TransactionStats::setEnabled(bool enabled) {
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionStats::isEnabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+int64_t TransactionStats::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+// Reads the interface token written by Parcel::writeInterfaceToken. The data
+// position is restored afterwards, and data() isn't used, since it would copy
+// in the external regions of the parcel.
+std::u16string_view TransactionStats::interfaceOf(const Parcel& data, uint32_t code) {
+    if (code < IBinder::FIRST_CALL_TRANSACTION || code > IBinder::LAST_CALL_TRANSACTION) {
+        return {};
+    }
+
+    const size_t pos = data.mDataPos;
+    // kernel binder parcels start with the strict mode policy, work source
+    // and vendor header
+    data.mDataPos = data.isForRpc() ? 0 : 3 * sizeof(int32_t);
+    // Not readString16Inplace, which logs parcels that don't hold a string
+    // there as an attack.
+    int32_t len = -1;
+    const char16_t* str = nullptr;
+    if (data.readInt32(&len) == OK && len >= 0 &&
+        static_cast<size_t>(len) < data.dataAvail() / sizeof(char16_t)) {
+        str = static_cast<const char16_t*>(data.readInplace((len + 1) * sizeof(char16_t)));
+    }
+    const size_t tokenEnd = data.mDataPos;
+    data.mDataPos = pos;
+    if (str == nullptr) return {};
+
+    // An external region before the end of the token hasn't been written yet.
+    if (const auto* rpcFields = data.maybeRpcFields();
+        rpcFields != nullptr && rpcFields->mExternalRegions != nullptr) {
+        const auto& regions = *rpcFields->mExternalRegions;
+        if (regions.state.load(std::memory_order_acquire) !=
+                    Parcel::RpcFields::ExternalRegions::COPIED &&
+            !regions.regions.empty() && regions.regions.front().offset < tokenEnd) {
+            return {};
+        }
+    }
+    if (str[len] != u'\0') return {};
+    return std::u16string_view(str, len);
+}
+
+void TransactionStats::record(Direction direction, const Parcel& data, uint32_t code,
+                              int64_t latencyNs, const Parcel* reply, status_t status) {
+    Counters* counters = ThreadStats::self().find(direction, interfaceOf(data, code), code);
+    if (counters == nullptr) return;
+
+    counters->latencyUs.add(latencyNs > 0 ? latencyNs / 1000 : 0);
+    counters->dataSize.add(data.dataSize());
+    if (reply != nullptr) counters->replySize.add(reply->dataSize());
+    if (status != OK) counters->errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<TransactionStats::Entry> TransactionStats::snapshot() {
+    GlobalStats& global = globalStats();
+    RpcMutexLockGuard _l(global.lock);
+
+    std::map<Key, Entry> merged = global.retired;
+    for (ThreadStats* thread : global.threads) {
+        RpcMutexLockGuard _tl(thread->mLock);
+        for (const auto& [key, counters] : thread->mCounters) {
+            auto it = merged.try_emplace(key, makeEntry(key)).first;
+            counters->mergeInto(&it->second);
+        }
+    }
+
+    std::vector<Entry> entries;
+    entries.reserve(merged.size());
+    for (auto& [key, entry] : merged) entries.push_back(std::move(entry));
+    return entries;
+}
+
+void TransactionStats::reset() {
+    GlobalStats& global = globalStats();
+    RpcMutexLockGuard _l(global.lock);
+
+    global.retired.clear();
+    for (ThreadStats* thread : global.threads) {
+        RpcMutexLockGuard _tl(thread->mLock);
+        for (auto& [key, counters] : thread->mCounters) counters->clear();
+    }
+}
+
+void TransactionStats::dump(std::ostream& out) {
+    std::vector<Entry> entries = snapshot();
+    out << "Binder transaction stats (" << (isEnabled() ? "enabled" : "disabled") << "), "
+        << entries.size() << " entries:\n";
+    for (const Entry& entry : entries) {
+        out << "  " << directionString(entry.direction) << " "
+            << (entry.interface.empty() ? "<unknown>" : entry.interface.c_str()) << " code "
+            << entry.code << ": " << entry.latencyUs.count << " transactions, " << entry.errors
+            << " errors\n";
+        printHistogram(out, "latency (us)", entry.latencyUs);
+        printHistogram(out, "data (bytes)", entry.dataSize);
+        printHistogram(out, "reply (bytes)", entry.replySize);
+    }
+}
+
+status_t TransactionStats::dump(int fd) {
+#ifdef BINDER_WITH_KERNEL_IPC
+    std::ostringstream out;
+    dump(out);
+    std::string str = out.str();
+    if (!WriteFully(borrowed_fd(fd), str.data(), str.size())) return -errno;
+    return OK;
+#else  // BINDER_WITH_KERNEL_IPC
+    // only dumpsys, over kernel binder, passes a file descriptor to dump to
+    (void)fd;
+    return INVALID_OPERATION;
+#endif // BINDER_WITH_KERNEL_IPC
+}
+
+} // namespace android::binder::debug
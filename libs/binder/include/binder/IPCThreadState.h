@@ -209,6 +209,8 @@ public:
             // side.
             static const int32_t kUnsetWorkSource = -1;
 private:
+    friend class PoolThread;
+
                                 IPCThreadState();
                                 ~IPCThreadState();
 
@@ -222,6 +224,13 @@ private:
                                                      uint32_t code,
                                                      const Parcel& data,
                                                      status_t* statusBuffer);
+            // Adaptive threads (see ProcessState::setThreadPoolAdaptive)
+            // enter the looper like joined threads, but may exit when idle.
+            void                joinThreadPoolInternal(bool isMain, bool isAdaptive);
+            // Waits for the driver to have a command for this thread, and
+            // reads it. Returns TIMED_OUT if none came within timeoutMs, and
+            // WOULD_BLOCK if the thread should wait again.
+            status_t            waitForCommand(int timeoutMs);
             status_t            getAndExecuteCommand();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
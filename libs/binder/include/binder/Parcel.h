@@ -17,14 +17,21 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <limits>
 #include <map> // for legacy reasons
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <variant>
 #include <vector>
 
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
 #include <binder/unique_fd.h>
 #ifndef BINDER_DISABLE_NATIVE_HANDLE
 #include <cutils/native_handle.h>
@@ -57,6 +64,7 @@ namespace binder {
 class Status;
 namespace debug {
 class RecordedTransaction;
+class TransactionStats;
 }
 }
 
@@ -186,6 +194,16 @@ public:
     status_t            writeStrongBinder(const sp<IBinder>& val);
     status_t            writeInt32Array(size_t len, const int32_t *val);
     status_t            writeByteArray(size_t len, const uint8_t *val);
+    // Same wire format as writeByteArray. For RPC Parcels, 'val' is not
+    // copied into this Parcel, and is instead sent directly from where it is
+    // when this Parcel is transacted. 'val' must not be modified while this
+    // Parcel refers to it, and 'keepAlive' is held until then. If the data of
+    // this Parcel is accessed in-process (e.g. data(), setDataPosition()),
+    // 'val' is copied in at that point.
+    //
+    // For kernel binder Parcels and small arrays, this is writeByteArray.
+    status_t            writeExternalByteArray(size_t len, const uint8_t* val,
+                                               std::shared_ptr<const void> keepAlive);
     status_t            writeBool(bool val);
     status_t            writeChar(char16_t val);
     status_t            writeByte(int8_t val);
@@ -423,6 +441,34 @@ public:
     status_t            readString16(std::optional<String16>* pArg) const;
     status_t            readString16(std::unique_ptr<String16>* pArg) const __attribute__((deprecated("use std::optional version instead")));
     const char16_t*     readString16Inplace(size_t* outLen) const;
+
+    // Zero-copy views of data written by writeByteVector, writeInt32Vector,
+    // writeString8 and writeString16. Nothing is allocated or copied: the
+    // views point into this parcel's buffer, so they are only valid until the
+    // parcel is next written to, resized or destroyed. A null (or, for
+    // strings, malformed) value gives UNEXPECTED_NULL; an array running past
+    // the end of the data gives BAD_VALUE.
+    status_t            readByteArrayInplace(const uint8_t** outData, size_t* outSize) const;
+    status_t            readInt32ArrayInplace(const int32_t** outData, size_t* outSize) const;
+    status_t            readString8Inplace(std::string_view* str) const;
+    status_t            readString16Inplace(std::u16string_view* str) const;
+#if __cplusplus >= 202002L
+    status_t            readByteArrayInplace(std::span<const uint8_t>* view) const {
+                            const uint8_t* data;
+                            size_t size;
+                            status_t status = readByteArrayInplace(&data, &size);
+                            *view = std::span<const uint8_t>(data, size);
+                            return status;
+                        }
+    status_t            readInt32ArrayInplace(std::span<const int32_t>* view) const {
+                            const int32_t* data;
+                            size_t size;
+                            status_t status = readInt32ArrayInplace(&data, &size);
+                            *view = std::span<const int32_t>(data, size);
+                            return status;
+                        }
+#endif
+
     sp<IBinder>         readStrongBinder() const;
     status_t            readStrongBinder(sp<IBinder>* val) const;
     status_t            readNullableStrongBinder(sp<IBinder>* val) const;
@@ -606,6 +652,19 @@ public:
     static size_t       getGlobalAllocSize();
     static size_t       getGlobalAllocCount();
 
+    // Opt-in reuse of data buffers. While enabled, buffers which Parcels free
+    // are kept in a small per-thread cache, bucketed by size, and the next
+    // Parcels which allocate data on that thread take them from there, so
+    // steady-state transactions don't need malloc. Disabling this frees the
+    // calling thread's cache, other threads' caches are freed when they exit.
+    static void         setBufferRecyclingEnabled(bool enabled);
+    // Number of allocations served from per-thread caches.
+    static size_t       getGlobalRecycledAllocCount();
+    // Bytes held by per-thread caches.
+    static size_t       getGlobalCachedSize();
+    // Bytes held by the calling thread's cache.
+    static size_t       getThreadCachedSize();
+
     bool                replaceCallingWorkSourceUid(uid_t uid);
     // Returns the work source provided by the caller. This can only be trusted for trusted calling
     // uid.
@@ -641,6 +700,12 @@ private:
     // Set the capacity to `desired`, truncating the Parcel if necessary.
     status_t            continueWrite(size_t desired);
     status_t truncateRpcObjects(size_t newObjectsSize);
+    // Copies the bytes of RpcFields::mExternalRegions into the data, for
+    // in-process access. Safe to call from several threads at once.
+    void copyInExternalRegions() const;
+    // Copies the bytes in like copyInExternalRegions, and drops the regions,
+    // before the data is modified.
+    void releaseExternalRegions();
     status_t            writePointer(uintptr_t val);
     status_t            readPointer(uintptr_t *pArg) const;
     uintptr_t           readPointer() const;
@@ -1017,8 +1082,12 @@ private:
             // TODO: Padding of the write is suboptimal when the length of the
             // data is not a multiple of 4.  Consider improving the write() method.
             return write(c.data(), c.size() * sizeof(T));
-        } else if constexpr (std::is_same_v<T, bool>
-                || std::is_same_v<T, char16_t>) {
+        } else if constexpr (std::is_same_v<T, char16_t>) {
+            // reserve data space to write to
+            auto data = reinterpret_cast<int32_t*>(writeInplace(c.size() * sizeof(int32_t)));
+            if (data == nullptr) return BAD_VALUE;
+            widenToInt32(data, c.data(), c.size());
+        } else if constexpr (std::is_same_v<T, bool>) {
             // reserve data space to write to
             auto data = reinterpret_cast<int32_t*>(writeInplace(c.size() * sizeof(int32_t)));
             if (data == nullptr) return BAD_VALUE;
@@ -1200,24 +1269,37 @@ private:
             if (__builtin_mul_overflow(size, sizeof(T), &dataLen)) {
                 return -EOVERFLOW;
             }
-            auto data = reinterpret_cast<const T*>(readInplace(dataLen));
+            auto data = readInplace(dataLen);
             if (data == nullptr) return BAD_VALUE;
             // std::vector::insert and similar methods will require type-dependent
             // byte alignment when inserting from a const iterator such as `data`,
             // e.g. 8 byte alignment for int64_t, and so will not work if `data`
             // is 4 byte aligned (which is all Parcel guarantees). Copying
             // the contents into the vector directly, where possible, circumvents
-            // this.
+            // this. When it is aligned, assign copies in one pass, rather than
+            // zeroing the vector first.
+            if (reinterpret_cast<uintptr_t>(data) % alignof(T) == 0) {
+                auto typedData = reinterpret_cast<const T*>(data);
+                c->assign(typedData, typedData + size);
+            } else {
+                c->resize(size);
+                memcpy(c->data(), data, dataLen);
+            }
+        } else if constexpr (std::is_same_v<T, char16_t>) {
+            auto data = reinterpret_cast<const int32_t*>(
+                    readInplace(static_cast<size_t>(size) * sizeof(int32_t)));
+            if (data == nullptr) return BAD_VALUE;
             c->resize(size);
-            memcpy(c->data(), data, dataLen);
-        } else if constexpr (std::is_same_v<T, bool>
-                || std::is_same_v<T, char16_t>) {
-            c->reserve(size); // avoids default initialization
+            narrowFromInt32(c->data(), data, size);
+        } else if constexpr (std::is_same_v<T, bool>) {
             auto data = reinterpret_cast<const int32_t*>(
                     readInplace(static_cast<size_t>(size) * sizeof(int32_t)));
             if (data == nullptr) return BAD_VALUE;
+            // std::vector<bool> is packed, so set bits in place rather than
+            // growing it one element at a time
+            c->resize(size);
             for (int32_t i = 0; i < size; ++i) {
-                c->emplace_back(static_cast<T>(*data++));
+                if (data[i] != 0) (*c)[i] = true;
             }
         } else if constexpr (is_specialization_v<T, sp>) {
             c->resize(size); // calls ctor
@@ -1280,6 +1362,11 @@ private:
     //-----------------------------------------------------------------------------
     private:
 
+    // char16_t arrays are written with each element widened to an int32_t.
+    // These convert whole arrays in one vectorizable pass.
+    static void widenToInt32(int32_t* out, const char16_t* in, size_t count);
+    static void narrowFromInt32(char16_t* out, const int32_t* in, size_t count);
+
     status_t            mError;
     uint8_t*            mData;
     size_t              mDataSize;
@@ -1324,6 +1411,30 @@ private:
         //
         // Boxed to save space. Lazy allocated.
         std::unique_ptr<std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>> mFds;
+
+        // Ranges of the data which were reserved but not written, and are sent
+        // from memory owned elsewhere instead (see writeExternalByteArray).
+        // Sorted by offset.
+        //
+        // Boxed to save space. Lazy allocated.
+        struct ExternalRegion {
+            size_t offset;
+            size_t size;
+            const uint8_t* data;
+            std::shared_ptr<const void> keepAlive;
+        };
+        struct ExternalRegions {
+            enum State : uint8_t { PENDING, COPYING, COPIED };
+
+            std::vector<ExternalRegion> regions;
+            // Const accessors copy the regions into the data the first time it
+            // is read in-process. Several threads may read the same const
+            // Parcel, so the copy is only done once, by whichever gets here
+            // first. Once COPIED, the data holds the bytes and the regions are
+            // no longer used.
+            std::atomic<State> state = PENDING;
+        };
+        std::unique_ptr<ExternalRegions> mExternalRegions;
     };
     std::variant<KernelFields, RpcFields> mVariantFields;
 
@@ -1449,6 +1560,9 @@ private:
 
     // Needed so that we can save object metadata to the disk
     friend class android::binder::debug::RecordedTransaction;
+    // Reads the interface token of every transaction without moving the data
+    // position or copying in external regions
+    friend class android::binder::debug::TransactionStats;
 };
 
 // ---------------------------------------------------------------------------
@@ -22,7 +22,9 @@
 
 #include <pthread.h>
 
+#include <chrono>
 #include <mutex>
+#include <ostream>
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -62,6 +64,39 @@ public:
     // threads started by 'startThreadPool' or 'joinRpcThreadpool'.
     status_t setThreadPoolMaxThreadCount(size_t maxThreads);
 
+    // Makes the threadpool adaptive. This should be called after
+    // setThreadPoolMaxThreadCount and before startThreadPool.
+    //
+    // By default the kernel asks for a new thread only once every pooled
+    // thread is busy, and threads never exit. In adaptive mode, libbinder
+    // instead starts a thread itself whenever fewer than 'spareThreads'
+    // threads are idle (one more for a while after the pool was saturated),
+    // so that a spike is not queued behind thread creation. Threads started
+    // this way exit when they have waited 'idleTimeout' for a command and
+    // the pool has had more than 'spareThreads' idle threads for as long. The total number of
+    // threads is still bounded as described for setThreadPoolMaxThreadCount.
+    status_t setThreadPoolAdaptive(size_t spareThreads, std::chrono::milliseconds idleTimeout);
+
+    struct ThreadPoolStats {
+        // as set by setThreadPoolMaxThreadCount
+        size_t maxThreads;
+        // threads currently in the threadpool, and how many of them are busy
+        size_t currentThreads;
+        size_t executingThreads;
+        // threads started and retired in adaptive mode
+        size_t threadsSpawned;
+        size_t threadsRetired;
+        // periods during which maxThreads threads were busy, so that new
+        // work had to queue in the kernel
+        size_t starvationCount;
+        int64_t starvationTimeMs;
+        int64_t maxStarvationTimeMs;
+    };
+    ThreadPoolStats getThreadPoolStats() const;
+
+    // Prints getThreadPoolStats(), for use in dump().
+    void dumpThreadPool(std::ostream& out) const;
+
     // Libraries should not call this, as processes should configure
     // threadpools themselves. Should be called in the main function
     // directly before any code executes or joins the threadpool.
@@ -150,6 +185,20 @@ private:
     ProcessState& operator=(const ProcessState& o);
     String8 makeBinderThreadName();
 
+    // Adaptive threadpool, see setThreadPoolAdaptive. IPCThreadState calls
+    // reserveAdaptiveThreadLocked when a command starts; if it returns true,
+    // a thread has been counted as started and must be spawned with
+    // spawnAdaptiveThread. Adaptive threads call retireAdaptiveThread when no
+    // command came for the idle timeout.
+    bool reserveAdaptiveThreadLocked();
+    void spawnAdaptiveThread();
+    bool retireAdaptiveThread();
+    size_t idleThreadsLocked() const;
+    // Whether adaptive threads blocked in the driver should be woken up with
+    // wakeWaitingThreads, because the pool has more idle threads than needed.
+    bool shouldWakeAdaptiveThreadsLocked() const;
+    void wakeWaitingThreads();
+
     struct handle_entry {
         IBinder* binder;
         RefBase::weakref_type* refs;
@@ -177,6 +226,28 @@ private:
     size_t mKernelStartedThreads;
     // Time when thread pool was emptied
     int64_t mStarvationStartTimeMs;
+    // Totals over all times the thread pool was emptied
+    size_t mStarvationCount;
+    int64_t mTotalStarvationTimeMs;
+    int64_t mMaxStarvationTimeMs;
+
+    // Adaptive threadpool configuration, set before the threadpool starts.
+    bool mAdaptive;
+    size_t mSpareThreads;
+    int64_t mIdleTimeoutMs;
+    // Adaptive threads spawned which haven't joined the threadpool yet.
+    size_t mPendingAdaptiveThreads;
+    // Last time fewer than mSpareThreads threads were idle, and last time
+    // none were.
+    int64_t mLastBusyTimeMs;
+    int64_t mLastSaturatedTimeMs;
+    size_t mAdaptiveThreadsSpawned;
+    size_t mAdaptiveThreadsRetired;
+    // Adaptive threads blocked in the driver after polling, which can't time
+    // out, and the number of commands finished so far, for them to tell
+    // whether one finished before they were counted.
+    size_t mAdaptiveThreadsInDriver;
+    uint64_t mFinishedCommandsCount;
 
     mutable std::mutex mLock; // protects everything below.
 
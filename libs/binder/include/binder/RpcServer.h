@@ -133,6 +133,25 @@ public:
     void setMaxThreads(size_t threads);
     size_t getMaxThreads();
 
+    /**
+     * By default, each incoming connection (see setMaxThreads) has its own
+     * thread, which is blocked reading from it while it is idle. If this is
+     * set, incoming connections are instead registered with a shared epoll
+     * set, and connections with commands ready are served by a pool of this
+     * many threads. This is for servers with many mostly idle sessions.
+     *
+     * Each connection is still served by at most one thread at a time, so
+     * commands on a connection are processed in order, and nested
+     * transactions are processed by the thread which is serving the
+     * connection. A thread is busy for as long as the transaction it is
+     * serving, so this must be enough for the transactions which may block
+     * concurrently.
+     *
+     * This must be called before join(). Not supported in single-threaded
+     * builds.
+     */
+    void setEventLoopThreads(size_t threads);
+
     /**
      * By default, the latest protocol version which is supported by a client is
      * used. However, this can be used in order to prevent newer protocol
@@ -258,12 +277,20 @@ private:
             std::array<uint8_t, kRpcAddressSize> addr, size_t addrLen,
             std::function<void(sp<RpcSession>&&, RpcSession::PreJoinSetupResult&&)>&& joinFn);
     static status_t acceptSocketConnection(const RpcServer& server, RpcTransportFd* out);
+    // See setEventLoopThreads
+    struct EventLoop;
+    static void joinEventLoop(int fd, sp<RpcSession>&& session,
+                              RpcSession::PreJoinSetupResult&& result);
+    static void eventLoopThread(sp<RpcServer>&& server);
+    void serveEventLoopKey(uint64_t key);
+    void closeIdleEventLoopConnections();
     static status_t recvmsgSocketConnection(const RpcServer& server, RpcTransportFd* out);
 
     [[nodiscard]] status_t setupSocketServer(const RpcSocketAddress& address);
 
     const std::unique_ptr<RpcTransportCtx> mCtx;
     size_t mMaxThreads = 1;
+    size_t mEventLoopThreads = 0;
     std::optional<uint32_t> mProtocolVersion;
     // A mode is supported if the N'th bit is on, where N is the mode enum's value.
     std::bitset<8> mSupportedFileDescriptorTransportModes = std::bitset<8>().set(
@@ -274,6 +301,7 @@ private:
     std::unique_ptr<RpcMaybeThread> mJoinThread;
     bool mJoinThreadRunning = false;
     std::map<RpcMaybeThread::id, RpcMaybeThread> mConnectingThreads;
+    std::unique_ptr<EventLoop> mEventLoop;
 
     sp<IBinder> mRootObject;
     wp<IBinder> mRootObjectWeak;
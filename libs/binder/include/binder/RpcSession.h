@@ -23,6 +23,7 @@
 #include <utils/RefBase.h>
 
 #include <map>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -35,6 +36,7 @@ class RpcSocketAddress;
 class RpcState;
 class RpcTransport;
 class FdTrigger;
+struct RpcConnectionMultiplexer;
 
 constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_NEXT = 2;
 constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_EXPERIMENTAL = 0xF0000000;
@@ -46,6 +48,23 @@ constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION = 1;
 // * RpcWireTransaction and RpcWireReplyV1 include the parcel data size.
 constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_EXPLICIT_PARCEL_SIZE = 1;
 
+// Starting with this version:
+//
+// * RpcWireHeader carries a transaction ID, which allows synchronous
+//   transactions from multiple threads to share a single connection. When all
+//   outgoing connections are busy, a synchronous call is pipelined onto an
+//   existing connection instead of waiting for one to become available.
+constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID =
+        RPC_WIRE_PROTOCOL_VERSION_EXPERIMENTAL;
+
+// Starting with this version:
+//
+// * Refcount drops are collected per session, and sent together in
+//   RPC_COMMAND_DEC_STRONG_BATCH before the next outgoing transaction, or
+//   shortly after they are made.
+constexpr uint32_t RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_DEC_STRONG_BATCH =
+        RPC_WIRE_PROTOCOL_VERSION_EXPERIMENTAL;
+
 /**
  * This represents a session (group of connections) between a client
  * and a server. Multiple connections are needed for multiple parallel "binder"
@@ -231,6 +250,24 @@ private:
 
     // for 'target', see RpcState::sendDecStrongToTarget
     [[nodiscard]] status_t sendDecStrongToTarget(uint64_t address, size_t target);
+    // sends refcount drops which were queued by sendDecStrongToTarget
+    [[nodiscard]] status_t flushDecStrongs(bool scheduled);
+
+    // Sends the refcount drops queued by sendDecStrongToTarget shortly after
+    // the first of them, unless a transaction sends them first. The thread
+    // holds no strong reference between flushes, and is joined by
+    // shutdownAndWait and the destructor.
+    struct DecStrongFlusher {
+        RpcMutex mutex; // for all below
+        RpcConditionVariable cv;
+        bool scheduled = false;
+        bool stopped = false;
+        RpcMaybeThread thread;
+    };
+    void scheduleDecStrongFlush();
+    void stopDecStrongFlusher();
+    static void decStrongFlushLoop(wp<RpcSession> weakSession,
+                                   std::shared_ptr<DecStrongFlusher> flusher);
 
     class EventListener : public virtual RefBase {
     public:
@@ -257,7 +294,23 @@ private:
         // or receive transactions.
         std::optional<uint64_t> exclusiveTid;
 
+        // Only consulted for incoming connections, which are never shared.
         bool allowNested = false;
+
+        // whether other threads may share this connection for synchronous
+        // transactions, which requires the transport to support concurrent
+        // reads and writes. Set before the connection is added to the session,
+        // and never changed.
+        bool shareable = false;
+
+        // threads, other than exclusiveTid, which have a synchronous transaction
+        // in flight on this connection (see
+        // RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID)
+        std::vector<uint64_t> sharingTids;
+
+        // managed by RpcState, for demultiplexing commands between the threads
+        // using this connection
+        std::shared_ptr<RpcConnectionMultiplexer> multiplexer;
     };
 
     [[nodiscard]] status_t readId();
@@ -280,6 +333,14 @@ private:
     PreJoinSetupResult preJoinSetup(std::unique_ptr<RpcTransport> rpcTransport);
     // join on thread passed to preJoinThreadOwnership
     static void join(sp<RpcSession>&& session, PreJoinSetupResult&& result);
+    // Instead of join, for connections which are served by whichever thread
+    // is available (see RpcServer::setEventLoopThreads). Gives up the thread
+    // passed to preJoinThreadOwnership, and unbinds the connection from it.
+    // The connection must be given to endIncomingConnection when done.
+    void releaseJoinThread(const sp<RpcConnection>& connection);
+    // cleanup after an incoming connection is no longer served (done by join)
+    static void endIncomingConnection(sp<RpcSession>&& session,
+                                      const sp<RpcConnection>& connection);
 
     [[nodiscard]] status_t setupClient(
             const std::function<status_t(const std::vector<uint8_t>& sessionId, bool incoming)>&
@@ -302,6 +363,7 @@ private:
             std::unique_ptr<RpcTransport> rpcTransport);
     [[nodiscard]] bool removeIncomingConnection(const sp<RpcConnection>& connection);
     void clearConnectionTid(const sp<RpcConnection>& connection);
+    void clearConnectionSharingTid(const sp<RpcConnection>& connection);
 
     [[nodiscard]] status_t initShutdownTrigger();
 
@@ -338,6 +400,10 @@ private:
         // thread guarantees we won't write in the middle of a message, the way
         // the wire protocol is constructed guarantees this is safe).
         bool mReentrant = false;
+
+        // whether this connection is shared with the thread which has exclusive
+        // use of it (see RpcConnection::sharingTids)
+        bool mShared = false;
     };
 
     const std::unique_ptr<RpcTransportCtx> mCtx;
@@ -382,6 +448,9 @@ private:
 
     std::unique_ptr<RpcTransport> mBootstrapTransport;
 
+    // started by the first scheduled flush, shared with its thread
+    std::shared_ptr<DecStrongFlusher> mDecStrongFlusher;
+
     struct ThreadState {
         size_t mWaitingThreads = 0;
         // hint index into clients, ++ when sending an async transaction
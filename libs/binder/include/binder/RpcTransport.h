@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -41,10 +42,12 @@ struct RpcTransportFd;
 
 // for 'friend'
 class RpcTransportRaw;
+class RpcTransportShm;
 class RpcTransportTls;
 class RpcTransportTipcAndroid;
 class RpcTransportTipcTrusty;
 class RpcTransportCtxRaw;
+class RpcTransportCtxShm;
 class RpcTransportCtxTls;
 class RpcTransportCtxTipcAndroid;
 class RpcTransportCtxTipcTrusty;
@@ -103,6 +106,25 @@ public:
      */
     [[nodiscard]] virtual bool isWaiting() = 0;
 
+    /**
+     * Whether one thread may read from this transport while another thread
+     * writes to it. Otherwise, all calls must be made from one thread at a
+     * time.
+     */
+    [[nodiscard]] virtual bool supportsConcurrentReadAndWrite() const { return false; }
+
+    /**
+     * Called before waiting for the socket to become readable outside of this
+     * transport (e.g. in RpcServer's event loop), after pollRead returned
+     * WOULD_BLOCK.
+     *
+     * Return:
+     *   OK - Data arrived in the meantime, so the caller should read it
+     *   instead of waiting
+     *   WOULD_BLOCK - The caller may wait for the socket
+     */
+    [[nodiscard]] virtual status_t prepareToPollRead() { return WOULD_BLOCK; }
+
 private:
     // limit the classes which can implement RpcTransport. Being able to change this
     // interface is important to allow development of RPC binder. In the past, we
@@ -114,6 +136,7 @@ private:
     // to add more transports.
 
     friend class ::android::RpcTransportRaw;
+    friend class ::android::RpcTransportShm;
     friend class ::android::RpcTransportTls;
     friend class ::android::RpcTransportTipcAndroid;
     friend class ::android::RpcTransportTipcTrusty;
@@ -145,6 +168,7 @@ public:
 private:
     // see comment on RpcTransport
     friend class ::android::RpcTransportCtxRaw;
+    friend class ::android::RpcTransportCtxShm;
     friend class ::android::RpcTransportCtxTls;
     friend class ::android::RpcTransportCtxTipcAndroid;
     friend class ::android::RpcTransportCtxTipcTrusty;
@@ -173,33 +197,38 @@ protected:
 
 struct RpcTransportFd final {
 private:
-    mutable bool isPolling{false};
+    // Poll events that a thread is currently waiting for. A thread may wait to
+    // read while another thread waits to write, but only one thread may wait
+    // for each event.
+    mutable std::atomic<int16_t> pollingEvents{0};
 
-    void setPollingState(bool state) const { isPolling = state; }
+    // Returns the events that were already being polled for.
+    int16_t beginPolling(int16_t events) const { return pollingEvents.fetch_or(events); }
+    void endPolling(int16_t events) const { pollingEvents.fetch_and(~events); }
 
 public:
     binder::unique_fd fd;
 
     RpcTransportFd() = default;
     explicit RpcTransportFd(binder::unique_fd&& descriptor)
-          : isPolling(false), fd(std::move(descriptor)) {}
+          : pollingEvents(0), fd(std::move(descriptor)) {}
 
     RpcTransportFd(RpcTransportFd &&transportFd) noexcept
-          : isPolling(transportFd.isPolling), fd(std::move(transportFd.fd)) {}
+          : pollingEvents(transportFd.pollingEvents.load()), fd(std::move(transportFd.fd)) {}
 
     RpcTransportFd &operator=(RpcTransportFd &&transportFd) noexcept {
         fd = std::move(transportFd.fd);
-        isPolling = transportFd.isPolling;
+        pollingEvents = transportFd.pollingEvents.load();
         return *this;
     }
 
     RpcTransportFd& operator=(binder::unique_fd&& descriptor) noexcept {
         fd = std::move(descriptor);
-        isPolling = false;
+        pollingEvents = 0;
         return *this;
     }
 
-    bool isInPollingState() const { return isPolling; }
+    bool isInPollingState() const { return pollingEvents.load() != 0; }
     friend class FdTrigger;
 };
 
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Wraps the transport layer of RPC. Implementation moves data through shared
+// memory rings, and uses a Unix domain socket for setup, wakeups and FDs.
+// Note: don't use directly. You probably want newServerRpcTransportCtx / newClientRpcTransportCtx.
+
+#pragma once
+
+#include <memory>
+
+#include <binder/RpcTransport.h>
+
+namespace android {
+
+// RpcTransportCtxFactory for peers on the same host.
+//
+// Each connection allocates a memfd holding one single-producer/single-consumer
+// ring per direction, and sends it to the server over the connection's socket.
+// Afterwards, data is copied through the rings. A reader briefly spins waiting
+// for data before it sleeps on the socket, and the writer only writes a byte
+// to the socket when the reader is asleep. So, when both sides are busy, no
+// syscalls are needed to send or receive data.
+//
+// Both the client and the server must use this factory, and the connections
+// must be Unix domain sockets (e.g. RpcSession::setupUnixDomainClient,
+// setupUnixDomainSocketBootstrapClient or setupPreconnectedClient with a
+// socketpair). Sockets without FD passing (e.g. vsock, inet) are not supported.
+class RpcTransportCtxFactoryShm : public RpcTransportCtxFactory {
+public:
+    static constexpr size_t kDefaultRingSize = 128 * 1024;
+
+    // ringSize - size of the ring for each direction of each connection. This
+    // is only used by clients, and must be a power of two between 4KB and 16MB.
+    // Writes which are bigger than this are streamed through the ring.
+    static std::unique_ptr<RpcTransportCtxFactory> make(size_t ringSize = kDefaultRingSize);
+
+    std::unique_ptr<RpcTransportCtx> newServerCtx() const override;
+    std::unique_ptr<RpcTransportCtx> newClientCtx() const override;
+    const char* toCString() const override;
+
+private:
+    explicit RpcTransportCtxFactoryShm(size_t ringSize) : mRingSize(ringSize) {}
+
+    size_t mRingSize;
+};
+
+} // namespace android
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <binder/Parcel.h>
+#include <utils/Errors.h>
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace android {
+
+namespace binder::debug {
+
+// Latency and payload size distributions of binder transactions, keyed by
+// interface descriptor and transaction code.
+//
+// Incoming transactions are recorded in BBinder::transact, so they include
+// local calls and RPC binder. Outgoing ones are recorded in
+// BpBinder::transact. The interface is read from the interface token at the
+// start of the data parcel, so transactions not written by AIDL (or
+// IInterface) are recorded under an empty descriptor.
+//
+// Each thread records into its own counters, which are merged when read.
+// This is off by default, and costs two clock reads and a lookup in a
+// thread-local table per transaction when on.
+//
+// Dumping a service with the single argument "--binder-transaction-stats"
+// prints the stats of the process it runs in, if the caller is the shell or
+// root.
+class TransactionStats {
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // Log-linear buckets, like an HDR histogram with 2 significant bits:
+    // values below 4 get their own bucket, and every power of two above is
+    // split into 4 buckets, so a bucket is at most 25% wider than its lower
+    // bound.
+    struct Histogram {
+        static constexpr size_t kNumBuckets = 128;
+
+        static size_t bucketFor(uint64_t value);
+        static uint64_t bucketLowerBound(size_t bucket);
+
+        // Lower bound of the bucket containing the 'percentile'th value, in
+        // [0, 100].
+        uint64_t percentile(double percentile) const;
+
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::array<uint64_t, kNumBuckets> buckets = {};
+    };
+
+    enum class Direction : uint8_t {
+        INCOMING,
+        OUTGOING,
+    };
+
+    struct Entry {
+        Direction direction;
+        std::string interface;
+        uint32_t code;
+        Histogram latencyUs;
+        Histogram dataSize;
+        Histogram replySize;
+        // transactions which didn't return OK
+        uint64_t errors = 0;
+    };
+
+    // Stats of all threads, including exited ones, sorted by key.
+    static std::vector<Entry> snapshot();
+    static void reset();
+
+    static void dump(std::ostream& out);
+    static status_t dump(int fd);
+
+    // Called by BBinder and BpBinder.
+    static void record(Direction direction, const Parcel& data, uint32_t code, int64_t latencyNs,
+                       const Parcel* reply, status_t status);
+    static int64_t now();
+
+private:
+    static std::u16string_view interfaceOf(const Parcel& data, uint32_t code);
+};
+
+} // namespace binder::debug
+
+} // namespace android
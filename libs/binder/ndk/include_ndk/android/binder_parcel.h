@@ -1207,6 +1207,44 @@ binder_status_t AParcel_marshal(const AParcel* parcel, uint8_t* buffer, size_t s
 binder_status_t AParcel_unmarshal(AParcel* parcel, const uint8_t* buffer, size_t len)
         __INTRODUCED_IN(33);
 
+/**
+ * Reads an array of int8_t written by AParcel_writeByteArray without copying it. outData is set to
+ * point directly into the parcel's buffer, so it is only valid until the parcel is next modified
+ * or deleted.
+ *
+ * If a null array was written, outData is set to null and outLength to -1.
+ *
+ * Available since API level 36.
+ *
+ * \param parcel the parcel to read from.
+ * \param outData set to the start of the array inside of the parcel.
+ * \param outLength set to the number of elements in the array, or -1 if it is null.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readByteArrayInPlace(const AParcel* parcel, const int8_t** outData,
+                                             int32_t* outLength)
+        __INTRODUCED_IN(__ANDROID_API_B__);
+
+/**
+ * Reads an array of int32_t written by AParcel_writeInt32Array without copying it. outData is set
+ * to point directly into the parcel's buffer, so it is only valid until the parcel is next
+ * modified or deleted.
+ *
+ * If a null array was written, outData is set to null and outLength to -1.
+ *
+ * Available since API level 36.
+ *
+ * \param parcel the parcel to read from.
+ * \param outData set to the start of the array inside of the parcel.
+ * \param outLength set to the number of elements in the array, or -1 if it is null.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readInt32ArrayInPlace(const AParcel* parcel, const int32_t** outData,
+                                              int32_t* outLength)
+        __INTRODUCED_IN(__ANDROID_API_B__);
+
 __END_DECLS
 
 /** @} */
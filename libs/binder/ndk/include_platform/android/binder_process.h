@@ -94,4 +94,30 @@ __attribute__((weak)) binder_status_t ABinderProcess_setupPolling(int* fd) __INT
  */
 __attribute__((weak)) binder_status_t ABinderProcess_handlePolledCommands(void) __INTRODUCED_IN(31);
 
+/**
+ * Enables or disables recording of latency and payload size histograms for the binder
+ * transactions this process sends and receives, keyed by interface descriptor and transaction
+ * code. This is disabled by default.
+ *
+ * Running `dumpsys <service> --binder-transaction-stats` as the shell or root, on any service in
+ * this process, prints the recorded stats.
+ *
+ * Available since API level 36.
+ *
+ * \param enabled whether to record transactions from now on. Recorded stats are kept.
+ */
+void ABinderProcess_setTransactionStatsEnabled(bool enabled) __INTRODUCED_IN(__ANDROID_API_B__);
+
+/**
+ * Prints the stats recorded since ABinderProcess_setTransactionStatsEnabled was called in a human
+ * readable form. This is intended for use in a dump method.
+ *
+ * Available since API level 36.
+ *
+ * \param fd file descriptor to write to.
+ *
+ * \return STATUS_OK on success.
+ */
+binder_status_t ABinderProcess_dumpTransactionStats(int fd) __INTRODUCED_IN(__ANDROID_API_B__);
+
 __END_DECLS
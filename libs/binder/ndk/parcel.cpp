@@ -731,4 +731,37 @@ binder_status_t AParcel_unmarshal(AParcel* parcel, const uint8_t* buffer, size_t
     return STATUS_OK;
 }
 
+template <typename T>
+static binder_status_t ReadArrayInPlace(const AParcel* parcel, const T** outData,
+                                        int32_t* outLength) {
+    int32_t length;
+    if (status_t status = parcel->get()->readInt32(&length); status != STATUS_OK) {
+        return PruneStatusT(status);
+    }
+    if (length < -1) return STATUS_BAD_VALUE;
+
+    const void* data = nullptr;
+    if (length > 0) {
+        int32_t size = 0;
+        if (__builtin_smul_overflow(sizeof(T), length, &size)) return STATUS_BAD_VALUE;
+
+        data = parcel->get()->readInplace(size);
+        if (data == nullptr) return STATUS_BAD_VALUE;
+    }
+
+    *outData = static_cast<const T*>(data);
+    *outLength = length;
+    return STATUS_OK;
+}
+
+binder_status_t AParcel_readByteArrayInPlace(const AParcel* parcel, const int8_t** outData,
+                                             int32_t* outLength) {
+    return ReadArrayInPlace<int8_t>(parcel, outData, outLength);
+}
+
+binder_status_t AParcel_readInt32ArrayInPlace(const AParcel* parcel, const int32_t** outData,
+                                              int32_t* outLength) {
+    return ReadArrayInPlace<int32_t>(parcel, outData, outLength);
+}
+
 // @END
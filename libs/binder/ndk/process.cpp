@@ -16,11 +16,15 @@
 
 #include <android/binder_process.h>
 #include <binder/IPCThreadState.h>
+#include <binder/TransactionStats.h>
 
 #include <mutex>
 
+#include "status_internal.h"
+
 using ::android::IPCThreadState;
 using ::android::ProcessState;
+using ::android::binder::debug::TransactionStats;
 
 void ABinderProcess_startThreadPool(void) {
     ProcessState::self()->startThreadPool();
@@ -43,3 +47,11 @@ binder_status_t ABinderProcess_setupPolling(int* fd) {
 binder_status_t ABinderProcess_handlePolledCommands(void) {
     return IPCThreadState::self()->handlePolledCommands();
 }
+
+void ABinderProcess_setTransactionStatsEnabled(bool enabled) {
+    TransactionStats::setEnabled(enabled);
+}
+
+binder_status_t ABinderProcess_dumpTransactionStats(int fd) {
+    return PruneStatusT(TransactionStats::dump(fd));
+}
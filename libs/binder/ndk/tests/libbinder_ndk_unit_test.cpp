@@ -801,6 +801,49 @@ TEST(NdkBinder, ConvertToPlatformParcel) {
     EXPECT_EQ(42, pparcel->readInt32());
 }
 
+TEST(NdkBinder, ReadArraysInPlace) {
+    const int8_t bytes[] = {1, -2, 3};
+    const int32_t ints[] = {INT32_MIN, 0, INT32_MAX};
+
+    ndk::ScopedAParcel parcel = ndk::ScopedAParcel(AParcel_create());
+    EXPECT_EQ(OK, AParcel_writeByteArray(parcel.get(), bytes, 3));
+    EXPECT_EQ(OK, AParcel_writeInt32Array(parcel.get(), ints, 3));
+    EXPECT_EQ(OK, AParcel_writeInt32Array(parcel.get(), nullptr, -1));
+    EXPECT_EQ(OK, AParcel_setDataPosition(parcel.get(), 0));
+
+    const int8_t* byteData;
+    int32_t length;
+    ASSERT_EQ(STATUS_OK, AParcel_readByteArrayInPlace(parcel.get(), &byteData, &length));
+    ASSERT_EQ(3, length);
+    EXPECT_EQ(0, memcmp(bytes, byteData, sizeof(bytes)));
+
+    const int32_t* intData;
+    ASSERT_EQ(STATUS_OK, AParcel_readInt32ArrayInPlace(parcel.get(), &intData, &length));
+    ASSERT_EQ(3, length);
+    EXPECT_EQ(0, memcmp(ints, intData, sizeof(ints)));
+
+    ASSERT_EQ(STATUS_OK, AParcel_readInt32ArrayInPlace(parcel.get(), &intData, &length));
+    EXPECT_EQ(-1, length);
+    EXPECT_EQ(nullptr, intData);
+}
+
+TEST(NdkBinder, ReadArrayInPlaceTruncated) {
+    const int32_t ints[] = {1, 2, 3};
+
+    ndk::ScopedAParcel parcel = ndk::ScopedAParcel(AParcel_create());
+    EXPECT_EQ(OK, AParcel_writeInt32(parcel.get(), 4));
+    EXPECT_EQ(OK, AParcel_writeInt32(parcel.get(), ints[0]));
+    EXPECT_EQ(OK, AParcel_writeInt32(parcel.get(), ints[1]));
+    EXPECT_EQ(OK, AParcel_writeInt32(parcel.get(), ints[2]));
+    EXPECT_EQ(OK, AParcel_setDataPosition(parcel.get(), 0));
+
+    const int32_t* intData = ints;
+    int32_t length = 42;
+    EXPECT_EQ(STATUS_BAD_VALUE, AParcel_readInt32ArrayInPlace(parcel.get(), &intData, &length));
+    EXPECT_EQ(ints, intData);
+    EXPECT_EQ(42, length);
+}
+
 TEST(NdkBinder, GetAndVerifyScopedAIBinder_Weak) {
     for (const ndk::SpAIBinder& binder :
          {// remote
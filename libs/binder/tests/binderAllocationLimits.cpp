@@ -224,6 +224,56 @@ TEST(BinderAllocation, SmallTransaction) {
     EXPECT_EQ(mallocs, 1);
 }
 
+TEST(BinderAllocation, SmallTransactionRecycled) {
+    String16 empty_descriptor = String16("");
+    sp<IServiceManager> manager = defaultServiceManager();
+
+    Parcel::setBufferRecyclingEnabled(true);
+    auto disable = make_scope_guard([] { Parcel::setBufferRecyclingEnabled(false); });
+
+    // fills this thread's cache
+    manager->checkService(empty_descriptor);
+    EXPECT_GT(Parcel::getThreadCachedSize(), 0);
+
+    size_t recycled = Parcel::getGlobalRecycledAllocCount();
+    {
+        const auto m = ScopeDisallowMalloc();
+        for (size_t i = 0; i < 10; i++) {
+            manager->checkService(empty_descriptor);
+        }
+    }
+    EXPECT_LE(recycled + 10, Parcel::getGlobalRecycledAllocCount());
+}
+
+TEST(BinderAllocation, ParcelGrowthRecycled) {
+    Parcel::setBufferRecyclingEnabled(true);
+    auto disable = make_scope_guard([] { Parcel::setBufferRecyclingEnabled(false); });
+
+    auto fill = [] {
+        Parcel p;
+        for (int32_t i = 0; i < 1000; i++) {
+            EXPECT_EQ(OK, p.writeInt32(i));
+        }
+    };
+    fill();
+
+    const auto m = ScopeDisallowMalloc();
+    fill();
+}
+
+TEST(BinderAllocation, ParcelRecyclingDisabledFreesCache) {
+    Parcel::setBufferRecyclingEnabled(true);
+    {
+        Parcel p;
+        EXPECT_EQ(OK, p.writeInt32(0));
+    }
+    EXPECT_GT(Parcel::getThreadCachedSize(), 0);
+    Parcel::setBufferRecyclingEnabled(false);
+    // other threads may cache buffers too, so only this thread's cache is
+    // known to be empty
+    EXPECT_EQ(0, Parcel::getThreadCachedSize());
+}
+
 TEST(RpcBinderAllocation, SetupRpcServer) {
     std::string tmp = getenv("TMPDIR") ?: "/tmp";
     std::string addr = tmp + "/binderRpcBenchmark";
@@ -22,6 +22,8 @@
 
 #include <chrono>
 #include <fstream>
+#include <functional>
+#include <sstream>
 #include <thread>
 
 #include <gmock/gmock.h>
@@ -38,6 +40,7 @@
 #include <binder/IServiceManager.h>
 #include <binder/RpcServer.h>
 #include <binder/RpcSession.h>
+#include <binder/TransactionStats.h>
 #include <binder/unique_fd.h>
 #include <utils/Flattenable.h>
 
@@ -59,6 +62,7 @@ using android::base::testing::HasValue;
 using android::base::testing::Ok;
 using android::binder::unique_fd;
 using testing::ExplainMatchResult;
+using testing::HasSubstr;
 using testing::Matcher;
 using testing::Not;
 using testing::WithParamInterface;
@@ -85,6 +89,8 @@ static constexpr int kSchedPolicy = SCHED_RR;
 static constexpr int kSchedPriority = 7;
 static constexpr int kSchedPriorityMore = 8;
 static constexpr int kKernelThreads = 17; // anything different than the default
+static constexpr size_t kAdaptiveSpareThreads = 1;
+static constexpr std::chrono::milliseconds kAdaptiveIdleTimeout = 100ms;
 
 static String16 binderLibTestServiceName = String16("test.binderLib");
 
@@ -93,6 +99,7 @@ enum BinderLibTestTranscationCode {
     BINDER_LIB_TEST_REGISTER_SERVER,
     BINDER_LIB_TEST_ADD_SERVER,
     BINDER_LIB_TEST_ADD_POLL_SERVER,
+    BINDER_LIB_TEST_ADD_ADAPTIVE_SERVER,
     BINDER_LIB_TEST_USE_CALLING_GUARD_TRANSACTION,
     BINDER_LIB_TEST_CALL_BACK,
     BINDER_LIB_TEST_CALL_BACK_VERIFY_BUF,
@@ -125,10 +132,18 @@ enum BinderLibTestTranscationCode {
     BINDER_LIB_TEST_LOCK_UNLOCK,
     BINDER_LIB_TEST_PROCESS_LOCK,
     BINDER_LIB_TEST_UNLOCK_AFTER_MS,
-    BINDER_LIB_TEST_PROCESS_TEMPORARY_LOCK
+    BINDER_LIB_TEST_PROCESS_TEMPORARY_LOCK,
+    BINDER_LIB_TEST_GET_THREADPOOL_STATS
 };
 
-pid_t start_server_process(int arg2, bool usePoll = false)
+// How a server process serves binder commands.
+enum ServerThreadPoolMode {
+    SERVER_KERNEL_THREADPOOL,
+    SERVER_POLL,
+    SERVER_ADAPTIVE_THREADPOOL,
+};
+
+pid_t start_server_process(int arg2, ServerThreadPoolMode mode = SERVER_KERNEL_THREADPOOL)
 {
     int ret;
     pid_t pid;
@@ -136,13 +151,13 @@ pid_t start_server_process(int arg2, bool usePoll = false)
     int pipefd[2];
     char stri[16];
     char strpipefd1[16];
-    char usepoll[2];
+    char threadpoolmode[2];
     char *childargv[] = {
         binderservername,
         binderserverarg,
         stri,
         strpipefd1,
-        usepoll,
+        threadpoolmode,
         binderserversuffix,
         nullptr
     };
@@ -153,7 +168,7 @@ pid_t start_server_process(int arg2, bool usePoll = false)
 
     snprintf(stri, sizeof(stri), "%d", arg2);
     snprintf(strpipefd1, sizeof(strpipefd1), "%d", pipefd[1]);
-    snprintf(usepoll, sizeof(usepoll), "%d", usePoll ? 1 : 0);
+    snprintf(threadpoolmode, sizeof(threadpoolmode), "%d", mode);
 
     pid = fork();
     if (pid == -1)
@@ -282,6 +297,11 @@ class BinderLibTest : public ::testing::Test {
             return addServerEtc(idPtr, BINDER_LIB_TEST_ADD_POLL_SERVER);
         }
 
+        sp<IBinder> addAdaptiveServer(int32_t *idPtr = nullptr)
+        {
+            return addServerEtc(idPtr, BINDER_LIB_TEST_ADD_ADAPTIVE_SERVER);
+        }
+
         void waitForReadData(int fd, int timeout_ms) {
             int ret;
             pollfd pfd = pollfd();
@@ -1411,6 +1431,133 @@ TEST_F(BinderLibTest, ThreadPoolStarted) {
     EXPECT_TRUE(reply.readBool());
 }
 
+TEST_F(BinderLibTest, ThreadPoolStats) {
+    ProcessState::ThreadPoolStats stats = ProcessState::self()->getThreadPoolStats();
+    // startThreadPool in main
+    EXPECT_GE(stats.currentThreads, 1u);
+    EXPECT_LE(stats.executingThreads, stats.currentThreads);
+    EXPECT_EQ(0u, stats.threadsSpawned);
+    EXPECT_LE(stats.maxStarvationTimeMs, stats.starvationTimeMs);
+
+    std::ostringstream out;
+    ProcessState::self()->dumpThreadPool(out);
+    EXPECT_THAT(out.str(), HasSubstr("kernel-managed"));
+}
+
+// The part of ProcessState::ThreadPoolStats that BINDER_LIB_TEST_GET_THREADPOOL_STATS returns.
+struct ThreadPoolStats {
+    uint64_t currentThreads = 0;
+    uint64_t threadsSpawned = 0;
+    uint64_t threadsRetired = 0;
+};
+
+static status_t getThreadPoolStats(const sp<IBinder>& server, ThreadPoolStats* stats) {
+    Parcel data, reply;
+    status_t status = server->transact(BINDER_LIB_TEST_GET_THREADPOOL_STATS, data, &reply);
+    if (status == NO_ERROR) status = reply.readUint64(&stats->currentThreads);
+    if (status == NO_ERROR) status = reply.readUint64(&stats->threadsSpawned);
+    if (status == NO_ERROR) status = reply.readUint64(&stats->threadsRetired);
+    return status;
+}
+
+// Returns whether 'condition' held for the threadpool stats of 'server' before
+// 'timeout' passed.
+static bool waitForThreadPoolStats(const sp<IBinder>& server, std::chrono::milliseconds timeout,
+                                   const std::function<bool(const ThreadPoolStats&)>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        ThreadPoolStats stats;
+        if (getThreadPoolStats(server, &stats) == NO_ERROR && condition(stats)) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(20ms);
+    }
+}
+
+TEST_F(BinderLibTest, AdaptiveThreadPoolSpawnsAndRetiresThreads) {
+    Parcel data, reply;
+    sp<IBinder> server = addAdaptiveServer();
+    ASSERT_TRUE(server != nullptr);
+
+    // Keep several threads of the server busy, so that it has to start more.
+    EXPECT_THAT(server->transact(BINDER_LIB_TEST_PROCESS_LOCK, data, &reply), NO_ERROR);
+    std::vector<std::thread> ts;
+    for (size_t i = 0; i < 4; i++) {
+        ts.push_back(std::thread([&] {
+            Parcel local_reply;
+            EXPECT_THAT(server->transact(BINDER_LIB_TEST_LOCK_UNLOCK, data, &local_reply),
+                        NO_ERROR);
+        }));
+    }
+    sleep(1);
+    data.writeInt32(100);
+    EXPECT_THAT(server->transact(BINDER_LIB_TEST_UNLOCK_AFTER_MS, data, &reply), NO_ERROR);
+    for (auto &t : ts) {
+        t.join();
+    }
+
+    ThreadPoolStats stats;
+    ASSERT_THAT(getThreadPoolStats(server, &stats), StatusEq(NO_ERROR));
+    EXPECT_GT(stats.threadsSpawned, 0u);
+
+    // Once idle, the threads it started leave the pool without any further
+    // commands, and only startThreadPool's and joinThreadPool's threads are
+    // left. Each should leave about kAdaptiveIdleTimeout after the pool is
+    // idle, but a loaded device may take much longer.
+    std::this_thread::sleep_for(kAdaptiveIdleTimeout);
+    EXPECT_TRUE(waitForThreadPoolStats(server, 10s, [](const ThreadPoolStats& s) {
+        return s.threadsRetired == s.threadsSpawned;
+    }));
+    ASSERT_THAT(getThreadPoolStats(server, &stats), StatusEq(NO_ERROR));
+    EXPECT_EQ(stats.threadsSpawned, stats.threadsRetired);
+    EXPECT_EQ(2u, stats.currentThreads);
+}
+
+TEST_F(BinderLibTest, TransactionStats) {
+    using android::binder::debug::TransactionStats;
+    TransactionStats::reset();
+    TransactionStats::setEnabled(true);
+    auto disable = make_scope_guard([] { TransactionStats::setEnabled(false); });
+
+    Parcel data, reply;
+    data.writeInterfaceToken(String16("binder.lib.test.IStats"));
+    for (size_t i = 0; i < 10; i++) {
+        EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                    StatusEq(NO_ERROR));
+    }
+
+    bool found = false;
+    for (const TransactionStats::Entry& entry : TransactionStats::snapshot()) {
+        if (entry.direction != TransactionStats::Direction::OUTGOING ||
+            entry.code != BINDER_LIB_TEST_NOP_TRANSACTION) {
+            continue;
+        }
+        found = true;
+        EXPECT_EQ("binder.lib.test.IStats", entry.interface);
+        EXPECT_EQ(10u, entry.latencyUs.count);
+        EXPECT_EQ(10u, entry.dataSize.count);
+        EXPECT_EQ(data.dataSize(), entry.dataSize.max);
+        EXPECT_LE(entry.dataSize.percentile(50), data.dataSize());
+        EXPECT_EQ(0u, entry.errors);
+    }
+    EXPECT_TRUE(found);
+
+    std::ostringstream out;
+    TransactionStats::dump(out);
+    EXPECT_THAT(out.str(), HasSubstr("outgoing binder.lib.test.IStats"));
+}
+
+TEST(TransactionStatsHistogram, Buckets) {
+    using Histogram = android::binder::debug::TransactionStats::Histogram;
+    for (uint64_t value : {0ull, 1ull, 3ull, 4ull, 7ull, 8ull, 1000ull, 123456789ull}) {
+        size_t bucket = Histogram::bucketFor(value);
+        EXPECT_LE(Histogram::bucketLowerBound(bucket), value);
+        EXPECT_GT(Histogram::bucketLowerBound(bucket + 1), value);
+        // 2 significant bits
+        EXPECT_LE(value - Histogram::bucketLowerBound(bucket), value / 4);
+    }
+    EXPECT_EQ(Histogram::kNumBuckets - 1, Histogram::bucketFor(UINT64_MAX));
+}
+
 size_t epochMillis() {
     using std::chrono::duration_cast;
     using std::chrono::milliseconds;
@@ -1633,10 +1780,15 @@ public:
                 } else {
                     serverid = m_nextServerId++;
                     m_serverStartRequested = true;
-                    bool usePoll = code == BINDER_LIB_TEST_ADD_POLL_SERVER;
+                    ServerThreadPoolMode mode = SERVER_KERNEL_THREADPOOL;
+                    if (code == BINDER_LIB_TEST_ADD_POLL_SERVER) {
+                        mode = SERVER_POLL;
+                    } else if (code == BINDER_LIB_TEST_ADD_ADAPTIVE_SERVER) {
+                        mode = SERVER_ADAPTIVE_THREADPOOL;
+                    }
 
                     pthread_mutex_unlock(&m_serverWaitMutex);
-                    ret = start_server_process(serverid, usePoll);
+                    ret = start_server_process(serverid, mode);
                     pthread_mutex_lock(&m_serverWaitMutex);
                 }
                 if (ret > 0) {
@@ -1933,6 +2085,13 @@ public:
                 t.detach();
                 return NO_ERROR;
             }
+            case BINDER_LIB_TEST_GET_THREADPOOL_STATS: {
+                ProcessState::ThreadPoolStats stats = ProcessState::self()->getThreadPoolStats();
+                reply->writeUint64(stats.currentThreads);
+                reply->writeUint64(stats.threadsSpawned);
+                reply->writeUint64(stats.threadsRetired);
+                return NO_ERROR;
+            }
             default:
                 return UNKNOWN_TRANSACTION;
         };
@@ -1957,7 +2116,7 @@ private:
     std::mutex m_blockMutex;
 };
 
-int run_server(int index, int readypipefd, bool usePoll)
+int run_server(int index, int readypipefd, ServerThreadPoolMode mode)
 {
     binderLibTestServiceName += String16(binderserversuffix);
 
@@ -2015,7 +2174,7 @@ int run_server(int index, int readypipefd, bool usePoll)
     if (ret)
         return 1;
     //printf("%s: joinThreadPool\n", __func__);
-    if (usePoll) {
+    if (mode == SERVER_POLL) {
         int fd;
         struct epoll_event ev;
         int epoll_fd;
@@ -2059,6 +2218,10 @@ int run_server(int index, int readypipefd, bool usePoll)
              }
         }
     } else {
+        if (mode == SERVER_ADAPTIVE_THREADPOOL) {
+            ProcessState::self()->setThreadPoolAdaptive(kAdaptiveSpareThreads,
+                                                        kAdaptiveIdleTimeout);
+        }
         ProcessState::self()->setThreadPoolMaxThreadCount(kKernelThreads);
         ProcessState::self()->startThreadPool();
         IPCThreadState::self()->joinThreadPool();
@@ -2076,7 +2239,8 @@ int main(int argc, char** argv) {
 
     if (argc == 6 && !strcmp(argv[1], binderserverarg)) {
         binderserversuffix = argv[5];
-        return run_server(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]) == 1);
+        return run_server(atoi(argv[2]), atoi(argv[3]),
+                          static_cast<ServerThreadPoolMode>(atoi(argv[4])));
     }
     binderserversuffix = new char[16];
     snprintf(binderserversuffix, 16, "%d", getpid());
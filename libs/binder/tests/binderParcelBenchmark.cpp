@@ -36,6 +36,10 @@ void writeVector(android::Parcel &p, const V<T, Args...> &v) {
         p.writeInt32Vector(v);
     } else if constexpr (std::is_same_v<T, int64_t>) {
         p.writeInt64Vector(v);
+    } else if constexpr (std::is_same_v<T, float>) {
+        p.writeFloatVector(v);
+    } else if constexpr (std::is_same_v<T, double>) {
+        p.writeDoubleVector(v);
     } else {
         static_assert(dependent_false_v<V<T>>);
     }
@@ -53,6 +57,10 @@ void readVector(android::Parcel &p, V<T, Args...> *v) {
         p.readInt32Vector(v);
     } else if constexpr (std::is_same_v<T, int64_t>) {
         p.readInt64Vector(v);
+    } else if constexpr (std::is_same_v<T, float>) {
+        p.readFloatVector(v);
+    } else if constexpr (std::is_same_v<T, double>) {
+        p.readDoubleVector(v);
     } else {
         static_assert(dependent_false_v<V<T>>);
     }
@@ -65,6 +73,13 @@ static void VectorArgs(benchmark::internal::Benchmark* b) {
     }
 }
 
+// Bulk sizes, { 1 << 10, 1 << 12, ..., 1 << 20 }
+static void LargeVectorArgs(benchmark::internal::Benchmark* b) {
+    for (int i = 10; i <= 20; i += 2) {
+        b->Args({1 << i});
+    }
+}
+
 template <typename T>
 static void BM_ParcelVector(benchmark::State& state) {
     const size_t elements = state.range(0);
@@ -163,10 +178,28 @@ static void BM_Int64Vector(benchmark::State& state) {
     BM_ParcelVector<int64_t>(state);
 }
 
+static void BM_FloatVector(benchmark::State& state) {
+    BM_ParcelVector<float>(state);
+}
+
+static void BM_DoubleVector(benchmark::State& state) {
+    BM_ParcelVector<double>(state);
+}
+
 BENCHMARK(BM_BoolVector)->Apply(VectorArgs);
 BENCHMARK(BM_ByteVector)->Apply(VectorArgs);
 BENCHMARK(BM_CharVector)->Apply(VectorArgs);
 BENCHMARK(BM_Int32Vector)->Apply(VectorArgs);
 BENCHMARK(BM_Int64Vector)->Apply(VectorArgs);
+BENCHMARK(BM_FloatVector)->Apply(VectorArgs);
+BENCHMARK(BM_DoubleVector)->Apply(VectorArgs);
+
+// Throughput of whole-array copies, where per-element costs dominate.
+BENCHMARK(BM_BoolVector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_CharVector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_Int32Vector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_Int64Vector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_FloatVector)->Apply(LargeVectorArgs);
+BENCHMARK(BM_DoubleVector)->Apply(LargeVectorArgs);
 
 BENCHMARK_MAIN();
@@ -16,15 +16,20 @@
 
 #include <binder/IPCThreadState.h>
 #include <binder/Parcel.h>
+#include <binder/RpcSession.h>
 #include <binder/Status.h>
 #include <cutils/ashmem.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <thread>
+
 using android::BBinder;
 using android::IBinder;
 using android::IPCThreadState;
 using android::OK;
 using android::Parcel;
+using android::RpcSession;
 using android::sp;
 using android::status_t;
 using android::String16;
@@ -284,6 +289,128 @@ void parcelOpSameLength(const std::function<void(Parcel*)>& a, const std::functi
     EXPECT_EQ(end, p.dataPosition());
 }
 
+TEST(Parcel, ExternalByteArrayReadsBackInProcess) {
+    auto bytes = std::make_shared<std::vector<uint8_t>>(10000);
+    for (size_t i = 0; i < bytes->size(); i++) (*bytes)[i] = i % 251;
+
+    Parcel p;
+    p.markForRpc(RpcSession::make());
+    ASSERT_EQ(OK, p.writeInt32(1));
+    ASSERT_EQ(OK, p.writeExternalByteArray(bytes->size(), bytes->data(), bytes));
+    ASSERT_EQ(OK, p.writeInt32(2));
+
+    Parcel expected;
+    expected.markForRpc(RpcSession::make());
+    ASSERT_EQ(OK, expected.writeInt32(1));
+    ASSERT_EQ(OK, expected.writeByteArray(bytes->size(), bytes->data()));
+    ASSERT_EQ(OK, expected.writeInt32(2));
+    ASSERT_EQ(expected.dataSize(), p.dataSize());
+    ASSERT_EQ(0, memcmp(expected.data(), p.data(), p.dataSize()));
+
+    p.setDataPosition(0);
+    EXPECT_EQ(1, p.readInt32());
+    std::vector<uint8_t> out;
+    ASSERT_EQ(OK, p.readByteVector(&out));
+    EXPECT_EQ(*bytes, out);
+    EXPECT_EQ(2, p.readInt32());
+}
+
+TEST(Parcel, ExternalByteArrayReadConcurrently) {
+    auto bytes = std::make_shared<std::vector<uint8_t>>(1 << 20);
+    for (size_t i = 0; i < bytes->size(); i++) (*bytes)[i] = i % 251;
+
+    Parcel p;
+    p.markForRpc(RpcSession::make());
+    ASSERT_EQ(OK, p.writeExternalByteArray(bytes->size(), bytes->data(), bytes));
+
+    // All the readers see the bytes, whichever of them copies them in.
+    const Parcel& constParcel = p;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> mismatches = 0;
+    for (size_t i = 0; i < 4; i++) {
+        threads.emplace_back([&] {
+            const uint8_t* data = constParcel.data() + sizeof(int32_t);
+            if (memcmp(bytes->data(), data, bytes->size()) != 0) mismatches++;
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(0u, mismatches);
+}
+
+TEST(Parcel, BulkVectorsMatchElementwiseLayout) {
+    std::vector<bool> bools{true, false, false, true, true};
+    std::vector<char16_t> chars{u'a', u'\0', u'\xffff', u'z'};
+    std::vector<int64_t> longs{-1, 0, 1, INT64_MAX};
+
+    Parcel p;
+    // misaligns the 8 byte elements below
+    ASSERT_EQ(OK, p.writeInt32(7));
+    ASSERT_EQ(OK, p.writeBoolVector(bools));
+    ASSERT_EQ(OK, p.writeCharVector(chars));
+    ASSERT_EQ(OK, p.writeInt64Vector(longs));
+
+    Parcel expected;
+    ASSERT_EQ(OK, expected.writeInt32(7));
+    ASSERT_EQ(OK, expected.writeInt32(bools.size()));
+    for (bool b : bools) ASSERT_EQ(OK, expected.writeBool(b));
+    ASSERT_EQ(OK, expected.writeInt32(chars.size()));
+    for (char16_t c : chars) ASSERT_EQ(OK, expected.writeChar(c));
+    ASSERT_EQ(OK, expected.writeInt32(longs.size()));
+    for (int64_t l : longs) ASSERT_EQ(OK, expected.writeInt64(l));
+    ASSERT_EQ(expected.dataSize(), p.dataSize());
+    ASSERT_EQ(0, memcmp(expected.data(), p.data(), p.dataSize()));
+
+    p.setDataPosition(0);
+    EXPECT_EQ(7, p.readInt32());
+    std::vector<bool> outBools{false, true};
+    ASSERT_EQ(OK, p.readBoolVector(&outBools));
+    EXPECT_EQ(bools, outBools);
+    std::vector<char16_t> outChars;
+    ASSERT_EQ(OK, p.readCharVector(&outChars));
+    EXPECT_EQ(chars, outChars);
+    std::vector<int64_t> outLongs;
+    ASSERT_EQ(OK, p.readInt64Vector(&outLongs));
+    EXPECT_EQ(longs, outLongs);
+}
+
+TEST(Parcel, InplaceViews) {
+    std::vector<uint8_t> bytes{1, 2, 3, 4, 5};
+    std::vector<int32_t> ints{-1, 0, INT32_MAX};
+
+    Parcel p;
+    ASSERT_EQ(OK, p.writeByteVector(bytes));
+    ASSERT_EQ(OK, p.writeInt32Vector(ints));
+    ASSERT_EQ(OK, p.writeString8(String8("asdf")));
+    ASSERT_EQ(OK, p.writeString16(String16("jkl")));
+    ASSERT_EQ(OK, p.writeByteVector(std::optional<std::vector<uint8_t>>()));
+    ASSERT_EQ(OK, p.writeInt32(100)); // array size past the end of the data
+
+    p.setDataPosition(0);
+    const uint8_t* byteData;
+    size_t byteSize;
+    ASSERT_EQ(OK, p.readByteArrayInplace(&byteData, &byteSize));
+    EXPECT_EQ(bytes, std::vector<uint8_t>(byteData, byteData + byteSize));
+    EXPECT_GE(byteData, p.data());
+    EXPECT_LT(byteData, p.data() + p.dataSize());
+
+    const int32_t* intData;
+    size_t intSize;
+    ASSERT_EQ(OK, p.readInt32ArrayInplace(&intData, &intSize));
+    EXPECT_EQ(ints, std::vector<int32_t>(intData, intData + intSize));
+
+    std::string_view str8;
+    ASSERT_EQ(OK, p.readString8Inplace(&str8));
+    EXPECT_EQ("asdf", str8);
+    std::u16string_view str16;
+    ASSERT_EQ(OK, p.readString16Inplace(&str16));
+    EXPECT_EQ(u"jkl", str16);
+
+    EXPECT_EQ(UNEXPECTED_NULL, p.readByteArrayInplace(&byteData, &byteSize));
+    EXPECT_EQ(nullptr, byteData);
+    EXPECT_EQ(BAD_VALUE, p.readInt32ArrayInplace(&intData, &intSize));
+    EXPECT_EQ(0u, intSize);
+}
+
 TEST(Parcel, InverseInterfaceToken) {
     const String16 token = String16("asdf");
     parcelOpSameLength([&] (Parcel* p) {
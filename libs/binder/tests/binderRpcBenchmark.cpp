@@ -28,6 +28,7 @@
 #include <binder/RpcTlsTestUtils.h>
 #include <binder/RpcTlsUtils.h>
 #include <binder/RpcTransportRaw.h>
+#include <binder/RpcTransportShm.h>
 #include <binder/RpcTransportTls.h>
 #include <openssl/ssl.h>
 
@@ -45,6 +46,7 @@ using android::interface_cast;
 using android::IPCThreadState;
 using android::IServiceManager;
 using android::OK;
+using android::Parcel;
 using android::ProcessState;
 using android::RpcAuthPreSigned;
 using android::RpcCertificateFormat;
@@ -54,6 +56,7 @@ using android::RpcServer;
 using android::RpcSession;
 using android::RpcTransportCtxFactory;
 using android::RpcTransportCtxFactoryRaw;
+using android::RpcTransportCtxFactoryShm;
 using android::RpcTransportCtxFactoryTls;
 using android::sp;
 using android::status_t;
@@ -118,6 +121,7 @@ enum Transport {
     KERNEL,
     RPC,
     RPC_TLS,
+    RPC_SHM,
 };
 
 static const std::initializer_list<int64_t> kTransportList = {
@@ -126,6 +130,7 @@ static const std::initializer_list<int64_t> kTransportList = {
 #endif
         Transport::RPC,
         Transport::RPC_TLS,
+        Transport::RPC_SHM,
 };
 
 std::unique_ptr<RpcTransportCtxFactory> makeFactoryTls() {
@@ -145,6 +150,8 @@ static sp<IBinder> gRpcBinder;
 // Skip certificate validation to simplify the setup process.
 static sp<RpcSession> gSessionTls = RpcSession::make(makeFactoryTls());
 static sp<IBinder> gRpcTlsBinder;
+static sp<RpcSession> gSessionShm = RpcSession::make(RpcTransportCtxFactoryShm::make());
+static sp<IBinder> gRpcShmBinder;
 #ifdef __BIONIC__
 static const String16 kKernelBinderInstance = String16(u"binderRpcBenchmark-control");
 static sp<IBinder> gKernelBinder;
@@ -161,6 +168,8 @@ static sp<IBinder> getBinderForOptions(benchmark::State& state) {
             return gRpcBinder;
         case RPC_TLS:
             return gRpcTlsBinder;
+        case RPC_SHM:
+            return gRpcShmBinder;
         default:
             LOG(FATAL) << "Unknown transport value: " << transport;
             return nullptr;
@@ -181,6 +190,9 @@ static void SetLabel(benchmark::State& state) {
         case RPC_TLS:
             state.SetLabel("rpc_tls");
             break;
+        case RPC_SHM:
+            state.SetLabel("rpc_shm");
+            break;
         default:
             LOG(FATAL) << "Unknown transport value: " << transport;
     }
@@ -250,6 +262,38 @@ BENCHMARK(BM_throughputForTransportAndBytes)
         ->ArgsProduct({kTransportList,
                        {64, 1024, 2048, 4096, 8182, 16364, 32728, 65535, 65536, 65537}});
 
+// Same as BM_throughputForTransportAndBytes, but the request bytes are sent
+// from where they are instead of being copied into the Parcel.
+void BM_throughputForTransportAndExternalBytes(benchmark::State& state) {
+    sp<IBinder> binder = getBinderForOptions(state);
+    CHECK(binder != nullptr);
+
+    auto bytes = std::make_shared<std::vector<uint8_t>>(state.range(1));
+    for (size_t i = 0; i < bytes->size(); i++) {
+        (*bytes)[i] = i % 256;
+    }
+
+    while (state.KeepRunning()) {
+        Parcel data;
+        data.markForBinder(binder);
+        CHECK_EQ(OK, data.writeInterfaceToken(IBinderRpcBenchmark::descriptor));
+        CHECK_EQ(OK, data.writeExternalByteArray(bytes->size(), bytes->data(), bytes));
+
+        Parcel reply;
+        CHECK_EQ(OK, binder->transact(BnBinderRpcBenchmark::TRANSACTION_repeatBytes, data, &reply));
+        Status ret;
+        CHECK_EQ(OK, ret.readFromParcel(reply));
+        CHECK(ret.isOk()) << ret;
+        std::vector<uint8_t> out;
+        CHECK_EQ(OK, reply.readByteVector(&out));
+    }
+
+    SetLabel(state);
+}
+BENCHMARK(BM_throughputForTransportAndExternalBytes)
+        ->ArgsProduct({kTransportList,
+                       {64, 1024, 2048, 4096, 8182, 16364, 32728, 65535, 65536, 65537}});
+
 void BM_collectProxies(benchmark::State& state) {
     sp<IBinder> binder = getBinderForOptions(state);
     sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
@@ -356,6 +400,12 @@ int main(int argc, char** argv) {
     setupClient(gSessionTls, tlsAddr.c_str());
     gRpcTlsBinder = gSessionTls->getRootObject();
 
+    std::string shmAddr = tmp + "/binderRpcShmBenchmark";
+    (void)unlink(shmAddr.c_str());
+    forkRpcServer(shmAddr.c_str(), RpcServer::make(RpcTransportCtxFactoryShm::make()));
+    setupClient(gSessionShm, shmAddr.c_str());
+    gRpcShmBinder = gSessionShm->getRootObject();
+
     ::benchmark::RunSpecifiedBenchmarks();
     return 0;
 }
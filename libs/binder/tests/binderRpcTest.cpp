@@ -503,6 +503,41 @@ TEST_P(BinderRpc, ThreadPoolLimitOutgoing) {
     testThreadPoolOverSaturated(proc.rootIface, kNumCalls, 500 /*ms*/);
 }
 
+TEST_P(BinderRpc, ConcurrentCallsShareOneOutgoingConnection) {
+    if (clientOrServerSingleThreaded()) {
+        GTEST_SKIP() << "This test requires multiple threads";
+    }
+    if (std::min(GetParam().clientVersion, GetParam().serverVersion) <
+        RPC_WIRE_PROTOCOL_VERSION_RPC_HEADER_FEATURE_TRANSACTION_ID) {
+        GTEST_SKIP() << "Connections are only shared with transaction IDs";
+    }
+
+    constexpr size_t kNumClientThreads = 10;
+    constexpr size_t kNumCalls = 20;
+
+    auto proc = createRpcTestSocketServerProcess(
+            {.numThreads = kNumClientThreads, .numOutgoingConnections = 1});
+
+    // replies and nested transactions for each thread must be routed back to
+    // that thread, even though they all arrive on the same connection
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumClientThreads; i++) {
+        threads.push_back(std::thread([&, i] {
+            for (size_t j = 0; j < kNumCalls; j++) {
+                std::string in = std::to_string(i) + "." + std::to_string(j);
+                std::string out;
+                EXPECT_OK(proc.rootIface->doubleString(in, &out));
+                EXPECT_EQ(in + in, out);
+
+                auto nester = sp<MyBinderRpcTestDefault>::make();
+                EXPECT_OK(proc.rootIface->nestMe(nester, 3));
+            }
+        }));
+    }
+
+    for (auto& t : threads) t.join();
+}
+
 TEST_P(BinderRpc, ThreadingStressTest) {
     if (clientOrServerSingleThreaded()) {
         GTEST_SKIP() << "This test requires multiple threads";
@@ -1417,6 +1452,129 @@ TEST(BinderRpc, Java) {
     ASSERT_EQ(OK, rpcBinder->pingBinder());
 }
 
+class EchoBytesBinder : public BBinder {
+public:
+    // Like FIRST_CALL_TRANSACTION, but the reply refers to the bytes with
+    // Parcel::writeExternalByteArray.
+    static constexpr uint32_t ECHO_EXTERNAL_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION + 1;
+
+private:
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        if (code != IBinder::FIRST_CALL_TRANSACTION && code != ECHO_EXTERNAL_TRANSACTION) {
+            return BBinder::onTransact(code, data, reply, flags);
+        }
+        auto bytes = std::make_shared<std::vector<uint8_t>>();
+        if (status_t status = data.readByteVector(bytes.get()); status != OK) return status;
+        if (code == ECHO_EXTERNAL_TRANSACTION) {
+            return reply->writeExternalByteArray(bytes->size(), bytes->data(), bytes);
+        }
+        return reply->writeByteVector(*bytes);
+    }
+};
+
+TEST(BinderRpc, ExternalByteArrays) {
+    if constexpr (!kEnableRpcThreads) {
+        GTEST_SKIP() << "Test skipped because threads were disabled at build time";
+    }
+
+    for (RpcSecurity rpcSecurity : {RpcSecurity::RAW, RpcSecurity::SHM}) {
+        SCOPED_TRACE(newTlsFactory(rpcSecurity)->toCString());
+
+        auto addr = allocateSocketAddress();
+        auto server = RpcServer::make(newTlsFactory(rpcSecurity));
+        server->setRootObject(sp<EchoBytesBinder>::make());
+        ASSERT_EQ(OK, server->setupUnixDomainServer(addr.c_str()));
+        std::thread serverThread([server] { server->join(); });
+
+        auto session = RpcSession::make(newTlsFactory(rpcSecurity));
+        ASSERT_EQ(OK, session->setupUnixDomainClient(addr.c_str()));
+        auto binder = session->getRootObject();
+        ASSERT_NE(nullptr, binder);
+
+        // Below 4KB, the bytes are copied in. Several arrays in one Parcel
+        // split its data more than once.
+        for (size_t size : {100, 4096, 100000}) {
+            auto bytes = std::make_shared<std::vector<uint8_t>>(size);
+            for (size_t i = 0; i < size; i++) (*bytes)[i] = i % 251;
+
+            Parcel data;
+            data.markForBinder(binder);
+            ASSERT_EQ(OK, data.writeExternalByteArray(bytes->size(), bytes->data(), bytes));
+            ASSERT_EQ(OK, data.writeInt32(42));
+            ASSERT_EQ(OK, data.writeExternalByteArray(bytes->size(), bytes->data(), bytes));
+
+            Parcel reply;
+            ASSERT_EQ(OK,
+                      binder->transact(EchoBytesBinder::ECHO_EXTERNAL_TRANSACTION, data, &reply));
+            std::vector<uint8_t> out;
+            ASSERT_EQ(OK, reply.readByteVector(&out));
+            EXPECT_EQ(*bytes, out) << size;
+        }
+
+        EXPECT_TRUE(session->shutdownAndWait(true));
+        EXPECT_TRUE(server->shutdown());
+        serverThread.join();
+    }
+}
+
+TEST(BinderRpc, EventLoopServer) {
+    if constexpr (!kEnableRpcThreads) {
+        GTEST_SKIP() << "Test skipped because threads were disabled at build time";
+    }
+
+    constexpr size_t kNumSessions = 4;
+    constexpr size_t kNumThreadsPerSession = 3;
+
+    auto addr = allocateSocketAddress();
+    auto server = RpcServer::make();
+    server->setMaxThreads(kNumThreadsPerSession);
+    // fewer threads than connections
+    server->setEventLoopThreads(2);
+    server->setRootObject(sp<EchoBytesBinder>::make());
+    ASSERT_EQ(OK, server->setupUnixDomainServer(addr.c_str()));
+    std::thread serverThread([server] { server->join(); });
+
+    std::vector<sp<RpcSession>> sessions;
+    std::vector<sp<IBinder>> binders;
+    for (size_t i = 0; i < kNumSessions; i++) {
+        auto session = RpcSession::make();
+        ASSERT_EQ(OK, session->setupUnixDomainClient(addr.c_str()));
+        auto binder = session->getRootObject();
+        ASSERT_NE(nullptr, binder);
+        EXPECT_EQ(OK, binder->pingBinder());
+        sessions.push_back(session);
+        binders.push_back(binder);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumSessions * kNumThreadsPerSession; i++) {
+        threads.emplace_back([&, i] {
+            const sp<IBinder>& binder = binders[i % kNumSessions];
+            for (size_t j = 0; j < 50; j++) {
+                std::vector<uint8_t> bytes(1 + (i * 50 + j) % 1000, static_cast<uint8_t>(i));
+                Parcel data;
+                data.markForBinder(binder);
+                ASSERT_EQ(OK, data.writeByteVector(bytes));
+                Parcel reply;
+                ASSERT_EQ(OK, binder->transact(IBinder::FIRST_CALL_TRANSACTION, data, &reply));
+                std::vector<uint8_t> out;
+                ASSERT_EQ(OK, reply.readByteVector(&out));
+                EXPECT_EQ(bytes, out);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    // one session leaves early, and the rest are cleaned up by the server
+    EXPECT_TRUE(sessions[0]->shutdownAndWait(true));
+    EXPECT_TRUE(server->shutdown());
+    serverThread.join();
+    for (size_t i = 1; i < kNumSessions; i++) {
+        EXPECT_TRUE(sessions[i]->shutdownAndWait(true));
+    }
+}
+
 class BinderRpcServerOnly : public ::testing::TestWithParam<std::tuple<RpcSecurity, uint32_t>> {
 public:
     static std::string PrintTestParam(const ::testing::TestParamInfo<ParamType>& info) {
@@ -1769,6 +1927,10 @@ public:
                             ret.emplace_back(socketType, rpcSecurity, RpcCertificateFormat::DER,
                                              serverVersion);
                         } break;
+                        case RpcSecurity::SHM: {
+                            // These tests drive the transport directly over sockets which may
+                            // not pass FDs. BinderRpc covers the shared memory transport.
+                        } break;
                     }
                 }
             }
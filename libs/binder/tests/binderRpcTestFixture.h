@@ -135,15 +135,21 @@ public:
             return false;
         }
         return clientVersion() >= 1 && serverVersion() >= 1 && rpcSecurity() != RpcSecurity::TLS &&
-                (socketType() == SocketType::PRECONNECTED || socketType() == SocketType::UNIX ||
-                 socketType() == SocketType::UNIX_BOOTSTRAP ||
-                 socketType() == SocketType::UNIX_RAW);
+                isUnixSocketType();
+    }
+
+    bool isUnixSocketType() const {
+        return socketType() == SocketType::PRECONNECTED || socketType() == SocketType::UNIX ||
+                socketType() == SocketType::UNIX_BOOTSTRAP || socketType() == SocketType::UNIX_RAW;
     }
 
     void SetUp() override {
         if (socketType() == SocketType::UNIX_BOOTSTRAP && rpcSecurity() == RpcSecurity::TLS) {
             GTEST_SKIP() << "Unix bootstrap not supported over a TLS transport";
         }
+        if (rpcSecurity() == RpcSecurity::SHM && !isUnixSocketType()) {
+            GTEST_SKIP() << "Shared memory transport needs a Unix domain socket to send the memfd";
+        }
     }
 
     BinderRpcTestProcessSession createRpcTestSocketServerProcess(const BinderRpcOptions& options) {
@@ -434,6 +434,24 @@ TEST_P(BinderRpc, ManySessions) {
     EXPECT_SESSIONS(0, proc.rootIface);
 }
 
+TEST_P(BinderRpc, ManySessionsDroppedTogether) {
+    auto proc = createRpcTestSocketServerProcess({});
+
+    // more than fit in one RPC_COMMAND_DEC_STRONG_BATCH
+    constexpr size_t kNumSessions = 300;
+
+    std::vector<sp<IBinderRpcSession>> sessions;
+    for (size_t i = 0; i < kNumSessions; i++) {
+        sp<IBinderRpcSession> session;
+        EXPECT_OK(proc.rootIface->openSession(std::to_string(i), &session));
+        sessions.push_back(session);
+    }
+    EXPECT_SESSIONS(kNumSessions, proc.rootIface);
+
+    sessions.clear();
+    EXPECT_SESSIONS(0, proc.rootIface);
+}
+
 TEST_P(BinderRpc, OnewayCallDoesNotWait) {
     constexpr size_t kReallyLongTimeMs = 100;
     constexpr size_t kSleepMs = kReallyLongTimeMs * 5;
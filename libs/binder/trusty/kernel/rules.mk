@@ -68,6 +68,7 @@ GLOBAL_COMPILEFLAGS += \
 	-DBINDER_ENABLE_LIBLOG_ASSERT \
 	-DBINDER_DISABLE_NATIVE_HANDLE \
 	-DBINDER_DISABLE_BLOB \
+	-DBINDER_DISABLE_TRANSACTION_STATS \
 	-DBINDER_NO_LIBBASE \
 	-D__ANDROID_VENDOR__ \
 	-D__ANDROID_VNDK__ \
@@ -11,7 +11,9 @@
 #include <inttypes.h>
 #include <math.h>
 #include <poll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -24,6 +26,9 @@
 #include <log/log.h>
 #include <utils/Trace.h>
 
+#include <array>
+#include <atomic>
+
 #include <com_android_input_flags.h>
 #include <input/InputTransport.h>
 #include <input/TraceTools.h>
@@ -123,6 +128,208 @@ namespace android {
 // behind processing touches.
 static const size_t SOCKET_BUFFER_SIZE = 32 * 1024;
 
+// Number of messages that each direction of a shared memory channel can hold. Like the socket
+// buffer, this is a few dozen events, and the messages that don't fit go through the socket. It
+// must be a power of two.
+static constexpr uint32_t RING_CAPACITY = 32;
+
+namespace {
+
+struct RingSlot {
+    uint32_t size;
+    InputMessage msg;
+};
+
+/**
+ * One direction of a shared memory channel. 'head' is only written by the sender and 'tail' only
+ * by the receiver, and both count up and wrap around. The receiver sets 'receiverWaiting' before it
+ * goes back to polling the socket, which tells the sender to write a wakeup to the socket.
+ *
+ * When the ring is full, the sender sends the message on the socket instead, and keeps doing so
+ * until the receiver has read all such messages, so that they stay in order with the ring. The
+ * counts of these messages are only written by the sender and the receiver respectively.
+ *
+ * The peer may be untrusted, so the indices and the messages read from here are validated.
+ */
+struct MessageRing {
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> receiverWaiting;
+    std::atomic<uint32_t> socketMessagesSent;
+    std::atomic<uint32_t> socketMessagesRead;
+    RingSlot slots[RING_CAPACITY];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+constexpr size_t SHARED_RING_SIZE = 2 * sizeof(MessageRing);
+
+} // namespace
+
+// --- InputChannel::SharedRing ---
+
+/**
+ * The mapping of the shared memory of a channel, which holds a MessageRing for each direction.
+ * Each end of the channel sends on the ring of its side, and receives on the other one.
+ */
+class InputChannel::SharedRing {
+public:
+    static std::unique_ptr<SharedRing> create() {
+        base::unique_fd fd(memfd_create("input channel ring", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+        if (!fd.ok()) {
+            ALOGE("Could not create the shared memory of an input channel: %s", strerror(errno));
+            return nullptr;
+        }
+        // Sealed, so that the peer can't shrink the memory from under us.
+        if (ftruncate(fd.get(), SHARED_RING_SIZE) != 0 ||
+            fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+            ALOGE("Could not set up the shared memory of an input channel: %s", strerror(errno));
+            return nullptr;
+        }
+        std::unique_ptr<SharedRing> ring = map(std::move(fd), /*side=*/0);
+        if (ring != nullptr) {
+            // Nothing was received yet, so both sides need the first wakeup.
+            ring->mRings[0].receiverWaiting.store(1);
+            ring->mRings[1].receiverWaiting.store(1);
+        }
+        return ring;
+    }
+
+    static std::unique_ptr<SharedRing> map(base::unique_fd fd, int32_t side) {
+        if (side != 0 && side != 1) {
+            ALOGE("Invalid side %" PRId32 " of an input channel ring", side);
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd.get(), &st) != 0 || st.st_size < static_cast<off_t>(SHARED_RING_SIZE)) {
+            ALOGE("The shared memory of an input channel is too small");
+            return nullptr;
+        }
+        const int seals = fcntl(fd.get(), F_GET_SEALS);
+        if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+            ALOGE("The shared memory of an input channel is not sealed");
+            return nullptr;
+        }
+        void* memory =
+                mmap(nullptr, SHARED_RING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+        if (memory == MAP_FAILED) {
+            ALOGE("Could not map the shared memory of an input channel: %s", strerror(errno));
+            return nullptr;
+        }
+        // using 'new' to access a non-public constructor
+        return std::unique_ptr<SharedRing>(
+                new SharedRing(std::move(fd), side, static_cast<MessageRing*>(memory)));
+    }
+
+    ~SharedRing() { munmap(mRings, SHARED_RING_SIZE); }
+
+    // Another mapping of the same side, for a duplicate of the channel.
+    std::unique_ptr<SharedRing> dup() const { return map(dupChannelFd(mFd.get()), mSide); }
+
+    // A mapping of the other side, for the other end of the channel.
+    std::unique_ptr<SharedRing> peer() const { return map(dupChannelFd(mFd.get()), 1 - mSide); }
+
+    int32_t getSide() const { return mSide; }
+    int getFd() const { return mFd.get(); }
+    base::unique_fd releaseFd() { return std::move(mFd); }
+
+    /**
+     * Copies the message into the send ring. Returns WOULD_BLOCK if the ring is full. Otherwise,
+     * 'outWakeReceiver' tells whether the receiver is waiting on the socket for the message.
+     */
+    status_t push(const InputMessage& msg, bool& outWakeReceiver) {
+        MessageRing& ring = sendRing();
+        const uint32_t tail = ring.tail.load(std::memory_order_acquire);
+        if (mSendHead - tail >= RING_CAPACITY) {
+            return WOULD_BLOCK;
+        }
+        RingSlot& slot = ring.slots[mSendHead % RING_CAPACITY];
+        msg.getSanitizedCopy(&slot.msg);
+        slot.size = msg.size();
+        // Sequentially consistent with the exchange below, and with prepareToWait, so that either
+        // the receiver sees the message or we see that it's waiting.
+        ring.head.store(++mSendHead);
+        outWakeReceiver = ring.receiverWaiting.exchange(0) != 0;
+        return OK;
+    }
+
+    /**
+     * Copies the next message out of the receive ring. Returns WOULD_BLOCK if the ring is empty, and
+     * BAD_VALUE if the peer corrupted the ring.
+     */
+    status_t pop(InputMessage* msg, size_t& outSize) {
+        MessageRing& ring = receiveRing();
+        const uint32_t head = ring.head.load(std::memory_order_acquire);
+        if (head == mReceiveTail) {
+            return WOULD_BLOCK;
+        }
+        if (head - mReceiveTail > RING_CAPACITY) {
+            return BAD_VALUE;
+        }
+        const RingSlot& slot = ring.slots[mReceiveTail % RING_CAPACITY];
+        const size_t size = slot.size;
+        if (size <= sizeof(InputMessage)) {
+            memcpy(msg, &slot.msg, size);
+        }
+        ring.tail.store(++mReceiveTail, std::memory_order_release);
+        outSize = size;
+        return size <= sizeof(InputMessage) ? OK : BAD_VALUE;
+    }
+
+    /**
+     * Whether some of the messages that were sent on the socket haven't been received yet. The
+     * next message must then be sent on the socket too.
+     */
+    bool hasSocketBacklog() const {
+        return mSocketMessagesSent !=
+                sendRing().socketMessagesRead.load(std::memory_order_acquire);
+    }
+
+    void onSentOnSocket() {
+        sendRing().socketMessagesSent.store(++mSocketMessagesSent, std::memory_order_relaxed);
+    }
+
+    void onReceivedFromSocket() {
+        receiveRing().socketMessagesRead.fetch_add(1, std::memory_order_release);
+    }
+
+    bool hasMessage() const {
+        return receiveRing().head.load(std::memory_order_acquire) != mReceiveTail;
+    }
+
+    /**
+     * Asks the sender for a wakeup with the next message. Returns false if a message arrived in the
+     * meantime, in which case it should be received instead of waiting.
+     */
+    bool prepareToWait() {
+        MessageRing& ring = receiveRing();
+        ring.receiverWaiting.store(1);
+        return ring.head.load() == mReceiveTail;
+    }
+
+private:
+    SharedRing(base::unique_fd fd, int32_t side, MessageRing* rings)
+          : mFd(std::move(fd)),
+            mSide(side),
+            mRings(rings),
+            mSendHead(sendRing().head.load(std::memory_order_relaxed)),
+            mReceiveTail(receiveRing().tail.load(std::memory_order_relaxed)),
+            mSocketMessagesSent(sendRing().socketMessagesSent.load(std::memory_order_relaxed)) {}
+
+    MessageRing& sendRing() { return mRings[mSide]; }
+    const MessageRing& sendRing() const { return mRings[mSide]; }
+    MessageRing& receiveRing() { return mRings[1 - mSide]; }
+    const MessageRing& receiveRing() const { return mRings[1 - mSide]; }
+
+    base::unique_fd mFd;
+    const int32_t mSide;
+    MessageRing* const mRings;
+    // Our own copies of the indices that only we write, so that the peer can't change them.
+    uint32_t mSendHead;
+    uint32_t mReceiveTail;
+    uint32_t mSocketMessagesSent;
+};
+
 // Nanoseconds per milliseconds.
 static const nsecs_t NANOS_PER_MS = 1000000;
 
@@ -183,6 +390,47 @@ static bool shouldResampleTool(ToolType toolType) {
     return toolType == ToolType::FINGER || toolType == ToolType::UNKNOWN;
 }
 
+namespace {
+
+/**
+ * The coordinates of the pointers of an event that get resampled, as separate arrays of X and Y,
+ * so that all of them are interpolated in one pass over plain floats, instead of reading and
+ * writing PointerCoords one pointer and one axis at a time.
+ */
+struct ResampleBatch {
+    size_t count = 0;
+    std::array<size_t, MAX_POINTERS> indices = {};
+    std::array<float, MAX_POINTERS> currentX = {};
+    std::array<float, MAX_POINTERS> currentY = {};
+    std::array<float, MAX_POINTERS> otherX = {};
+    std::array<float, MAX_POINTERS> otherY = {};
+    std::array<float, MAX_POINTERS> outX = {};
+    std::array<float, MAX_POINTERS> outY = {};
+
+    void add(size_t pointerIndex, const PointerCoords& current, const PointerCoords& other) {
+        indices[count] = pointerIndex;
+        currentX[count] = current.getX();
+        currentY[count] = current.getY();
+        otherX[count] = other.getX();
+        otherY[count] = other.getY();
+        count++;
+    }
+
+    void resample(float alpha) {
+        // Over the whole arrays, so that the loops have a constant trip count and no remainder,
+        // which leaves the compiler free to unroll them. The entries past 'count' are zero, and
+        // are never read back.
+        for (size_t i = 0; i < MAX_POINTERS; i++) {
+            outX[i] = lerp(currentX[i], otherX[i], alpha);
+        }
+        for (size_t i = 0; i < MAX_POINTERS; i++) {
+            outY[i] = lerp(currentY[i], otherY[i], alpha);
+        }
+    }
+};
+
+} // namespace
+
 // --- InputMessage ---
 
 bool InputMessage::isValid(size_t actualSize) const {
@@ -399,7 +647,8 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
 // --- InputChannel ---
 
 std::unique_ptr<InputChannel> InputChannel::create(const std::string& name,
-                                                   android::base::unique_fd fd, sp<IBinder> token) {
+                                                   android::base::unique_fd fd, sp<IBinder> token,
+                                                   std::unique_ptr<SharedRing> ring) {
     const int result = fcntl(fd, F_SETFL, O_NONBLOCK);
     if (result != 0) {
         LOG_ALWAYS_FATAL("channel '%s' ~ Could not make socket non-blocking: %s", name.c_str(),
@@ -407,16 +656,27 @@ std::unique_ptr<InputChannel> InputChannel::create(const std::string& name,
         return nullptr;
     }
     // using 'new' to access a non-public constructor
-    return std::unique_ptr<InputChannel>(new InputChannel(name, std::move(fd), token));
+    return std::unique_ptr<InputChannel>(
+            new InputChannel(name, std::move(fd), token, std::move(ring)));
 }
 
 std::unique_ptr<InputChannel> InputChannel::create(
         android::os::InputChannelCore&& parceledChannel) {
+    std::unique_ptr<SharedRing> ring;
+    if (parceledChannel.ring) {
+        ring = SharedRing::map(parceledChannel.ring->release(), parceledChannel.ringSide);
+        if (ring == nullptr) {
+            ALOGE("channel '%s' ~ Could not map the shared ring", parceledChannel.name.c_str());
+            return nullptr;
+        }
+    }
     return InputChannel::create(parceledChannel.name, parceledChannel.fd.release(),
-                                parceledChannel.token);
+                                parceledChannel.token, std::move(ring));
 }
 
-InputChannel::InputChannel(const std::string name, android::base::unique_fd fd, sp<IBinder> token) {
+InputChannel::InputChannel(const std::string name, android::base::unique_fd fd, sp<IBinder> token,
+                           std::unique_ptr<SharedRing> ring)
+      : mRing(std::move(ring)) {
     this->name = std::move(name);
     this->fd.reset(std::move(fd));
     this->token = std::move(token);
@@ -432,6 +692,26 @@ InputChannel::~InputChannel() {
 status_t InputChannel::openInputChannelPair(const std::string& name,
                                             std::unique_ptr<InputChannel>& outServerChannel,
                                             std::unique_ptr<InputChannel>& outClientChannel) {
+    return openInputChannelPair(name, outServerChannel, outClientChannel, /*useSharedRing=*/false);
+}
+
+status_t InputChannel::openInputChannelPair(const std::string& name,
+                                            std::unique_ptr<InputChannel>& outServerChannel,
+                                            std::unique_ptr<InputChannel>& outClientChannel,
+                                            bool useSharedRing) {
+    std::unique_ptr<SharedRing> serverRing;
+    std::unique_ptr<SharedRing> clientRing;
+    if (useSharedRing) {
+        serverRing = SharedRing::create();
+        clientRing = serverRing != nullptr ? serverRing->peer() : nullptr;
+        if (clientRing == nullptr) {
+            ALOGE("channel '%s' ~ Could not create the shared ring", name.c_str());
+            outServerChannel.reset();
+            outClientChannel.reset();
+            return NO_MEMORY;
+        }
+    }
+
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) {
         status_t result = -errno;
@@ -452,11 +732,13 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
 
     std::string serverChannelName = name + " (server)";
     android::base::unique_fd serverFd(sockets[0]);
-    outServerChannel = InputChannel::create(serverChannelName, std::move(serverFd), token);
+    outServerChannel = InputChannel::create(serverChannelName, std::move(serverFd), token,
+                                            std::move(serverRing));
 
     std::string clientChannelName = name + " (client)";
     android::base::unique_fd clientFd(sockets[1]);
-    outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token);
+    outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token,
+                                            std::move(clientRing));
     return OK;
 }
 
@@ -465,6 +747,13 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
                    StringPrintf("sendMessage(inputChannel=%s, seq=0x%" PRIx32 ", type=0x%" PRIx32
                                 ")",
                                 name.c_str(), msg->header.seq, msg->header.type));
+    if (mRing != nullptr) {
+        return sendRingMessage(msg);
+    }
+    return sendSocketMessage(msg);
+}
+
+status_t InputChannel::sendSocketMessage(const InputMessage* msg) {
     const size_t msgLength = msg->size();
     InputMessage cleanMsg;
     msg->getSanitizedCopy(&cleanMsg);
@@ -499,11 +788,99 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendRingMessage(const InputMessage* msg) {
+    bool wakeReceiver = false;
+    if (mRing->hasSocketBacklog() || mRing->push(*msg, wakeReceiver) != OK) {
+        // The ring is full, or earlier messages went through the socket. Send this one after them,
+        // which also wakes the receiver. Once the socket is full as well, it stops being writable
+        // until the receiver catches up.
+        const status_t status = sendSocketMessage(msg);
+        if (status == OK) {
+            mRing->onSentOnSocket();
+        }
+        return status;
+    }
+
+    if (wakeReceiver) {
+        const uint8_t wakeup = 0;
+        ssize_t nWrite;
+        do {
+            nWrite = ::send(getFd(), &wakeup, sizeof(wakeup), MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nWrite == -1 && errno == EINTR);
+
+        // If the socket is full, the receiver already has wakeups to read.
+        if (nWrite < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            int error = errno;
+            ALOGD_IF(DEBUG_CHANNEL_MESSAGES, "channel '%s' ~ error sending wakeup, %s",
+                     name.c_str(), strerror(error));
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED ||
+                error == ECONNRESET) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+    }
+
+    ALOGD_IF(DEBUG_CHANNEL_MESSAGES, "channel '%s' ~ sent message of type %s through the ring",
+             name.c_str(), ftl::enum_string(msg->header.type).c_str());
+    return OK;
+}
+
+status_t InputChannel::receiveRingMessage(InputMessage* msg) {
+    size_t size = 0;
+    status_t status = mRing->pop(msg, size);
+    if (status == WOULD_BLOCK) {
+        // The messages that didn't fit in the ring come after it, on the socket. Otherwise, read the
+        // wakeups that led us here, then ask for one with the next message.
+        status = receiveSocketMessage(msg);
+        if (status == OK) {
+            mRing->onReceivedFromSocket();
+            return OK;
+        }
+        if (status != WOULD_BLOCK) {
+            return status;
+        }
+        if (mRing->prepareToWait()) {
+            return WOULD_BLOCK;
+        }
+        status = mRing->pop(msg, size);
+    }
+
+    if (status != OK) {
+        ALOGE("channel '%s' ~ the shared ring is corrupted", name.c_str());
+        return status;
+    }
+
+    if (!msg->isValid(size)) {
+        ALOGE("channel '%s' ~ received invalid message of size %zu", name.c_str(), size);
+        return BAD_VALUE;
+    }
+    return OK;
+}
+
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mRing != nullptr) {
+        const status_t status = receiveRingMessage(msg);
+        if (status == OK) {
+            traceReceivedMessage(*msg);
+        }
+        return status;
+    }
+
+    const status_t status = receiveSocketMessage(msg);
+    if (status == OK) {
+        traceReceivedMessage(*msg);
+    }
+    return status;
+}
+
+status_t InputChannel::receiveSocketMessage(InputMessage* msg) {
     ssize_t nRead;
     do {
         nRead = ::recv(getFd(), msg, sizeof(InputMessage), MSG_DONTWAIT);
-    } while (nRead == -1 && errno == EINTR);
+    } while ((nRead == -1 && errno == EINTR) ||
+             // The wakeups of a shared ring are a single byte, and carry no message.
+             (mRing != nullptr && nRead == 1));
 
     if (nRead < 0) {
         int error = errno;
@@ -528,20 +905,25 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
         ALOGE("channel '%s' ~ received invalid message of size %zd", name.c_str(), nRead);
         return BAD_VALUE;
     }
+    return OK;
+}
 
+void InputChannel::traceReceivedMessage(const InputMessage& msg) const {
     ALOGD_IF(DEBUG_CHANNEL_MESSAGES, "channel '%s' ~ received message of type %s", name.c_str(),
-             ftl::enum_string(msg->header.type).c_str());
+             ftl::enum_string(msg.header.type).c_str());
     if (ATRACE_ENABLED()) {
         // Add an additional trace point to include data about the received message.
         std::string message = StringPrintf("receiveMessage(inputChannel=%s, seq=0x%" PRIx32
                                            ", type=0x%" PRIx32 ")",
-                                           name.c_str(), msg->header.seq, msg->header.type);
+                                           name.c_str(), msg.header.seq, msg.header.type);
         ATRACE_NAME(message.c_str());
     }
-    return OK;
 }
 
 bool InputChannel::probablyHasInput() const {
+    if (mRing != nullptr && mRing->hasMessage()) {
+        return true;
+    }
     struct pollfd pfds = {.fd = fd.get(), .events = POLLIN};
     if (::poll(&pfds, /*nfds=*/1, /*timeout=*/0) <= 0) {
         // This can be a false negative because EINTR and ENOMEM are not handled. The latter should
@@ -561,6 +943,9 @@ void InputChannel::waitForMessage(std::chrono::milliseconds timeout) const {
     if (timeout < 0ms) {
         LOG(FATAL) << "Timeout cannot be negative, received " << timeout.count();
     }
+    if (mRing != nullptr && !mRing->prepareToWait()) {
+        return;
+    }
     struct pollfd pfds = {.fd = fd.get(), .events = POLLIN};
     int ret;
     std::chrono::time_point<std::chrono::steady_clock> stopTime =
@@ -575,13 +960,27 @@ void InputChannel::waitForMessage(std::chrono::milliseconds timeout) const {
 
 std::unique_ptr<InputChannel> InputChannel::dup() const {
     base::unique_fd newFd(dupChannelFd(fd.get()));
-    return InputChannel::create(getName(), std::move(newFd), getConnectionToken());
+    std::unique_ptr<SharedRing> newRing;
+    if (mRing != nullptr) {
+        newRing = mRing->dup();
+        if (newRing == nullptr) {
+            return nullptr;
+        }
+    }
+    return InputChannel::create(getName(), std::move(newFd), getConnectionToken(),
+                                std::move(newRing));
 }
 
 void InputChannel::copyTo(android::os::InputChannelCore& outChannel) const {
     outChannel.name = getName();
     outChannel.fd.reset(dupChannelFd(fd.get()));
     outChannel.token = getConnectionToken();
+    if (mRing != nullptr) {
+        outChannel.ring.emplace(dupChannelFd(mRing->getFd()));
+        outChannel.ringSide = mRing->getSide();
+    } else {
+        outChannel.ring.reset();
+    }
 }
 
 void InputChannel::moveChannel(std::unique_ptr<InputChannel> from,
@@ -589,6 +988,12 @@ void InputChannel::moveChannel(std::unique_ptr<InputChannel> from,
     outChannel.name = from->getName();
     outChannel.fd = android::os::ParcelFileDescriptor(std::move(from->fd));
     outChannel.token = from->getConnectionToken();
+    if (from->mRing != nullptr) {
+        outChannel.ring.emplace(from->mRing->releaseFd());
+        outChannel.ringSide = from->mRing->getSide();
+    } else {
+        outChannel.ring.reset();
+    }
 }
 
 sp<IBinder> InputChannel::getConnectionToken() const {
@@ -1281,11 +1686,13 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         return;
     }
 
-    // Resample touch coordinates.
+    // Resample touch coordinates. The pointers that are interpolated or extrapolated are gathered
+    // first, so that they are all resampled in one pass over plain arrays.
     History oldLastResample;
     oldLastResample.initializeFrom(touchState.lastResample);
     touchState.lastResample.eventTime = sampleTime;
     touchState.lastResample.idBits.clear();
+    ResampleBatch batch;
     for (size_t i = 0; i < pointerCount; i++) {
         uint32_t id = event->getPointerId(i);
         touchState.lastResample.idToIndex[id] = i;
@@ -1309,16 +1716,7 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         resampledCoords = currentCoords;
         resampledCoords.isResampled = true;
         if (other->idBits.hasBit(id) && shouldResampleTool(event->getToolType(i))) {
-            const PointerCoords& otherCoords = other->getPointerById(id);
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
-                                         lerp(currentCoords.getX(), otherCoords.getX(), alpha));
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
-                                         lerp(currentCoords.getY(), otherCoords.getY(), alpha));
-            ALOGD_IF(debugResampling(),
-                     "[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), "
-                     "other (%0.3f, %0.3f), alpha %0.3f",
-                     id, resampledCoords.getX(), resampledCoords.getY(), currentCoords.getX(),
-                     currentCoords.getY(), otherCoords.getX(), otherCoords.getY(), alpha);
+            batch.add(i, currentCoords, other->getPointerById(id));
         } else {
             ALOGD_IF(debugResampling(), "[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f)", id,
                      resampledCoords.getX(), resampledCoords.getY(), currentCoords.getX(),
@@ -1326,6 +1724,19 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         }
     }
 
+    batch.resample(alpha);
+    for (size_t j = 0; j < batch.count; j++) {
+        const size_t i = batch.indices[j];
+        PointerCoords& resampledCoords = touchState.lastResample.pointers[i];
+        resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X, batch.outX[j]);
+        resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, batch.outY[j]);
+        ALOGD_IF(debugResampling(),
+                 "[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), other (%0.3f, %0.3f), "
+                 "alpha %0.3f",
+                 event->getPointerId(i), batch.outX[j], batch.outY[j], batch.currentX[j],
+                 batch.currentY[j], batch.otherX[j], batch.otherY[j], alpha);
+    }
+
     event->addSample(sampleTime, touchState.lastResample.pointers);
 }
 
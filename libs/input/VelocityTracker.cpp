@@ -89,21 +89,25 @@ static std::string toString(std::chrono::nanoseconds t) {
     return stream.str();
 }
 
-static float vectorDot(const float* a, const float* b, uint32_t m) {
-    float r = 0;
-    for (size_t i = 0; i < m; i++) {
-        r += *(a++) * *(b++);
-    }
-    return r;
-}
-
-static float vectorNorm(const float* a, uint32_t m) {
-    float r = 0;
-    for (size_t i = 0; i < m; i++) {
-        float t = *(a++);
-        r += t * t;
+// The most data points that solveLeastSquares fits. Its columns always have this many entries,
+// and the entries past the data points are zero, so that its loops have a constant trip count and
+// are vectorized. Must be a multiple of LSQ_LANES.
+static constexpr size_t LSQ_MAX_POINTS = 20;
+static constexpr size_t LSQ_LANES = 4;
+static_assert(LSQ_MAX_POINTS % LSQ_LANES == 0);
+
+using LsqColumn = std::array<float, LSQ_MAX_POINTS>;
+
+// Sums in separate lanes, which lets the loop be vectorized without relaxing the floating point
+// semantics. The rounding differs slightly from summing in order.
+static float columnDot(const LsqColumn& a, const LsqColumn& b) {
+    std::array<float, LSQ_LANES> sums = {};
+    for (size_t h = 0; h < LSQ_MAX_POINTS; h += LSQ_LANES) {
+        for (size_t lane = 0; lane < LSQ_LANES; lane++) {
+            sums[lane] += a[h + lane] * b[h + lane];
+        }
     }
-    return sqrtf(r);
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
 }
 
 static std::string vectorToString(const float* a, uint32_t m) {
@@ -119,10 +123,6 @@ static std::string vectorToString(const float* a, uint32_t m) {
     return str;
 }
 
-static std::string vectorToString(const std::vector<float>& v) {
-    return vectorToString(v.data(), v.size());
-}
-
 static std::string matrixToString(const float* a, uint32_t m, uint32_t n, bool rowMajor) {
     std::string str;
     str = "[";
@@ -479,43 +479,42 @@ LeastSquaresVelocityTrackerStrategy::~LeastSquaresVelocityTrackerStrategy() {}
  * http://en.wikipedia.org/wiki/Numerical_methods_for_linear_least_squares
  * http://en.wikipedia.org/wiki/Gram-Schmidt
  */
-static std::optional<float> solveLeastSquares(const std::vector<float>& x,
-                                              const std::vector<float>& y,
-                                              const std::vector<float>& w, uint32_t n) {
-    const size_t m = x.size();
-
+static std::optional<float> solveLeastSquares(const LsqColumn& x, const LsqColumn& y,
+                                              const LsqColumn& w, size_t m, uint32_t n) {
     ALOGD_IF(DEBUG_STRATEGY, "solveLeastSquares: m=%d, n=%d, x=%s, y=%s, w=%s", int(m), int(n),
-             vectorToString(x).c_str(), vectorToString(y).c_str(), vectorToString(w).c_str());
+             vectorToString(x.data(), m).c_str(), vectorToString(y.data(), m).c_str(),
+             vectorToString(w.data(), m).c_str());
 
-    LOG_ALWAYS_FATAL_IF(m != y.size() || m != w.size(), "Mismatched vector sizes");
+    LOG_ALWAYS_FATAL_IF(m > LSQ_MAX_POINTS, "Too many data points: %zu", m);
+
+    constexpr size_t N = VelocityTracker::MAX_DEGREE + 1;
 
     // Expand the X vector to a matrix A, pre-multiplied by the weights.
-    float a[n][m]; // column-major order
-    for (uint32_t h = 0; h < m; h++) {
-        a[0][h] = w[h];
-        for (uint32_t i = 1; i < n; i++) {
+    // The weights past m are zero, and so are the rest of the columns.
+    std::array<LsqColumn, N> a; // column-major order
+    a[0] = w;
+    for (uint32_t i = 1; i < n; i++) {
+        for (size_t h = 0; h < LSQ_MAX_POINTS; h++) {
             a[i][h] = a[i - 1][h] * x[h];
         }
     }
 
     ALOGD_IF(DEBUG_STRATEGY, "  - a=%s",
-             matrixToString(&a[0][0], m, n, /*rowMajor=*/false).c_str());
+             matrixToString(&a[0][0], LSQ_MAX_POINTS, n, /*rowMajor=*/false).c_str());
 
     // Apply the Gram-Schmidt process to A to obtain its QR decomposition.
-    float q[n][m]; // orthonormal basis, column-major order
-    float r[n][n]; // upper triangular matrix, row-major order
+    std::array<LsqColumn, N> q;          // orthonormal basis, column-major order
+    std::array<std::array<float, N>, N> r = {}; // upper triangular matrix, row-major order
     for (uint32_t j = 0; j < n; j++) {
-        for (uint32_t h = 0; h < m; h++) {
-            q[j][h] = a[j][h];
-        }
+        q[j] = a[j];
         for (uint32_t i = 0; i < j; i++) {
-            float dot = vectorDot(&q[j][0], &q[i][0], m);
-            for (uint32_t h = 0; h < m; h++) {
+            const float dot = columnDot(q[j], q[i]);
+            for (size_t h = 0; h < LSQ_MAX_POINTS; h++) {
                 q[j][h] -= dot * q[i][h];
             }
         }
 
-        float norm = vectorNorm(&q[j][0], m);
+        float norm = sqrtf(columnDot(q[j], q[j]));
         if (norm < 0.000001f) {
             // vectors are linearly dependent or zero so no solution
             ALOGD_IF(DEBUG_STRATEGY, "  - no solution, norm=%f", norm);
@@ -523,40 +522,39 @@ static std::optional<float> solveLeastSquares(const std::vector<float>& x,
         }
 
         float invNorm = 1.0f / norm;
-        for (uint32_t h = 0; h < m; h++) {
+        for (size_t h = 0; h < LSQ_MAX_POINTS; h++) {
             q[j][h] *= invNorm;
         }
-        for (uint32_t i = 0; i < n; i++) {
-            r[j][i] = i < j ? 0 : vectorDot(&q[j][0], &a[i][0], m);
+        for (uint32_t i = j; i < n; i++) {
+            r[j][i] = columnDot(q[j], a[i]);
         }
     }
     if (DEBUG_STRATEGY) {
-        ALOGD("  - q=%s", matrixToString(&q[0][0], m, n, /*rowMajor=*/false).c_str());
-        ALOGD("  - r=%s", matrixToString(&r[0][0], n, n, /*rowMajor=*/true).c_str());
+        ALOGD("  - q=%s", matrixToString(&q[0][0], LSQ_MAX_POINTS, n, /*rowMajor=*/false).c_str());
+        ALOGD("  - r=%s", matrixToString(&r[0][0], N, N, /*rowMajor=*/true).c_str());
 
         // calculate QR, if we factored A correctly then QR should equal A
-        float qr[n][m];
-        for (uint32_t h = 0; h < m; h++) {
+        std::array<LsqColumn, N> qr = {};
+        for (size_t h = 0; h < LSQ_MAX_POINTS; h++) {
             for (uint32_t i = 0; i < n; i++) {
-                qr[i][h] = 0;
                 for (uint32_t j = 0; j < n; j++) {
                     qr[i][h] += q[j][h] * r[j][i];
                 }
             }
         }
-        ALOGD("  - qr=%s", matrixToString(&qr[0][0], m, n, /*rowMajor=*/false).c_str());
+        ALOGD("  - qr=%s", matrixToString(&qr[0][0], LSQ_MAX_POINTS, n, /*rowMajor=*/false).c_str());
     }
 
     // Solve R B = Qt W Y to find B.  This is easy because R is upper triangular.
     // We just work from bottom-right to top-left calculating B's coefficients.
-    float wy[m];
-    for (uint32_t h = 0; h < m; h++) {
+    LsqColumn wy;
+    for (size_t h = 0; h < LSQ_MAX_POINTS; h++) {
         wy[h] = y[h] * w[h];
     }
-    std::array<float, VelocityTracker::MAX_DEGREE + 1> outB;
+    std::array<float, N> outB;
     for (uint32_t i = n; i != 0; ) {
         i--;
-        outB[i] = vectorDot(&q[i][0], wy, m);
+        outB[i] = columnDot(q[i], wy);
         for (uint32_t j = n - 1; j > i; j--) {
             outB[i] -= r[i][j] * outB[j];
         }
@@ -672,25 +670,28 @@ std::optional<float> LeastSquaresVelocityTrackerStrategy::getVelocity(int32_t po
     }
 
     // Iterate over movement samples in reverse time order and collect samples.
-    std::vector<float> positions;
-    std::vector<float> w;
-    std::vector<float> time;
+    // The entries past the samples stay zero.
+    static_assert(HISTORY_SIZE <= LSQ_MAX_POINTS);
+    LsqColumn positions = {};
+    LsqColumn w = {};
+    LsqColumn time = {};
 
     const Movement& newestMovement = movements[size - 1];
-    for (ssize_t i = size - 1; i >= 0; i--) {
-        const Movement& movement = movements[i];
+    for (size_t i = 0; i < size; i++) {
+        const size_t index = size - 1 - i;
+        const Movement& movement = movements[index];
         nsecs_t age = newestMovement.eventTime - movement.eventTime;
-        positions.push_back(movement.position);
-        w.push_back(chooseWeight(pointerId, i));
-        time.push_back(-age * 0.000000001f);
+        positions[i] = movement.position;
+        w[i] = chooseWeight(movements, index);
+        time[i] = -age * 0.000000001f;
     }
 
     // General case for an Nth degree polynomial fit
-    return solveLeastSquares(time, positions, w, degree + 1);
+    return solveLeastSquares(time, positions, w, size, degree + 1);
 }
 
-float LeastSquaresVelocityTrackerStrategy::chooseWeight(int32_t pointerId, uint32_t index) const {
-    const RingBuffer<Movement>& movements = mMovements.at(pointerId);
+float LeastSquaresVelocityTrackerStrategy::chooseWeight(const RingBuffer<Movement>& movements,
+                                                        uint32_t index) const {
     const size_t size = movements.size();
     switch (mWeighting) {
         case Weighting::DELTA: {
@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
 
 #include <binder/Binder.h>
 #include <binder/Parcel.h>
@@ -45,6 +46,24 @@ bool operator==(const InputChannel& left, const InputChannel& right) {
     return left.getName() == right.getName() &&
             left.getConnectionToken() == right.getConnectionToken() && lhs.st_ino == rhs.st_ino;
 }
+
+bool isReadable(const InputChannel& channel) {
+    struct pollfd pfd = {.fd = channel.getFd(), .events = POLLIN};
+    return ::poll(&pfd, /*nfds=*/1, /*timeout=*/0) == 1 && (pfd.revents & POLLIN) != 0;
+}
+
+bool isWritable(const InputChannel& channel) {
+    struct pollfd pfd = {.fd = channel.getFd(), .events = POLLOUT};
+    return ::poll(&pfd, /*nfds=*/1, /*timeout=*/0) == 1 && (pfd.revents & POLLOUT) != 0;
+}
+
+InputMessage createKeyMessage(uint32_t seq) {
+    InputMessage msg = {};
+    msg.header.type = InputMessage::Type::KEY;
+    msg.header.seq = seq;
+    msg.body.key.action = AKEY_EVENT_ACTION_DOWN;
+    return msg;
+}
 } // namespace
 
 class InputChannelTest : public testing::Test {
@@ -241,4 +260,146 @@ TEST_F(InputChannelTest, DuplicateChannelAndAssertEqual) {
     EXPECT_EQ(*serverChannel == *dupChan, true) << "inputchannel should be equal after duplication";
 }
 
+TEST_F(InputChannelTest, SharedRing_SendAndReceive) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedRing=*/true));
+    ASSERT_TRUE(serverChannel->usesSharedRing());
+    ASSERT_TRUE(clientChannel->usesSharedRing());
+
+    InputMessage serverMsg = createKeyMessage(/*seq=*/1);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    // The client was waiting, so it got woken up.
+    ASSERT_TRUE(isReadable(*clientChannel));
+    ASSERT_TRUE(clientChannel->probablyHasInput());
+
+    InputMessage clientMsg;
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(InputMessage::Type::KEY, clientMsg.header.type);
+    EXPECT_EQ(1u, clientMsg.header.seq);
+    EXPECT_EQ(AKEY_EVENT_ACTION_DOWN, clientMsg.body.key.action);
+    ASSERT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+    ASSERT_FALSE(isReadable(*clientChannel));
+
+    InputMessage clientReply = {};
+    clientReply.header.type = InputMessage::Type::FINISHED;
+    clientReply.header.seq = 1;
+    clientReply.body.finished.handled = true;
+    ASSERT_EQ(OK, clientChannel->sendMessage(&clientReply));
+
+    InputMessage serverReply;
+    ASSERT_EQ(OK, serverChannel->receiveMessage(&serverReply));
+    EXPECT_EQ(InputMessage::Type::FINISHED, serverReply.header.type);
+    EXPECT_EQ(1u, serverReply.header.seq);
+    EXPECT_TRUE(serverReply.body.finished.handled);
+}
+
+TEST_F(InputChannelTest, SharedRing_OnlyWakesWaitingReceiver) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedRing=*/true));
+
+    InputMessage msg = createKeyMessage(/*seq=*/1);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+
+    // The client hasn't run out of messages yet, so these don't need a wakeup.
+    for (uint32_t seq = 2; seq <= 4; seq++) {
+        msg = createKeyMessage(seq);
+        ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    }
+    for (uint32_t seq = 2; seq <= 4; seq++) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+        ASSERT_EQ(seq, msg.header.seq);
+    }
+
+    ASSERT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+    ASSERT_FALSE(isReadable(*clientChannel));
+
+    // Now it's waiting again.
+    msg = createKeyMessage(/*seq=*/5);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    ASSERT_TRUE(isReadable(*clientChannel));
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+    ASSERT_EQ(5u, msg.header.seq);
+}
+
+TEST_F(InputChannelTest, SharedRing_WhenFull_SendsOnTheSocket) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedRing=*/true));
+
+    // Fill the ring, and then the socket.
+    InputMessage msg = createKeyMessage(/*seq=*/1);
+    status_t status;
+    uint32_t sent = 0;
+    while ((status = serverChannel->sendMessage(&msg)) == OK) {
+        sent++;
+        msg.header.seq = sent + 1;
+        ASSERT_LT(sent, 10000u) << "the channel should fill up eventually";
+    }
+    ASSERT_EQ(WOULD_BLOCK, status);
+    // A sender that waits for room to send more messages doesn't spin.
+    ASSERT_FALSE(isWritable(*serverChannel));
+
+    // Receiving from the ring alone doesn't let newer messages overtake the ones on the socket.
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+    ASSERT_EQ(1u, msg.header.seq);
+    msg = createKeyMessage(sent + 1);
+    ASSERT_EQ(WOULD_BLOCK, serverChannel->sendMessage(&msg));
+
+    for (uint32_t seq = 2; seq <= sent; seq++) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+        ASSERT_EQ(seq, msg.header.seq);
+    }
+    ASSERT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+    ASSERT_TRUE(isWritable(*serverChannel));
+
+    // With everything received, the messages go through the ring again.
+    msg = createKeyMessage(sent + 1);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+    ASSERT_EQ(sent + 1, msg.header.seq);
+    ASSERT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SharedRing_WhenPeerClosed_ReturnsDeadObject) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedRing=*/true));
+
+    // Messages sent before the peer went away can still be received.
+    InputMessage msg = createKeyMessage(/*seq=*/1);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    serverChannel.reset();
+
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&msg));
+    ASSERT_EQ(1u, msg.header.seq);
+    ASSERT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&msg));
+    ASSERT_EQ(DEAD_OBJECT, clientChannel->sendMessage(&msg));
+}
+
+TEST_F(InputChannelTest, SharedRing_CopyToKeepsTheRing) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 /*useSharedRing=*/true));
+
+    android::os::InputChannelCore parceledChannel;
+    clientChannel->copyTo(parceledChannel);
+    ASSERT_TRUE(parceledChannel.ring.has_value());
+    std::unique_ptr<InputChannel> copy = InputChannel::create(std::move(parceledChannel));
+    ASSERT_NE(nullptr, copy);
+    ASSERT_TRUE(copy->usesSharedRing());
+
+    InputMessage msg = createKeyMessage(/*seq=*/7);
+    ASSERT_EQ(OK, serverChannel->sendMessage(&msg));
+    ASSERT_EQ(OK, copy->receiveMessage(&msg));
+    ASSERT_EQ(7u, msg.header.seq);
+}
+
 } // namespace android
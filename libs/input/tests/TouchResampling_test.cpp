@@ -621,4 +621,66 @@ TEST_F(TouchResamplingTest, TwoPointersAreResampledIndependently) {
     consumeInputEventEntries(expectedEntries, frameTime);
 }
 
+/**
+ * With several pointers down, the fingers are resampled together, each with its own coordinates,
+ * while a stylus among them keeps its last coordinates.
+ */
+TEST_F(TouchResamplingTest, OnlyFingersAreResampledAmongSeveralPointers) {
+    std::chrono::nanoseconds frameTime;
+    std::vector<InputEventEntry> entries, expectedEntries;
+
+    constexpr int32_t actionPointer1Down =
+            AMOTION_EVENT_ACTION_POINTER_DOWN + (1 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+    constexpr int32_t actionPointer2Down =
+            AMOTION_EVENT_ACTION_POINTER_DOWN + (2 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+
+    entries = {
+            //      id  x    y
+            {0ms, {{0, 100, 100}}, AMOTION_EVENT_ACTION_DOWN},
+    };
+    publishInputEventEntries(entries);
+    consumeInputEventEntries(entries, /*frameTime=*/5ms);
+
+    entries = {
+            //      id  x    y
+            {5ms,
+             {{0, 100, 100}, {1, 200, 200, .toolType = ToolType::STYLUS}},
+             actionPointer1Down},
+    };
+    publishInputEventEntries(entries);
+    consumeInputEventEntries(entries, /*frameTime=*/10ms);
+
+    entries = {
+            //      id  x    y
+            {10ms,
+             {{0, 100, 100}, {1, 200, 200, .toolType = ToolType::STYLUS}, {2, 300, 300}},
+             actionPointer2Down},
+    };
+    publishInputEventEntries(entries);
+    consumeInputEventEntries(entries, /*frameTime=*/15ms);
+
+    entries = {
+            //      id  x    y
+            {20ms,
+             {{0, 100, 100}, {1, 200, 200, .toolType = ToolType::STYLUS}, {2, 300, 300}},
+             AMOTION_EVENT_ACTION_MOVE},
+            {30ms,
+             {{0, 110, 120}, {1, 210, 220, .toolType = ToolType::STYLUS}, {2, 320, 340}},
+             AMOTION_EVENT_ACTION_MOVE},
+    };
+    publishInputEventEntries(entries);
+    frameTime = 35ms + 5ms /*RESAMPLE_LATENCY*/;
+    expectedEntries = {
+            //      id  x    y
+            {20ms, {{0, 100, 100}, {1, 200, 200}, {2, 300, 300}}, AMOTION_EVENT_ACTION_MOVE},
+            {30ms, {{0, 110, 120}, {1, 210, 220}, {2, 320, 340}}, AMOTION_EVENT_ACTION_MOVE},
+            {35ms,
+             {{0, 115, 130, .isResampled = true},
+              {1, 210, 220, .isResampled = true},
+              {2, 330, 360, .isResampled = true}},
+             AMOTION_EVENT_ACTION_MOVE},
+    };
+    consumeInputEventEntries(expectedEntries, frameTime);
+}
+
 } // namespace android
@@ -20,9 +20,11 @@
 #include <array>
 #include <chrono>
 #include <limits>
+#include <random>
 
 #include <android-base/stringprintf.h>
 #include <attestation/HmacKeyManager.h>
+#include <ftl/enum.h>
 #include <gtest/gtest.h>
 #include <gui/constants.h>
 #include <input/VelocityTracker.h>
@@ -493,6 +495,209 @@ TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
     computeAndCheckVelocity(VelocityTracker::Strategy::LSQ2, motions, AMOTION_EVENT_AXIS_X, 500);
 }
 
+/**
+ * Polynomial motion that a least squares strategy of at least the same degree fits exactly, so the
+ * velocity has to match the derivative closely, whatever the weights.
+ */
+static std::vector<PlanarMotionEventEntry> createPolynomialMotion(uint32_t degree) {
+    std::vector<PlanarMotionEventEntry> motions;
+    for (int i = 0; i < 12; i++) {
+        const std::chrono::nanoseconds eventTime = i * 8ms;
+        const double t = std::chrono::duration<double>(eventTime).count();
+        double position = 100 + 2000 * t;
+        if (degree >= 2) {
+            position -= 3000 * t * t;
+        }
+        if (degree >= 3) {
+            position += 8000 * t * t * t;
+        }
+        motions.push_back({eventTime, {{static_cast<float>(position), 0}}});
+    }
+    motions.push_back(motions.back()); // ACTION_UP
+    return motions;
+}
+
+TEST_F(VelocityTrackerTest, LeastSquaresStrategiesFitPolynomialMotion) {
+    // Derivatives at the last sample, t = 88ms.
+    constexpr float linearVelocity = 2000;
+    constexpr float quadraticVelocity = 2000 - 6000 * 0.088;
+    constexpr float cubicVelocity = 2000 - 6000 * 0.088 + 24000 * 0.088 * 0.088;
+    constexpr float tolerance = 0.001;
+
+    const std::vector<PlanarMotionEventEntry> linear = createPolynomialMotion(1);
+    for (VelocityTracker::Strategy strategy :
+         {VelocityTracker::Strategy::LSQ1, VelocityTracker::Strategy::LSQ2,
+          VelocityTracker::Strategy::LSQ3, VelocityTracker::Strategy::WLSQ2_DELTA,
+          VelocityTracker::Strategy::WLSQ2_CENTRAL, VelocityTracker::Strategy::WLSQ2_RECENT}) {
+        SCOPED_TRACE(ftl::enum_string(strategy));
+        std::optional<float> velocity =
+                computePlanarVelocity(strategy, linear, AMOTION_EVENT_AXIS_X, DEFAULT_POINTER_ID);
+        ASSERT_TRUE(velocity);
+        EXPECT_NEAR_BY_FRACTION(*velocity, linearVelocity, tolerance);
+    }
+
+    const std::vector<PlanarMotionEventEntry> quadratic = createPolynomialMotion(2);
+    for (VelocityTracker::Strategy strategy :
+         {VelocityTracker::Strategy::LSQ2, VelocityTracker::Strategy::LSQ3,
+          VelocityTracker::Strategy::WLSQ2_DELTA, VelocityTracker::Strategy::WLSQ2_CENTRAL,
+          VelocityTracker::Strategy::WLSQ2_RECENT}) {
+        SCOPED_TRACE(ftl::enum_string(strategy));
+        std::optional<float> velocity = computePlanarVelocity(strategy, quadratic,
+                                                              AMOTION_EVENT_AXIS_X,
+                                                              DEFAULT_POINTER_ID);
+        ASSERT_TRUE(velocity);
+        EXPECT_NEAR_BY_FRACTION(*velocity, quadraticVelocity, tolerance);
+    }
+
+    std::optional<float> velocity =
+            computePlanarVelocity(VelocityTracker::Strategy::LSQ3, createPolynomialMotion(3),
+                                  AMOTION_EVENT_AXIS_X, DEFAULT_POINTER_ID);
+    ASSERT_TRUE(velocity);
+    EXPECT_NEAR_BY_FRACTION(*velocity, cubicVelocity, tolerance);
+}
+
+/**
+ * The general least squares solver as it was before its columns had a fixed size, to compare the
+ * strategies against. Returns the velocity, i.e. the coefficient of the linear term.
+ */
+static std::optional<float> solveLeastSquaresReference(const std::vector<float>& x,
+                                                       const std::vector<float>& y,
+                                                       const std::vector<float>& w, uint32_t n) {
+    const size_t m = x.size();
+    auto dot = [m](const std::vector<float>& a, const std::vector<float>& b) {
+        float r = 0;
+        for (size_t h = 0; h < m; h++) {
+            r += a[h] * b[h];
+        }
+        return r;
+    };
+
+    std::vector<std::vector<float>> a(n, std::vector<float>(m)); // column-major order
+    for (size_t h = 0; h < m; h++) {
+        a[0][h] = w[h];
+        for (uint32_t i = 1; i < n; i++) {
+            a[i][h] = a[i - 1][h] * x[h];
+        }
+    }
+
+    std::vector<std::vector<float>> q(n, std::vector<float>(m)); // column-major order
+    std::vector<std::vector<float>> r(n, std::vector<float>(n)); // row-major order
+    for (uint32_t j = 0; j < n; j++) {
+        q[j] = a[j];
+        for (uint32_t i = 0; i < j; i++) {
+            const float d = dot(q[j], q[i]);
+            for (size_t h = 0; h < m; h++) {
+                q[j][h] -= d * q[i][h];
+            }
+        }
+        const float norm = sqrtf(dot(q[j], q[j]));
+        if (norm < 0.000001f) {
+            return std::nullopt;
+        }
+        const float invNorm = 1.0f / norm;
+        for (size_t h = 0; h < m; h++) {
+            q[j][h] *= invNorm;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            r[j][i] = i < j ? 0 : dot(q[j], a[i]);
+        }
+    }
+
+    std::vector<float> wy(m);
+    for (size_t h = 0; h < m; h++) {
+        wy[h] = y[h] * w[h];
+    }
+    std::vector<float> b(n);
+    for (uint32_t i = n; i != 0;) {
+        i--;
+        b[i] = dot(q[i], wy);
+        for (uint32_t j = n - 1; j > i; j--) {
+            b[i] -= r[i][j] * b[j];
+        }
+        b[i] /= r[i][i];
+    }
+    return b[1];
+}
+
+/**
+ * Fits the samples that a least squares strategy keeps (the last 20, within 100ms of the newest)
+ * with the reference solver. Only the weightings used below are supported.
+ */
+static std::optional<float> computeReferenceVelocity(
+        const std::vector<PlanarMotionEventEntry>& motions, uint32_t degree, bool recentWeighting) {
+    constexpr size_t historySize = 20;
+    constexpr std::chrono::nanoseconds horizon = 100ms;
+
+    const std::chrono::nanoseconds newestTime = motions.back().eventTime;
+    std::vector<float> x, y, w;
+    // The last entry repeats the one before it, for ACTION_UP.
+    for (size_t i = motions.size() - 1; i-- > 0 && x.size() < historySize;) {
+        const std::chrono::nanoseconds age = newestTime - motions[i].eventTime;
+        if (age > horizon) {
+            break;
+        }
+        x.push_back(-age.count() * 0.000000001f);
+        y.push_back(motions[i].positions[0].x);
+        const float ageMillis = age.count() * 0.000001f;
+        float weight = 1;
+        if (recentWeighting && ageMillis >= 50) {
+            weight = ageMillis < 100 ? 0.5f + (100 - ageMillis) * 0.01f : 0.5f;
+        }
+        w.push_back(weight);
+    }
+    const uint32_t fittedDegree = std::min<uint32_t>(degree, x.size() - 1);
+    if (fittedDegree == 0) {
+        return std::nullopt;
+    }
+    return solveLeastSquaresReference(x, y, w, fittedDegree + 1);
+}
+
+TEST_F(VelocityTrackerTest, LeastSquaresStrategiesMatchReferenceSolver) {
+    struct Case {
+        VelocityTracker::Strategy strategy;
+        uint32_t degree;
+        bool recentWeighting;
+    };
+    // LSQ2 has its own solver, and is covered by the quadratic tests.
+    const std::vector<Case> cases = {
+            {VelocityTracker::Strategy::LSQ1, 1, false},
+            {VelocityTracker::Strategy::LSQ3, 3, false},
+            {VelocityTracker::Strategy::WLSQ2_RECENT, 2, true},
+    };
+
+    // Random strokes of 5 to 30 samples, 4 to 12ms apart, moving up to 20px each time. The longer
+    // ones go past the horizon and the history size.
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<int> sampleCount(5, 30);
+    std::uniform_int_distribution<int> intervalUs(4000, 12000);
+    std::uniform_real_distribution<float> step(-20, 20);
+    for (int iteration = 0; iteration < 200; iteration++) {
+        std::vector<PlanarMotionEventEntry> motions;
+        std::chrono::nanoseconds eventTime = 0ms;
+        float position = 500;
+        for (int i = sampleCount(random); i > 0; i--) {
+            motions.push_back({eventTime, {{position, 0}}});
+            eventTime += std::chrono::microseconds(intervalUs(random));
+            position += step(random);
+        }
+        motions.push_back(motions.back()); // ACTION_UP
+
+        for (const Case& c : cases) {
+            SCOPED_TRACE(ftl::enum_string(c.strategy) + " iteration " + std::to_string(iteration));
+            std::optional<float> velocity = computePlanarVelocity(c.strategy, motions,
+                                                                  AMOTION_EVENT_AXIS_X,
+                                                                  DEFAULT_POINTER_ID);
+            std::optional<float> reference =
+                    computeReferenceVelocity(motions, c.degree, c.recentWeighting);
+            ASSERT_EQ(reference.has_value(), velocity.has_value());
+            if (reference) {
+                // Only the order in which the sums are rounded differs.
+                EXPECT_NEAR(*velocity, *reference, std::max(fabsf(*reference) * 1e-3f, 0.5f));
+            }
+        }
+    }
+}
+
 /**
  * When the stream is terminated with ACTION_CANCEL, the resulting velocity should be 0.
  */
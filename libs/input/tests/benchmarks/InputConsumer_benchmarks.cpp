@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/logging.h>
+#include <attestation/HmacKeyManager.h>
+#include <input/InputTransport.h>
+#include <utils/Errors.h>
+
+#include <chrono>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace android {
+
+namespace {
+
+constexpr size_t POINTER_COUNT = 10;
+constexpr size_t SAMPLES_PER_FRAME = 8;
+// Close enough together that a frame gets several samples, and far enough apart to be resampled.
+constexpr nsecs_t SAMPLE_INTERVAL = std::chrono::nanoseconds(3ms).count();
+// The latency that the consumer subtracts from the frame time when resampling.
+constexpr nsecs_t RESAMPLE_LATENCY = std::chrono::nanoseconds(5ms).count();
+
+class TouchStream {
+public:
+    explicit TouchStream(bool useSharedRing) {
+        std::unique_ptr<InputChannel> serverChannel, clientChannel;
+        InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel,
+                                           useSharedRing);
+        mPublisher = std::make_unique<InputPublisher>(std::move(serverChannel));
+        mConsumer = std::make_unique<InputConsumer>(std::move(clientChannel),
+                                                    /*enableTouchResampling=*/true);
+    }
+
+    // Puts all the pointers down.
+    void start() {
+        publish(AMOTION_EVENT_ACTION_DOWN, /*pointerCount=*/1);
+        for (size_t count = 2; count <= POINTER_COUNT; count++) {
+            publish(AMOTION_EVENT_ACTION_POINTER_DOWN |
+                            ((count - 1) << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT),
+                    count);
+        }
+        consumeAll(/*frameTime=*/-1);
+    }
+
+    void publishFrame() {
+        for (size_t i = 0; i < SAMPLES_PER_FRAME; i++) {
+            publish(AMOTION_EVENT_ACTION_MOVE, POINTER_COUNT);
+        }
+    }
+
+    // Consumes the batch of a frame, which is resampled between the last two samples.
+    void consumeFrame() {
+        const nsecs_t frameTime = mEventTime - SAMPLE_INTERVAL / 2 + RESAMPLE_LATENCY;
+        uint32_t seq;
+        InputEvent* event;
+        status_t status = mConsumer->consume(&mEventFactory, /*consumeBatches=*/true, frameTime,
+                                             &seq, &event);
+        if (status != OK) {
+            LOG(FATAL) << "Could not consume the batch: " << statusToString(status);
+        }
+        mConsumer->sendFinishedSignal(seq, /*handled=*/true);
+    }
+
+    void drainResponses() {
+        while (mPublisher->receiveConsumerResponse().ok()) {
+        }
+    }
+
+private:
+    std::unique_ptr<InputPublisher> mPublisher;
+    std::unique_ptr<InputConsumer> mConsumer;
+    PreallocatedInputEventFactory mEventFactory;
+    uint32_t mSeq = 1;
+    nsecs_t mEventTime = 0;
+
+    void publish(int32_t action, size_t pointerCount) {
+        std::vector<PointerProperties> properties(pointerCount);
+        std::vector<PointerCoords> coords(pointerCount);
+        for (size_t i = 0; i < pointerCount; i++) {
+            properties[i].id = i;
+            properties[i].toolType = ToolType::FINGER;
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 * i + mSeq);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 200 + mSeq);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5);
+            coords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, 10);
+        }
+        const ui::Transform identityTransform;
+        mEventTime += SAMPLE_INTERVAL;
+        status_t status =
+                mPublisher->publishMotionEvent(mSeq++, InputEvent::nextId(), /*deviceId=*/1,
+                                               AINPUT_SOURCE_TOUCHSCREEN, /*displayId=*/0,
+                                               INVALID_HMAC, action, /*actionButton=*/0,
+                                               /*flags=*/0, /*edgeFlags=*/0, AMETA_NONE,
+                                               /*buttonState=*/0, MotionClassification::NONE,
+                                               identityTransform, /*xPrecision=*/0,
+                                               /*yPrecision=*/0,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                               AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                               identityTransform, /*downTime=*/0, mEventTime,
+                                               pointerCount, properties.data(), coords.data());
+        if (status != OK) {
+            LOG(FATAL) << "Could not publish: " << statusToString(status);
+        }
+    }
+
+    void consumeAll(nsecs_t frameTime) {
+        uint32_t seq;
+        InputEvent* event;
+        while (mConsumer->consume(&mEventFactory, /*consumeBatches=*/true, frameTime, &seq,
+                                  &event) == OK) {
+            mConsumer->sendFinishedSignal(seq, /*handled=*/true);
+        }
+        drainResponses();
+    }
+};
+
+/**
+ * Ten fingers moving, with eight samples per frame that are batched into one event and resampled.
+ * Only the consumer's side is timed.
+ */
+static void benchmarkConsumeResampledBatch(benchmark::State& state) {
+    TouchStream stream(/*useSharedRing=*/state.range(0) != 0);
+    stream.start();
+    for (auto _ : state) {
+        state.PauseTiming();
+        stream.drainResponses();
+        stream.publishFrame();
+        state.ResumeTiming();
+
+        stream.consumeFrame();
+    }
+    state.SetItemsProcessed(state.iterations() * SAMPLES_PER_FRAME);
+}
+
+} // namespace
+
+BENCHMARK(benchmarkConsumeResampledBatch)->ArgName("sharedRing")->Arg(0)->Arg(1);
+
+} // namespace android
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ftl/enum.h>
+#include <input/VelocityTracker.h>
+
+#include <cmath>
+
+namespace android {
+
+namespace {
+
+constexpr int32_t POINTER_COUNT = 10;
+constexpr size_t SAMPLE_COUNT = 20;
+constexpr nsecs_t SAMPLE_INTERVAL = 4'000'000; // 4 ms, within the horizon of all strategies
+
+/**
+ * Ten pointers with a full history, whose velocity is queried on both planar axes, as apps do
+ * once per frame during a fling.
+ */
+static void benchmarkGetVelocity(benchmark::State& state) {
+    const auto strategy = static_cast<VelocityTracker::Strategy>(state.range(0));
+    state.SetLabel(ftl::enum_string(strategy));
+
+    VelocityTracker tracker(strategy);
+    for (size_t sample = 0; sample < SAMPLE_COUNT; sample++) {
+        const nsecs_t eventTime = sample * SAMPLE_INTERVAL;
+        const float t = sample * 0.004f;
+        for (int32_t id = 0; id < POINTER_COUNT; id++) {
+            tracker.addMovement(eventTime, id, AMOTION_EVENT_AXIS_X,
+                                100 * id + 1500 * t - 2000 * t * t);
+            tracker.addMovement(eventTime, id, AMOTION_EVENT_AXIS_Y, 50 * id + 800 * sinf(t * 10));
+        }
+    }
+
+    for (auto _ : state) {
+        for (int32_t id = 0; id < POINTER_COUNT; id++) {
+            benchmark::DoNotOptimize(tracker.getVelocity(AMOTION_EVENT_AXIS_X, id));
+            benchmark::DoNotOptimize(tracker.getVelocity(AMOTION_EVENT_AXIS_Y, id));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * POINTER_COUNT * 2);
+}
+
+} // namespace
+
+BENCHMARK(benchmarkGetVelocity)
+        ->ArgName("strategy")
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::IMPULSE))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::LSQ1))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::LSQ2))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::LSQ3))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::WLSQ2_DELTA))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::WLSQ2_CENTRAL))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::WLSQ2_RECENT))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::INT1))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::INT2))
+        ->Arg(static_cast<int>(VelocityTracker::Strategy::LEGACY));
+
+} // namespace android
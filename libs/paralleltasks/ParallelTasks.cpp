@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <paralleltasks/ParallelTasks.h>
+
+namespace android {
+
+void ParallelTasks::run(const std::vector<std::function<void()>>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    // std::unique_lock has no thread-safety annotations.
+    std::unique_lock lock(mMutex);
+    base::ScopedLockAssertion assumeLocked(mMutex);
+    mTasks = &tasks;
+    mNextTask = 0;
+    mNumUnfinishedTasks = tasks.size();
+    if (tasks.size() > 1) {
+        mWorkAvailable.notify_all();
+    }
+
+    while (runNextTask(lock)) {
+    }
+    mWorkDone.wait(lock, [this]() REQUIRES(mMutex) { return mNumUnfinishedTasks == 0; });
+    mTasks = nullptr;
+}
+
+void ParallelTasks::workerLoop() {
+    std::unique_lock lock(mMutex);
+    base::ScopedLockAssertion assumeLocked(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [this]() REQUIRES(mMutex) {
+            return mStopped || (mTasks != nullptr && mNextTask < mTasks->size());
+        });
+        if (mStopped) {
+            return;
+        }
+        while (runNextTask(lock)) {
+        }
+    }
+}
+
+void ParallelTasks::stop() {
+    {
+        std::scoped_lock lock(mMutex);
+        mStopped = true;
+    }
+    mWorkAvailable.notify_all();
+}
+
+bool ParallelTasks::runNextTask(std::unique_lock<std::mutex>& lock) {
+    if (mTasks == nullptr || mNextTask == mTasks->size()) {
+        return false;
+    }
+    const std::function<void()>& task = (*mTasks)[mNextTask++];
+    lock.unlock();
+    task();
+    lock.lock();
+    if (--mNumUnfinishedTasks == 0) {
+        mWorkDone.notify_all();
+    }
+    return true;
+}
+
+} // namespace android
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+// Runs batches of tasks on the calling thread and on a set of worker threads at the same time.
+//
+// There is no queue. run() hands out a batch of tasks and the calling thread takes part in
+// executing them. Idle threads take the next task that was not started yet, so a large task does
+// not hold up the smaller ones. run() only returns once all of the tasks are done.
+//
+// The threads are owned by the user, so that each can be started with the right priority. Each of
+// them runs workerLoop() until stop() is called.
+class ParallelTasks {
+public:
+    ParallelTasks() = default;
+    ParallelTasks(const ParallelTasks&) = delete;
+    ParallelTasks& operator=(const ParallelTasks&) = delete;
+
+    // Run all the tasks, in no particular order, and wait until they have all finished. Must not be
+    // called from more than one thread at a time.
+    void run(const std::vector<std::function<void()>>& tasks) EXCLUDES(mMutex);
+
+    // The body of a worker thread. Takes part in every run() until stop() is called.
+    void workerLoop() EXCLUDES(mMutex);
+
+    // Makes workerLoop() return on all threads. Must not be called during run().
+    void stop() EXCLUDES(mMutex);
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    const std::vector<std::function<void()>>* mTasks GUARDED_BY(mMutex) = nullptr;
+    size_t mNextTask GUARDED_BY(mMutex) = 0;
+    size_t mNumUnfinishedTasks GUARDED_BY(mMutex) = 0;
+    bool mStopped GUARDED_BY(mMutex) = false;
+
+    // Takes a task that was not started yet and runs it without holding the lock. Returns false if
+    // there was nothing left to take.
+    bool runNextTask(std::unique_lock<std::mutex>& lock) REQUIRES(mMutex);
+};
+
+} // namespace android
@@ -19,6 +19,8 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -66,6 +68,107 @@ const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 
 // ----------------------------------------------------------------------------
 
+// The operations that update a region in place work on a copy of it. The copy is kept for each
+// thread, so that it doesn't need an allocation every time once the regions grow past the inline
+// storage.
+static Region& scratchRegion() {
+    thread_local Region region;
+    return region;
+}
+
+// Same for the span that the rasterizer collects.
+static FatVector<Rect>& scratchSpan() {
+    thread_local FatVector<Rect> span;
+    return span;
+}
+
+static inline bool contains(const Rect& outer, const Rect& inner) {
+    return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right &&
+            outer.bottom >= inner.bottom;
+}
+
+/**
+ * Most of the operations on single rectangles, like clipping a layer to the display or removing an
+ * opaque layer from the one below it, result in one rectangle or in nothing. Those results are
+ * computed directly, without the rasterizer. Returns false, and leaves dst unchanged, if the
+ * result may need more than one rectangle.
+ */
+static bool rectOperation(uint32_t op, Region& dst, const Rect& lhs, const Rect& rhs) {
+    // Invalid rectangles are left to the general operation, which has its own way of handling them.
+    if (!lhs.isValid() || !rhs.isValid()) {
+        return false;
+    }
+
+    Rect result(Rect::EMPTY_RECT);
+    switch (op) {
+        case op_and:
+            lhs.intersect(rhs, &result);
+            break;
+        case op_nand:
+            if (lhs.isEmpty() || contains(rhs, lhs)) {
+                result = Rect::EMPTY_RECT;
+            } else if (rhs.isEmpty() || !lhs.intersect(rhs, &result)) {
+                result = lhs;
+            } else if (rhs.left <= lhs.left && rhs.right >= lhs.right) {
+                // rhs removes the top or the bottom of lhs, unless it is strictly inside
+                if (rhs.top <= lhs.top) {
+                    result = Rect(lhs.left, rhs.bottom, lhs.right, lhs.bottom);
+                } else if (rhs.bottom >= lhs.bottom) {
+                    result = Rect(lhs.left, lhs.top, lhs.right, rhs.top);
+                } else {
+                    return false;
+                }
+            } else if (rhs.top <= lhs.top && rhs.bottom >= lhs.bottom) {
+                // rhs removes the left or the right of lhs, unless it is strictly inside
+                if (rhs.left <= lhs.left) {
+                    result = Rect(rhs.right, lhs.top, lhs.right, lhs.bottom);
+                } else if (rhs.right >= lhs.right) {
+                    result = Rect(lhs.left, lhs.top, rhs.left, lhs.bottom);
+                } else {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+            break;
+        case op_or:
+        case op_xor:
+            if (lhs.isEmpty()) {
+                result = rhs;
+            } else if (rhs.isEmpty()) {
+                result = lhs;
+            } else if (op == op_xor) {
+                return false;
+            } else if (contains(lhs, rhs)) {
+                result = lhs;
+            } else if (contains(rhs, lhs)) {
+                result = rhs;
+            } else if (lhs.left == rhs.left && lhs.right == rhs.right && lhs.top <= rhs.bottom &&
+                       rhs.top <= lhs.bottom) {
+                result = Rect(lhs.left, std::min(lhs.top, rhs.top), lhs.right,
+                              std::max(lhs.bottom, rhs.bottom));
+            } else if (lhs.top == rhs.top && lhs.bottom == rhs.bottom && lhs.left <= rhs.right &&
+                       rhs.left <= lhs.right) {
+                result = Rect(std::min(lhs.left, rhs.left), lhs.top,
+                              std::max(lhs.right, rhs.right), lhs.bottom);
+            } else {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    if (result.isEmpty()) {
+        dst.clear();
+    } else {
+        dst.set(result);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
 Region::Region() {
     mStorage.push_back(Rect(0, 0));
 }
@@ -329,7 +432,11 @@ Region& Region::subtractSelf(const Rect& r) {
     return operationSelf(r, op_nand);
 }
 Region& Region::operationSelf(const Rect& r, uint32_t op) {
-    Region lhs(*this);
+    if (isRect() && rectOperation(op, *this, getBounds(), r)) {
+        return *this;
+    }
+    Region& lhs = scratchRegion();
+    lhs = *this;
     boolean_operation(op, *this, lhs, r);
     return *this;
 }
@@ -353,7 +460,11 @@ Region& Region::subtractSelf(const Region& rhs) {
     return operationSelf(rhs, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, uint32_t op) {
-    Region lhs(*this);
+    if (isRect() && rhs.isRect() && rectOperation(op, *this, getBounds(), rhs.getBounds())) {
+        return *this;
+    }
+    Region& lhs = scratchRegion();
+    lhs = *this;
     boolean_operation(op, *this, lhs, rhs);
     return *this;
 }
@@ -438,7 +549,8 @@ Region& Region::subtractSelf(const Region& rhs, int dx, int dy) {
     return operationSelf(rhs, dx, dy, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, int dx, int dy, uint32_t op) {
-    Region lhs(*this);
+    Region& lhs = scratchRegion();
+    lhs = *this;
     boolean_operation(op, *this, lhs, rhs, dx, dy);
     return *this;
 }
@@ -473,12 +585,18 @@ class Region::rasterizer : public region_operator<Rect>::region_rasterizer
     FatVector<Rect>& storage;
     Rect* head;
     Rect* tail;
-    FatVector<Rect> span;
+    FatVector<Rect>& span;
     Rect* cur;
 public:
     explicit rasterizer(Region& reg)
-        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(), cur() {
+        : bounds(INT_MAX, 0, INT_MIN, 0),
+          storage(reg.mStorage),
+          head(),
+          tail(),
+          span(scratchSpan()),
+          cur() {
         storage.clear();
+        span.clear();
     }
 
     virtual ~rasterizer();
@@ -653,6 +771,11 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+    if (lhs.isRect() && rhs.isRect() &&
+        rectOperation(op, dst, lhs.getBounds(), Rect(rhs.getBounds()).offsetBy(dx, dy))) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -767,6 +890,10 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    if (lhs.isRect() && rectOperation(op, dst, lhs.getBounds(), Rect(rhs).offsetBy(dx, dy))) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
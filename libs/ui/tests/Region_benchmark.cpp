@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the Region operations that SurfaceFlinger uses the most. To compare two
+// implementations of Region, run the benchmarks against each of them.
+
+#include <benchmark/benchmark.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include <vector>
+
+namespace android {
+namespace {
+
+const Rect kDisplay(0, 0, 1080, 2400);
+const Rect kStatusBar(0, 0, 1080, 100);
+const Rect kNavigationBar(0, 2300, 1080, 2400);
+
+// Clipping a layer to the display.
+void BM_intersectRects(benchmark::State& state) {
+    const Rect layer(-100, 50, 900, 3000);
+    for (auto _ : state) {
+        Region region(layer);
+        region.andSelf(kDisplay);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_intersectRects);
+
+// Removing an opaque bar from the layer below it.
+void BM_subtractRects(benchmark::State& state) {
+    for (auto _ : state) {
+        Region region(kDisplay);
+        region.subtractSelf(kStatusBar);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_subtractRects);
+
+// Accumulating the area covered by two layers, where the result needs more than one rectangle.
+void BM_mergeOverlappingRects(benchmark::State& state) {
+    const Rect dialog(100, 800, 980, 1600);
+    for (auto _ : state) {
+        Region region(kStatusBar);
+        region.orSelf(dialog);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_mergeOverlappingRects);
+
+// Updating a region with many rectangles in place, like a dirty region late in a frame.
+void BM_mergeIntoComplexRegion(benchmark::State& state) {
+    Region complex;
+    for (int i = 0; i < 32; i++) {
+        complex.orSelf(Rect(i * 30, i * 70, i * 30 + 100, i * 70 + 50));
+    }
+    const Rect update(500, 1000, 700, 1200);
+    for (auto _ : state) {
+        Region region(complex);
+        region.orSelf(update);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_mergeIntoComplexRegion);
+
+// The region arithmetic that CompositionEngine does for each layer when the geometry changes,
+// front to back, over a stack of layers like a launcher over some apps.
+void BM_visibleRegions(benchmark::State& state) {
+    const auto numLayers = static_cast<int32_t>(state.range(0));
+    std::vector<Rect> layers = {kStatusBar, kNavigationBar};
+    for (int32_t i = 0; static_cast<int32_t>(layers.size()) < numLayers; i++) {
+        const int32_t inset = (i % 8) * 40;
+        layers.emplace_back(inset, 100 + inset, 1080 - inset, 2300 - inset);
+    }
+
+    for (auto _ : state) {
+        Region aboveOpaqueLayers;
+        Region aboveCoveredLayers;
+        Region dirtyRegion;
+        for (size_t i = 0; i < layers.size(); i++) {
+            Region visibleRegion(layers[i]);
+            const Region coveredRegion = aboveCoveredLayers.intersect(visibleRegion);
+            aboveCoveredLayers.orSelf(visibleRegion);
+            visibleRegion.subtractSelf(aboveOpaqueLayers);
+            dirtyRegion.orSelf(visibleRegion.subtract(coveredRegion));
+            // Every other layer is translucent.
+            if (i % 2 == 0) {
+                aboveOpaqueLayers.orSelf(layers[i]);
+            }
+            visibleRegion.andSelf(kDisplay);
+            benchmark::DoNotOptimize(visibleRegion);
+        }
+        benchmark::DoNotOptimize(dirtyRegion);
+    }
+    state.SetItemsProcessed(state.iterations() * numLayers);
+}
+BENCHMARK(BM_visibleRegions)->Arg(10)->Arg(100)->Arg(500);
+
+} // namespace
+} // namespace android
@@ -21,6 +21,10 @@
 #include <ui/Rect.h>
 #include <gtest/gtest.h>
 
+#include <functional>
+#include <string>
+#include <vector>
+
 namespace android {
 
 class RegionTest : public testing::Test {
@@ -179,5 +183,179 @@ TEST_F(RegionTest, RegionHash) {
     EXPECT_NE(std::hash<Region>{}(region1), std::hash<Region>{}(region2));
 }
 
+TEST_F(RegionTest, RectOperations) {
+    const Rect display(0, 0, 100, 200);
+
+    EXPECT_TRUE(Region(display).intersect(Rect(-10, 50, 50, 300)).hasSameRects(
+            Region(Rect(0, 50, 50, 200))));
+    EXPECT_TRUE(Region(display).intersect(Rect(100, 0, 200, 200)).isEmpty());
+
+    // Removing a band that spans the rect leaves a single rect.
+    EXPECT_TRUE(Region(display).subtract(Rect(0, 0, 100, 20)).hasSameRects(
+            Region(Rect(0, 20, 100, 200))));
+    EXPECT_TRUE(Region(display).subtract(Rect(-10, 0, 30, 300)).hasSameRects(
+            Region(Rect(30, 0, 100, 200))));
+    EXPECT_TRUE(Region(display).subtract(Rect(-10, -10, 110, 210)).isEmpty());
+
+    // Removing a band from the middle splits the rect.
+    Region split = Region(display).subtract(Rect(0, 50, 100, 60));
+    EXPECT_EQ(split.end() - split.begin(), 2);
+    EXPECT_TRUE(split.contains(50, 40));
+    EXPECT_FALSE(split.contains(50, 55));
+
+    // Rects that line up merge into a single rect.
+    EXPECT_TRUE(Region(Rect(0, 0, 100, 20)).merge(Rect(0, 20, 100, 200)).hasSameRects(
+            Region(display)));
+    EXPECT_TRUE(Region(Rect(0, 0, 60, 200)).merge(Rect(40, 0, 100, 200)).hasSameRects(
+            Region(display)));
+
+    Region merged = Region(Rect(0, 0, 50, 50)).merge(Rect(25, 25, 100, 100));
+    EXPECT_EQ(merged.end() - merged.begin(), 3);
+    EXPECT_TRUE(merged.contains(10, 10));
+    EXPECT_TRUE(merged.contains(90, 90));
+    EXPECT_FALSE(merged.contains(90, 10));
+
+    Region region(display);
+    region.subtractSelf(Region(Rect(0, 0, 100, 20)));
+    region.orSelf(Rect(0, 0, 100, 20));
+    EXPECT_TRUE(region.hasSameRects(Region(display)));
+    region.xorSelf(display);
+    EXPECT_TRUE(region.isEmpty());
+}
+
+enum class RegionOp { OR, XOR, AND, SUBTRACT };
+
+// Computes lhs op (rhs translated by dx, dy) with the general rasterizer. A region with two rects
+// far below the operands is added to them, so that they are never single rects, and is removed from
+// the result again.
+static Region rasterizeRectOperation(RegionOp op, const Rect& lhs, const Rect& rhs, int dx, int dy) {
+    const Region sentinel = Region(Rect(0, 1000, 10, 1010)).merge(Region(Rect(20, 1020, 30, 1030)));
+    const Region lhsWithSentinel = Region(lhs).merge(sentinel);
+    Region result;
+    switch (op) {
+        case RegionOp::OR:
+            result = lhsWithSentinel.merge(Region(rhs), dx, dy);
+            break;
+        case RegionOp::XOR:
+            result = lhsWithSentinel.mergeExclusive(Region(rhs), dx, dy);
+            break;
+        case RegionOp::AND:
+            result = lhsWithSentinel.intersect(Region(rhs).merge(sentinel.translate(-dx, -dy)), dx,
+                                               dy);
+            break;
+        case RegionOp::SUBTRACT:
+            result = lhsWithSentinel.subtract(Region(rhs), dx, dy);
+            break;
+    }
+    return result.subtract(sentinel);
+}
+
+// Every overload that can take the single rect path, as lhs op (rhs translated by dx, dy). The
+// overloads without a translation are only used with dx = dy = 0.
+struct RectOperationVariant {
+    std::string name;
+    RegionOp op;
+    bool translates;
+    std::function<Region(const Rect& lhs, const Rect& rhs, int dx, int dy)> apply;
+};
+
+static std::vector<RectOperationVariant> rectOperationVariants() {
+    using Apply = std::function<Region(const Rect&, const Rect&, int, int)>;
+    std::vector<RectOperationVariant> variants;
+    auto add = [&](RegionOp op, const char* name, Apply rect, Apply region, Apply rectSelf,
+                   Apply regionSelf, Apply translated, Apply translatedSelf) {
+        variants.push_back({std::string(name) + "(Rect)", op, false, rect});
+        variants.push_back({std::string(name) + "(Region)", op, false, region});
+        variants.push_back({std::string(name) + "Self(Rect)", op, false, rectSelf});
+        variants.push_back({std::string(name) + "Self(Region)", op, false, regionSelf});
+        variants.push_back({std::string(name) + "(Region, dx, dy)", op, true, translated});
+        variants.push_back({std::string(name) + "Self(Region, dx, dy)", op, true, translatedSelf});
+    };
+    add(RegionOp::OR, "or",
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).merge(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).merge(Region(r)); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).orSelf(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).orSelf(Region(r)); },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).merge(Region(r), dx, dy);
+        },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).orSelf(Region(r), dx, dy);
+        });
+    add(RegionOp::XOR, "xor",
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).mergeExclusive(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).mergeExclusive(Region(r)); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).xorSelf(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).xorSelf(Region(r)); },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).mergeExclusive(Region(r), dx, dy);
+        },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).xorSelf(Region(r), dx, dy);
+        });
+    add(RegionOp::AND, "and",
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).intersect(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).intersect(Region(r)); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).andSelf(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).andSelf(Region(r)); },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).intersect(Region(r), dx, dy);
+        },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).andSelf(Region(r), dx, dy);
+        });
+    add(RegionOp::SUBTRACT, "subtract",
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).subtract(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).subtract(Region(r)); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).subtractSelf(r); },
+        [](const Rect& l, const Rect& r, int, int) { return Region(l).subtractSelf(Region(r)); },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).subtract(Region(r), dx, dy);
+        },
+        [](const Rect& l, const Rect& r, int dx, int dy) {
+            return Region(l).subtractSelf(Region(r), dx, dy);
+        });
+    return variants;
+}
+
+// A rect on a small grid, so that edges often line up. Some of them are empty.
+static Rect randomGridRect() {
+    const int left = random() % X_MAX;
+    const int top = random() % Y_MAX;
+    return Rect(left, top, left + random() % (X_MAX - left + 1), top + random() % (Y_MAX - top + 1));
+}
+
+TEST_F(RegionTest, RectOperationsMatchRasterizer) {
+    srandom(12345);
+
+    for (const RectOperationVariant& variant : rectOperationVariants()) {
+        for (int iter = 0; iter < ITER_MAX; iter++) {
+            const Rect lhs = randomGridRect();
+            const Rect rhs = randomGridRect();
+            const int dx = variant.translates ? static_cast<int>(random() % X_MAX) - X_MAX / 2 : 0;
+            const int dy = variant.translates ? static_cast<int>(random() % Y_MAX) - Y_MAX / 2 : 0;
+
+            const Region expected = rasterizeRectOperation(variant.op, lhs, rhs, dx, dy);
+            const Region actual = variant.apply(lhs, rhs, dx, dy);
+            if (expected.isEmpty()) {
+                EXPECT_TRUE(actual.isEmpty());
+            } else {
+                EXPECT_TRUE(actual.hasSameRects(expected));
+                EXPECT_EQ(expected.getBounds(), actual.getBounds());
+            }
+            if (HasFailure()) {
+                std::string dump;
+                actual.dump(dump, "actual");
+                expected.dump(dump, "expected");
+                FAIL() << variant.name << " of " << lhs.left << "," << lhs.top << "," << lhs.right
+                       << "," << lhs.bottom << " and " << rhs.left << "," << rhs.top << ","
+                       << rhs.right << "," << rhs.bottom << " moved by " << dx << "," << dy
+                       << "\n"
+                       << dump;
+            }
+        }
+    }
+}
+
 }; // namespace android
 
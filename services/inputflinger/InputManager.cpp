@@ -300,4 +300,18 @@ binder::Status InputManager::setFocusedWindow(const gui::FocusRequest& request)
     return binder::Status::ok();
 }
 
+binder::Status InputManager::dumpLatencyBreakdown(std::string* outDump) {
+    IPCThreadState* ipc = IPCThreadState::self();
+    const uid_t uid = ipc->getCallingUid();
+    if (uid != AID_SHELL && uid != AID_ROOT && uid != AID_SYSTEM) {
+        LOG(ERROR) << __func__ << " can only be called by SHELL, ROOT or SYSTEM users, "
+                   << "but was called from UID " << uid;
+        return binder::Status::
+                fromExceptionCode(EX_SECURITY,
+                                  "This uid is not allowed to call dumpLatencyBreakdown");
+    }
+    *outDump = mDispatcher->dumpLatencyBreakdown();
+    return binder::Status::ok();
+}
+
 } // namespace android
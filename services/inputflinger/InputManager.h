@@ -140,6 +140,7 @@ public:
                                       android::os::InputChannelCore* outChannel) override;
     binder::Status removeInputChannel(const sp<IBinder>& connectionToken) override;
     binder::Status setFocusedWindow(const gui::FocusRequest&) override;
+    binder::Status dumpLatencyBreakdown(std::string* outDump) override;
 
 private:
     std::unique_ptr<InputReaderInterface> mReader;
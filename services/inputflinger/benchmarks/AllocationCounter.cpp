@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AllocationCounter.h"
+
+#include <allocationcounter/HeapAllocations.h>
+
+namespace android {
+
+AllocationCounter::AllocationCounter(benchmark::State& state, size_t eventsPerIteration)
+      : mState(state), mEventsPerIteration(eventsPerIteration), mStart(getHeapAllocations()) {}
+
+AllocationCounter::~AllocationCounter() {
+    const size_t allocations = getHeapAllocations() - mStart;
+    const size_t events = mState.iterations() * mEventsPerIteration;
+    mState.counters["allocs_per_event"] =
+            events == 0 ? 0 : static_cast<double>(allocations) / events;
+}
+
+} // namespace android
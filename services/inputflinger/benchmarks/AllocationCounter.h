@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+
+namespace android {
+
+/**
+ * Reports the heap allocations made, on any thread, between its construction and its destruction
+ * as the "allocs_per_event" counter of the benchmark.
+ */
+class AllocationCounter {
+public:
+    AllocationCounter(benchmark::State& state, size_t eventsPerIteration);
+    ~AllocationCounter();
+
+private:
+    benchmark::State& mState;
+    const size_t mEventsPerIteration;
+    const size_t mStart;
+};
+
+} // namespace android
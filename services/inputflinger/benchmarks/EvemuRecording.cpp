@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EvemuRecording.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace android {
+
+namespace {
+
+// Bitmaps are written as hexadecimal bytes, 8 per line, and may be continued on the following
+// lines with the same prefix. 'nextByte' is the index of the first byte of this line, and is
+// advanced past the bytes that were read.
+template <size_t N>
+bool parseBitmapLine(std::istringstream& line, size_t& nextByte, std::bitset<N>& bits) {
+    std::string byteString;
+    while (line >> byteString) {
+        char* end;
+        const unsigned long byte = strtoul(byteString.c_str(), &end, 16);
+        if (*end != '\0' || byte > 0xff) {
+            return false;
+        }
+        for (size_t bit = 0; bit < 8; bit++) {
+            const size_t index = nextByte * 8 + bit;
+            if ((byte & (1 << bit)) && index < N) {
+                bits.set(index);
+            }
+        }
+        nextByte++;
+    }
+    return true;
+}
+
+} // namespace
+
+bool EvemuRecording::hasAbsoluteAxis(int32_t code) const {
+    return std::any_of(absoluteAxes.begin(), absoluteAxes.end(),
+                       [code](const AbsoluteAxis& axis) { return axis.code == code; });
+}
+
+base::Result<EvemuRecording> EvemuRecording::parse(std::istream& in) {
+    EvemuRecording recording;
+    // The index of the next byte of each bitmap, by event type.
+    std::map<int32_t, size_t> nextBitmapByte;
+    size_t nextPropertyByte = 0;
+    std::vector<Event> frame;
+
+    std::string text;
+    for (size_t lineNumber = 1; std::getline(in, text); lineNumber++) {
+        if (text.empty() || text[0] == '#') {
+            continue;
+        }
+        std::istringstream line(text);
+        std::string prefix;
+        line >> prefix;
+        if (prefix == "N:") {
+            std::getline(line >> std::ws, recording.name);
+        } else if (prefix == "I:") {
+            line >> std::hex >> recording.bus >> recording.vendor >> recording.product >>
+                    recording.version;
+        } else if (prefix == "P:") {
+            if (!parseBitmapLine(line, nextPropertyByte, recording.properties)) {
+                return base::Error() << "line " << lineNumber << ": invalid property bitmap";
+            }
+            continue;
+        } else if (prefix == "B:") {
+            int32_t type;
+            line >> std::hex >> type;
+            size_t& nextByte = nextBitmapByte[type];
+            // Only the keys are needed to describe the device. The absolute axes are described by
+            // the "A:" lines, and other event types don't affect how the events are processed.
+            std::bitset<KEY_CNT> ignored;
+            if (!parseBitmapLine(line, nextByte, type == EV_KEY ? recording.keys : ignored)) {
+                return base::Error() << "line " << lineNumber << ": invalid bitmap";
+            }
+            continue;
+        } else if (prefix == "A:") {
+            AbsoluteAxis axis{};
+            line >> std::hex >> axis.code >> std::dec >> axis.minValue >> axis.maxValue >>
+                    axis.fuzz >> axis.flat;
+            // Older versions of the format don't have the resolution.
+            if (!(line >> axis.resolution)) {
+                axis.resolution = 0;
+                line.clear();
+            }
+            recording.absoluteAxes.push_back(axis);
+        } else if (prefix == "E:") {
+            std::string time;
+            Event event;
+            line >> time >> std::hex >> event.type >> event.code >> std::dec >> event.value;
+            if (line.fail()) {
+                return base::Error() << "line " << lineNumber << ": invalid event";
+            }
+            frame.push_back(event);
+            if (event.type == EV_SYN && event.code == SYN_REPORT) {
+                recording.frames.push_back(std::move(frame));
+                frame.clear();
+            }
+            continue;
+        } else {
+            // Newer versions of the format can describe LEDs and switches, which aren't needed.
+            continue;
+        }
+        if (line.fail()) {
+            return base::Error() << "line " << lineNumber << ": could not parse '" << text << "'";
+        }
+    }
+    if (recording.name.empty()) {
+        return base::Error() << "the recording does not describe a device";
+    }
+    return recording;
+}
+
+base::Result<EvemuRecording> EvemuRecording::readFile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        return base::ErrnoError() << "could not open " << path;
+    }
+    return parse(in);
+}
+
+} // namespace android
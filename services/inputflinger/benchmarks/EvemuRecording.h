@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/result.h>
+#include <linux/input.h>
+
+#include <bitset>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/**
+ * An input device and the events that it produced, as recorded by evemu-record (see
+ * frameworks/native/cmds/evemu-record for the format).
+ *
+ * The timestamps of the events are not kept, since the recordings are replayed as fast as the
+ * pipeline can process them.
+ */
+struct EvemuRecording {
+    struct AbsoluteAxis {
+        int32_t code;
+        int32_t minValue;
+        int32_t maxValue;
+        int32_t fuzz;
+        int32_t flat;
+        int32_t resolution;
+    };
+
+    struct Event {
+        int32_t type;
+        int32_t code;
+        int32_t value;
+    };
+
+    std::string name;
+    uint16_t bus = 0;
+    uint16_t vendor = 0;
+    uint16_t product = 0;
+    uint16_t version = 0;
+    std::bitset<INPUT_PROP_CNT> properties;
+    std::bitset<KEY_CNT> keys;
+    std::vector<AbsoluteAxis> absoluteAxes;
+    // The events, grouped into the frames that the device reported. Every frame ends with a
+    // SYN_REPORT. Events after the last SYN_REPORT of the recording are dropped.
+    std::vector<std::vector<Event>> frames;
+
+    bool hasAbsoluteAxis(int32_t code) const;
+
+    static base::Result<EvemuRecording> parse(std::istream& in);
+    static base::Result<EvemuRecording> readFile(const std::string& path);
+};
+
+} // namespace android
@@ -23,6 +23,7 @@
 #include "../tests/FakeApplicationHandle.h"
 #include "../tests/FakeInputDispatcherPolicy.h"
 #include "../tests/FakeWindowHandle.h"
+#include "AllocationCounter.h"
 
 using android::base::Result;
 using android::gui::WindowInfo;
@@ -117,6 +118,7 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
 
     NotifyMotionArgs motionArgs = generateMotionArgs();
 
+    AllocationCounter allocationCounter(state, /*eventsPerIteration=*/2);
     for (auto _ : state) {
         // Send ACTION_DOWN
         motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
@@ -150,6 +152,7 @@ static void benchmarkInjectMotion(benchmark::State& state) {
 
     dispatcher.onWindowInfosChanged({{*window->getInfo()}, {}, 0, 0});
 
+    AllocationCounter allocationCounter(state, /*eventsPerIteration=*/2);
     for (auto _ : state) {
         MotionEvent event = generateMotionEvent();
         // Send ACTION_DOWN
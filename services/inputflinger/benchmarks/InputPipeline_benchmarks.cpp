@@ -0,0 +1,601 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <InputReader.h>
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <gui/constants.h>
+#include <linux/input.h>
+#include "../PointerChoreographer.h"
+#include "../UnwantedInteractionBlocker.h"
+#include "../dispatcher/InputDispatcher.h"
+#include "../dispatcher/LatencyBreakdown.h"
+#include "../tests/FakeApplicationHandle.h"
+#include "../tests/FakeEventHub.h"
+#include "../tests/FakeInputDispatcherPolicy.h"
+#include "../tests/FakeInputReaderPolicy.h"
+#include "../tests/FakePointerController.h"
+#include "../tests/FakeWindowHandle.h"
+#include "AllocationCounter.h"
+#include "EvemuRecording.h"
+
+#include <cinttypes>
+#include <cstdlib>
+#include <sstream>
+
+/**
+ * Benchmarks for the whole input pipeline, from the EventHub to the app: the events of an evdev
+ * recording are replayed one frame at a time through the InputReader, UnwantedInteractionBlocker,
+ * PointerChoreographer and InputDispatcher, and consumed by a window that covers the display.
+ *
+ * Besides the built-in recordings, recordings made with evemu-record can be replayed by listing
+ * their paths, separated by ':', in the INPUTFLINGER_BENCHMARK_RECORDINGS environment variable.
+ * Only touchscreens and styluses are supported.
+ */
+
+namespace android {
+
+using android::base::Result;
+using android::base::StringPrintf;
+using android::inputdispatcher::InputDispatcher;
+using android::inputdispatcher::LatencyHistogram;
+
+namespace {
+
+constexpr const char* RECORDINGS_ENV = "INPUTFLINGER_BENCHMARK_RECORDINGS";
+
+constexpr int32_t EVENTHUB_ID = 1;
+
+constexpr int32_t DISPLAY_ID = ADISPLAY_ID_DEFAULT;
+constexpr int32_t DISPLAY_WIDTH = FakeWindowHandle::WIDTH;
+constexpr int32_t DISPLAY_HEIGHT = FakeWindowHandle::HEIGHT;
+
+// How long to wait for the window to receive an event before giving up on the replay.
+constexpr std::chrono::milliseconds CONSUME_TIMEOUT = 1000ms;
+
+// The frame interval of the built-in recordings.
+constexpr nsecs_t FRAME_INTERVAL = ms2ns(8);
+
+nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// --- Built-in recordings ---
+
+constexpr const char* TOUCHSCREEN_DESCRIPTION = R"(# EVEMU 1.2
+N: Benchmark Touchscreen
+I: 0018 18d1 4ee1 0100
+P: 02 00 00 00 00 00 00 00
+B: 00 0b 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 04 00 00 00 00 00 00
+B: 03 00 00 00 00 00 80 61 06
+A: 2f 0 9 0 0 0
+A: 30 0 255 0 0 0
+A: 35 0 599 0 0 0
+A: 36 0 799 0 0 0
+A: 39 0 65535 0 0 0
+A: 3a 0 255 0 0 0
+)";
+
+constexpr const char* STYLUS_DESCRIPTION = R"(# EVEMU 1.2
+N: Benchmark Pen
+I: 0018 18d1 4ee2 0100
+P: 02 00 00 00 00 00 00 00
+B: 00 0b 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 00 00 00 00 00 00 00 00
+B: 01 01 0c 00 00 00 00 00 00
+B: 03 03 00 00 03 00 00 00 00
+A: 00 0 599 0 0 0
+A: 01 0 799 0 0 0
+A: 18 0 4095 0 0 0
+A: 19 0 255 0 0 0
+)";
+
+// Writes the events of a recording in the same format as evemu-record.
+class RecordingWriter {
+public:
+    explicit RecordingWriter(const char* description) : mText(description) {}
+
+    void event(int32_t type, int32_t code, int32_t value) {
+        mText += StringPrintf("E: %" PRId64 ".%06" PRId64 " %04x %04x %04d\n", mTime / 1000000000,
+                              (mTime / 1000) % 1000000, type, code, value);
+    }
+
+    void sync() {
+        event(EV_SYN, SYN_REPORT, 0);
+        mTime += FRAME_INTERVAL;
+    }
+
+    const std::string& getText() const { return mText; }
+
+private:
+    std::string mText;
+    nsecs_t mTime = us2ns(1);
+};
+
+void writeMtPointer(RecordingWriter& writer, int32_t slot, int32_t x, int32_t y) {
+    writer.event(EV_ABS, ABS_MT_SLOT, slot);
+    writer.event(EV_ABS, ABS_MT_POSITION_X, x);
+    writer.event(EV_ABS, ABS_MT_POSITION_Y, y);
+}
+
+void writeMtPointerDown(RecordingWriter& writer, int32_t slot, int32_t x, int32_t y) {
+    writer.event(EV_ABS, ABS_MT_SLOT, slot);
+    writer.event(EV_ABS, ABS_MT_TRACKING_ID, slot);
+    writer.event(EV_ABS, ABS_MT_TOUCH_MAJOR, 10);
+    writer.event(EV_ABS, ABS_MT_PRESSURE, 100);
+    writeMtPointer(writer, slot, x, y);
+}
+
+void writeMtPointerUp(RecordingWriter& writer, int32_t slot) {
+    writer.event(EV_ABS, ABS_MT_SLOT, slot);
+    writer.event(EV_ABS, ABS_MT_TRACKING_ID, -1);
+}
+
+// Ten fingers go down one after the other, move together, and are lifted one after the other.
+std::string createTenFingerRecording() {
+    constexpr int32_t NUM_FINGERS = 10;
+    RecordingWriter writer(TOUCHSCREEN_DESCRIPTION);
+    for (int32_t slot = 0; slot < NUM_FINGERS; slot++) {
+        writeMtPointerDown(writer, slot, 30 + 60 * slot, 100);
+        if (slot == 0) {
+            writer.event(EV_KEY, BTN_TOUCH, 1);
+        }
+        writer.sync();
+    }
+    for (int32_t frame = 0; frame < 100; frame++) {
+        for (int32_t slot = 0; slot < NUM_FINGERS; slot++) {
+            writeMtPointer(writer, slot, 30 + 60 * slot, 100 + 5 * frame);
+        }
+        writer.sync();
+    }
+    for (int32_t slot = 0; slot < NUM_FINGERS; slot++) {
+        writeMtPointerUp(writer, slot);
+        if (slot == NUM_FINGERS - 1) {
+            writer.event(EV_KEY, BTN_TOUCH, 0);
+        }
+        writer.sync();
+    }
+    return writer.getText();
+}
+
+// Two fingers go down in the middle of the display and move apart.
+std::string createPinchRecording() {
+    constexpr int32_t CENTER_X = DISPLAY_WIDTH / 2;
+    constexpr int32_t CENTER_Y = DISPLAY_HEIGHT / 2;
+    RecordingWriter writer(TOUCHSCREEN_DESCRIPTION);
+    writeMtPointerDown(writer, 0, CENTER_X - 20, CENTER_Y - 20);
+    writer.event(EV_KEY, BTN_TOUCH, 1);
+    writer.sync();
+    writeMtPointerDown(writer, 1, CENTER_X + 20, CENTER_Y + 20);
+    writer.sync();
+    for (int32_t distance = 20; distance < 270; distance += 2) {
+        writeMtPointer(writer, 0, CENTER_X - distance, CENTER_Y - distance);
+        writeMtPointer(writer, 1, CENTER_X + distance, CENTER_Y + distance);
+        writer.sync();
+    }
+    writeMtPointerUp(writer, 0);
+    writer.sync();
+    writeMtPointerUp(writer, 1);
+    writer.event(EV_KEY, BTN_TOUCH, 0);
+    writer.sync();
+    return writer.getText();
+}
+
+// A stylus hovers over the display, touches it briefly, and goes back to hovering before it is
+// taken out of range.
+std::string createStylusHoverRecording() {
+    RecordingWriter writer(STYLUS_DESCRIPTION);
+    const auto writePosition = [&writer](int32_t x, int32_t y) {
+        writer.event(EV_ABS, ABS_X, x);
+        writer.event(EV_ABS, ABS_Y, y);
+    };
+    writer.event(EV_KEY, BTN_TOOL_PEN, 1);
+    writer.event(EV_ABS, ABS_DISTANCE, 20);
+    writePosition(100, 100);
+    writer.sync();
+    for (int32_t frame = 0; frame < 100; frame++) {
+        writePosition(100 + 4 * frame, 100 + 5 * frame);
+        writer.sync();
+    }
+    writer.event(EV_KEY, BTN_TOUCH, 1);
+    writer.event(EV_ABS, ABS_DISTANCE, 0);
+    writer.event(EV_ABS, ABS_PRESSURE, 2000);
+    writer.sync();
+    for (int32_t frame = 0; frame < 20; frame++) {
+        writePosition(500 - 4 * frame, 600);
+        writer.sync();
+    }
+    writer.event(EV_KEY, BTN_TOUCH, 0);
+    writer.event(EV_ABS, ABS_DISTANCE, 20);
+    writer.event(EV_ABS, ABS_PRESSURE, 0);
+    writer.sync();
+    for (int32_t frame = 0; frame < 20; frame++) {
+        writePosition(420, 600 - 5 * frame);
+        writer.sync();
+    }
+    writer.event(EV_KEY, BTN_TOOL_PEN, 0);
+    writer.sync();
+    return writer.getText();
+}
+
+// --- Pipeline ---
+
+// Stands in for the system policy, which lets the events through to the apps while the display is
+// on.
+class ReplayDispatcherPolicy : public FakeInputDispatcherPolicy {
+private:
+    void interceptMotionBeforeQueueing(int32_t, uint32_t, int32_t, nsecs_t,
+                                       uint32_t& policyFlags) override {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
+    }
+};
+
+class ReplayChoreographerPolicy : public PointerChoreographerPolicyInterface {
+public:
+    std::shared_ptr<PointerControllerInterface> createPointerController(
+            PointerControllerInterface::ControllerType) override {
+        return std::make_shared<FakePointerController>();
+    }
+
+    void notifyPointerDisplayIdChanged(int32_t, const FloatPoint&) override {}
+};
+
+// Makes the loop of the reader thread callable from the benchmark, so that every frame can be
+// processed as soon as it is enqueued.
+class ReplayInputReader : public InputReader {
+public:
+    using InputReader::InputReader;
+    using InputReader::loopOnce;
+};
+
+/**
+ * Forwards everything to the next stage of the pipeline, and measures how long that stage takes,
+ * including the stages after it.
+ */
+class TimedInputListener : public InputListenerInterface {
+public:
+    explicit TimedInputListener(InputListenerInterface& innerListener)
+          : mInnerListener(innerListener) {}
+
+    void notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs& args) override {
+        timed([&]() { mInnerListener.notifyInputDevicesChanged(args); });
+    }
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs& args) override {
+        timed([&]() { mInnerListener.notifyConfigurationChanged(args); });
+    }
+    void notifyKey(const NotifyKeyArgs& args) override {
+        mNumEvents++;
+        timed([&]() { mInnerListener.notifyKey(args); });
+    }
+    void notifyMotion(const NotifyMotionArgs& args) override {
+        mNumEvents++;
+        timed([&]() { mInnerListener.notifyMotion(args); });
+    }
+    void notifySwitch(const NotifySwitchArgs& args) override {
+        timed([&]() { mInnerListener.notifySwitch(args); });
+    }
+    void notifySensor(const NotifySensorArgs& args) override {
+        timed([&]() { mInnerListener.notifySensor(args); });
+    }
+    void notifyVibratorState(const NotifyVibratorStateArgs& args) override {
+        timed([&]() { mInnerListener.notifyVibratorState(args); });
+    }
+    void notifyDeviceReset(const NotifyDeviceResetArgs& args) override {
+        timed([&]() { mInnerListener.notifyDeviceReset(args); });
+    }
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs& args) override {
+        timed([&]() { mInnerListener.notifyPointerCaptureChanged(args); });
+    }
+
+    // The total time spent in the next stages.
+    nsecs_t getTime() const { return mTime; }
+    // The number of key and motion events that were passed on to the next stage.
+    size_t getNumEvents() const { return mNumEvents; }
+
+private:
+    InputListenerInterface& mInnerListener;
+    nsecs_t mTime = 0;
+    size_t mNumEvents = 0;
+
+    template <typename F>
+    void timed(F&& notify) {
+        const nsecs_t start = now();
+        notify();
+        mTime += now() - start;
+    }
+};
+
+// What replaying a recording cost, summed over all of the replays.
+struct ReplayStats {
+    size_t frames = 0;
+    size_t events = 0;
+    // The time spent in each stage, excluding the stages after it.
+    nsecs_t readerTime = 0;
+    nsecs_t blockerTime = 0;
+    nsecs_t choreographerTime = 0;
+    nsecs_t dispatcherEnqueueTime = 0;
+    // From the end of InputReader::loopOnce until the window has received the events of a frame.
+    nsecs_t deliveryTime = 0;
+    // From the frame being enqueued in the EventHub until the window has received its events.
+    LatencyHistogram endToEnd;
+
+    void report(benchmark::State& state) const {
+        const auto perFrameUs = [this](nsecs_t time) {
+            return frames == 0 ? 0 : time * 1E-3 / frames;
+        };
+        state.counters["reader_us"] = perFrameUs(readerTime);
+        state.counters["blocker_us"] = perFrameUs(blockerTime);
+        state.counters["choreographer_us"] = perFrameUs(choreographerTime);
+        state.counters["dispatcher_enqueue_us"] = perFrameUs(dispatcherEnqueueTime);
+        state.counters["delivery_us"] = perFrameUs(deliveryTime);
+        state.counters["end_to_end_p50_us"] = endToEnd.percentile(0.5) * 1E-3;
+        state.counters["end_to_end_p99_us"] = endToEnd.percentile(0.99) * 1E-3;
+    }
+};
+
+/**
+ * The input pipeline, connected the same way as in the InputManager, without the stages that
+ * need a HAL or the system server. The InputReader runs on the calling thread, and the
+ * InputDispatcher on its own thread.
+ */
+class InputPipeline {
+public:
+    InputPipeline()
+          : mEventHub(std::make_shared<FakeEventHub>()),
+            mReaderPolicy(sp<FakeInputReaderPolicy>::make()),
+            mDispatcher(mDispatcherPolicy),
+            mToDispatcher(mDispatcher),
+            mChoreographer(mToDispatcher, mChoreographerPolicy),
+            mToChoreographer(mChoreographer),
+            mBlocker(mToChoreographer),
+            mToBlocker(mBlocker) {
+        mReaderPolicy->addDisplayViewport(DISPLAY_ID, DISPLAY_WIDTH, DISPLAY_HEIGHT,
+                                          ui::ROTATION_0, /*isActive=*/true, "local:0",
+                                          /*physicalPort=*/std::nullopt, ViewportType::INTERNAL);
+        mChoreographer.setDisplayViewports(
+                {*mReaderPolicy->getDisplayViewportByType(ViewportType::INTERNAL)});
+        mReader = std::make_unique<ReplayInputReader>(mEventHub, mReaderPolicy, mToBlocker);
+
+        mDispatcher.setInputDispatchMode(/*enabled=*/true, /*frozen=*/false);
+        mDispatcher.start();
+        std::shared_ptr<FakeApplicationHandle> application =
+                std::make_shared<FakeApplicationHandle>();
+        mWindow = sp<FakeWindowHandle>::make(application, mDispatcher, "Fake Window", DISPLAY_ID);
+        mDispatcher.onWindowInfosChanged({{*mWindow->getInfo()}, {}, 0, 0});
+    }
+
+    ~InputPipeline() { mDispatcher.stop(); }
+
+    Result<void> addDevice(const EvemuRecording& recording) {
+        ftl::Flags<InputDeviceClass> classes;
+        if (recording.hasAbsoluteAxis(ABS_MT_POSITION_X) &&
+            recording.hasAbsoluteAxis(ABS_MT_POSITION_Y)) {
+            classes = ftl::Flags<InputDeviceClass>(InputDeviceClass::TOUCH) |
+                    InputDeviceClass::TOUCH_MT;
+        } else if (recording.hasAbsoluteAxis(ABS_X) && recording.hasAbsoluteAxis(ABS_Y) &&
+                   recording.keys.test(BTN_TOUCH)) {
+            classes = InputDeviceClass::TOUCH;
+        }
+        if (!classes.test(InputDeviceClass::TOUCH) ||
+            !recording.properties.test(INPUT_PROP_DIRECT)) {
+            return base::Error() << "'" << recording.name
+                                 << "' is not a touchscreen or a stylus, which is not supported";
+        }
+
+        mEventHub->addDevice(EVENTHUB_ID, recording.name, classes, recording.bus);
+        // The FakeEventHub doesn't report input properties, so configure the device the same way
+        // that INPUT_PROP_DIRECT would.
+        mEventHub->addConfigurationProperty(EVENTHUB_ID, "touch.deviceType", "touchScreen");
+        for (const EvemuRecording::AbsoluteAxis& axis : recording.absoluteAxes) {
+            mEventHub->addAbsoluteAxis(EVENTHUB_ID, axis.code, axis.minValue, axis.maxValue,
+                                       axis.flat, axis.fuzz, axis.resolution);
+        }
+        for (size_t scanCode = 0; scanCode < recording.keys.size(); scanCode++) {
+            if (recording.keys.test(scanCode)) {
+                mEventHub->addKey(EVENTHUB_ID, scanCode, /*usageCode=*/0, AKEYCODE_UNKNOWN,
+                                  /*flags=*/0);
+            }
+        }
+        initializeMtSlots(recording);
+        mEventHub->finishDeviceScan();
+        mReader->loopOnce();
+
+        const std::vector<InputDeviceInfo> devices = mReader->getInputDevices();
+        if (devices.empty() ||
+            !(devices[0].getSources() & (AINPUT_SOURCE_TOUCHSCREEN | AINPUT_SOURCE_STYLUS))) {
+            return base::Error() << "'" << recording.name << "' was not configured as a "
+                                 << "touchscreen";
+        }
+        return {};
+    }
+
+    Result<void> replay(const EvemuRecording& recording, ReplayStats& stats) {
+        for (const std::vector<EvemuRecording::Event>& frame : recording.frames) {
+            const nsecs_t readerStart = mToBlocker.getTime();
+            const nsecs_t blockerStart = mToChoreographer.getTime();
+            const nsecs_t choreographerStart = mToDispatcher.getTime();
+
+            const nsecs_t start = now();
+            for (const EvemuRecording::Event& event : frame) {
+                mEventHub->enqueueEvent(start, start, EVENTHUB_ID, event.type, event.code,
+                                        event.value);
+            }
+            mReader->loopOnce();
+            const nsecs_t readDone = now();
+            if (!consumeAll()) {
+                return base::Error() << "The window did not receive all of the events";
+            }
+            const nsecs_t end = now();
+
+            const nsecs_t blockerInclusive = mToBlocker.getTime() - readerStart;
+            const nsecs_t choreographerInclusive = mToChoreographer.getTime() - blockerStart;
+            const nsecs_t dispatcherInclusive = mToDispatcher.getTime() - choreographerStart;
+            stats.readerTime += (readDone - start) - blockerInclusive;
+            stats.blockerTime += blockerInclusive - choreographerInclusive;
+            stats.choreographerTime += choreographerInclusive - dispatcherInclusive;
+            stats.dispatcherEnqueueTime += dispatcherInclusive;
+            stats.deliveryTime += end - readDone;
+            stats.endToEnd.add(end - start);
+            stats.frames++;
+        }
+        stats.events = mToDispatcher.getNumEvents();
+        return {};
+    }
+
+private:
+    std::shared_ptr<FakeEventHub> mEventHub;
+    sp<FakeInputReaderPolicy> mReaderPolicy;
+    ReplayDispatcherPolicy mDispatcherPolicy;
+    InputDispatcher mDispatcher;
+    TimedInputListener mToDispatcher;
+    ReplayChoreographerPolicy mChoreographerPolicy;
+    PointerChoreographer mChoreographer;
+    TimedInputListener mToChoreographer;
+    UnwantedInteractionBlocker mBlocker;
+    TimedInputListener mToBlocker;
+    std::unique_ptr<ReplayInputReader> mReader;
+    sp<FakeWindowHandle> mWindow;
+    // The number of samples that the window received, counting every sample of a batch.
+    size_t mNumConsumedSamples = 0;
+
+    // The reader queries the state of all the slots when the device is configured.
+    void initializeMtSlots(const EvemuRecording& recording) {
+        const auto slotAxis =
+                std::find_if(recording.absoluteAxes.begin(), recording.absoluteAxes.end(),
+                             [](const auto& axis) { return axis.code == ABS_MT_SLOT; });
+        if (slotAxis == recording.absoluteAxes.end()) {
+            return;
+        }
+        const size_t numSlots = slotAxis->maxValue + 1;
+        for (const EvemuRecording::AbsoluteAxis& axis : recording.absoluteAxes) {
+            if (axis.code >= ABS_MT_TOUCH_MAJOR && axis.code <= ABS_MT_TOOL_Y) {
+                const int32_t value = axis.code == ABS_MT_TRACKING_ID ? -1 : 0;
+                mEventHub->setMtSlotValues(EVENTHUB_ID, axis.code,
+                                           std::vector<int32_t>(numSlots, value));
+            }
+        }
+    }
+
+    // Consumes events until the window has received at least as many samples as were sent to the
+    // dispatcher. The dispatcher may add some events of its own, like hover enter and exit, in
+    // which case the extra events are consumed along with those of the following frames.
+    bool consumeAll() {
+        while (mNumConsumedSamples < mToDispatcher.getNumEvents()) {
+            std::unique_ptr<InputEvent> event = mWindow->consume(CONSUME_TIMEOUT);
+            if (event == nullptr) {
+                return false;
+            }
+            if (event->getType() == InputEventType::MOTION) {
+                mNumConsumedSamples += static_cast<MotionEvent&>(*event).getHistorySize() + 1;
+            } else {
+                mNumConsumedSamples++;
+            }
+        }
+        return true;
+    }
+};
+
+void benchmarkReplay(benchmark::State& state, const EvemuRecording& recording) {
+    InputPipeline pipeline;
+    if (Result<void> result = pipeline.addDevice(recording); !result.ok()) {
+        state.SkipWithError(result.error().message().c_str());
+        return;
+    }
+
+    // Warm up the pipeline, and find out how many events it produces for one replay.
+    ReplayStats warmUpStats;
+    if (Result<void> result = pipeline.replay(recording, warmUpStats); !result.ok()) {
+        state.SkipWithError(result.error().message().c_str());
+        return;
+    }
+    const size_t eventsPerReplay = warmUpStats.events;
+    if (eventsPerReplay == 0) {
+        state.SkipWithError("The recording did not produce any events");
+        return;
+    }
+
+    ReplayStats stats;
+    {
+        AllocationCounter allocationCounter(state, eventsPerReplay);
+        for (auto _ : state) {
+            if (Result<void> result = pipeline.replay(recording, stats); !result.ok()) {
+                state.SkipWithError(result.error().message().c_str());
+                break;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * eventsPerReplay);
+    stats.report(state);
+}
+
+void registerReplayBenchmark(const std::string& name, const EvemuRecording& recording) {
+    benchmark::RegisterBenchmark(("benchmarkReplay/" + name).c_str(),
+                                 [recording](benchmark::State& state) {
+                                     benchmarkReplay(state, recording);
+                                 });
+}
+
+bool registerReplayBenchmarks() {
+    const std::vector<std::pair<std::string, std::string>> builtInRecordings = {
+            {"ten_finger", createTenFingerRecording()},
+            {"pinch", createPinchRecording()},
+            {"stylus_hover", createStylusHoverRecording()},
+    };
+    for (const auto& [name, text] : builtInRecordings) {
+        std::istringstream in(text);
+        Result<EvemuRecording> recording = EvemuRecording::parse(in);
+        LOG_IF(FATAL, !recording.ok())
+                << "Invalid built-in recording " << name << ": " << recording.error();
+        registerReplayBenchmark(name, *recording);
+    }
+
+    const char* paths = getenv(RECORDINGS_ENV);
+    if (paths == nullptr) {
+        return true;
+    }
+    for (const std::string& path : base::Split(paths, ":")) {
+        if (path.empty()) {
+            continue;
+        }
+        Result<EvemuRecording> recording = EvemuRecording::readFile(path);
+        if (!recording.ok()) {
+            LOG(ERROR) << "Skipping " << path << ": " << recording.error();
+            continue;
+        }
+        registerReplayBenchmark(base::Basename(path), *recording);
+    }
+    return true;
+}
+
+[[maybe_unused]] const bool gReplayBenchmarksRegistered = registerReplayBenchmarks();
+
+} // namespace
+
+} // namespace android
@@ -29,8 +29,8 @@ struct DragState {
           : dragWindow(windowHandle), pointerId(pointerId) {}
     void dump(std::string& dump, const char* prefix = "");
 
-    // The window being dragged.
-    const sp<android::gui::WindowInfoHandle> dragWindow;
+    // The window being dragged. Switched to the new handle of the window on every window update.
+    sp<android::gui::WindowInfoHandle> dragWindow;
     // The last drag hover window which could receive the drag event.
     sp<android::gui::WindowInfoHandle> dragHoverWindowHandle;
     // Indicates the if received first event to check for button state.
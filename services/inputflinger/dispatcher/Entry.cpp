@@ -206,9 +206,17 @@ MotionEntry::MotionEntry(int32_t id, std::shared_ptr<InjectionState> injectionSt
         xCursorPosition(xCursorPosition),
         yCursorPosition(yCursorPosition),
         downTime(downTime),
-        pointerProperties(pointerProperties),
-        pointerCoords(pointerCoords) {
+        pointerProperties(EntryPool::obtainPointerProperties()),
+        pointerCoords(EntryPool::obtainPointerCoords()) {
     EventEntry::injectionState = std::move(injectionState);
+    // Copy into the recycled arrays, which usually have enough capacity already.
+    this->pointerProperties.assign(pointerProperties.begin(), pointerProperties.end());
+    this->pointerCoords.assign(pointerCoords.begin(), pointerCoords.end());
+}
+
+MotionEntry::~MotionEntry() {
+    EntryPool::recycle(std::move(pointerProperties));
+    EntryPool::recycle(std::move(pointerCoords));
 }
 
 std::string MotionEntry::getDescription() const {
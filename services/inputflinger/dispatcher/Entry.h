@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "EntryPool.h"
 #include "InjectionState.h"
 #include "InputTargetFlags.h"
 #include "trace/EventTrackerInterface.h"
@@ -76,6 +77,11 @@ struct EventEntry {
     EventEntry(const EventEntry&) = delete;
     EventEntry& operator=(const EventEntry&) = delete;
     virtual ~EventEntry() = default;
+
+    // Entries are allocated from EntryPool. The destructor is virtual, so 'size' is the size of
+    // the most derived type.
+    static void* operator new(size_t size) { return EntryPool::allocate(size); }
+    static void operator delete(void* ptr, size_t size) { EntryPool::deallocate(ptr, size); }
 };
 
 struct ConfigurationChangedEntry : EventEntry {
@@ -180,6 +186,7 @@ struct MotionEntry : EventEntry {
                 float xPrecision, float yPrecision, float xCursorPosition, float yCursorPosition,
                 nsecs_t downTime, const std::vector<PointerProperties>& pointerProperties,
                 const std::vector<PointerCoords>& pointerCoords);
+    ~MotionEntry() override;
     std::string getDescription() const override;
 };
 
@@ -243,6 +250,9 @@ struct DispatchEntry {
     DispatchEntry(const DispatchEntry&) = delete;
     DispatchEntry& operator=(const DispatchEntry&) = delete;
 
+    static void* operator new(size_t size) { return EntryPool::allocate(size); }
+    static void operator delete(void* ptr, size_t size) { EntryPool::deallocate(ptr, size); }
+
     inline bool hasForegroundTarget() const {
         return targetFlags.test(InputTargetFlags::FOREGROUND);
     }
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputDispatcher"
+
+#include "EntryPool.h"
+
+#include <android-base/thread_annotations.h>
+
+#include <array>
+#include <mutex>
+#include <new>
+
+namespace android::inputdispatcher {
+
+namespace {
+
+constexpr size_t SIZE_CLASS_GRANULARITY = 32;
+constexpr size_t NUM_SIZE_CLASSES = EntryPool::kMaxPooledSize / SIZE_CLASS_GRANULARITY;
+
+// Enough for a burst of events queued behind an unresponsive window, without holding on to an
+// unbounded amount of memory afterwards.
+constexpr size_t MAX_FREE_BLOCKS_PER_CLASS = 256;
+constexpr size_t MAX_FREE_VECTORS = 256;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+template <typename T>
+struct VectorPool {
+    std::mutex lock;
+    std::vector<std::vector<T>> free GUARDED_BY(lock);
+};
+
+struct Pools {
+    std::mutex lock;
+    std::array<FreeBlock*, NUM_SIZE_CLASSES> freeBlocks GUARDED_BY(lock) = {};
+    std::array<size_t, NUM_SIZE_CLASSES> numFreeBlocks GUARDED_BY(lock) = {};
+
+    VectorPool<PointerProperties> pointerProperties;
+    VectorPool<PointerCoords> pointerCoords;
+};
+
+Pools& pools() {
+    // Never destroyed, since entries can outlive static destructors.
+    static Pools* pools = new Pools();
+    return *pools;
+}
+
+size_t sizeClassOf(size_t size) {
+    return (size + SIZE_CLASS_GRANULARITY - 1) / SIZE_CLASS_GRANULARITY - 1;
+}
+
+template <typename T>
+std::vector<T> obtain(VectorPool<T>& pool) {
+    std::scoped_lock _l(pool.lock);
+    if (pool.free.empty()) {
+        return {};
+    }
+    std::vector<T> vector = std::move(pool.free.back());
+    pool.free.pop_back();
+    return vector;
+}
+
+template <typename T>
+size_t countFree(VectorPool<T>& pool) {
+    std::scoped_lock _l(pool.lock);
+    return pool.free.size();
+}
+
+template <typename T>
+void recycleInto(VectorPool<T>& pool, std::vector<T>&& vector) {
+    // Don't keep the large arrays of an unusual event around.
+    if (vector.capacity() == 0 || vector.capacity() > MAX_POINTERS) {
+        return;
+    }
+    vector.clear();
+    std::scoped_lock _l(pool.lock);
+    if (pool.free.size() < MAX_FREE_VECTORS) {
+        pool.free.push_back(std::move(vector));
+    }
+}
+
+} // namespace
+
+void* EntryPool::allocate(size_t size) {
+    if (size == 0 || size > kMaxPooledSize) {
+        return ::operator new(size);
+    }
+    const size_t sizeClass = sizeClassOf(size);
+    Pools& p = pools();
+    {
+        std::scoped_lock _l(p.lock);
+        if (FreeBlock* block = p.freeBlocks[sizeClass]; block != nullptr) {
+            p.freeBlocks[sizeClass] = block->next;
+            p.numFreeBlocks[sizeClass]--;
+            return block;
+        }
+    }
+    return ::operator new((sizeClass + 1) * SIZE_CLASS_GRANULARITY);
+}
+
+void EntryPool::deallocate(void* ptr, size_t size) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (size == 0 || size > kMaxPooledSize) {
+        ::operator delete(ptr);
+        return;
+    }
+    const size_t sizeClass = sizeClassOf(size);
+    Pools& p = pools();
+    {
+        std::scoped_lock _l(p.lock);
+        if (p.numFreeBlocks[sizeClass] < MAX_FREE_BLOCKS_PER_CLASS) {
+            FreeBlock* block = new (ptr) FreeBlock{p.freeBlocks[sizeClass]};
+            p.freeBlocks[sizeClass] = block;
+            p.numFreeBlocks[sizeClass]++;
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
+std::vector<PointerProperties> EntryPool::obtainPointerProperties() {
+    return obtain(pools().pointerProperties);
+}
+
+std::vector<PointerCoords> EntryPool::obtainPointerCoords() {
+    return obtain(pools().pointerCoords);
+}
+
+void EntryPool::recycle(std::vector<PointerProperties>&& pointerProperties) {
+    recycleInto(pools().pointerProperties, std::move(pointerProperties));
+}
+
+void EntryPool::recycle(std::vector<PointerCoords>&& pointerCoords) {
+    recycleInto(pools().pointerCoords, std::move(pointerCoords));
+}
+
+EntryPool::Stats EntryPool::getStats() {
+    Pools& p = pools();
+    size_t freeBlocks = 0;
+    {
+        std::scoped_lock _l(p.lock);
+        for (size_t count : p.numFreeBlocks) {
+            freeBlocks += count;
+        }
+    }
+    return {.freeBlocks = freeBlocks,
+            .freePointerProperties = countFree(p.pointerProperties),
+            .freePointerCoords = countFree(p.pointerCoords)};
+}
+
+void EntryPool::trim() {
+    Pools& p = pools();
+    {
+        std::scoped_lock _l(p.lock);
+        for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+            while (FreeBlock* block = p.freeBlocks[i]) {
+                p.freeBlocks[i] = block->next;
+                ::operator delete(block);
+            }
+            p.numFreeBlocks[i] = 0;
+        }
+    }
+    {
+        std::scoped_lock _l(p.pointerProperties.lock);
+        p.pointerProperties.free.clear();
+    }
+    {
+        std::scoped_lock _l(p.pointerCoords.lock);
+        p.pointerCoords.free.clear();
+    }
+}
+
+} // namespace android::inputdispatcher
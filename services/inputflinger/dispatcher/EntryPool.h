@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <input/Input.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * Recycles the memory of the entries and the pointer arrays that are created for every event going
+ * through the dispatcher, so that dispatching doesn't go through malloc once it reaches a steady
+ * state.
+ *
+ * Entries are usually created on the reader thread and destroyed on the dispatcher thread, so the
+ * free lists are shared between threads. Each free list is bounded, and blocks beyond that go back
+ * to the heap.
+ */
+class EntryPool {
+public:
+    // Backs operator new and delete of the entries. Sizes above kMaxPooledSize use the heap.
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+
+    // Empty vectors that may have capacity left from an earlier entry.
+    static std::vector<PointerProperties> obtainPointerProperties();
+    static std::vector<PointerCoords> obtainPointerCoords();
+    static void recycle(std::vector<PointerProperties>&& pointerProperties);
+    static void recycle(std::vector<PointerCoords>&& pointerCoords);
+
+    // What the pool currently holds, ready to be reused.
+    struct Stats {
+        size_t freeBlocks;
+        size_t freePointerProperties;
+        size_t freePointerCoords;
+    };
+    static Stats getStats();
+
+    // Returns all the free memory to the heap.
+    static void trim();
+
+    static constexpr size_t kMaxPooledSize = 512;
+
+private:
+    EntryPool() = delete;
+};
+
+} // namespace android::inputdispatcher
@@ -399,7 +399,9 @@ std::unique_ptr<DispatchEntry> createDispatchEntry(const IdGenerator& idGenerato
     ALOG_ASSERT(eventEntry->type == EventEntry::Type::MOTION);
     const MotionEntry& motionEntry = static_cast<const MotionEntry&>(*eventEntry);
 
-    std::vector<PointerCoords> pointerCoords{motionEntry.getPointerCount()};
+    // Scratch array, which is copied into the combined entry.
+    std::vector<PointerCoords> pointerCoords = EntryPool::obtainPointerCoords();
+    pointerCoords.resize(motionEntry.getPointerCount());
 
     const ui::Transform* transform = &kIdentityTransform;
     const ui::Transform* displayTransform = &kIdentityTransform;
@@ -442,6 +444,7 @@ std::unique_ptr<DispatchEntry> createDispatchEntry(const IdGenerator& idGenerato
                                           motionEntry.xCursorPosition, motionEntry.yCursorPosition,
                                           motionEntry.downTime, motionEntry.pointerProperties,
                                           pointerCoords);
+    EntryPool::recycle(std::move(pointerCoords));
 
     std::unique_ptr<DispatchEntry> dispatchEntry =
             std::make_unique<DispatchEntry>(std::move(combinedMotionEntry), inputTargetFlags,
@@ -804,6 +807,32 @@ Result<void> validateWindowInfosUpdate(const gui::WindowInfosUpdate& update) {
     return {};
 }
 
+// Checks a window from a window infos update. Only uses the window itself, so it can run before
+// the update is applied.
+void validateWindowHandle(const sp<WindowInfoHandle>& window) {
+    const WindowInfo& info = *window->getInfo();
+
+    // Ensure all tokens are null if the window has feature NO_INPUT_CHANNEL
+    const bool noInputWindow = info.inputConfig.test(WindowInfo::InputConfig::NO_INPUT_CHANNEL);
+    if (noInputWindow && window->getToken() != nullptr) {
+        ALOGE("%s has feature NO_INPUT_WINDOW, but a non-null token. Clearing",
+              window->getName().c_str());
+        window->releaseChannel();
+    }
+
+    // Ensure all spy windows are trusted overlays
+    LOG_ALWAYS_FATAL_IF(info.isSpy() &&
+                                !info.inputConfig.test(WindowInfo::InputConfig::TRUSTED_OVERLAY),
+                        "%s has feature SPY, but is not a trusted overlay.",
+                        window->getName().c_str());
+
+    // Ensure all stylus interceptors are trusted overlays
+    LOG_ALWAYS_FATAL_IF(info.interceptsStylus() &&
+                                !info.inputConfig.test(WindowInfo::InputConfig::TRUSTED_OVERLAY),
+                        "%s has feature INTERCEPTS_STYLUS, but is not a trusted overlay.",
+                        window->getName().c_str());
+}
+
 int32_t getUserActivityEventType(const EventEntry& eventEntry) {
     switch (eventEntry.type) {
         case EventEntry::Type::KEY: {
@@ -864,6 +893,9 @@ InputDispatcher::InputDispatcher(InputDispatcherPolicyInterface& policy,
     mLooper = sp<Looper>::make(false);
     mReporter = createInputReporter();
 
+    mWindowInfos = std::make_shared<const WindowInfosSnapshot>();
+    mPublishedWindowInfos = mWindowInfos;
+
     mWindowInfoListener = sp<DispatcherWindowListener>::make(*this);
 #if defined(__ANDROID__)
     SurfaceComposerClient::getDefault()->addWindowInfosListener(mWindowInfoListener);
@@ -1357,14 +1389,15 @@ sp<WindowInfoHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t displayI
                                                                 bool ignoreDragWindow) const {
     // Traverse windows from front to back to find touched window.
     const auto& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
+    const ui::Transform transform = getTransformLocked(displayId);
+    for (size_t i : getWindowHitIndexLocked(displayId).candidatesAt(transform.transform(x, y))) {
+        const sp<WindowInfoHandle>& windowHandle = windowHandles[i];
         if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
             continue;
         }
 
         const WindowInfo& info = *windowHandle->getInfo();
-        if (!info.isSpy() &&
-            windowAcceptsTouchAt(info, displayId, x, y, isStylus, getTransformLocked(displayId))) {
+        if (!info.isSpy() && windowAcceptsTouchAt(info, displayId, x, y, isStylus, transform)) {
             return windowHandle;
         }
     }
@@ -1403,10 +1436,12 @@ std::vector<sp<WindowInfoHandle>> InputDispatcher::findTouchedSpyWindowsAtLocked
     // Traverse windows from front to back and gather the touched spy windows.
     std::vector<sp<WindowInfoHandle>> spyWindows;
     const auto& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
+    const ui::Transform transform = getTransformLocked(displayId);
+    for (size_t i : getWindowHitIndexLocked(displayId).candidatesAt(transform.transform(x, y))) {
+        const sp<WindowInfoHandle>& windowHandle = windowHandles[i];
         const WindowInfo& info = *windowHandle->getInfo();
 
-        if (!windowAcceptsTouchAt(info, displayId, x, y, isStylus, getTransformLocked(displayId))) {
+        if (!windowAcceptsTouchAt(info, displayId, x, y, isStylus, transform)) {
             continue;
         }
         if (!info.isSpy()) {
@@ -2884,9 +2919,10 @@ std::optional<InputTarget> InputDispatcher::createInputTargetLocked(
     inputTarget.flags = targetFlags;
     inputTarget.globalScaleFactor = windowHandle->getInfo()->globalScaleFactor;
     inputTarget.firstDownTimeInTarget = firstDownTimeInTarget;
-    const auto& displayInfoIt = mDisplayInfos.find(windowHandle->getInfo()->displayId);
-    if (displayInfoIt != mDisplayInfos.end()) {
-        inputTarget.displayTransform = displayInfoIt->second.transform;
+    if (const gui::DisplayInfo* displayInfo =
+                mWindowInfos->getDisplayInfo(windowHandle->getInfo()->displayId);
+        displayInfo != nullptr) {
+        inputTarget.displayTransform = displayInfo->transform;
     } else {
         // DisplayInfo not found for this window on display windowHandle->getInfo()->displayId.
         // TODO(b/198444055): Make this an error message after 'setInputWindows' API is removed.
@@ -2994,8 +3030,9 @@ void InputDispatcher::addGlobalMonitoringTargetsLocked(std::vector<InputTarget>&
         InputTarget target{monitor.connection};
         // target.firstDownTimeInTarget is not set for global monitors. It is only required in split
         // touch and global monitoring works as intended even without setting firstDownTimeInTarget
-        if (const auto& it = mDisplayInfos.find(displayId); it != mDisplayInfos.end()) {
-            target.displayTransform = it->second.transform;
+        if (const gui::DisplayInfo* displayInfo = mWindowInfos->getDisplayInfo(displayId);
+            displayInfo != nullptr) {
+            target.displayTransform = displayInfo->transform;
         }
         target.setDefaultPointerTransform(target.displayTransform);
         inputTargets.push_back(target);
@@ -3065,10 +3102,13 @@ InputDispatcher::TouchOcclusionInfo InputDispatcher::computeTouchOcclusionInfoLo
     info.obscuringOpacity = 0;
     info.obscuringUid = gui::Uid::INVALID;
     std::map<gui::Uid, float> opacityByUid;
-    for (const sp<WindowInfoHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
+    const WindowHitIndex& hitIndex = getWindowHitIndexLocked(displayId);
+    const size_t windowIndex = hitIndex.indexOf(windowHandles, windowHandle);
+    for (size_t i : hitIndex.candidatesAt(getTransformLocked(displayId).transform(x, y))) {
+        if (i >= windowIndex) {
             break; // All future windows are below us. Exit early.
         }
+        const sp<WindowInfoHandle>& otherHandle = windowHandles[i];
         const WindowInfo* otherInfo = otherHandle->getInfo();
         if (canBeObscuredBy(windowHandle, otherHandle) && otherInfo->frameContainsPoint(x, y) &&
             !haveSameApplicationToken(windowInfo, otherInfo)) {
@@ -3143,10 +3183,13 @@ bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<WindowInfoHandle>&
                                                     int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
     const std::vector<sp<WindowInfoHandle>>& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<WindowInfoHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
+    const WindowHitIndex& hitIndex = getWindowHitIndexLocked(displayId);
+    const size_t windowIndex = hitIndex.indexOf(windowHandles, windowHandle);
+    for (size_t i : hitIndex.candidatesAt(getTransformLocked(displayId).transform(x, y))) {
+        if (i >= windowIndex) {
             break; // All future windows are below us. Exit early.
         }
+        const sp<WindowInfoHandle>& otherHandle = windowHandles[i];
         const WindowInfo* otherInfo = otherHandle->getInfo();
         if (canBeObscuredBy(windowHandle, otherHandle) &&
             otherInfo->frameContainsPoint(x, y)) {
@@ -4034,7 +4077,7 @@ void InputDispatcher::synthesizeCancelationEventsForAllConnectionsLocked(
     // Follow up by generating cancellations for all windows, because we don't explicitly track
     // the windows that have an ongoing focus event stream.
     if (cancelNonPointers) {
-        for (const auto& [_, handles] : mWindowHandlesByDisplay) {
+        for (const auto& [_, handles] : mWindowInfos->getWindowHandlesByDisplay()) {
             for (const auto& windowHandle : handles) {
                 synthesizeCancelationEventsForWindowLocked(windowHandle, options);
             }
@@ -4152,10 +4195,11 @@ void InputDispatcher::synthesizeCancelationEventsForConnectionLocked(
                                                  motionEntry.downTime, targets);
                 } else {
                     targets.emplace_back(fallbackTarget);
-                    const auto it = mDisplayInfos.find(motionEntry.displayId);
-                    if (it != mDisplayInfos.end()) {
-                        targets.back().displayTransform = it->second.transform;
-                        targets.back().setDefaultPointerTransform(it->second.transform);
+                    if (const gui::DisplayInfo* displayInfo =
+                                mWindowInfos->getDisplayInfo(motionEntry.displayId);
+                        displayInfo != nullptr) {
+                        targets.back().displayTransform = displayInfo->transform;
+                        targets.back().setDefaultPointerTransform(displayInfo->transform);
                     }
                 }
                 logOutboundMotionDetails("cancel - ", motionEntry);
@@ -4231,10 +4275,11 @@ void InputDispatcher::synthesizePointerDownEventsForConnectionLocked(
                                                  targets);
                 } else {
                     targets.emplace_back(connection, targetFlags);
-                    const auto it = mDisplayInfos.find(motionEntry.displayId);
-                    if (it != mDisplayInfos.end()) {
-                        targets.back().displayTransform = it->second.transform;
-                        targets.back().setDefaultPointerTransform(it->second.transform);
+                    if (const gui::DisplayInfo* displayInfo =
+                                mWindowInfos->getDisplayInfo(motionEntry.displayId);
+                        displayInfo != nullptr) {
+                        targets.back().displayTransform = displayInfo->transform;
+                        targets.back().setDefaultPointerTransform(displayInfo->transform);
                     }
                 }
                 logOutboundMotionDetails("down - ", motionEntry);
@@ -4271,8 +4316,9 @@ std::unique_ptr<MotionEntry> InputDispatcher::splitMotionEvent(
     ALOG_ASSERT(pointerIds.any());
 
     uint32_t splitPointerIndexMap[MAX_POINTERS];
-    std::vector<PointerProperties> splitPointerProperties;
-    std::vector<PointerCoords> splitPointerCoords;
+    // Scratch arrays, which are copied into the split entry.
+    std::vector<PointerProperties> splitPointerProperties = EntryPool::obtainPointerProperties();
+    std::vector<PointerCoords> splitPointerCoords = EntryPool::obtainPointerCoords();
 
     uint32_t originalPointerCount = originalMotionEntry.getPointerCount();
     uint32_t splitPointerCount = 0;
@@ -4300,6 +4346,8 @@ std::unique_ptr<MotionEntry> InputDispatcher::splitMotionEvent(
               "we expected there to be %zu pointers.  This probably means we received "
               "a broken sequence of pointer ids from the input device: %s",
               splitPointerCount, pointerIds.count(), originalMotionEntry.getDescription().c_str());
+        EntryPool::recycle(std::move(splitPointerProperties));
+        EntryPool::recycle(std::move(splitPointerCoords));
         return nullptr;
     }
 
@@ -4362,6 +4410,8 @@ std::unique_ptr<MotionEntry> InputDispatcher::splitMotionEvent(
                                           originalMotionEntry.xCursorPosition,
                                           originalMotionEntry.yCursorPosition, splitDownTime,
                                           splitPointerProperties, splitPointerCoords);
+    EntryPool::recycle(std::move(splitPointerProperties));
+    EntryPool::recycle(std::move(splitPointerCoords));
 
     return splitMotionEntry;
 }
@@ -4549,13 +4599,11 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs& args) {
         }
 
         if (shouldSendMotionToInputFilterLocked(args)) {
-            ui::Transform displayTransform;
-            if (const auto it = mDisplayInfos.find(args.displayId); it != mDisplayInfos.end()) {
-                displayTransform = it->second.transform;
-            }
-
             mLock.unlock();
 
+            const ui::Transform displayTransform =
+                    getWindowInfosSnapshot()->getTransform(args.displayId);
+
             MotionEvent event;
             event.initialize(args.id, args.deviceId, args.source, args.displayId, INVALID_HMAC,
                              args.action, args.actionButton, args.flags, args.edgeFlags,
@@ -5013,9 +5061,9 @@ void InputDispatcher::transformMotionEntryForInjectionLocked(
         MotionEntry& entry, const ui::Transform& injectedTransform) const {
     // Input injection works in the logical display coordinate space, but the input pipeline works
     // display space, so we need to transform the injected events accordingly.
-    const auto it = mDisplayInfos.find(entry.displayId);
-    if (it == mDisplayInfos.end()) return;
-    const auto& transformToDisplay = it->second.transform.inverse() * injectedTransform;
+    const gui::DisplayInfo* displayInfo = mWindowInfos->getDisplayInfo(entry.displayId);
+    if (displayInfo == nullptr) return;
+    const auto& transformToDisplay = displayInfo->transform.inverse() * injectedTransform;
 
     if (entry.xCursorPosition != AMOTION_EVENT_INVALID_CURSOR_POSITION &&
         entry.yCursorPosition != AMOTION_EVENT_INVALID_CURSOR_POSITION) {
@@ -5048,11 +5096,18 @@ void InputDispatcher::decrementPendingForegroundDispatches(const EventEntry& ent
     }
 }
 
+std::shared_ptr<const WindowInfosSnapshot> InputDispatcher::getWindowInfosSnapshot() const {
+    std::scoped_lock _l(mWindowInfosLock);
+    return mPublishedWindowInfos;
+}
+
 const std::vector<sp<WindowInfoHandle>>& InputDispatcher::getWindowHandlesLocked(
         int32_t displayId) const {
-    static const std::vector<sp<WindowInfoHandle>> EMPTY_WINDOW_HANDLES;
-    auto it = mWindowHandlesByDisplay.find(displayId);
-    return it != mWindowHandlesByDisplay.end() ? it->second : EMPTY_WINDOW_HANDLES;
+    return mWindowInfos->getWindowHandles(displayId);
+}
+
+const WindowHitIndex& InputDispatcher::getWindowHitIndexLocked(int32_t displayId) const {
+    return mWindowInfos->getWindowHitIndex(displayId);
 }
 
 sp<WindowInfoHandle> InputDispatcher::getWindowHandleLocked(
@@ -5063,8 +5118,7 @@ sp<WindowInfoHandle> InputDispatcher::getWindowHandleLocked(
 
     if (!displayId) {
         // Look through all displays.
-        for (auto& it : mWindowHandlesByDisplay) {
-            const std::vector<sp<WindowInfoHandle>>& windowHandles = it.second;
+        for (const auto& [_, windowHandles] : mWindowInfos->getWindowHandlesByDisplay()) {
             for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
                 if (windowHandle->getToken() == windowHandleToken) {
                     return windowHandle;
@@ -5085,22 +5139,7 @@ sp<WindowInfoHandle> InputDispatcher::getWindowHandleLocked(
 
 sp<WindowInfoHandle> InputDispatcher::getWindowHandleLocked(
         const sp<WindowInfoHandle>& windowHandle) const {
-    for (auto& it : mWindowHandlesByDisplay) {
-        const std::vector<sp<WindowInfoHandle>>& windowHandles = it.second;
-        for (const sp<WindowInfoHandle>& handle : windowHandles) {
-            if (handle->getId() == windowHandle->getId() &&
-                handle->getToken() == windowHandle->getToken()) {
-                if (windowHandle->getInfo()->displayId != it.first) {
-                    ALOGE("Found window %s in display %" PRId32
-                          ", but it should belong to display %" PRId32,
-                          windowHandle->getName().c_str(), it.first,
-                          windowHandle->getInfo()->displayId);
-                }
-                return handle;
-            }
-        }
-    }
-    return nullptr;
+    return mWindowInfos->findWindow(windowHandle);
 }
 
 sp<WindowInfoHandle> InputDispatcher::getFocusedWindowHandleLocked(int displayId) const {
@@ -5109,9 +5148,7 @@ sp<WindowInfoHandle> InputDispatcher::getFocusedWindowHandleLocked(int displayId
 }
 
 ui::Transform InputDispatcher::getTransformLocked(int32_t displayId) const {
-    auto displayInfoIt = mDisplayInfos.find(displayId);
-    return displayInfoIt != mDisplayInfos.end() ? displayInfoIt->second.transform
-                                                : kIdentityTransform;
+    return mWindowInfos->getTransform(displayId);
 }
 
 bool InputDispatcher::canWindowReceiveMotionLocked(const sp<WindowInfoHandle>& window,
@@ -5176,24 +5213,11 @@ bool InputDispatcher::canWindowReceiveMotionLocked(const sp<WindowInfoHandle>& w
     return true;
 }
 
-void InputDispatcher::updateWindowHandlesForDisplayLocked(
-        const std::vector<sp<WindowInfoHandle>>& windowInfoHandles, int32_t displayId) {
-    if (windowInfoHandles.empty()) {
-        // Remove all handles on a display if there are no windows left.
-        mWindowHandlesByDisplay.erase(displayId);
-        return;
-    }
-
-    // Since we compare the pointer of input window handles across window updates, we need
-    // to make sure the handle object for the same window stays unchanged across updates.
-    const std::vector<sp<WindowInfoHandle>>& oldHandles = getWindowHandlesLocked(displayId);
-    std::unordered_map<int32_t /*id*/, sp<WindowInfoHandle>> oldHandlesById;
-    for (const sp<WindowInfoHandle>& handle : oldHandles) {
-        oldHandlesById[handle->getId()] = handle;
-    }
-
-    std::vector<sp<WindowInfoHandle>> newHandles;
-    for (const sp<WindowInfoHandle>& handle : windowInfoHandles) {
+std::vector<sp<WindowInfoHandle>> InputDispatcher::getInputWindowHandlesLocked(
+        const std::vector<sp<WindowInfoHandle>>& windowHandles) const {
+    std::vector<sp<WindowInfoHandle>> inputWindowHandles;
+    inputWindowHandles.reserve(windowHandles.size());
+    for (const sp<WindowInfoHandle>& handle : windowHandles) {
         const WindowInfo* info = handle->getInfo();
         if (getConnectionLocked(handle->getToken()) == nullptr) {
             const bool noInputChannel =
@@ -5207,78 +5231,104 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
                 continue;
             }
         }
-
-        if (info->displayId != displayId) {
-            ALOGE("Window %s updated by wrong display %d, should belong to display %d",
-                  handle->getName().c_str(), displayId, info->displayId);
-            continue;
-        }
-
-        if ((oldHandlesById.find(handle->getId()) != oldHandlesById.end()) &&
-                (oldHandlesById.at(handle->getId())->getToken() == handle->getToken())) {
-            const sp<WindowInfoHandle>& oldHandle = oldHandlesById.at(handle->getId());
-            oldHandle->updateFrom(handle);
-            newHandles.push_back(oldHandle);
-        } else {
-            newHandles.push_back(handle);
-        }
+        inputWindowHandles.push_back(handle);
     }
-
-    // Insert or replace
-    mWindowHandlesByDisplay[displayId] = newHandles;
+    return inputWindowHandles;
 }
 
 /**
- * Called from InputManagerService, update window handle list by displayId that can receive input.
+ * Called when the windows change, with the windows of every display that can receive input.
  * A window handle contains information about InputChannel, Touch Region, Types, Focused,...
- * If set an empty list, remove all handles from the specific display.
+ * If a display has no windows left, all of its handles are removed.
  * For focused handle, check if need to change and send a cancel event to previous one.
  * For removed handle, check if need to send a cancel event if already in touch.
  */
-void InputDispatcher::setInputWindowsLocked(
-        const std::vector<sp<WindowInfoHandle>>& windowInfoHandles, int32_t displayId) {
-    if (DEBUG_FOCUS) {
-        std::string windowList;
-        for (const sp<WindowInfoHandle>& iwh : windowInfoHandles) {
-            windowList += iwh->getName() + " ";
+void InputDispatcher::setWindowInfosLocked(
+        std::shared_ptr<const WindowInfosSnapshot> windowInfos) {
+    // Whether a window has an input channel can only be checked under the lock. Windows rarely
+    // don't have one, so the snapshot is only copied when some of them have to be dropped.
+    std::shared_ptr<const WindowInfosSnapshot> inputWindowInfos = windowInfos;
+    for (const auto& [displayId, windowHandles] : windowInfos->getWindowHandlesByDisplay()) {
+        std::vector<sp<WindowInfoHandle>> inputWindowHandles =
+                getInputWindowHandlesLocked(windowHandles);
+        if (inputWindowHandles.size() != windowHandles.size()) {
+            inputWindowInfos =
+                    inputWindowInfos->withWindowsOnDisplay(displayId,
+                                                           std::move(inputWindowHandles));
+        }
+    }
+
+    // The displays that had windows before the update, or have some after it.
+    std::vector<int32_t> displayIds;
+    for (const auto& [displayId, windowHandles] : inputWindowInfos->getWindowHandlesByDisplay()) {
+        displayIds.push_back(displayId);
+        if (DEBUG_FOCUS) {
+            std::string windowList;
+            for (const sp<WindowInfoHandle>& iwh : windowHandles) {
+                windowList += iwh->getName() + " ";
+            }
+            LOG(INFO) << "setInputWindows displayId=" << displayId << " " << windowList;
         }
-        LOG(INFO) << "setInputWindows displayId=" << displayId << " " << windowList;
     }
-
-    // Check preconditions for new input windows
-    for (const sp<WindowInfoHandle>& window : windowInfoHandles) {
-        const WindowInfo& info = *window->getInfo();
-
-        // Ensure all tokens are null if the window has feature NO_INPUT_CHANNEL
-        const bool noInputWindow = info.inputConfig.test(WindowInfo::InputConfig::NO_INPUT_CHANNEL);
-        if (noInputWindow && window->getToken() != nullptr) {
-            ALOGE("%s has feature NO_INPUT_WINDOW, but a non-null token. Clearing",
-                  window->getName().c_str());
-            window->releaseChannel();
+    for (const auto& [displayId, _] : mWindowInfos->getWindowHandlesByDisplay()) {
+        if (inputWindowInfos->getWindowHandlesByDisplay().count(displayId) == 0) {
+            displayIds.push_back(displayId);
         }
+    }
 
-        // Ensure all spy windows are trusted overlays
-        LOG_ALWAYS_FATAL_IF(info.isSpy() &&
-                                    !info.inputConfig.test(
-                                            WindowInfo::InputConfig::TRUSTED_OVERLAY),
-                            "%s has feature SPY, but is not a trusted overlay.",
-                            window->getName().c_str());
+    // Copy old handles and focused windows, since the windows may go away.
+    const std::shared_ptr<const WindowInfosSnapshot> oldWindowInfos = mWindowInfos;
+    std::unordered_map<int32_t, sp<WindowInfoHandle>> removedFocusedWindowHandles;
+    for (int32_t displayId : displayIds) {
+        removedFocusedWindowHandles[displayId] = getFocusedWindowHandleLocked(displayId);
+    }
 
-        // Ensure all stylus interceptors are trusted overlays
-        LOG_ALWAYS_FATAL_IF(info.interceptsStylus() &&
-                                    !info.inputConfig.test(
-                                            WindowInfo::InputConfig::TRUSTED_OVERLAY),
-                            "%s has feature INTERCEPTS_STYLUS, but is not a trusted overlay.",
-                            window->getName().c_str());
+    mWindowInfos = std::move(inputWindowInfos);
+    {
+        std::scoped_lock _l(mWindowInfosLock);
+        mPublishedWindowInfos = mWindowInfos;
     }
 
-    // Copy old handles for release if they are no longer present.
-    const std::vector<sp<WindowInfoHandle>> oldWindowHandles = getWindowHandlesLocked(displayId);
-    const sp<WindowInfoHandle> removedFocusedWindowHandle = getFocusedWindowHandleLocked(displayId);
+    // Every update comes with new handles, and older snapshots may still be read, so the old
+    // handles are left untouched. The touch and drag state instead switch over to the new handles
+    // of the windows that stayed on their display, so that they see the new window geometry, and
+    // can still be compared with the handles of the snapshot.
+    auto updateHandle = [this](sp<WindowInfoHandle>& handle) REQUIRES(mLock) {
+        if (handle == nullptr) {
+            return;
+        }
+        for (const sp<WindowInfoHandle>& newHandle :
+             getWindowHandlesLocked(handle->getInfo()->displayId)) {
+            if (newHandle->getId() == handle->getId() &&
+                newHandle->getToken() == handle->getToken()) {
+                handle = newHandle;
+                return;
+            }
+        }
+    };
+    for (auto& [_, state] : mTouchStatesByDisplay) {
+        for (TouchedWindow& touchedWindow : state.windows) {
+            updateHandle(touchedWindow.windowHandle);
+        }
+    }
+    if (mDragState) {
+        updateHandle(mDragState->dragWindow);
+        updateHandle(mDragState->dragHoverWindowHandle);
+    }
 
-    updateWindowHandlesForDisplayLocked(windowInfoHandles, displayId);
+    for (int32_t displayId : displayIds) {
+        onWindowsChangedOnDisplayLocked(displayId, oldWindowInfos->getWindowHandles(displayId),
+                                        removedFocusedWindowHandles[displayId]);
+    }
+}
 
+void InputDispatcher::onWindowsChangedOnDisplayLocked(
+        int32_t displayId, const std::vector<sp<WindowInfoHandle>>& oldWindowHandles,
+        const sp<WindowInfoHandle>& removedFocusedWindowHandle) {
     const std::vector<sp<WindowInfoHandle>>& windowHandles = getWindowHandlesLocked(displayId);
+    auto isWindowPresent = [&](const sp<WindowInfoHandle>& handle) REQUIRES(mLock) {
+        return getWindowHandleLocked(handle) != nullptr;
+    };
 
     std::optional<FocusResolver::FocusChanges> changes =
             mFocusResolver.setInputWindows(displayId, windowHandles);
@@ -5292,7 +5342,7 @@ void InputDispatcher::setInputWindowsLocked(
         TouchState& state = stateIt->second;
         for (size_t i = 0; i < state.windows.size();) {
             TouchedWindow& touchedWindow = state.windows[i];
-            if (getWindowHandleLocked(touchedWindow.windowHandle) == nullptr) {
+            if (!isWindowPresent(touchedWindow.windowHandle)) {
                 LOG(INFO) << "Touched window was removed: " << touchedWindow.windowHandle->getName()
                           << " in display %" << displayId;
                 CancelationOptions options(CancelationOptions::Mode::CANCEL_POINTER_EVENTS,
@@ -5324,16 +5374,11 @@ void InputDispatcher::setInputWindowsLocked(
         }
     }
 
-    // Release information for windows that are no longer present.
-    // This ensures that unused input channels are released promptly.
-    // Otherwise, they might stick around until the window handle is destroyed
-    // which might not happen until the next GC.
-    for (const sp<WindowInfoHandle>& oldWindowHandle : oldWindowHandles) {
-        if (getWindowHandleLocked(oldWindowHandle) == nullptr) {
-            if (DEBUG_FOCUS) {
+    if (DEBUG_FOCUS) {
+        for (const sp<WindowInfoHandle>& oldWindowHandle : oldWindowHandles) {
+            if (!isWindowPresent(oldWindowHandle)) {
                 ALOGD("Window went away: %s", oldWindowHandle->getName().c_str());
             }
-            oldWindowHandle->releaseChannel();
         }
     }
 }
@@ -5795,14 +5840,14 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) const {
         mDragState->dump(dump, INDENT2);
     }
 
-    if (!mWindowHandlesByDisplay.empty()) {
-        for (const auto& [displayId, windowHandles] : mWindowHandlesByDisplay) {
+    if (!mWindowInfos->getWindowHandlesByDisplay().empty()) {
+        for (const auto& [displayId, windowHandles] : mWindowInfos->getWindowHandlesByDisplay()) {
             dump += StringPrintf(INDENT "Display: %" PRId32 "\n", displayId);
-            if (const auto& it = mDisplayInfos.find(displayId); it != mDisplayInfos.end()) {
-                const auto& displayInfo = it->second;
-                dump += StringPrintf(INDENT2 "logicalSize=%dx%d\n", displayInfo.logicalWidth,
-                                     displayInfo.logicalHeight);
-                displayInfo.transform.dump(dump, "transform", INDENT4);
+            if (const gui::DisplayInfo* displayInfo = mWindowInfos->getDisplayInfo(displayId);
+                displayInfo != nullptr) {
+                dump += StringPrintf(INDENT2 "logicalSize=%dx%d\n", displayInfo->logicalWidth,
+                                     displayInfo->logicalHeight);
+                displayInfo->transform.dump(dump, "transform", INDENT4);
             } else {
                 dump += INDENT2 "No DisplayInfo found!\n";
             }
@@ -5955,7 +6000,9 @@ Result<std::unique_ptr<InputChannel>> InputDispatcher::createInputChannel(const
 
     std::unique_ptr<InputChannel> serverChannel;
     std::unique_ptr<InputChannel> clientChannel;
-    status_t result = InputChannel::openInputChannelPair(name, serverChannel, clientChannel);
+    status_t result =
+            InputChannel::openInputChannelPair(name, serverChannel, clientChannel,
+                                               input_flags::enable_shared_memory_input_channel());
 
     if (result) {
         return base::Error(result) << "Failed to open input channel pair with name " << name;
@@ -5991,7 +6038,9 @@ Result<std::unique_ptr<InputChannel>> InputDispatcher::createInputMonitor(int32_
                                                                           gui::Pid pid) {
     std::unique_ptr<InputChannel> serverChannel;
     std::unique_ptr<InputChannel> clientChannel;
-    status_t result = InputChannel::openInputChannelPair(name, serverChannel, clientChannel);
+    status_t result =
+            InputChannel::openInputChannelPair(name, serverChannel, clientChannel,
+                                               input_flags::enable_shared_memory_input_channel());
     if (result) {
         return base::Error(result) << "Failed to open input channel pair with name " << name;
     }
@@ -6838,7 +6887,7 @@ void InputDispatcher::displayRemoved(int32_t displayId) {
     { // acquire lock
         std::scoped_lock _l(mLock);
         // Set an empty list to remove all handles from the specific display.
-        setInputWindowsLocked(/*windowInfoHandles=*/{}, displayId);
+        setWindowInfosLocked(mWindowInfos->withWindowsOnDisplay(displayId, /*windowHandles=*/{}));
         setFocusedApplicationLocked(displayId, nullptr);
         // Call focus resolver to clean up stale requests. This must be called after input windows
         // have been removed for the removed display.
@@ -6864,31 +6913,32 @@ void InputDispatcher::onWindowInfosChanged(const gui::WindowInfosUpdate& update)
         LOG_ALWAYS_FATAL("Incorrect WindowInfosUpdate provided: %s",
                          result.error().message().c_str());
     };
+    // The snapshot of the windows, with the hit test index of each display, is built before
+    // taking mLock, so that window updates, which come at up to the display refresh rate while
+    // windows animate, hold up the dispatcher and the event producers for as little as possible.
+    // Under mLock, the new snapshot is only swapped in, and the touch state, focus and the
+    // cancelations for removed windows, which have to change along with it, are updated.
+
     // The listener sends the windows as a flattened array. Separate the windows by display for
     // more convenient parsing.
     std::unordered_map<int32_t, std::vector<sp<WindowInfoHandle>>> handlesPerDisplay;
     for (const auto& info : update.windowInfos) {
         handlesPerDisplay.emplace(info.displayId, std::vector<sp<WindowInfoHandle>>());
         handlesPerDisplay[info.displayId].push_back(sp<WindowInfoHandle>::make(info));
+        validateWindowHandle(handlesPerDisplay[info.displayId].back());
     }
 
-    { // acquire lock
-        std::scoped_lock _l(mLock);
-
-        // Ensure that we have an entry created for all existing displays so that if a displayId has
-        // no windows, we can tell that the windows were removed from the display.
-        for (const auto& [displayId, _] : mWindowHandlesByDisplay) {
-            handlesPerDisplay[displayId];
-        }
+    std::unordered_map<int32_t, gui::DisplayInfo> displayInfos;
+    for (const auto& displayInfo : update.displayInfos) {
+        displayInfos.emplace(displayInfo.displayId, displayInfo);
+    }
 
-        mDisplayInfos.clear();
-        for (const auto& displayInfo : update.displayInfos) {
-            mDisplayInfos.emplace(displayInfo.displayId, displayInfo);
-        }
+    auto windowInfos = std::make_shared<const WindowInfosSnapshot>(std::move(handlesPerDisplay),
+                                                                   std::move(displayInfos));
 
-        for (const auto& [displayId, handles] : handlesPerDisplay) {
-            setInputWindowsLocked(handles, displayId);
-        }
+    { // acquire lock
+        std::scoped_lock _l(mLock);
+        setWindowInfosLocked(std::move(windowInfos));
 
         if (update.vsyncId < mWindowInfosVsyncId) {
             ALOGE("Received out of order window infos update. Last update vsync id: %" PRId64
@@ -7071,4 +7121,9 @@ bool InputDispatcher::isPointerInWindow(const sp<android::IBinder>& token, int32
     return false;
 }
 
+std::string InputDispatcher::dumpLatencyBreakdown() const {
+    std::scoped_lock _l(mLock);
+    return mLatencyAggregator.dumpLatencyBreakdown("");
+}
+
 } // namespace android::inputdispatcher
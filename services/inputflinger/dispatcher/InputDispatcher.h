@@ -32,6 +32,8 @@
 #include "Monitor.h"
 #include "TouchState.h"
 #include "TouchedWindow.h"
+#include "WindowHitIndex.h"
+#include "WindowInfosSnapshot.h"
 #include "trace/InputTracerInterface.h"
 #include "trace/InputTracingBackendInterface.h"
 
@@ -158,6 +160,8 @@ public:
     bool isPointerInWindow(const sp<IBinder>& token, int32_t displayId, DeviceId deviceId,
                            int32_t pointerId) override;
 
+    std::string dumpLatencyBreakdown() const override;
+
 private:
     enum class DropReason {
         NOT_DROPPED,
@@ -352,17 +356,26 @@ private:
     };
     sp<gui::WindowInfosListener> mWindowInfoListener;
 
-    std::unordered_map<int32_t /*displayId*/, std::vector<sp<android::gui::WindowInfoHandle>>>
-            mWindowHandlesByDisplay GUARDED_BY(mLock);
-    std::unordered_map<int32_t /*displayId*/, android::gui::DisplayInfo> mDisplayInfos
-            GUARDED_BY(mLock);
-    void setInputWindowsLocked(
-            const std::vector<sp<android::gui::WindowInfoHandle>>& inputWindowHandles,
-            int32_t displayId) REQUIRES(mLock);
+    // The windows and displays from the last window infos update. The snapshot is immutable, and
+    // is swapped for a new one on every update, while holding both mLock and mWindowInfosLock.
+    // Holders of mLock read it directly, along with the touch and focus state that is kept in sync
+    // with it; other threads take a reference under mWindowInfosLock, which is only held for the
+    // pointer swap, and read it without waiting for mLock.
+    std::shared_ptr<const WindowInfosSnapshot> mWindowInfos GUARDED_BY(mLock);
+    mutable std::mutex mWindowInfosLock;
+    std::shared_ptr<const WindowInfosSnapshot> mPublishedWindowInfos GUARDED_BY(mWindowInfosLock);
+    std::shared_ptr<const WindowInfosSnapshot> getWindowInfosSnapshot() const
+            EXCLUDES(mWindowInfosLock);
+    // Drops the windows that can't receive input, swaps in the snapshot, and updates the touch,
+    // drag and focus state for the windows that changed or went away.
+    void setWindowInfosLocked(std::shared_ptr<const WindowInfosSnapshot> windowInfos)
+            REQUIRES(mLock);
     // Get a reference to window handles by display, return an empty vector if not found.
     const std::vector<sp<android::gui::WindowInfoHandle>>& getWindowHandlesLocked(
             int32_t displayId) const REQUIRES(mLock);
     ui::Transform getTransformLocked(int32_t displayId) const REQUIRES(mLock);
+    // Get the hit test index of the windows on a display, return an empty index if not found.
+    const WindowHitIndex& getWindowHitIndexLocked(int32_t displayId) const REQUIRES(mLock);
 
     sp<android::gui::WindowInfoHandle> getWindowHandleLocked(
             const sp<IBinder>& windowHandleToken, std::optional<int32_t> displayId = {}) const
@@ -380,12 +393,16 @@ private:
             const std::vector<sp<android::gui::WindowInfoHandle>>& windowHandles) const
             REQUIRES(mLock);
 
-    /*
-     * Validate and update InputWindowHandles for a given display.
-     */
-    void updateWindowHandlesForDisplayLocked(
-            const std::vector<sp<android::gui::WindowInfoHandle>>& inputWindowHandles,
-            int32_t displayId) REQUIRES(mLock);
+    // The windows of the display which can receive input, out of 'windowHandles'.
+    std::vector<sp<android::gui::WindowInfoHandle>> getInputWindowHandlesLocked(
+            const std::vector<sp<android::gui::WindowInfoHandle>>& windowHandles) const
+            REQUIRES(mLock);
+    // Cancels the touches of the windows on the display that went away, and updates its focus.
+    // 'removedFocusedWindowHandle' is the window that had focus before the update.
+    void onWindowsChangedOnDisplayLocked(
+            int32_t displayId,
+            const std::vector<sp<android::gui::WindowInfoHandle>>& oldWindowHandles,
+            const sp<android::gui::WindowInfoHandle>& removedFocusedWindowHandle) REQUIRES(mLock);
 
     std::unordered_map<int32_t, TouchState> mTouchStatesByDisplay GUARDED_BY(mLock);
     std::unique_ptr<DragState> mDragState GUARDED_BY(mLock);
@@ -53,6 +53,7 @@ struct ConnectionTimeline {
      * True if all contained timestamps are valid, false otherwise.
      */
     bool isComplete() const;
+    bool hasDispatchTimeline() const { return mHasDispatchTimeline; }
     /**
      * Set the dispatching-related times. Return true if the operation succeeded, false if the
      * dispatching times have already been set. If this function returns false, it likely indicates
@@ -127,6 +127,7 @@ void LatencyAggregator::processTimeline(const InputEventTimeline& timeline) {
 
 void LatencyAggregator::processStatistics(const InputEventTimeline& timeline) {
     std::scoped_lock lock(mLock);
+    mLatencyBreakdown.addTimeline(timeline);
     // Before we do any processing, check that we have not yet exceeded MAX_SIZE
     if (mNumSketchEventsProcessed >= MAX_EVENTS_FOR_STATISTICS) {
         return;
@@ -279,7 +280,13 @@ std::string LatencyAggregator::dump(const char* prefix) const {
             StringPrintf("%s  mLastSlowEventTime=%" PRId64 "\n", prefix, mLastSlowEventTime) +
             StringPrintf("%s  mNumEventsSinceLastSlowEventReport = %zu\n", prefix,
                          mNumEventsSinceLastSlowEventReport) +
-            StringPrintf("%s  mNumSkippedSlowEvents = %zu\n", prefix, mNumSkippedSlowEvents);
+            StringPrintf("%s  mNumSkippedSlowEvents = %zu\n", prefix, mNumSkippedSlowEvents) +
+            mLatencyBreakdown.dump((std::string(prefix) + "  ").c_str());
+}
+
+std::string LatencyAggregator::dumpLatencyBreakdown(const char* prefix) const {
+    std::scoped_lock lock(mLock);
+    return mLatencyBreakdown.dump(prefix);
 }
 
 } // namespace android::inputdispatcher
@@ -22,6 +22,7 @@
 #include <utils/Timers.h>
 
 #include "InputEventTimeline.h"
+#include "LatencyBreakdown.h"
 
 namespace android::inputdispatcher {
 
@@ -58,6 +59,10 @@ public:
     void processTimeline(const InputEventTimeline& timeline) override;
 
     std::string dump(const char* prefix) const;
+    /**
+     * Dump the per-stage latency percentiles of every device and source seen so far.
+     */
+    std::string dumpLatencyBreakdown(const char* prefix) const;
 
     ~LatencyAggregator();
 
@@ -89,6 +94,8 @@ private:
             mMoveSketches GUARDED_BY(mLock);
     // How many events have been processed so far
     size_t mNumSketchEventsProcessed GUARDED_BY(mLock) = 0;
+    // Unlike the sketches, this records every event and is not reset when the data is pulled.
+    LatencyBreakdown mLatencyBreakdown GUARDED_BY(mLock);
 };
 
 } // namespace android::inputdispatcher
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputDispatcher"
+
+#include "LatencyBreakdown.h"
+
+#include <inttypes.h>
+
+#include <android-base/stringprintf.h>
+#include <ftl/enum.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+using android::base::StringPrintf;
+
+namespace android::inputdispatcher {
+
+namespace {
+
+// Values below this many microseconds get a bucket of their own.
+constexpr uint32_t LINEAR_LIMIT = 4;
+
+size_t bucketOf(uint32_t micros) {
+    if (micros < LINEAR_LIMIT) {
+        return micros;
+    }
+    // The two bits after the most significant bit pick one of four buckets in this power of two.
+    const int msb = std::bit_width(micros) - 1;
+    const uint32_t subBucket = (micros >> (msb - 2)) & 0x3;
+    return 4 * (msb - 1) + subBucket;
+}
+
+// The midpoint of the given bucket, in microseconds.
+double bucketMidpoint(size_t bucket) {
+    if (bucket < LINEAR_LIMIT) {
+        return bucket + 0.5;
+    }
+    const int msb = bucket / 4 + 1;
+    const double width = std::ldexp(1.0, msb - 2);
+    const double lower = (4 + bucket % 4) * width;
+    return lower + width / 2;
+}
+
+void addStage(LatencyBreakdown::Histograms& histograms, LatencyBreakdown::Stage stage,
+              nsecs_t latency) {
+    histograms[static_cast<size_t>(stage)].add(latency);
+}
+
+} // namespace
+
+// --- LatencyHistogram ---
+
+void LatencyHistogram::add(nsecs_t latency) {
+    if (latency < 0) {
+        // The timestamps reported by the app are not trusted
+        return;
+    }
+    const uint32_t micros = static_cast<uint32_t>(
+            std::min<nsecs_t>(ns2us(latency), std::numeric_limits<uint32_t>::max()));
+    uint32_t& bucket = mBuckets[bucketOf(micros)];
+    if (bucket == std::numeric_limits<uint32_t>::max()) {
+        return;
+    }
+    bucket++;
+    mCount++;
+}
+
+nsecs_t LatencyHistogram::percentile(float fraction) const {
+    if (mCount == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil(fraction * mCount));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += mBuckets[i];
+        if (seen >= rank) {
+            return us2ns(static_cast<nsecs_t>(bucketMidpoint(i)));
+        }
+    }
+    return us2ns(static_cast<nsecs_t>(bucketMidpoint(NUM_BUCKETS - 1)));
+}
+
+// --- LatencyBreakdown ---
+
+void LatencyBreakdown::addTimeline(const InputEventTimeline& timeline) {
+    for (InputDeviceUsageSource source : timeline.sources) {
+        const Key key{timeline.vendorId, timeline.productId, source};
+        auto it = mHistograms.find(key);
+        if (it == mHistograms.end()) {
+            if (mHistograms.size() >= MAX_KEYS) {
+                continue;
+            }
+            it = mHistograms.emplace(key, Histograms{}).first;
+        }
+        Histograms& histograms = it->second;
+
+        addStage(histograms, Stage::EVENT_TO_READ, timeline.readTime - timeline.eventTime);
+        for (const auto& [_, connectionTimeline] : timeline.connectionTimelines) {
+            if (connectionTimeline.hasDispatchTimeline()) {
+                addStage(histograms, Stage::READ_TO_DELIVER,
+                         connectionTimeline.deliveryTime - timeline.readTime);
+                addStage(histograms, Stage::DELIVER_TO_CONSUME,
+                         connectionTimeline.consumeTime - connectionTimeline.deliveryTime);
+                addStage(histograms, Stage::CONSUME_TO_FINISH,
+                         connectionTimeline.finishTime - connectionTimeline.consumeTime);
+            }
+            if (!connectionTimeline.isComplete()) {
+                continue;
+            }
+            const nsecs_t gpuCompletedTime =
+                    connectionTimeline.graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME];
+            const nsecs_t presentTime =
+                    connectionTimeline.graphicsTimeline[GraphicsTimeline::PRESENT_TIME];
+            addStage(histograms, Stage::CONSUME_TO_GPU_COMPLETE,
+                     gpuCompletedTime - connectionTimeline.consumeTime);
+            addStage(histograms, Stage::GPU_COMPLETE_TO_PRESENT, presentTime - gpuCompletedTime);
+            addStage(histograms, Stage::END_TO_END, presentTime - timeline.eventTime);
+        }
+    }
+}
+
+std::string LatencyBreakdown::dump(const char* prefix) const {
+    std::string dump = StringPrintf("%sLatencyBreakdown (ms):\n", prefix);
+    if (mHistograms.empty()) {
+        return dump + StringPrintf("%s  <none>\n", prefix);
+    }
+    for (const auto& [key, histograms] : mHistograms) {
+        dump += StringPrintf("%s  vendor=0x%04x product=0x%04x source=%s:\n", prefix,
+                             key.vendorId, key.productId, ftl::enum_string(key.source).c_str());
+        for (size_t i = 0; i < NUM_STAGES; i++) {
+            const LatencyHistogram& histogram = histograms[i];
+            if (histogram.count() == 0) {
+                continue;
+            }
+            dump += StringPrintf("%s    %s: count=%" PRIu64 " p50=%.2f p90=%.2f p99=%.2f\n", prefix,
+                                 ftl::enum_string(static_cast<Stage>(i)).c_str(), histogram.count(),
+                                 histogram.percentile(0.5) * 1E-6, histogram.percentile(0.9) * 1E-6,
+                                 histogram.percentile(0.99) * 1E-6);
+        }
+    }
+    return dump;
+}
+
+} // namespace android::inputdispatcher
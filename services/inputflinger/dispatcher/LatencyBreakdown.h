@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include <utils/Timers.h>
+
+#include "InputEventTimeline.h"
+
+namespace android::inputdispatcher {
+
+/**
+ * A fixed-size histogram of latencies with logarithmic buckets. Each power of two is split into
+ * four buckets, so a reported percentile is within ~12% of the true value. Adding a sample is a
+ * couple of bit operations, which makes it cheap enough to record every event.
+ */
+class LatencyHistogram {
+public:
+    // Latencies are kept in microseconds. The last bucket also holds everything above ~70 minutes.
+    static constexpr size_t NUM_BUCKETS = 124;
+
+    void add(nsecs_t latency);
+    uint64_t count() const { return mCount; }
+    /**
+     * The latency below which the given fraction (in [0, 1]) of the samples fall, or 0 if the
+     * histogram is empty. This is the midpoint of the bucket where that fraction is reached.
+     */
+    nsecs_t percentile(float fraction) const;
+
+private:
+    std::array<uint32_t, NUM_BUCKETS> mBuckets{};
+    uint64_t mCount = 0;
+};
+
+/**
+ * A per-stage breakdown of the latency of the input events, kept separately for every device and
+ * usage source. Unlike the sketches that are reported to statsd, this is never reset, and it also
+ * includes the events for which the app did not report a graphics timeline, so that the stage
+ * which regressed can be found from a bug report.
+ *
+ * The stages follow LatencyAggregator's SketchIndex:
+ *   eventTime -> readTime -> deliveryTime -> consumeTime -> finishTime -> gpuCompletedTime ->
+ *   presentTime
+ */
+class LatencyBreakdown {
+public:
+    enum class Stage : size_t {
+        EVENT_TO_READ,
+        READ_TO_DELIVER,
+        DELIVER_TO_CONSUME,
+        CONSUME_TO_FINISH,
+        CONSUME_TO_GPU_COMPLETE,
+        GPU_COMPLETE_TO_PRESENT,
+        END_TO_END,
+
+        ftl_last = END_TO_END,
+    };
+    static constexpr size_t NUM_STAGES = static_cast<size_t>(Stage::ftl_last) + 1;
+
+    struct Key {
+        uint16_t vendorId;
+        uint16_t productId;
+        InputDeviceUsageSource source;
+
+        bool operator<(const Key& other) const {
+            return std::tie(vendorId, productId, source) <
+                    std::tie(other.vendorId, other.productId, other.source);
+        }
+    };
+    using Histograms = std::array<LatencyHistogram, NUM_STAGES>;
+
+    // Devices beyond this many keys are not tracked, to bound the memory that is used.
+    static constexpr size_t MAX_KEYS = 32;
+
+    void addTimeline(const InputEventTimeline& timeline);
+    const std::map<Key, Histograms>& getHistograms() const { return mHistograms; }
+
+    std::string dump(const char* prefix) const;
+
+private:
+    std::map<Key, Histograms> mHistograms;
+};
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputDispatcher"
+
+#include "WindowHitIndex.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <cmath>
+
+using android::gui::WindowInfo;
+using android::gui::WindowInfoHandle;
+
+namespace android::inputdispatcher {
+
+namespace {
+
+FloatRect unionOf(const FloatRect& a, const FloatRect& b) {
+    if (a.isEmpty()) return b;
+    if (b.isEmpty()) return a;
+    return FloatRect(std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right),
+                     std::max(a.bottom, b.bottom));
+}
+
+// Bounds of everything which can be hit in the window, in logical display coordinates. Hit tests
+// floor the point and treat the right and bottom edges differently depending on the rotation, so
+// the bounds are padded by a pixel on each side.
+FloatRect logicalBoundsOf(const WindowInfo& info, const ui::Transform& displayTransform) {
+    FloatRect bounds;
+    if (!info.touchableRegion.isEmpty()) {
+        bounds = displayTransform.transform(info.touchableRegion.getBounds().toFloatRect());
+    }
+    if (info.frame.isValid() && !info.frame.isEmpty()) {
+        bounds = unionOf(bounds, displayTransform.transform(info.frame.toFloatRect()));
+    }
+    if (bounds.isEmpty()) return bounds;
+    return FloatRect(bounds.left - 1, bounds.top - 1, bounds.right + 1, bounds.bottom + 1);
+}
+
+bool contains(const FloatRect& rect, vec2 point) {
+    return point.x >= rect.left && point.x < rect.right && point.y >= rect.top &&
+            point.y < rect.bottom;
+}
+
+} // namespace
+
+WindowHitIndex::WindowHitIndex(const std::vector<sp<WindowInfoHandle>>& windowHandles,
+                               const ui::Transform& displayTransform,
+                               const Rect& logicalDisplayBounds) {
+    const size_t numWindows = windowHandles.size();
+    mAllWindows.reserve(numWindows);
+    for (size_t i = 0; i < numWindows; i++) {
+        mIndexByWindowId.emplace(windowHandles[i]->getId(), i);
+        mAllWindows.push_back(i);
+    }
+    if (numWindows < kMinWindowsForGrid) return;
+
+    std::vector<FloatRect> windowBounds;
+    windowBounds.reserve(numWindows);
+    for (const sp<WindowInfoHandle>& windowHandle : windowHandles) {
+        windowBounds.push_back(logicalBoundsOf(*windowHandle->getInfo(), displayTransform));
+    }
+
+    if (!logicalDisplayBounds.isEmpty()) {
+        mGridBounds = logicalDisplayBounds.toFloatRect();
+    } else {
+        for (const FloatRect& bounds : windowBounds) mGridBounds = unionOf(mGridBounds, bounds);
+    }
+    if (mGridBounds.isEmpty()) return;
+
+    // Roughly one window per cell, if they were spread evenly.
+    mCellsPerSide = std::clamp<size_t>(std::ceil(std::sqrt(numWindows)), 1, kMaxCellsPerSide);
+    mCellWidth = mGridBounds.getWidth() / mCellsPerSide;
+    mCellHeight = mGridBounds.getHeight() / mCellsPerSide;
+    mCells.resize(mCellsPerSide * mCellsPerSide);
+
+    auto column = [&](float x) {
+        return std::clamp<ssize_t>(std::floor((x - mGridBounds.left) / mCellWidth), 0,
+                                   mCellsPerSide - 1);
+    };
+    auto row = [&](float y) {
+        return std::clamp<ssize_t>(std::floor((y - mGridBounds.top) / mCellHeight), 0,
+                                   mCellsPerSide - 1);
+    };
+
+    for (size_t i = 0; i < numWindows; i++) {
+        const FloatRect& bounds = windowBounds[i];
+        if (bounds.isEmpty()) continue;
+        if (bounds.left < mGridBounds.left || bounds.top < mGridBounds.top ||
+            bounds.right > mGridBounds.right || bounds.bottom > mGridBounds.bottom) {
+            mOutsideGrid.push_back(i);
+        }
+        const FloatRect clipped = bounds.intersect(mGridBounds);
+        if (clipped.isEmpty()) continue;
+        for (ssize_t y = row(clipped.top); y <= row(clipped.bottom); y++) {
+            for (ssize_t x = column(clipped.left); x <= column(clipped.right); x++) {
+                mCells[y * mCellsPerSide + x].push_back(i);
+            }
+        }
+    }
+}
+
+const std::vector<size_t>& WindowHitIndex::candidatesAt(vec2 logicalPoint) const {
+    if (mCells.empty()) return mAllWindows;
+    if (!contains(mGridBounds, logicalPoint)) return mOutsideGrid;
+
+    const size_t x = std::min<size_t>((logicalPoint.x - mGridBounds.left) / mCellWidth,
+                                      mCellsPerSide - 1);
+    const size_t y = std::min<size_t>((logicalPoint.y - mGridBounds.top) / mCellHeight,
+                                      mCellsPerSide - 1);
+    return mCells[y * mCellsPerSide + x];
+}
+
+size_t WindowHitIndex::indexOf(const std::vector<sp<WindowInfoHandle>>& windowHandles,
+                               const sp<WindowInfoHandle>& windowHandle) const {
+    LOG_ALWAYS_FATAL_IF(windowHandles.size() != mAllWindows.size(),
+                        "Index of %zu windows used with %zu windows", mAllWindows.size(),
+                        windowHandles.size());
+    // A window that was replaced by another one with the same id is no longer in the list.
+    const auto it = mIndexByWindowId.find(windowHandle->getId());
+    if (it == mIndexByWindowId.end() || windowHandles[it->second] != windowHandle) {
+        return windowHandles.size();
+    }
+    return it->second;
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gui/WindowInfo.h>
+#include <math/vec2.h>
+#include <ui/FloatRect.h>
+#include <ui/Rect.h>
+#include <ui/Transform.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * Spatial index over the windows of one display, used to hit test a point without testing every
+ * window on the display.
+ *
+ * The logical display is split into a uniform grid, and each cell lists the windows whose frame or
+ * touchable region may overlap it, in z-order. Looking up a point only returns candidates: callers
+ * still have to do the exact hit test, but can skip every window which isn't returned, and see the
+ * candidates in the same order as in the full list of windows.
+ *
+ * The index is a snapshot of the windows' geometry, so it must be rebuilt whenever the windows or
+ * the display transform change.
+ */
+class WindowHitIndex {
+public:
+    WindowHitIndex() = default;
+
+    // 'windowHandles' must be ordered from front to back. 'logicalDisplayBounds' may be empty if
+    // the display size isn't known, in which case the grid covers all of the windows instead.
+    WindowHitIndex(const std::vector<sp<gui::WindowInfoHandle>>& windowHandles,
+                   const ui::Transform& displayTransform, const Rect& logicalDisplayBounds);
+
+    // Indices into the window list, in increasing order, of the windows whose frame or touchable
+    // region may contain the point. The point is in logical display coordinates.
+    const std::vector<size_t>& candidatesAt(vec2 logicalPoint) const;
+
+    // Index of the window in 'windowHandles', or the number of windows if it isn't in the list.
+    // 'windowHandles' must describe the same windows, in the same order, as the ones the index was
+    // built from, but may be other handles, so that the index can be built ahead of time from
+    // copies of the windows.
+    size_t indexOf(const std::vector<sp<gui::WindowInfoHandle>>& windowHandles,
+                   const sp<gui::WindowInfoHandle>& windowHandle) const;
+
+private:
+    // Below this many windows, a linear scan is as fast as looking up the grid.
+    static constexpr size_t kMinWindowsForGrid = 8;
+    static constexpr size_t kMaxCellsPerSide = 32;
+
+    std::unordered_map<int32_t /*windowId*/, size_t> mIndexByWindowId;
+    // every window, for small lists
+    std::vector<size_t> mAllWindows;
+
+    FloatRect mGridBounds;
+    size_t mCellsPerSide = 0;
+    float mCellWidth = 0;
+    float mCellHeight = 0;
+    std::vector<std::vector<size_t>> mCells;
+    // windows which extend past mGridBounds, for points outside of it
+    std::vector<size_t> mOutsideGrid;
+};
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputDispatcher"
+
+#include "WindowInfosSnapshot.h"
+
+#include <inttypes.h>
+#include <log/log.h>
+
+using android::gui::DisplayInfo;
+using android::gui::WindowInfoHandle;
+
+namespace android::inputdispatcher {
+
+WindowInfosSnapshot::WindowInfosSnapshot(
+        std::unordered_map<int32_t, WindowHandles> windowHandles,
+        std::unordered_map<int32_t, DisplayInfo> displayInfos)
+      : mWindowHandlesByDisplay(std::move(windowHandles)), mDisplayInfos(std::move(displayInfos)) {
+    for (const auto& [displayId, _] : mWindowHandlesByDisplay) {
+        indexDisplay(displayId);
+    }
+}
+
+std::shared_ptr<const WindowInfosSnapshot> WindowInfosSnapshot::withWindowsOnDisplay(
+        int32_t displayId, WindowHandles windowHandles) const {
+    auto snapshot = std::make_shared<WindowInfosSnapshot>(*this);
+    for (const sp<WindowInfoHandle>& oldHandle : getWindowHandles(displayId)) {
+        auto [begin, end] = snapshot->mWindowsById.equal_range(oldHandle->getId());
+        for (auto it = begin; it != end; it++) {
+            if (it->second == oldHandle) {
+                snapshot->mWindowsById.erase(it);
+                break;
+            }
+        }
+    }
+    if (windowHandles.empty()) {
+        snapshot->mWindowHandlesByDisplay.erase(displayId);
+        snapshot->mWindowHitIndexByDisplay.erase(displayId);
+    } else {
+        snapshot->mWindowHandlesByDisplay.insert_or_assign(displayId, std::move(windowHandles));
+        snapshot->indexDisplay(displayId);
+    }
+    return snapshot;
+}
+
+const WindowInfosSnapshot::WindowHandles& WindowInfosSnapshot::getWindowHandles(
+        int32_t displayId) const {
+    static const WindowHandles EMPTY_WINDOW_HANDLES;
+    auto it = mWindowHandlesByDisplay.find(displayId);
+    return it != mWindowHandlesByDisplay.end() ? it->second : EMPTY_WINDOW_HANDLES;
+}
+
+const WindowHitIndex& WindowInfosSnapshot::getWindowHitIndex(int32_t displayId) const {
+    static const WindowHitIndex EMPTY_HIT_INDEX;
+    auto it = mWindowHitIndexByDisplay.find(displayId);
+    return it != mWindowHitIndexByDisplay.end() ? it->second : EMPTY_HIT_INDEX;
+}
+
+const DisplayInfo* WindowInfosSnapshot::getDisplayInfo(int32_t displayId) const {
+    auto it = mDisplayInfos.find(displayId);
+    return it != mDisplayInfos.end() ? &it->second : nullptr;
+}
+
+ui::Transform WindowInfosSnapshot::getTransform(int32_t displayId) const {
+    const DisplayInfo* displayInfo = getDisplayInfo(displayId);
+    return displayInfo != nullptr ? displayInfo->transform : ui::Transform();
+}
+
+sp<WindowInfoHandle> WindowInfosSnapshot::findWindow(
+        const sp<WindowInfoHandle>& windowHandle) const {
+    auto [begin, end] = mWindowsById.equal_range(windowHandle->getId());
+    for (auto it = begin; it != end; it++) {
+        const sp<WindowInfoHandle>& handle = it->second;
+        if (handle->getToken() != windowHandle->getToken()) {
+            continue;
+        }
+        if (windowHandle->getInfo()->displayId != handle->getInfo()->displayId) {
+            ALOGE("Found window %s in display %" PRId32
+                  ", but it should belong to display %" PRId32,
+                  windowHandle->getName().c_str(), handle->getInfo()->displayId,
+                  windowHandle->getInfo()->displayId);
+        }
+        return handle;
+    }
+    return nullptr;
+}
+
+void WindowInfosSnapshot::indexDisplay(int32_t displayId) {
+    const WindowHandles& windowHandles = mWindowHandlesByDisplay.at(displayId);
+    for (const sp<WindowInfoHandle>& handle : windowHandles) {
+        mWindowsById.emplace(handle->getId(), handle);
+    }
+    const DisplayInfo* displayInfo = getDisplayInfo(displayId);
+    WindowHitIndex hitIndex = displayInfo != nullptr
+            ? WindowHitIndex(windowHandles, displayInfo->transform,
+                             Rect(displayInfo->logicalWidth, displayInfo->logicalHeight))
+            : WindowHitIndex(windowHandles, ui::Transform(), Rect());
+    mWindowHitIndexByDisplay.insert_or_assign(displayId, std::move(hitIndex));
+}
+
+} // namespace android::inputdispatcher
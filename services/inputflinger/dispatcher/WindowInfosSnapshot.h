@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gui/DisplayInfo.h>
+#include <gui/WindowInfo.h>
+#include <ui/Transform.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "WindowHitIndex.h"
+
+namespace android::inputdispatcher {
+
+/**
+ * The windows and displays of a window infos update, along with the hit test index of each display.
+ *
+ * A snapshot is never changed once it is built, and neither are the window handles in it: every
+ * update gets a new snapshot, with new handles, which the dispatcher swaps in. Whoever holds on to
+ * a snapshot can keep reading it without any lock while newer ones are published.
+ */
+class WindowInfosSnapshot {
+public:
+    using WindowHandles = std::vector<sp<gui::WindowInfoHandle>>;
+
+    WindowInfosSnapshot() = default;
+    // The windows of each display must be ordered from front to back.
+    WindowInfosSnapshot(std::unordered_map<int32_t /*displayId*/, WindowHandles> windowHandles,
+                        std::unordered_map<int32_t /*displayId*/, gui::DisplayInfo> displayInfos);
+
+    // A copy of this snapshot in which the windows of the display are replaced. Only the hit test
+    // index of that display is rebuilt.
+    std::shared_ptr<const WindowInfosSnapshot> withWindowsOnDisplay(
+            int32_t displayId, WindowHandles windowHandles) const;
+
+    const std::unordered_map<int32_t /*displayId*/, WindowHandles>& getWindowHandlesByDisplay()
+            const {
+        return mWindowHandlesByDisplay;
+    }
+    // The windows of the display, or an empty list if it has none.
+    const WindowHandles& getWindowHandles(int32_t displayId) const;
+    // The hit test index of the windows of the display, or an empty index if it has none.
+    const WindowHitIndex& getWindowHitIndex(int32_t displayId) const;
+
+    const std::unordered_map<int32_t /*displayId*/, gui::DisplayInfo>& getDisplayInfos() const {
+        return mDisplayInfos;
+    }
+    // Null if the update had no info for the display.
+    const gui::DisplayInfo* getDisplayInfo(int32_t displayId) const;
+    // The identity transform if the update had no info for the display.
+    ui::Transform getTransform(int32_t displayId) const;
+
+    // The handle in this snapshot of the window that 'windowHandle' describes, i.e. the one with
+    // the same id and token, or null if the window is gone. 'windowHandle' may come from an older
+    // snapshot.
+    sp<gui::WindowInfoHandle> findWindow(const sp<gui::WindowInfoHandle>& windowHandle) const;
+
+private:
+    std::unordered_map<int32_t /*displayId*/, WindowHandles> mWindowHandlesByDisplay;
+    std::unordered_map<int32_t /*displayId*/, gui::DisplayInfo> mDisplayInfos;
+    std::unordered_map<int32_t /*displayId*/, WindowHitIndex> mWindowHitIndexByDisplay;
+    // Ids are only expected to be unique per display, so there may be more than one window per id.
+    std::unordered_multimap<int32_t /*windowId*/, sp<gui::WindowInfoHandle>> mWindowsById;
+
+    void indexDisplay(int32_t displayId);
+};
+
+} // namespace android::inputdispatcher
@@ -236,6 +236,11 @@ public:
      */
     virtual bool isPointerInWindow(const sp<IBinder>& token, int32_t displayId, DeviceId deviceId,
                                    int32_t pointerId) = 0;
+
+    /*
+     * Returns the per-stage latency percentiles of the input events, keyed by device and source.
+     */
+    virtual std::string dumpLatencyBreakdown() const = 0;
 };
 
 } // namespace android
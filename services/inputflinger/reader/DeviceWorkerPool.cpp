@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DeviceWorkerPool.h"
+
+#include <android-base/stringprintf.h>
+#include <utils/Thread.h>
+
+namespace android {
+
+// Same as the InputThread, since the workers are doing the work of the reader thread.
+class DeviceWorkerPool::Worker : public Thread {
+public:
+    explicit Worker(DeviceWorkerPool& pool) : Thread(/*canCallJava=*/true), mPool(pool) {}
+
+private:
+    DeviceWorkerPool& mPool;
+
+    bool threadLoop() override {
+        mPool.mTasks.workerLoop();
+        return false;
+    }
+};
+
+DeviceWorkerPool::DeviceWorkerPool(size_t numWorkers) {
+    for (size_t i = 0; i < numWorkers; i++) {
+        sp<Thread> worker = sp<Worker>::make(*this);
+        worker->run(base::StringPrintf("InputReader%zu", i + 1).c_str(),
+                    ANDROID_PRIORITY_URGENT_DISPLAY);
+        mWorkers.push_back(std::move(worker));
+    }
+}
+
+DeviceWorkerPool::~DeviceWorkerPool() {
+    mTasks.stop();
+    for (const sp<Thread>& worker : mWorkers) {
+        worker->requestExitAndWait();
+    }
+}
+
+void DeviceWorkerPool::run(const std::vector<std::function<void()>>& tasks) {
+    mTasks.run(tasks);
+}
+
+} // namespace android
@@ -1845,11 +1845,17 @@ std::optional<int32_t> EventHub::getBatteryStatus(int32_t deviceId, int32_t batt
 }
 
 std::vector<RawEvent> EventHub::getEvents(int timeoutMillis) {
+    std::vector<RawEvent> events;
+    getEventsInto(timeoutMillis, events);
+    return events;
+}
+
+void EventHub::getEventsInto(int timeoutMillis, std::vector<RawEvent>& events) {
     std::scoped_lock _l(mLock);
 
     std::array<input_event, EVENT_BUFFER_SIZE> readBuffer;
 
-    std::vector<RawEvent> events;
+    events.clear();
     bool awoken = false;
     for (;;) {
         nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
@@ -2009,6 +2015,8 @@ std::vector<RawEvent> EventHub::getEvents(int timeoutMillis) {
                     ALOGE("could not get event (wrong size: %d)", readSize);
                 } else {
                     const int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
+                    // All the events of a read were read at the same time.
+                    const nsecs_t readTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
                     const size_t count = size_t(readSize) / sizeof(struct input_event);
                     for (size_t i = 0; i < count; i++) {
@@ -2016,16 +2024,26 @@ std::vector<RawEvent> EventHub::getEvents(int timeoutMillis) {
                         device->trackInputEvent(iev);
                         events.push_back({
                                 .when = processEventTimestamp(iev),
-                                .readTime = systemTime(SYSTEM_TIME_MONOTONIC),
+                                .readTime = readTime,
                                 .deviceId = deviceId,
                                 .type = iev.type,
                                 .code = iev.code,
                                 .value = iev.value,
                         });
                     }
+
+                    Device::ReadStats& stats = device->readStats;
+                    stats.reads++;
+                    stats.events += count;
+                    stats.maxEventsPerRead = std::max(stats.maxEventsPerRead, count);
+                    if (count == readBuffer.size()) {
+                        stats.fullReads++;
+                    }
+
                     if (events.size() >= EVENT_BUFFER_SIZE) {
                         // The result buffer is full.  Reset the pending event index
                         // so we will try to read the device again on the next iteration.
+                        stats.deferrals++;
                         mPendingEventIndex -= 1;
                         break;
                     }
@@ -2103,9 +2121,6 @@ std::vector<RawEvent> EventHub::getEvents(int timeoutMillis) {
             mPendingEventCount = size_t(pollResult);
         }
     }
-
-    // All done, return the number of events we read.
-    return events;
 }
 
 std::vector<TouchVideoFrame> EventHub::getVideoFrames(int32_t deviceId) {
@@ -2923,6 +2938,12 @@ void EventHub::dump(std::string& dump) const {
                 }
                 dump += INDENT3 "AbsState: " + axisValues + "\n";
             }
+            const Device::ReadStats& readStats = device->readStats;
+            dump += StringPrintf(INDENT3 "ReadStats: reads=%" PRIu64 ", events=%" PRIu64
+                                         ", fullReads=%" PRIu64 ", deferrals=%" PRIu64
+                                         ", maxEventsPerRead=%zu\n",
+                                 readStats.reads, readStats.events, readStats.fullReads,
+                                 readStats.deferrals, readStats.maxEventsPerRead);
         }
 
         dump += INDENT "Unattached video devices:\n";
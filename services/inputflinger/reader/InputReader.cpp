@@ -19,6 +19,7 @@
 #include "InputReader.h"
 
 #include <android-base/stringprintf.h>
+#include <com_android_input_flags.h>
 #include <errno.h>
 #include <input/Keyboard.h>
 #include <input/VirtualKeyMap.h>
@@ -36,8 +37,14 @@
 
 using android::base::StringPrintf;
 
+namespace input_flags = com::android::input::flags;
+
 namespace android {
 
+// The number of threads, besides the reader thread, that process the events of input devices in
+// parallel when enable_parallel_input_mapping is on.
+static constexpr size_t NUM_DEVICE_WORKERS = 2;
+
 /**
  * Determines if the identifiers passed are a sub-devices. Sub-devices are physical devices
  * that expose multiple input device paths such a keyboard that also has a touchpad input.
@@ -69,6 +76,42 @@ static bool isStylusPointerGestureStart(const NotifyMotionArgs& motionArgs) {
     return isStylusToolType(motionArgs.pointerProperties[actionIndex].toolType);
 }
 
+static nsecs_t getEventTime(const NotifyArgs& args) {
+    return std::visit(
+            [](const auto& typedArgs) -> nsecs_t {
+                if constexpr (requires { typedArgs.eventTime; }) {
+                    return typedArgs.eventTime;
+                } else {
+                    // Does not come from a device, so there is nothing to order it against.
+                    return LLONG_MIN;
+                }
+            },
+            args);
+}
+
+/**
+ * Merges the events that were generated by several devices at the same time. The events of each
+ * device stay in their order. Across devices, the earliest event goes first, and ties go to the
+ * device that appears first, so that the result does not depend on which worker finished first.
+ */
+static std::list<NotifyArgs> mergeByEventTime(std::vector<std::list<NotifyArgs>>& argsPerDevice) {
+    std::list<NotifyArgs> out;
+    while (true) {
+        std::list<NotifyArgs>* earliest = nullptr;
+        for (std::list<NotifyArgs>& args : argsPerDevice) {
+            if (!args.empty() &&
+                (earliest == nullptr ||
+                 getEventTime(args.front()) < getEventTime(earliest->front()))) {
+                earliest = &args;
+            }
+        }
+        if (earliest == nullptr) {
+            return out;
+        }
+        out.splice(out.end(), *earliest, earliest->begin());
+    }
+}
+
 // --- InputReader ---
 
 InputReader::InputReader(std::shared_ptr<EventHubInterface> eventHub,
@@ -85,6 +128,9 @@ InputReader::InputReader(std::shared_ptr<EventHubInterface> eventHub,
         mDisableVirtualKeysTimeout(LLONG_MIN),
         mNextTimeout(LLONG_MAX),
         mConfigurationChangesToRefresh(0) {
+    if (input_flags::enable_parallel_input_mapping()) {
+        mWorkerPool = std::make_unique<DeviceWorkerPool>(NUM_DEVICE_WORKERS);
+    }
     refreshConfigurationLocked(/*changes=*/{});
     updateGlobalMetaStateLocked();
 }
@@ -133,7 +179,8 @@ void InputReader::loopOnce() {
         }
     } // release lock
 
-    std::vector<RawEvent> events = mEventHub->getEvents(timeoutMillis);
+    std::vector<RawEvent>& events = mEventBuffer;
+    mEventHub->getEventsInto(timeoutMillis, events);
 
     { // acquire lock
         std::scoped_lock _l(mLock);
@@ -193,6 +240,9 @@ void InputReader::loopOnce() {
 
 std::list<NotifyArgs> InputReader::processEventsLocked(const RawEvent* rawEvents, size_t count) {
     std::list<NotifyArgs> out;
+    // Batches that can go to the worker pool. They are held back until an event that has to be
+    // processed on this thread shows up, so that they are not reordered around it.
+    std::vector<DeviceBatch> parallelBatches;
     for (const RawEvent* rawEvent = rawEvents; count;) {
         int32_t type = rawEvent->type;
         size_t batchSize = 1;
@@ -208,8 +258,14 @@ std::list<NotifyArgs> InputReader::processEventsLocked(const RawEvent* rawEvents
             if (debugRawEvents()) {
                 ALOGD("BatchSize: %zu Count: %zu", batchSize, count);
             }
-            out += processEventsForDeviceLocked(deviceId, rawEvent, batchSize);
+            if (canProcessInParallelLocked(deviceId)) {
+                parallelBatches.push_back({deviceId, rawEvent, batchSize});
+            } else {
+                out += processParallelBatchesLocked(parallelBatches);
+                out += processEventsForDeviceLocked(deviceId, rawEvent, batchSize);
+            }
         } else {
+            out += processParallelBatchesLocked(parallelBatches);
             switch (rawEvent->type) {
                 case EventHubInterface::DEVICE_ADDED:
                     addDeviceLocked(rawEvent->when, rawEvent->deviceId);
@@ -228,9 +284,82 @@ std::list<NotifyArgs> InputReader::processEventsLocked(const RawEvent* rawEvents
         count -= batchSize;
         rawEvent += batchSize;
     }
+    out += processParallelBatchesLocked(parallelBatches);
     return out;
 }
 
+bool InputReader::canProcessInParallelLocked(int32_t eventHubId) {
+    if (mWorkerPool == nullptr) {
+        return false;
+    }
+    auto deviceIt = mDevices.find(eventHubId);
+    if (deviceIt == mDevices.end() || deviceIt->second->isIgnored()) {
+        return false;
+    }
+    // Keyboards (and the d-pads and gamepads, which also get a KeyboardInputMapper) update the
+    // global meta state and the LEDs of all the other devices, and an external stylus pushes its
+    // state into the touch devices. Those stay on the reader thread.
+    const ftl::Flags<InputDeviceClass> classes = deviceIt->second->getClasses();
+    if (classes.test(InputDeviceClass::KEYBOARD) || classes.test(InputDeviceClass::DPAD) ||
+        classes.test(InputDeviceClass::GAMEPAD) ||
+        classes.test(InputDeviceClass::EXTERNAL_STYLUS)) {
+        return false;
+    }
+    // Without PointerChoreographer, mice, touchpads and touch devices in pointer mode all move the
+    // single pointer controller of the reader, so they stay on the reader thread too.
+    if (!input_flags::enable_pointer_choreographer()) {
+        const bool isMouse = (deviceIt->second->getSources() & AINPUT_SOURCE_MOUSE) ==
+                AINPUT_SOURCE_MOUSE;
+        return !classes.test(InputDeviceClass::CURSOR) &&
+                !classes.test(InputDeviceClass::TOUCHPAD) && !isMouse;
+    }
+    return true;
+}
+
+std::list<NotifyArgs> InputReader::processParallelBatchesLocked(std::vector<DeviceBatch>& batches) {
+    if (batches.empty()) {
+        return {};
+    }
+    // The same device can have more than one batch, if its events are interleaved with the events
+    // of other devices, or if it has several EventHub devices. Its batches are processed in order
+    // by the same task.
+    std::vector<std::pair<std::shared_ptr<InputDevice>, std::vector<DeviceBatch>>> batchesPerDevice;
+    for (const DeviceBatch& batch : batches) {
+        const std::shared_ptr<InputDevice>& device = mDevices.at(batch.eventHubId);
+        auto it = std::find_if(batchesPerDevice.begin(), batchesPerDevice.end(),
+                               [&device](const auto& pair) { return pair.first == device; });
+        if (it == batchesPerDevice.end()) {
+            batchesPerDevice.emplace_back(device, std::vector<DeviceBatch>{batch});
+        } else {
+            it->second.push_back(batch);
+        }
+    }
+    batches.clear();
+
+    std::vector<std::list<NotifyArgs>> argsPerDevice(batchesPerDevice.size());
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(batchesPerDevice.size());
+    for (size_t i = 0; i < batchesPerDevice.size(); i++) {
+        tasks.push_back([&device = batchesPerDevice[i].first,
+                         &deviceBatches = batchesPerDevice[i].second, &out = argsPerDevice[i]]() {
+            for (const DeviceBatch& batch : deviceBatches) {
+                out += device->process(batch.rawEvents, batch.count);
+            }
+        });
+    }
+    if (tasks.size() == 1) {
+        tasks[0]();
+        return std::move(argsPerDevice[0]);
+    }
+    // While the workers run, this thread keeps holding mLock and waits for them, so the reader
+    // state that the devices reach through mContext is only shared among the workers. ContextImpl
+    // serializes that access while they run.
+    mContext.setWorkersRunning(true);
+    mWorkerPool->run(tasks);
+    mContext.setWorkersRunning(false);
+    return mergeByEventTime(argsPerDevice);
+}
+
 void InputReader::addDeviceLocked(nsecs_t when, int32_t eventHubId) {
     if (mDevices.find(eventHubId) != mDevices.end()) {
         ALOGW("Ignoring spurious device added event for eventHubId %d.", eventHubId);
@@ -1018,13 +1147,24 @@ void InputReader::monitor() {
 InputReader::ContextImpl::ContextImpl(InputReader* reader)
       : mReader(reader), mIdGenerator(IdGenerator::Source::INPUT_READER) {}
 
+std::unique_lock<std::mutex> InputReader::ContextImpl::lockSharedState() {
+    if (!mWorkersRunning) {
+        return {};
+    }
+    return std::unique_lock(mSharedStateLock);
+}
+
+void InputReader::ContextImpl::setWorkersRunning(bool running) {
+    mWorkersRunning = running;
+}
+
 void InputReader::ContextImpl::updateGlobalMetaState() {
     // lock is already held by the input loop
     mReader->updateGlobalMetaStateLocked();
 }
 
 int32_t InputReader::ContextImpl::getGlobalMetaState() {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     return mReader->getGlobalMetaStateLocked();
 }
 
@@ -1039,52 +1179,54 @@ int32_t InputReader::ContextImpl::getLedMetaState() {
 }
 
 void InputReader::ContextImpl::setPreventingTouchpadTaps(bool prevent) {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     mReader->mPreventingTouchpadTaps = prevent;
 }
 
 bool InputReader::ContextImpl::isPreventingTouchpadTaps() {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     return mReader->mPreventingTouchpadTaps;
 }
 
 void InputReader::ContextImpl::setLastKeyDownTimestamp(nsecs_t when) {
+    // lock is already held by the input loop
     mReader->mLastKeyDownTimestamp = when;
 }
 
 nsecs_t InputReader::ContextImpl::getLastKeyDownTimestamp() {
+    auto _l = lockSharedState();
     return mReader->mLastKeyDownTimestamp;
 }
 
 void InputReader::ContextImpl::disableVirtualKeysUntil(nsecs_t time) {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     mReader->disableVirtualKeysUntilLocked(time);
 }
 
 bool InputReader::ContextImpl::shouldDropVirtualKey(nsecs_t now, int32_t keyCode,
                                                     int32_t scanCode) {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     return mReader->shouldDropVirtualKeyLocked(now, keyCode, scanCode);
 }
 
 void InputReader::ContextImpl::fadePointer() {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     mReader->fadePointerLocked();
 }
 
 std::shared_ptr<PointerControllerInterface> InputReader::ContextImpl::getPointerController(
         int32_t deviceId) {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     return mReader->getPointerControllerLocked(deviceId);
 }
 
 void InputReader::ContextImpl::requestTimeoutAtTime(nsecs_t when) {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     mReader->requestTimeoutAtTimeLocked(when);
 }
 
 int32_t InputReader::ContextImpl::bumpGeneration() {
-    // lock is already held by the input loop
+    auto _l = lockSharedState();
     return mReader->bumpGenerationLocked();
 }
 
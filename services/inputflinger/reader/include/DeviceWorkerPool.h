@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <paralleltasks/ParallelTasks.h>
+#include <utils/StrongPointer.h>
+
+#include <functional>
+#include <vector>
+
+namespace android {
+
+class Thread;
+
+/**
+ * A small, fixed set of threads that the InputReader uses to process the events of independent
+ * input devices at the same time.
+ *
+ * The pool does not keep a queue: run() hands out a set of tasks, takes part in executing them on
+ * the calling thread, and only returns once all of them are done. The workers sleep in between.
+ */
+class DeviceWorkerPool {
+public:
+    explicit DeviceWorkerPool(size_t numWorkers);
+    ~DeviceWorkerPool();
+
+    DeviceWorkerPool(const DeviceWorkerPool&) = delete;
+    DeviceWorkerPool& operator=(const DeviceWorkerPool&) = delete;
+
+    /**
+     * Run all the tasks, in no particular order, and wait until they have all finished. Must not
+     * be called from more than one thread at a time.
+     */
+    void run(const std::vector<std::function<void()>>& tasks);
+
+    size_t getNumWorkers() const { return mWorkers.size(); }
+
+private:
+    class Worker;
+
+    ParallelTasks mTasks;
+    std::vector<sp<Thread>> mWorkers;
+};
+
+} // namespace android
@@ -308,6 +308,13 @@ public:
      * Returns the number of events obtained, or 0 if the timeout expired.
      */
     virtual std::vector<RawEvent> getEvents(int timeoutMillis) = 0;
+    /*
+     * Same as getEvents(), but returns the events in 'outEvents', which is cleared first. Callers
+     * that keep 'outEvents' across calls avoid reallocating it on every loop.
+     */
+    virtual void getEventsInto(int timeoutMillis, std::vector<RawEvent>& outEvents) {
+        outEvents = getEvents(timeoutMillis);
+    }
     virtual std::vector<TouchVideoFrame> getVideoFrames(int32_t deviceId) = 0;
     virtual base::Result<std::pair<InputDeviceSensorType, int32_t>> mapSensor(
             int32_t deviceId, int32_t absCode) const = 0;
@@ -563,6 +570,7 @@ public:
                                uint8_t* outFlags) const override final;
 
     std::vector<RawEvent> getEvents(int timeoutMillis) override final;
+    void getEventsInto(int timeoutMillis, std::vector<RawEvent>& outEvents) override final;
     std::vector<TouchVideoFrame> getVideoFrames(int32_t deviceId) override final;
 
     bool hasScanCode(int32_t deviceId, int32_t scanCode) const override final;
@@ -693,6 +701,18 @@ private:
 
         bool currentFrameDropped;
         void trackInputEvent(const struct input_event& event);
+
+        // How the reads from the device went, to tell whether the reader keeps up with it.
+        struct ReadStats {
+            uint64_t reads = 0;
+            uint64_t events = 0;
+            // Reads that filled the read buffer, so the device likely had more events queued.
+            uint64_t fullReads = 0;
+            // Times the device was left for the next getEvents() call because the result was full.
+            uint64_t deferrals = 0;
+            size_t maxEventsPerRead = 0;
+        };
+        ReadStats readStats;
         void readDeviceState();
     };
 
@@ -25,6 +25,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "DeviceWorkerPool.h"
 #include "EventHub.h"
 #include "InputListener.h"
 #include "InputReaderBase.h"
@@ -132,35 +133,52 @@ protected:
     class ContextImpl : public InputReaderContext {
         InputReader* mReader;
         IdGenerator mIdGenerator;
+        // While the worker pool runs, the reader thread holds mReader->mLock and waits for it, and
+        // the devices on the workers reach the reader state through this context. The calls they
+        // can make take this lock, but only while the pool runs, and never across calls into
+        // devices or mappers.
+        std::mutex mSharedStateLock;
+        // Only changed by the reader thread, while the workers are idle.
+        bool mWorkersRunning = false;
+
+        // Locks mSharedStateLock if the worker pool is running.
+        std::unique_lock<std::mutex> lockSharedState();
 
     public:
         explicit ContextImpl(InputReader* reader);
+        // Called by the reader thread before and after it runs the worker pool.
+        void setWorkersRunning(bool running);
+
+        // Only called on the reader thread, by keyboards. These call into the other devices, so the
+        // worker pool must not be running.
         // lock is already held by the input loop
         void updateGlobalMetaState() NO_THREAD_SAFETY_ANALYSIS override;
-        int32_t getGlobalMetaState() NO_THREAD_SAFETY_ANALYSIS override;
-        void disableVirtualKeysUntil(nsecs_t time) REQUIRES(mReader->mLock) override;
-        bool shouldDropVirtualKey(nsecs_t now, int32_t keyCode, int32_t scanCode)
-                REQUIRES(mReader->mLock) override;
-        void fadePointer() REQUIRES(mReader->mLock) override;
-        std::shared_ptr<PointerControllerInterface> getPointerController(int32_t deviceId)
-                REQUIRES(mReader->mLock) override;
-        void requestTimeoutAtTime(nsecs_t when) REQUIRES(mReader->mLock) override;
-        int32_t bumpGeneration() NO_THREAD_SAFETY_ANALYSIS override;
+        void updateLedMetaState(int32_t metaState) REQUIRES(mReader->mLock) override;
+        int32_t getLedMetaState() REQUIRES(mReader->mLock) override;
+        void setLastKeyDownTimestamp(nsecs_t when) REQUIRES(mReader->mLock) override;
+        // Only called on the reader thread, by touch devices and external styluses.
         void getExternalStylusDevices(std::vector<InputDeviceInfo>& outDevices)
                 REQUIRES(mReader->mLock) override;
         [[nodiscard]] std::list<NotifyArgs> dispatchExternalStylusState(const StylusState& outState)
                 REQUIRES(mReader->mLock) override;
-        InputReaderPolicyInterface* getPolicy() REQUIRES(mReader->mLock) override;
-        EventHubInterface* getEventHub() REQUIRES(mReader->mLock) override;
-        int32_t getNextId() NO_THREAD_SAFETY_ANALYSIS override;
-        void updateLedMetaState(int32_t metaState) REQUIRES(mReader->mLock) override;
-        int32_t getLedMetaState() REQUIRES(mReader->mLock) REQUIRES(mLock) override;
-        void setPreventingTouchpadTaps(bool prevent) REQUIRES(mReader->mLock)
-                REQUIRES(mLock) override;
-        bool isPreventingTouchpadTaps() REQUIRES(mReader->mLock) REQUIRES(mLock) override;
-        void setLastKeyDownTimestamp(nsecs_t when) REQUIRES(mReader->mLock)
-                REQUIRES(mLock) override;
-        nsecs_t getLastKeyDownTimestamp() REQUIRES(mReader->mLock) REQUIRES(mLock) override;
+
+        // Also called on the workers, which don't hold mReader->mLock themselves; the reader thread
+        // holds it while it waits for them.
+        int32_t getGlobalMetaState() NO_THREAD_SAFETY_ANALYSIS override;
+        void disableVirtualKeysUntil(nsecs_t time) NO_THREAD_SAFETY_ANALYSIS override;
+        bool shouldDropVirtualKey(nsecs_t now, int32_t keyCode, int32_t scanCode)
+                NO_THREAD_SAFETY_ANALYSIS override;
+        void fadePointer() NO_THREAD_SAFETY_ANALYSIS override;
+        std::shared_ptr<PointerControllerInterface> getPointerController(int32_t deviceId)
+                NO_THREAD_SAFETY_ANALYSIS override;
+        void requestTimeoutAtTime(nsecs_t when) NO_THREAD_SAFETY_ANALYSIS override;
+        int32_t bumpGeneration() NO_THREAD_SAFETY_ANALYSIS override;
+        InputReaderPolicyInterface* getPolicy() override;
+        EventHubInterface* getEventHub() override;
+        int32_t getNextId() override;
+        void setPreventingTouchpadTaps(bool prevent) NO_THREAD_SAFETY_ANALYSIS override;
+        bool isPreventingTouchpadTaps() NO_THREAD_SAFETY_ANALYSIS override;
+        nsecs_t getLastKeyDownTimestamp() NO_THREAD_SAFETY_ANALYSIS override;
     } mContext;
 
     friend class ContextImpl;
@@ -176,6 +194,11 @@ private:
     // it is made shared_ptr here. In the tests, an EventHub reference is retained by the test
     // in parallel to passing it to the InputReader.
     std::shared_ptr<EventHubInterface> mEventHub;
+    // Only used by loopOnce(), and kept across loops so that its capacity is reused.
+    std::vector<RawEvent> mEventBuffer;
+    // Processes independent devices at the same time. Null unless enable_parallel_input_mapping
+    // is on.
+    std::unique_ptr<DeviceWorkerPool> mWorkerPool;
     sp<InputReaderPolicyInterface> mPolicy;
 
     // The next stage that should receive the events generated inside InputReader.
@@ -215,6 +238,17 @@ private:
                                                                      size_t count) REQUIRES(mLock);
     [[nodiscard]] std::list<NotifyArgs> timeoutExpiredLocked(nsecs_t when) REQUIRES(mLock);
 
+    // Consecutive raw events of one EventHub device.
+    struct DeviceBatch {
+        int32_t eventHubId;
+        const RawEvent* rawEvents;
+        size_t count;
+    };
+    bool canProcessInParallelLocked(int32_t eventHubId) REQUIRES(mLock);
+    // Processes the batches on the worker pool, one task per device, and clears them.
+    [[nodiscard]] std::list<NotifyArgs> processParallelBatchesLocked(
+            std::vector<DeviceBatch>& batches) REQUIRES(mLock);
+
     void handleConfigurationChangedLocked(nsecs_t when) REQUIRES(mLock);
 
     int32_t mGlobalMetaState GUARDED_BY(mLock);
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DeviceWorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace android {
+
+using std::chrono_literals::operator""s;
+
+TEST(DeviceWorkerPoolTest, RunsAllTasks) {
+    DeviceWorkerPool pool(/*numWorkers=*/2);
+    for (size_t numTasks = 0; numTasks < 10; numTasks++) {
+        std::vector<std::atomic<int>> runs(numTasks);
+        std::vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < numTasks; i++) {
+            tasks.push_back([&runs, i]() { runs[i]++; });
+        }
+        pool.run(tasks);
+        for (size_t i = 0; i < numTasks; i++) {
+            ASSERT_EQ(1, runs[i]) << "task " << i << " of " << numTasks;
+        }
+    }
+}
+
+TEST(DeviceWorkerPoolTest, TasksRunAtTheSameTime) {
+    DeviceWorkerPool pool(/*numWorkers=*/2);
+    std::mutex lock;
+    std::condition_variable allStarted;
+    size_t numStarted = 0;
+    std::atomic<size_t> numTimedOut = 0;
+    auto task = [&]() {
+        std::unique_lock l(lock);
+        numStarted++;
+        allStarted.notify_all();
+        // Only possible if all three tasks are running at once.
+        if (!allStarted.wait_for(l, 5s, [&]() { return numStarted == 3; })) {
+            numTimedOut++;
+        }
+    };
+    pool.run({task, task, task});
+    ASSERT_EQ(0u, numTimedOut);
+}
+
+TEST(DeviceWorkerPoolTest, CallingThreadTakesPart) {
+    DeviceWorkerPool pool(/*numWorkers=*/0);
+    const std::thread::id caller = std::this_thread::get_id();
+    std::vector<std::thread::id> ids(3);
+    pool.run({[&]() { ids[0] = std::this_thread::get_id(); },
+              [&]() { ids[1] = std::this_thread::get_id(); },
+              [&]() { ids[2] = std::this_thread::get_id(); }});
+    ASSERT_EQ(std::vector<std::thread::id>(3, caller), ids);
+}
+
+} // namespace android
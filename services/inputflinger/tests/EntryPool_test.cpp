@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/Entry.h"
+#include "../dispatcher/EntryPool.h"
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace inputdispatcher {
+
+namespace {
+
+std::unique_ptr<MotionEntry> createMotionEntry(size_t pointerCount) {
+    std::vector<PointerProperties> pointerProperties(pointerCount);
+    std::vector<PointerCoords> pointerCoords(pointerCount);
+    for (size_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = ToolType::FINGER;
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 10 * i);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 20 * i);
+    }
+    return std::make_unique<MotionEntry>(/*id=*/1, /*injectionState=*/nullptr, /*eventTime=*/0,
+                                         /*deviceId=*/1, AINPUT_SOURCE_TOUCHSCREEN,
+                                         ADISPLAY_ID_DEFAULT, /*policyFlags=*/0,
+                                         AMOTION_EVENT_ACTION_MOVE, /*actionButton=*/0,
+                                         /*flags=*/0, AMETA_NONE, /*buttonState=*/0,
+                                         MotionClassification::NONE, AMOTION_EVENT_EDGE_FLAG_NONE,
+                                         /*xPrecision=*/0, /*yPrecision=*/0,
+                                         AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                         AMOTION_EVENT_INVALID_CURSOR_POSITION, /*downTime=*/0,
+                                         pointerProperties, pointerCoords);
+}
+
+} // namespace
+
+class EntryPoolTest : public testing::Test {
+protected:
+    void SetUp() override { EntryPool::trim(); }
+    void TearDown() override { EntryPool::trim(); }
+};
+
+TEST_F(EntryPoolTest, ReusesFreedBlocks) {
+    void* first = EntryPool::allocate(100);
+    ASSERT_EQ(0u, EntryPool::getStats().freeBlocks);
+    EntryPool::deallocate(first, 100);
+    ASSERT_EQ(1u, EntryPool::getStats().freeBlocks);
+
+    // Same size class.
+    void* second = EntryPool::allocate(120);
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(0u, EntryPool::getStats().freeBlocks);
+    EntryPool::deallocate(second, 120);
+    ASSERT_EQ(1u, EntryPool::getStats().freeBlocks);
+}
+
+TEST_F(EntryPoolTest, LargeBlocksUseHeap) {
+    void* ptr = EntryPool::allocate(EntryPool::kMaxPooledSize + 1);
+    ASSERT_NE(nullptr, ptr);
+    EntryPool::deallocate(ptr, EntryPool::kMaxPooledSize + 1);
+
+    ASSERT_EQ(0u, EntryPool::getStats().freeBlocks);
+}
+
+TEST_F(EntryPoolTest, MotionEntriesAreRecycled) {
+    // Warm up the pool with the entry and both of its pointer arrays.
+    createMotionEntry(/*pointerCount=*/2).reset();
+    EntryPool::Stats stats = EntryPool::getStats();
+    ASSERT_EQ(1u, stats.freeBlocks);
+    ASSERT_EQ(1u, stats.freePointerProperties);
+    ASSERT_EQ(1u, stats.freePointerCoords);
+
+    for (int i = 0; i < 10; i++) {
+        std::unique_ptr<MotionEntry> entry = createMotionEntry(/*pointerCount=*/2);
+        stats = EntryPool::getStats();
+        ASSERT_EQ(0u, stats.freeBlocks);
+        ASSERT_EQ(0u, stats.freePointerProperties);
+        ASSERT_EQ(0u, stats.freePointerCoords);
+
+        ASSERT_EQ(2u, entry->getPointerCount());
+        ASSERT_EQ(1, entry->pointerProperties[1].id);
+        ASSERT_EQ(10, entry->pointerCoords[1].getX());
+        ASSERT_EQ(20, entry->pointerCoords[1].getY());
+
+        entry.reset();
+        stats = EntryPool::getStats();
+        ASSERT_EQ(1u, stats.freeBlocks);
+        ASSERT_EQ(1u, stats.freePointerProperties);
+        ASSERT_EQ(1u, stats.freePointerCoords);
+    }
+}
+
+TEST_F(EntryPoolTest, RecycledEntryHasNoStalePointers) {
+    createMotionEntry(/*pointerCount=*/5).reset();
+
+    std::unique_ptr<MotionEntry> entry = createMotionEntry(/*pointerCount=*/1);
+    ASSERT_EQ(1u, entry->getPointerCount());
+    ASSERT_EQ(1u, entry->pointerCoords.size());
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
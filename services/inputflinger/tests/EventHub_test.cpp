@@ -218,6 +218,29 @@ TEST_F(EventHubTest, InputEvent_TimestampIsMonotonic) {
     }
 }
 
+/**
+ * Ensure that getEventsInto replaces the contents of the buffer it is given, and that events read
+ * together share the same read time.
+ */
+TEST_F(EventHubTest, GetEventsInto_ReusesBuffer) {
+    std::vector<RawEvent> events;
+    events.push_back({.type = EventHubInterface::FINISHED_DEVICE_SCAN});
+    mEventHub->getEventsInto(/*timeoutMillis=*/0, events);
+    ASSERT_TRUE(events.empty());
+
+    // The key events are all queued before they are read, so a single read returns them.
+    ASSERT_NO_FATAL_FAILURE(mKeyboard->pressAndReleaseHomeKey());
+    const std::chrono::milliseconds timeout = 2s;
+    mEventHub->getEventsInto(timeout.count(), events);
+    ASSERT_EQ(4U, events.size()) << "Expected to receive 2 keys and 2 syncs, total of 4 events";
+    const nsecs_t readTime = events.front().readTime;
+    for (const RawEvent& event : events) {
+        ASSERT_EQ(mDeviceId, event.deviceId);
+        ASSERT_LE(event.when, event.readTime);
+        ASSERT_EQ(readTime, event.readTime);
+    }
+}
+
 // --- BitArrayTest ---
 class BitArrayTest : public testing::Test {
 protected:
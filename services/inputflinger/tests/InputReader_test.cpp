@@ -1214,6 +1214,104 @@ TEST_F(InputReaderTest, VibratorGetVibratorIds) {
     ASSERT_EQ(mReader->getVibratorIds(deviceId).size(), 2U);
 }
 
+// --- ParallelInputReaderTest ---
+
+class ParallelInputReaderTest : public InputReaderTest {
+protected:
+    void SetUp() override {
+        input_flags::enable_parallel_input_mapping(true);
+        InputReaderTest::SetUp();
+    }
+
+    void TearDown() override {
+        InputReaderTest::TearDown();
+        input_flags::enable_parallel_input_mapping(false);
+    }
+};
+
+TEST_F(ParallelInputReaderTest, EventsOfSeveralDevicesAreMergedByEventTime) {
+    FakeInputMapper& mapper1 =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1000, /*eventHubId=*/1, "touch1",
+                                         InputDeviceClass::TOUCH, AINPUT_SOURCE_TOUCHSCREEN,
+                                         nullptr);
+    FakeInputMapper& mapper2 =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1001, /*eventHubId=*/2, "touch2",
+                                         InputDeviceClass::TOUCH, AINPUT_SOURCE_TOUCHSCREEN,
+                                         nullptr);
+    mapper1.setProcessResult({NotifySwitchArgs(/*id=*/1, /*eventTime=*/20, /*policyFlags=*/0,
+                                               /*switchValues=*/1, /*switchMask=*/1)});
+    mapper2.setProcessResult({NotifySwitchArgs(/*id=*/2, /*eventTime=*/10, /*policyFlags=*/0,
+                                               /*switchValues=*/2, /*switchMask=*/2)});
+
+    mFakeEventHub->enqueueEvent(/*when=*/20, /*readTime=*/30, /*deviceId=*/1, EV_ABS, ABS_X, 1);
+    mFakeEventHub->enqueueEvent(/*when=*/10, /*readTime=*/30, /*deviceId=*/2, EV_ABS, ABS_X, 1);
+    mReader->loopOnce();
+    ASSERT_NO_FATAL_FAILURE(mapper1.assertProcessWasCalled());
+    ASSERT_NO_FATAL_FAILURE(mapper2.assertProcessWasCalled());
+
+    NotifySwitchArgs args;
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifySwitchWasCalled(&args));
+    ASSERT_EQ(10, args.eventTime);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifySwitchWasCalled(&args));
+    ASSERT_EQ(20, args.eventTime);
+}
+
+TEST_F(ParallelInputReaderTest, KeyboardEventsAreNotReorderedAroundOtherDevices) {
+    FakeInputMapper& keyboardMapper =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1000, /*eventHubId=*/1, "keyboard",
+                                         InputDeviceClass::KEYBOARD, AINPUT_SOURCE_KEYBOARD,
+                                         nullptr);
+    FakeInputMapper& touchMapper =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1001, /*eventHubId=*/2, "touch",
+                                         InputDeviceClass::TOUCH, AINPUT_SOURCE_TOUCHSCREEN,
+                                         nullptr);
+    keyboardMapper.setProcessResult({NotifySwitchArgs(/*id=*/1, /*eventTime=*/20,
+                                                      /*policyFlags=*/0, /*switchValues=*/1,
+                                                      /*switchMask=*/1)});
+    touchMapper.setProcessResult({NotifySwitchArgs(/*id=*/2, /*eventTime=*/10, /*policyFlags=*/0,
+                                                   /*switchValues=*/2, /*switchMask=*/2)});
+
+    mFakeEventHub->enqueueEvent(/*when=*/20, /*readTime=*/30, /*deviceId=*/1, EV_KEY, KEY_A, 1);
+    mFakeEventHub->enqueueEvent(/*when=*/10, /*readTime=*/30, /*deviceId=*/2, EV_ABS, ABS_X, 1);
+    mReader->loopOnce();
+
+    // The keyboard is processed on the reader thread, in the order of the raw events.
+    NotifySwitchArgs args;
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifySwitchWasCalled(&args));
+    ASSERT_EQ(20, args.eventTime);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifySwitchWasCalled(&args));
+    ASSERT_EQ(10, args.eventTime);
+}
+
+TEST_F(ParallelInputReaderTest, MouseEventsAreNotReorderedWithoutPointerChoreographer) {
+    const bool choreographerEnabled = input_flags::enable_pointer_choreographer();
+    input_flags::enable_pointer_choreographer(false);
+    FakeInputMapper& mouseMapper =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1000, /*eventHubId=*/1, "mouse",
+                                         InputDeviceClass::CURSOR, AINPUT_SOURCE_MOUSE, nullptr);
+    FakeInputMapper& touchMapper =
+            addDeviceWithFakeInputMapper(END_RESERVED_ID + 1001, /*eventHubId=*/2, "touch",
+                                         InputDeviceClass::TOUCH, AINPUT_SOURCE_TOUCHSCREEN,
+                                         nullptr);
+    mouseMapper.setProcessResult({NotifySwitchArgs(/*id=*/1, /*eventTime=*/20, /*policyFlags=*/0,
+                                                   /*switchValues=*/1, /*switchMask=*/1)});
+    touchMapper.setProcessResult({NotifySwitchArgs(/*id=*/2, /*eventTime=*/10, /*policyFlags=*/0,
+                                                   /*switchValues=*/2, /*switchMask=*/2)});
+
+    mFakeEventHub->enqueueEvent(/*when=*/20, /*readTime=*/30, /*deviceId=*/1, EV_REL, REL_X, 1);
+    mFakeEventHub->enqueueEvent(/*when=*/10, /*readTime=*/30, /*deviceId=*/2, EV_ABS, ABS_X, 1);
+    mReader->loopOnce();
+    input_flags::enable_pointer_choreographer(choreographerEnabled);
+
+    // The mouse shares the pointer controller of the reader, so it is processed on the reader
+    // thread, in the order of the raw events.
+    NotifySwitchArgs args;
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifySwitchWasCalled(&args));
+    ASSERT_EQ(20, args.eventTime);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifySwitchWasCalled(&args));
+    ASSERT_EQ(10, args.eventTime);
+}
+
 // --- FakePeripheralController ---
 
 class FakePeripheralController : public PeripheralControllerInterface {
@@ -3751,6 +3849,47 @@ TEST_F(KeyboardInputMapperTest, Process_LockedKeysShouldToggleMetaStateAndLeds)
     ASSERT_EQ(AMETA_NONE, mapper.getMetaState());
 }
 
+// Runs with parallel input mapping on and off: toggling a lock key updates the LEDs of the devices
+// through the reader context, which must not take its own lock twice.
+class KeyboardInputMapperParallelMappingTest : public KeyboardInputMapperTest,
+                                               public testing::WithParamInterface<bool> {
+protected:
+    void SetUp() override {
+        input_flags::enable_parallel_input_mapping(GetParam());
+        KeyboardInputMapperTest::SetUp();
+    }
+
+    void TearDown() override {
+        KeyboardInputMapperTest::TearDown();
+        input_flags::enable_parallel_input_mapping(false);
+    }
+};
+
+TEST_P(KeyboardInputMapperParallelMappingTest, Process_LockedKeyShouldToggleMetaStateAndLed) {
+    mFakeEventHub->addLed(EVENTHUB_ID, LED_CAPSL, false /*initially off*/);
+    mFakeEventHub->addKey(EVENTHUB_ID, KEY_CAPSLOCK, 0, AKEYCODE_CAPS_LOCK, 0);
+
+    KeyboardInputMapper& mapper =
+            constructAndAddMapper<KeyboardInputMapper>(AINPUT_SOURCE_KEYBOARD,
+                                                       AINPUT_KEYBOARD_TYPE_ALPHABETIC);
+    ASSERT_EQ(AMETA_NONE, mapper.getMetaState());
+    ASSERT_FALSE(mFakeEventHub->getLedState(EVENTHUB_ID, LED_CAPSL));
+
+    // Toggle caps lock on.
+    process(mapper, ARBITRARY_TIME, READ_TIME, EV_KEY, KEY_CAPSLOCK, 1);
+    process(mapper, ARBITRARY_TIME, READ_TIME, EV_KEY, KEY_CAPSLOCK, 0);
+    ASSERT_TRUE(mFakeEventHub->getLedState(EVENTHUB_ID, LED_CAPSL));
+    ASSERT_EQ(AMETA_CAPS_LOCK_ON, mapper.getMetaState());
+
+    // Toggle caps lock off.
+    process(mapper, ARBITRARY_TIME, READ_TIME, EV_KEY, KEY_CAPSLOCK, 1);
+    process(mapper, ARBITRARY_TIME, READ_TIME, EV_KEY, KEY_CAPSLOCK, 0);
+    ASSERT_FALSE(mFakeEventHub->getLedState(EVENTHUB_ID, LED_CAPSL));
+    ASSERT_EQ(AMETA_NONE, mapper.getMetaState());
+}
+
+INSTANTIATE_TEST_SUITE_P(ParallelMapping, KeyboardInputMapperParallelMappingTest, testing::Bool());
+
 TEST_F(KeyboardInputMapperTest, NoMetaStateWhenMetaKeysNotPresent) {
     mFakeEventHub->addKey(EVENTHUB_ID, BTN_A, 0, AKEYCODE_BUTTON_A, 0);
     mFakeEventHub->addKey(EVENTHUB_ID, BTN_B, 0, AKEYCODE_BUTTON_B, 0);
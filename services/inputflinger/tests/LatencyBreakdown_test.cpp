@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/LatencyBreakdown.h"
+
+#include <binder/Binder.h>
+#include <gtest/gtest.h>
+#include <limits>
+
+namespace android {
+
+namespace inputdispatcher {
+
+using Stage = LatencyBreakdown::Stage;
+
+namespace {
+
+constexpr uint16_t VENDOR_ID = 0x18d1;
+constexpr uint16_t PRODUCT_ID = 0x4ee1;
+
+InputEventTimeline createTimeline(nsecs_t eventTime, std::set<InputDeviceUsageSource> sources) {
+    return InputEventTimeline(/*isDown=*/false, eventTime, /*readTime=*/eventTime + ms2ns(1),
+                              VENDOR_ID, PRODUCT_ID, sources);
+}
+
+// All of the stages take 'stageDuration'.
+InputEventTimeline createCompleteTimeline(nsecs_t stageDuration) {
+    InputEventTimeline timeline(/*isDown=*/false, /*eventTime=*/0, /*readTime=*/stageDuration,
+                                VENDOR_ID, PRODUCT_ID, {InputDeviceUsageSource::TOUCHSCREEN});
+    ConnectionTimeline connectionTimeline(/*deliveryTime=*/2 * stageDuration,
+                                          /*consumeTime=*/3 * stageDuration,
+                                          /*finishTime=*/4 * stageDuration);
+    std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline;
+    graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME] = 4 * stageDuration;
+    graphicsTimeline[GraphicsTimeline::PRESENT_TIME] = 5 * stageDuration;
+    connectionTimeline.setGraphicsTimeline(std::move(graphicsTimeline));
+    timeline.connectionTimelines.emplace(sp<BBinder>::make(), std::move(connectionTimeline));
+    return timeline;
+}
+
+const LatencyHistogram& getHistogram(const LatencyBreakdown& breakdown,
+                                     InputDeviceUsageSource source, Stage stage) {
+    const auto& histograms =
+            breakdown.getHistograms().at(LatencyBreakdown::Key{VENDOR_ID, PRODUCT_ID, source});
+    return histograms[static_cast<size_t>(stage)];
+}
+
+} // namespace
+
+TEST(LatencyHistogramTest, EmptyHistogram) {
+    LatencyHistogram histogram;
+    ASSERT_EQ(0u, histogram.count());
+    ASSERT_EQ(0, histogram.percentile(0.5));
+}
+
+TEST(LatencyHistogramTest, PercentilesAreWithinBucketPrecision) {
+    LatencyHistogram histogram;
+    // 1ms, 2ms, ..., 100ms
+    for (int i = 1; i <= 100; i++) {
+        histogram.add(ms2ns(i));
+    }
+    ASSERT_EQ(100u, histogram.count());
+    ASSERT_NEAR(ms2ns(50), histogram.percentile(0.5), ms2ns(50) * 0.125);
+    ASSERT_NEAR(ms2ns(90), histogram.percentile(0.9), ms2ns(90) * 0.125);
+    ASSERT_NEAR(ms2ns(99), histogram.percentile(0.99), ms2ns(99) * 0.125);
+    ASSERT_LE(histogram.percentile(0.5), histogram.percentile(0.9));
+}
+
+TEST(LatencyHistogramTest, IgnoresNegativeLatency) {
+    LatencyHistogram histogram;
+    histogram.add(-1);
+    ASSERT_EQ(0u, histogram.count());
+}
+
+TEST(LatencyHistogramTest, VeryLargeLatencyIsKept) {
+    LatencyHistogram histogram;
+    histogram.add(std::numeric_limits<nsecs_t>::max());
+    ASSERT_EQ(1u, histogram.count());
+    ASSERT_GT(histogram.percentile(1), s2ns(3600));
+}
+
+TEST(LatencyBreakdownTest, CompleteTimelineFillsAllStages) {
+    LatencyBreakdown breakdown;
+    breakdown.addTimeline(createCompleteTimeline(ms2ns(2)));
+
+    for (size_t i = 0; i < LatencyBreakdown::NUM_STAGES; i++) {
+        const Stage stage = static_cast<Stage>(i);
+        const LatencyHistogram& histogram =
+                getHistogram(breakdown, InputDeviceUsageSource::TOUCHSCREEN, stage);
+        ASSERT_EQ(1u, histogram.count());
+        const nsecs_t expected = stage == Stage::END_TO_END ? ms2ns(10) : ms2ns(2);
+        ASSERT_NEAR(expected, histogram.percentile(0.5), expected * 0.125);
+    }
+}
+
+TEST(LatencyBreakdownTest, TimelineWithoutGraphicsStillCountsDispatchStages) {
+    InputEventTimeline timeline = createTimeline(/*eventTime=*/0,
+                                                 {InputDeviceUsageSource::TOUCHSCREEN});
+    timeline.connectionTimelines.emplace(sp<BBinder>::make(),
+                                         ConnectionTimeline(/*deliveryTime=*/ms2ns(2),
+                                                            /*consumeTime=*/ms2ns(3),
+                                                            /*finishTime=*/ms2ns(4)));
+    LatencyBreakdown breakdown;
+    breakdown.addTimeline(timeline);
+
+    const InputDeviceUsageSource source = InputDeviceUsageSource::TOUCHSCREEN;
+    ASSERT_EQ(1u, getHistogram(breakdown, source, Stage::EVENT_TO_READ).count());
+    ASSERT_EQ(1u, getHistogram(breakdown, source, Stage::READ_TO_DELIVER).count());
+    ASSERT_EQ(1u, getHistogram(breakdown, source, Stage::DELIVER_TO_CONSUME).count());
+    ASSERT_EQ(1u, getHistogram(breakdown, source, Stage::CONSUME_TO_FINISH).count());
+    ASSERT_EQ(0u, getHistogram(breakdown, source, Stage::CONSUME_TO_GPU_COMPLETE).count());
+    ASSERT_EQ(0u, getHistogram(breakdown, source, Stage::END_TO_END).count());
+}
+
+TEST(LatencyBreakdownTest, KeyedBySource) {
+    LatencyBreakdown breakdown;
+    breakdown.addTimeline(createTimeline(/*eventTime=*/0,
+                                         {InputDeviceUsageSource::TOUCHSCREEN,
+                                          InputDeviceUsageSource::STYLUS_DIRECT}));
+    breakdown.addTimeline(createTimeline(/*eventTime=*/1, {InputDeviceUsageSource::TOUCHSCREEN}));
+
+    ASSERT_EQ(2u, breakdown.getHistograms().size());
+    ASSERT_EQ(2u,
+              getHistogram(breakdown, InputDeviceUsageSource::TOUCHSCREEN, Stage::EVENT_TO_READ)
+                      .count());
+    ASSERT_EQ(1u,
+              getHistogram(breakdown, InputDeviceUsageSource::STYLUS_DIRECT, Stage::EVENT_TO_READ)
+                      .count());
+}
+
+TEST(LatencyBreakdownTest, NumberOfKeysIsBounded) {
+    LatencyBreakdown breakdown;
+    for (uint16_t product = 0; product < LatencyBreakdown::MAX_KEYS + 5; product++) {
+        breakdown.addTimeline(InputEventTimeline(/*isDown=*/false, /*eventTime=*/0,
+                                                 /*readTime=*/1, VENDOR_ID, product,
+                                                 {InputDeviceUsageSource::TOUCHSCREEN}));
+    }
+    ASSERT_EQ(LatencyBreakdown::MAX_KEYS, breakdown.getHistograms().size());
+}
+
+TEST(LatencyBreakdownTest, Dump) {
+    LatencyBreakdown breakdown;
+    ASSERT_NE(std::string::npos, breakdown.dump("").find("<none>"));
+
+    breakdown.addTimeline(createCompleteTimeline(ms2ns(2)));
+    const std::string dump = breakdown.dump("");
+    ASSERT_NE(std::string::npos, dump.find("source=TOUCHSCREEN"));
+    ASSERT_NE(std::string::npos, dump.find("END_TO_END: count=1"));
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
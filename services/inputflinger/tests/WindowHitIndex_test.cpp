@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/WindowHitIndex.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+
+namespace inputdispatcher {
+
+using gui::WindowInfo;
+using gui::WindowInfoHandle;
+using testing::Contains;
+using testing::ElementsAre;
+using testing::Not;
+
+namespace {
+
+constexpr int32_t DISPLAY_WIDTH = 1000;
+constexpr int32_t DISPLAY_HEIGHT = 2000;
+
+sp<WindowInfoHandle> makeWindow(const Rect& frame) {
+    static int32_t sNextId = 1;
+    WindowInfo info;
+    info.id = sNextId++;
+    info.frame = frame;
+    info.touchableRegion = Region(frame);
+    return sp<WindowInfoHandle>::make(info);
+}
+
+// Lays out 'count' windows as 100x100 tiles from the top left of the display, row by row.
+std::vector<sp<WindowInfoHandle>> makeTiles(size_t count) {
+    std::vector<sp<WindowInfoHandle>> windows;
+    for (size_t i = 0; i < count; i++) {
+        const int32_t left = (i % 10) * 100;
+        const int32_t top = (i / 10) * 100;
+        windows.push_back(makeWindow(Rect(left, top, left + 100, top + 100)));
+    }
+    return windows;
+}
+
+// The candidates have to include every window whose touchable region contains the point.
+void assertCandidatesCover(const WindowHitIndex& index,
+                           const std::vector<sp<WindowInfoHandle>>& windows,
+                           const ui::Transform& transform, float x, float y) {
+    const vec2 logical = transform.transform(x, y);
+    const std::vector<size_t>& candidates = index.candidatesAt(logical);
+    ASSERT_TRUE(std::is_sorted(candidates.begin(), candidates.end()));
+    for (size_t i = 0; i < windows.size(); i++) {
+        const Region touchable = transform.transform(windows[i]->getInfo()->touchableRegion);
+        if (touchable.contains(std::floor(logical.x), std::floor(logical.y))) {
+            ASSERT_NE(candidates.end(), std::find(candidates.begin(), candidates.end(), i))
+                    << "window " << i << " missing at " << x << ", " << y;
+        }
+    }
+}
+
+} // namespace
+
+TEST(WindowHitIndexTest, FewWindows_ReturnsAll) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(3);
+    WindowHitIndex index(windows, ui::Transform(), Rect(DISPLAY_WIDTH, DISPLAY_HEIGHT));
+
+    ASSERT_THAT(index.candidatesAt(vec2(950, 1950)), ElementsAre(0, 1, 2));
+}
+
+TEST(WindowHitIndexTest, ManyWindows_ReturnsNearbyWindows) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(100);
+    // A full screen window below all the tiles.
+    windows.push_back(makeWindow(Rect(DISPLAY_WIDTH, DISPLAY_HEIGHT)));
+    WindowHitIndex index(windows, ui::Transform(), Rect(DISPLAY_WIDTH, DISPLAY_HEIGHT));
+
+    const std::vector<size_t>& candidates = index.candidatesAt(vec2(50, 50));
+    ASSERT_LT(candidates.size(), windows.size() / 4);
+    ASSERT_EQ(0u, candidates.front());
+    ASSERT_EQ(100u, candidates.back());
+
+    for (float x = 0.5; x < DISPLAY_WIDTH; x += 33) {
+        for (float y = 0.5; y < DISPLAY_HEIGHT; y += 33) {
+            assertCandidatesCover(index, windows, ui::Transform(), x, y);
+        }
+    }
+}
+
+TEST(WindowHitIndexTest, RotatedDisplay) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(100);
+    ui::Transform transform(ui::Transform::ROT_90, DISPLAY_HEIGHT, DISPLAY_WIDTH);
+    WindowHitIndex index(windows, transform, Rect(DISPLAY_HEIGHT, DISPLAY_WIDTH));
+
+    for (float x = 0.5; x < DISPLAY_WIDTH; x += 33) {
+        for (float y = 0.5; y < DISPLAY_HEIGHT; y += 33) {
+            assertCandidatesCover(index, windows, transform, x, y);
+        }
+    }
+}
+
+TEST(WindowHitIndexTest, WindowsOutsideDisplay) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(20);
+    windows.push_back(makeWindow(Rect(-500, -500, 100, 100)));
+    windows.push_back(makeWindow(Rect(DISPLAY_WIDTH + 10, 0, DISPLAY_WIDTH + 200, 200)));
+    WindowHitIndex index(windows, ui::Transform(), Rect(DISPLAY_WIDTH, DISPLAY_HEIGHT));
+
+    // Tile 15 is away from the edges of the display.
+    const std::vector<size_t>& aboveDisplay = index.candidatesAt(vec2(-100, -100));
+    ASSERT_THAT(aboveDisplay, Contains(20));
+    ASSERT_THAT(aboveDisplay, Not(Contains(15)));
+    const std::vector<size_t>& rightOfDisplay = index.candidatesAt(vec2(DISPLAY_WIDTH + 50, 50));
+    ASSERT_THAT(rightOfDisplay, Contains(21));
+    ASSERT_THAT(rightOfDisplay, Not(Contains(15)));
+}
+
+TEST(WindowHitIndexTest, UnknownDisplaySize_CoversAllWindows) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(50);
+    WindowHitIndex index(windows, ui::Transform(), Rect());
+
+    for (float x = 0.5; x < DISPLAY_WIDTH; x += 33) {
+        for (float y = 0.5; y < 500; y += 33) {
+            assertCandidatesCover(index, windows, ui::Transform(), x, y);
+        }
+    }
+}
+
+TEST(WindowHitIndexTest, IndexOf) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(10);
+    WindowHitIndex index(windows, ui::Transform(), Rect(DISPLAY_WIDTH, DISPLAY_HEIGHT));
+
+    ASSERT_EQ(0u, index.indexOf(windows, windows[0]));
+    ASSERT_EQ(7u, index.indexOf(windows, windows[7]));
+    ASSERT_EQ(windows.size(), index.indexOf(windows, makeWindow(Rect(10, 10))));
+}
+
+TEST(WindowHitIndexTest, IndexOf_OtherHandlesForTheSameWindows) {
+    std::vector<sp<WindowInfoHandle>> windows = makeTiles(10);
+    WindowHitIndex index(windows, ui::Transform(), Rect(DISPLAY_WIDTH, DISPLAY_HEIGHT));
+
+    std::vector<sp<WindowInfoHandle>> copies;
+    for (const sp<WindowInfoHandle>& window : windows) {
+        copies.push_back(sp<WindowInfoHandle>::make(*window->getInfo()));
+    }
+
+    ASSERT_EQ(3u, index.indexOf(copies, copies[3]));
+    ASSERT_EQ(windows.size(), index.indexOf(copies, windows[3]));
+    ASSERT_THAT(index.candidatesAt(vec2(350, 50)), Contains(3));
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
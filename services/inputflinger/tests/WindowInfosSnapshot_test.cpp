@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/WindowInfosSnapshot.h"
+
+#include <binder/Binder.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace inputdispatcher {
+
+using gui::DisplayInfo;
+using gui::WindowInfo;
+using gui::WindowInfoHandle;
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+namespace {
+
+constexpr int32_t DISPLAY_ID = 0;
+constexpr int32_t SECOND_DISPLAY_ID = 1;
+
+sp<WindowInfoHandle> makeWindow(int32_t id, int32_t displayId, const sp<IBinder>& token,
+                                const Rect& frame = Rect(0, 0, 100, 100)) {
+    WindowInfo info;
+    info.id = id;
+    info.displayId = displayId;
+    info.token = token;
+    info.frame = frame;
+    info.touchableRegion = Region(frame);
+    return sp<WindowInfoHandle>::make(info);
+}
+
+DisplayInfo makeDisplay(int32_t displayId, const ui::Transform& transform) {
+    DisplayInfo info;
+    info.displayId = displayId;
+    info.transform = transform;
+    info.logicalWidth = 1000;
+    info.logicalHeight = 2000;
+    return info;
+}
+
+} // namespace
+
+TEST(WindowInfosSnapshotTest, FindWindow_MatchesIdAndToken) {
+    const sp<IBinder> token = sp<BBinder>::make();
+    const sp<WindowInfoHandle> window = makeWindow(1, DISPLAY_ID, token);
+    WindowInfosSnapshot snapshot({{DISPLAY_ID, {window}}}, {});
+
+    // A handle of the same window from another update.
+    EXPECT_EQ(window, snapshot.findWindow(makeWindow(1, DISPLAY_ID, token)));
+    // Another window with the same id.
+    EXPECT_EQ(nullptr, snapshot.findWindow(makeWindow(1, DISPLAY_ID, sp<BBinder>::make())));
+    EXPECT_EQ(nullptr, snapshot.findWindow(makeWindow(2, DISPLAY_ID, token)));
+}
+
+TEST(WindowInfosSnapshotTest, MissingDisplay_ReturnsEmptyDefaults) {
+    WindowInfosSnapshot snapshot;
+
+    EXPECT_THAT(snapshot.getWindowHandles(DISPLAY_ID), IsEmpty());
+    EXPECT_THAT(snapshot.getWindowHitIndex(DISPLAY_ID).candidatesAt(vec2(10, 10)), IsEmpty());
+    EXPECT_EQ(nullptr, snapshot.getDisplayInfo(DISPLAY_ID));
+    EXPECT_EQ(ui::Transform(), snapshot.getTransform(DISPLAY_ID));
+}
+
+TEST(WindowInfosSnapshotTest, DisplayInfo_ProvidesTransform) {
+    ui::Transform transform;
+    transform.set(-100, -100);
+    const sp<WindowInfoHandle> window =
+            makeWindow(1, DISPLAY_ID, sp<BBinder>::make(), Rect(0, 0, 100, 100));
+    WindowInfosSnapshot snapshot({{DISPLAY_ID, {window}}},
+                                 {{DISPLAY_ID, makeDisplay(DISPLAY_ID, transform)}});
+
+    ASSERT_NE(nullptr, snapshot.getDisplayInfo(DISPLAY_ID));
+    EXPECT_EQ(transform, snapshot.getTransform(DISPLAY_ID));
+    EXPECT_THAT(snapshot.getWindowHitIndex(DISPLAY_ID).candidatesAt(transform.transform(150, 150)),
+                ElementsAre(0u));
+}
+
+TEST(WindowInfosSnapshotTest, WithWindowsOnDisplay_LeavesOriginalUnchanged) {
+    const sp<WindowInfoHandle> first = makeWindow(1, DISPLAY_ID, sp<BBinder>::make());
+    const sp<WindowInfoHandle> second = makeWindow(2, SECOND_DISPLAY_ID, sp<BBinder>::make());
+    WindowInfosSnapshot snapshot({{DISPLAY_ID, {first}}, {SECOND_DISPLAY_ID, {second}}}, {});
+
+    std::shared_ptr<const WindowInfosSnapshot> withoutFirst =
+            snapshot.withWindowsOnDisplay(DISPLAY_ID, {});
+
+    EXPECT_THAT(withoutFirst->getWindowHandles(DISPLAY_ID), IsEmpty());
+    EXPECT_EQ(0u, withoutFirst->getWindowHandlesByDisplay().count(DISPLAY_ID));
+    EXPECT_EQ(nullptr, withoutFirst->findWindow(first));
+    EXPECT_EQ(second, withoutFirst->findWindow(second));
+
+    EXPECT_THAT(snapshot.getWindowHandles(DISPLAY_ID), ElementsAre(first));
+    EXPECT_EQ(first, snapshot.findWindow(first));
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
@@ -280,6 +280,10 @@ public:
     // Enables overriding the 170M trasnfer function as sRGB
     virtual void setTreat170mAsSrgb(bool) = 0;
 
+    // Enables reusing the visible regions of the layers that did not change, and are not affected
+    // by the layers that did, when the geometry is updated
+    virtual void setIncrementalVisibleRegion(bool) = 0;
+
 protected:
     virtual void setDisplayColorProfile(std::unique_ptr<DisplayColorProfile>) = 0;
     virtual void setRenderSurface(std::unique_ptr<RenderSurface>) = 0;
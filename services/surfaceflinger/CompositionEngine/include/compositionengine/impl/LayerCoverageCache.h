@@ -0,0 +1,133 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <compositionengine/LayerFE.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <ui/FloatRect.h>
+#include <ui/LayerStack.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+namespace android::compositionengine::impl {
+
+// Keeps the coverage that an Output computed for each of its layers in the last geometry update,
+// so that the next update can skip the region arithmetic for the layers whose coverage can't have
+// changed.
+//
+// The coverage of a layer depends on its own geometry, and on the geometry of the layers above it.
+// The cache tracks the damage, which is the area where the layers above the current one changed:
+// the old and new footprints of the layers that were added, removed, moved in z or changed their
+// geometry. A layer is reused if its geometry did not change and its footprint does not overlap
+// the damage, since the layers above it then cover the same part of it as before.
+//
+// Layers must be looked up front to back, in the same order as they are processed.
+class LayerCoverageCache {
+public:
+    // The state of a layer that its coverage is computed from.
+    struct Geometry {
+        ui::Transform transform;
+        FloatRect bounds;
+        float shadowLength = 0.f;
+        bool isOpaque = false;
+        Region transparentRegionHint;
+        bool toInternalDisplay = false;
+        bool isDisplayDecoration = false;
+
+        static Geometry from(const LayerFECompositionState&);
+        bool operator==(const Geometry&) const;
+    };
+
+    // The coverage of a layer, as computed by Output::ensureOutputLayerIfVisible.
+    struct Coverage {
+        // The area that the layer and its shadow cover, before the layers above it are removed.
+        Region footprint;
+        Region opaqueRegion;
+        Region visibleRegion;
+        Region coveredRegion;
+        // Whether the layer is visible on the output, and so has an OutputLayer.
+        bool hasOutputLayer = false;
+    };
+
+    // The state of the output that the coverage of all of its layers depends on.
+    struct OutputGeometry {
+        ui::Transform transform;
+        Rect displayBounds;
+        Rect layerStackContent;
+        ui::LayerFilter layerFilter;
+        bool tracksCoveredExcludingOverlays = false;
+
+        bool operator==(const OutputGeometry&) const;
+    };
+
+    // Starts a geometry update. Nothing is reused if the geometry of the output changed.
+    void begin(const OutputGeometry&);
+
+    // Returns the coverage of the layer from the last update, if it is still valid. It is also kept
+    // for the next update. Otherwise, returns nullptr, and the caller must compute the coverage and
+    // record() it. 'hasOutputLayer' is whether the layer currently has an OutputLayer.
+    const Coverage* find(const LayerFE*, const Geometry&, bool hasOutputLayer);
+
+    // Records the coverage of the last layer that was passed to find().
+    void record(const LayerFE*, Geometry, Coverage);
+
+    // Ends the geometry update. The layers that were not found are dropped.
+    void end();
+
+    bool isActive() const { return mActive; }
+
+    // The number of layers that were reused, and that were computed, in the last update.
+    size_t getReusedCount() const { return mReusedCount; }
+    size_t getRecordedCount() const { return mRecordedCount; }
+
+private:
+    struct Entry {
+        // Only used to identify the layer, and never dereferenced.
+        const LayerFE* layerFE;
+        Geometry geometry;
+        Coverage coverage;
+    };
+
+    std::optional<size_t> findLastIndex(const LayerFE*);
+    void addDamage(const Region&);
+    bool overlapsDamage(const Region&) const;
+
+    bool mActive = false;
+    OutputGeometry mOutputGeometry;
+
+    std::vector<Entry> mLastEntries;
+    std::vector<Entry> mEntries;
+    // The index of each layer in mLastEntries. Only built when the layers are not in the same order
+    // as in the last update.
+    std::unordered_map<const LayerFE*, size_t> mLastIndices;
+    // The index in mLastEntries of the layer that is expected next, if the order did not change.
+    size_t mNextLastIndex = 0;
+    Region mDamage;
+    // Whether the last layer passed to find() changed, so that its footprint must be added to the
+    // damage when it is recorded.
+    bool mLastFoundChanged = false;
+
+    size_t mReusedCount = 0;
+    size_t mRecordedCount = 0;
+};
+
+} // namespace android::compositionengine::impl
@@ -22,6 +22,7 @@
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
 #include <compositionengine/impl/GpuCompositionResult.h>
 #include <compositionengine/impl/HwcAsyncWorker.h>
+#include <compositionengine/impl/LayerCoverageCache.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
 #include <compositionengine/impl/planner/Planner.h>
@@ -110,6 +111,7 @@ public:
     bool canPredictCompositionStrategy(const CompositionRefreshArgs&) override;
     void setPredictCompositionStrategy(bool) override;
     void setTreat170mAsSrgb(bool) override;
+    void setIncrementalVisibleRegion(bool) override;
 
     // Testing
     const ReleasedLayers& getReleasedLayersForTest() const;
@@ -169,6 +171,10 @@ private:
     compositionengine::Output::ColorProfile pickColorProfile(
             const compositionengine::CompositionRefreshArgs&) const;
     void updateHwcAsyncWorker();
+    void reuseCachedCoverage(const sp<compositionengine::LayerFE>&, const LayerFECompositionState&,
+                             const LayerCoverageCache::Coverage&,
+                             std::optional<size_t> prevOutputLayerIndex,
+                             compositionengine::Output::CoverageState&);
     float getHdrSdrRatio(const std::shared_ptr<renderengine::ExternalTexture>& buffer) const;
 
     std::string mName;
@@ -186,6 +192,9 @@ private:
     bool mPredictCompositionStrategy = false;
     bool mOffloadPresent = false;
 
+    bool mIncrementalVisibleRegion = false;
+    LayerCoverageCache mLayerCoverageCache;
+
     // Whether the content must be recomposed this frame.
     bool mMustRecompose = false;
 };
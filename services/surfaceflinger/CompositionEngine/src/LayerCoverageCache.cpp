@@ -0,0 +1,158 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/LayerCoverageCache.h>
+
+namespace android::compositionengine::impl {
+
+using aidl::android::hardware::graphics::composer3::Composition;
+
+LayerCoverageCache::Geometry LayerCoverageCache::Geometry::from(
+        const LayerFECompositionState& state) {
+    return {.transform = state.geomLayerTransform,
+            .bounds = state.geomLayerBounds,
+            .shadowLength = state.shadowSettings.length,
+            .isOpaque = state.isOpaque,
+            .transparentRegionHint = state.transparentRegionHint,
+            .toInternalDisplay = state.outputFilter.toInternalDisplay,
+            .isDisplayDecoration = state.compositionType == Composition::DISPLAY_DECORATION};
+}
+
+bool LayerCoverageCache::Geometry::operator==(const Geometry& other) const {
+    return bounds == other.bounds && shadowLength == other.shadowLength &&
+            isOpaque == other.isOpaque && toInternalDisplay == other.toInternalDisplay &&
+            isDisplayDecoration == other.isDisplayDecoration && transform == other.transform &&
+            transparentRegionHint.hasSameRects(other.transparentRegionHint);
+}
+
+bool LayerCoverageCache::OutputGeometry::operator==(const OutputGeometry& other) const {
+    return transform == other.transform && displayBounds == other.displayBounds &&
+            layerStackContent == other.layerStackContent &&
+            layerFilter.layerStack == other.layerFilter.layerStack &&
+            layerFilter.toInternalDisplay == other.layerFilter.toInternalDisplay &&
+            tracksCoveredExcludingOverlays == other.tracksCoveredExcludingOverlays;
+}
+
+void LayerCoverageCache::begin(const OutputGeometry& outputGeometry) {
+    if (!(outputGeometry == mOutputGeometry)) {
+        mOutputGeometry = outputGeometry;
+        mLastEntries.clear();
+    }
+    mActive = true;
+    mEntries.clear();
+    mEntries.reserve(mLastEntries.size());
+    mLastIndices.clear();
+    mNextLastIndex = 0;
+    mDamage.clear();
+    mLastFoundChanged = false;
+    mReusedCount = 0;
+    mRecordedCount = 0;
+}
+
+const LayerCoverageCache::Coverage* LayerCoverageCache::find(const LayerFE* layerFE,
+                                                             const Geometry& geometry,
+                                                             bool hasOutputLayer) {
+    // Until the layer is found unchanged, it is treated as a new layer.
+    mLastFoundChanged = true;
+
+    const std::optional<size_t> lastIndex = findLastIndex(layerFE);
+    if (!lastIndex) {
+        return nullptr;
+    }
+
+    const Entry& lastEntry = mLastEntries[*lastIndex];
+    if (*lastIndex < mNextLastIndex) {
+        // The layer moved above some of the layers that were above it.
+        addDamage(lastEntry.coverage.footprint);
+        return nullptr;
+    }
+
+    // The layers that were expected before this one were removed, or moved below it.
+    for (size_t i = mNextLastIndex; i < *lastIndex; i++) {
+        addDamage(mLastEntries[i].coverage.footprint);
+    }
+    mNextLastIndex = *lastIndex + 1;
+
+    if (!(lastEntry.geometry == geometry)) {
+        addDamage(lastEntry.coverage.footprint);
+        return nullptr;
+    }
+    mLastFoundChanged = false;
+
+    if (lastEntry.coverage.hasOutputLayer != hasOutputLayer ||
+        overlapsDamage(lastEntry.coverage.footprint)) {
+        return nullptr;
+    }
+
+    mReusedCount++;
+    return &mEntries.emplace_back(lastEntry).coverage;
+}
+
+void LayerCoverageCache::record(const LayerFE* layerFE, Geometry geometry, Coverage coverage) {
+    if (mLastFoundChanged) {
+        addDamage(coverage.footprint);
+    }
+    mRecordedCount++;
+    mEntries.push_back(
+            {.layerFE = layerFE, .geometry = std::move(geometry), .coverage = std::move(coverage)});
+}
+
+void LayerCoverageCache::end() {
+    std::swap(mLastEntries, mEntries);
+    mEntries.clear();
+    mLastIndices.clear();
+    mDamage.clear();
+    mActive = false;
+}
+
+std::optional<size_t> LayerCoverageCache::findLastIndex(const LayerFE* layerFE) {
+    if (mNextLastIndex < mLastEntries.size() &&
+        mLastEntries[mNextLastIndex].layerFE == layerFE) {
+        return mNextLastIndex;
+    }
+
+    if (mLastIndices.empty()) {
+        for (size_t i = 0; i < mLastEntries.size(); i++) {
+            mLastIndices.emplace(mLastEntries[i].layerFE, i);
+        }
+    }
+    const auto it = mLastIndices.find(layerFE);
+    if (it == mLastIndices.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void LayerCoverageCache::addDamage(const Region& footprint) {
+    // Without layers from the last update, nothing can be reused, so the damage is not needed.
+    if (mLastEntries.empty()) {
+        return;
+    }
+    mDamage.orSelf(footprint);
+}
+
+bool LayerCoverageCache::overlapsDamage(const Region& footprint) const {
+    if (mDamage.isEmpty() || footprint.isEmpty()) {
+        return false;
+    }
+    Rect unused;
+    if (!mDamage.getBounds().intersect(footprint.getBounds(), &unused)) {
+        return false;
+    }
+    return !mDamage.intersect(footprint).isEmpty();
+}
+
+} // namespace android::compositionengine::impl
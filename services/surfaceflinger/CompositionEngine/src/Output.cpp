@@ -533,6 +533,17 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
 void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
                                   compositionengine::Output::CoverageState& coverage) {
+    if (mIncrementalVisibleRegion) {
+        const auto& outputState = getState();
+        mLayerCoverageCache.begin(
+                {.transform = outputState.transform,
+                 .displayBounds = outputState.displaySpace.getBoundsAsRect(),
+                 .layerStackContent = outputState.layerStackSpace.getContent(),
+                 .layerFilter = outputState.layerFilter,
+                 .tracksCoveredExcludingOverlays =
+                         coverage.aboveCoveredLayersExcludingOverlays.has_value()});
+    }
+
     // Evaluate the layers from front to back to determine what is visible. This
     // also incrementally calculates the coverage information for each layer as
     // well as the entire output.
@@ -544,6 +555,10 @@ void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArg
         // no more layers could even be visible underneath the ones on top.
     }
 
+    if (mLayerCoverageCache.isActive()) {
+        mLayerCoverageCache.end();
+    }
+
     setReleasedLayers(refreshArgs);
 
     finalizePendingOutputLayers();
@@ -574,6 +589,31 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         return;
     }
 
+    // The index of the layer's current OutputLayer. It is a linear search, so it is only done
+    // when needed, and at most once.
+    std::optional<std::optional<size_t>> prevOutputLayerIndexLookup;
+    const auto findPrevOutputLayerIndex = [&] {
+        if (!prevOutputLayerIndexLookup) {
+            prevOutputLayerIndexLookup = findCurrentOutputLayerForLayer(layerFE);
+        }
+        return *prevOutputLayerIndexLookup;
+    };
+
+    // Reuse the coverage from the last geometry update if neither the layer nor the layers above
+    // it changed where they overlap it
+    std::optional<LayerCoverageCache::Geometry> cacheGeometry;
+    if (mLayerCoverageCache.isActive()) {
+        cacheGeometry = LayerCoverageCache::Geometry::from(*layerFEState);
+        const auto prevOutputLayerIndex = findPrevOutputLayerIndex();
+        if (const auto* cachedCoverage =
+                    mLayerCoverageCache.find(layerFE.get(), *cacheGeometry,
+                                             prevOutputLayerIndex.has_value())) {
+            reuseCachedCoverage(layerFE, *layerFEState, *cachedCoverage, prevOutputLayerIndex,
+                                coverage);
+            return;
+        }
+    }
+
     bool computeAboveCoveredExcludingOverlays = coverage.aboveCoveredLayersExcludingOverlays &&
             !layerFEState->outputFilter.toInternalDisplay;
 
@@ -645,6 +685,20 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         return;
     }
 
+    // The footprint is what the layers below see of this layer. Keep it, with the rest of the
+    // coverage, for the next geometry update.
+    const Region footprint = visibleRegion;
+    const auto recordCoverage = [&](bool hasOutputLayer) {
+        if (cacheGeometry) {
+            mLayerCoverageCache.record(layerFE.get(), std::move(*cacheGeometry),
+                                       {.footprint = footprint,
+                                        .opaqueRegion = opaqueRegion,
+                                        .visibleRegion = visibleRegion,
+                                        .coveredRegion = coveredRegion,
+                                        .hasOutputLayer = hasOutputLayer});
+        }
+    };
+
     // Remove the transparent area from the visible region
     if (!layerFEState->isOpaque) {
         if (tr.preserveRects()) {
@@ -705,12 +759,13 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     visibleRegion.subtractSelf(coverage.aboveOpaqueLayers);
 
     if (visibleRegion.isEmpty()) {
+        recordCoverage(/*hasOutputLayer=*/false);
         return;
     }
 
     // Get coverage information for the layer as previously displayed,
     // also taking over ownership from mOutputLayersorderedByZ.
-    auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
+    auto prevOutputLayerIndex = findPrevOutputLayerIndex();
     auto prevOutputLayer =
             prevOutputLayerIndex ? getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex) : nullptr;
 
@@ -764,6 +819,7 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     Region drawRegion(outputState.transform.transform(visibleNonTransparentRegion));
     drawRegion.andSelf(outputState.displaySpace.getBoundsAsRect());
     if (drawRegion.isEmpty()) {
+        recordCoverage(/*hasOutputLayer=*/false);
         return;
     }
 
@@ -791,6 +847,43 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         outputLayerState.coveredRegionExcludingDisplayOverlays =
                 std::move(coveredRegionExcludingDisplayOverlays);
     }
+    recordCoverage(/*hasOutputLayer=*/true);
+}
+
+void Output::reuseCachedCoverage(const sp<compositionengine::LayerFE>& layerFE,
+                                 const LayerFECompositionState& layerFEState,
+                                 const LayerCoverageCache::Coverage& cachedCoverage,
+                                 std::optional<size_t> prevOutputLayerIndex,
+                                 compositionengine::Output::CoverageState& coverage) {
+    // This follows ensureOutputLayerIfVisible, for a layer whose regions are the same as in the
+    // last geometry update. The OutputLayer, if there is one, already has them.
+    coverage.aboveCoveredLayers.orSelf(cachedCoverage.footprint);
+    if (CC_UNLIKELY(coverage.aboveCoveredLayersExcludingOverlays &&
+                    !layerFEState.outputFilter.toInternalDisplay)) {
+        coverage.aboveCoveredLayersExcludingOverlays->orSelf(cachedCoverage.footprint);
+    }
+
+    const Region& visibleRegion = cachedCoverage.visibleRegion;
+    if (visibleRegion.isEmpty()) {
+        return;
+    }
+
+    // The old visible and covered regions are the same as the new ones, so the dirty region is
+    // what ensureOutputLayerIfVisible would compute for them. The visible region does not overlap
+    // the opaque layers above, so there is nothing to subtract.
+    if (layerFEState.contentDirty) {
+        coverage.dirtyRegion.orSelf(visibleRegion);
+    } else if (prevOutputLayerIndex) {
+        coverage.dirtyRegion.orSelf(visibleRegion.intersect(cachedCoverage.coveredRegion));
+    } else {
+        coverage.dirtyRegion.orSelf(visibleRegion.subtract(cachedCoverage.coveredRegion));
+    }
+
+    coverage.aboveOpaqueLayers.orSelf(cachedCoverage.opaqueRegion);
+
+    if (cachedCoverage.hasOutputLayer) {
+        ensureOutputLayer(prevOutputLayerIndex, layerFE);
+    }
 }
 
 void Output::setReleasedLayers(const compositionengine::CompositionRefreshArgs&) {
@@ -1692,6 +1785,10 @@ void Output::setTreat170mAsSrgb(bool enable) {
     editState().treat170mAsSrgb = enable;
 }
 
+void Output::setIncrementalVisibleRegion(bool enable) {
+    mIncrementalVisibleRegion = enable;
+}
+
 bool Output::canPredictCompositionStrategy(const CompositionRefreshArgs& refreshArgs) {
     uint64_t lastOutputLayerHash = getState().lastOutputLayerHash;
     uint64_t outputLayerHash = getState().outputLayerHash;
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/LayerCoverageCache.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace android::compositionengine {
+namespace {
+
+using impl::LayerCoverageCache;
+
+struct TestLayer {
+    sp<mock::LayerFE> layerFE = sp<mock::LayerFE>::make();
+    Rect bounds;
+    bool hasOutputLayer = true;
+};
+
+class LayerCoverageCacheTest : public testing::Test {
+public:
+    LayerCoverageCacheTest() {
+        mOutputGeometry.displayBounds = Rect(0, 0, 1000, 1000);
+        mOutputGeometry.layerStackContent = Rect(0, 0, 1000, 1000);
+    }
+
+    // Runs a geometry update over the layers, front to back, and returns whether each of them was
+    // reused.
+    std::vector<bool> update(const std::vector<TestLayer*>& layers) {
+        std::vector<bool> reused;
+        mCache.begin(mOutputGeometry);
+        for (const TestLayer* layer : layers) {
+            LayerCoverageCache::Geometry geometry{.bounds = layer->bounds.toFloatRect()};
+            if (mCache.find(layer->layerFE.get(), geometry, layer->hasOutputLayer)) {
+                reused.push_back(true);
+                continue;
+            }
+            reused.push_back(false);
+            mCache.record(layer->layerFE.get(), std::move(geometry),
+                          {.footprint = Region(layer->bounds),
+                           .visibleRegion = Region(layer->bounds),
+                           .hasOutputLayer = layer->hasOutputLayer});
+        }
+        mCache.end();
+        return reused;
+    }
+
+    LayerCoverageCache mCache;
+    LayerCoverageCache::OutputGeometry mOutputGeometry;
+    TestLayer mTop{.bounds = Rect(0, 0, 100, 100)};
+    TestLayer mOverlapping{.bounds = Rect(50, 50, 150, 150)};
+    TestLayer mApart{.bounds = Rect(500, 500, 600, 600)};
+};
+
+TEST_F(LayerCoverageCacheTest, firstUpdateComputesAllLayers) {
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({false, false, false}));
+    EXPECT_EQ(mCache.getReusedCount(), 0u);
+    EXPECT_EQ(mCache.getRecordedCount(), 3u);
+}
+
+TEST_F(LayerCoverageCacheTest, reusesUnchangedLayers) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({true, true, true}));
+    EXPECT_EQ(mCache.getReusedCount(), 3u);
+    EXPECT_EQ(mCache.getRecordedCount(), 0u);
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesLayersBelowAChangeThatOverlapIt) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    mTop.bounds = Rect(0, 0, 60, 60);
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({false, false, true}));
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesLayersBelowTheOldFootprintOfAChange) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    // The top layer no longer overlaps the one below it, which is now uncovered.
+    mTop.bounds = Rect(0, 0, 10, 10);
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({false, false, true}));
+}
+
+TEST_F(LayerCoverageCacheTest, reusesLayersAboveAChange) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    mOverlapping.bounds = Rect(0, 0, 200, 200);
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({true, false, true}));
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesLayersBelowARemovedLayer) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    EXPECT_EQ(update({&mOverlapping, &mApart}), std::vector({false, true}));
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesLayersBelowAnAddedLayer) {
+    update({&mOverlapping, &mApart});
+
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({false, false, true}));
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesLayersThatChangedOrder) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    EXPECT_EQ(update({&mOverlapping, &mTop, &mApart}), std::vector({false, false, true}));
+    EXPECT_EQ(update({&mOverlapping, &mTop, &mApart}), std::vector({true, true, true}));
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesLayersThatLostTheirOutputLayer) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    mApart.hasOutputLayer = false;
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({true, true, false}));
+}
+
+TEST_F(LayerCoverageCacheTest, recomputesAllLayersWhenTheOutputChanges) {
+    update({&mTop, &mOverlapping, &mApart});
+
+    mOutputGeometry.displayBounds = Rect(0, 0, 500, 500);
+    EXPECT_EQ(update({&mTop, &mOverlapping, &mApart}), std::vector({false, false, false}));
+}
+
+} // namespace
+} // namespace android::compositionengine
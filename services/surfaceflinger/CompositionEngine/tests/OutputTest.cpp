@@ -1995,6 +1995,171 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, transparentRegionClipsWhenOutsideBo
                 RegionEq(kTransparentRegionHint));
 }
 
+/*
+ * Output::setIncrementalVisibleRegion()
+ */
+
+// Runs the same frames through an output which reuses the coverage of unaffected layers, and one
+// which recomputes all of it, and expects the same results.
+struct OutputIncrementalVisibleRegionTest : public testing::Test {
+    struct Layer {
+        Layer() {
+            ON_CALL(*layerFE, getCompositionState()).WillByDefault(Return(&layerFEState));
+            ON_CALL(*layerFE, getDebugName()).WillByDefault(Return("Layer"));
+
+            layerFEState.outputFilter = {kLayerStack, false};
+            layerFEState.isVisible = true;
+            layerFEState.isOpaque = true;
+            layerFEState.contentDirty = true;
+        }
+
+        void setBounds(const Rect& bounds) { layerFEState.geomLayerBounds = bounds.toFloatRect(); }
+
+        sp<NiceMock<mock::LayerFE>> layerFE = sp<NiceMock<mock::LayerFE>>::make();
+        LayerFECompositionState layerFEState;
+    };
+
+    OutputIncrementalVisibleRegionTest() {
+        mIncrementalOutput->setIncrementalVisibleRegion(true);
+        for (auto* output : {mOutput.get(), mIncrementalOutput.get()}) {
+            auto& state = output->editState();
+            state.isEnabled = true;
+            state.displaySpace.setBounds(ui::Size(kDisplayBounds.width(), kDisplayBounds.height()));
+            state.layerStackSpace.setContent(kDisplayBounds);
+            state.transform = ui::Transform(TR_IDENT, kDisplayBounds.width(),
+                                            kDisplayBounds.height());
+            state.layerFilter = {kLayerStack, true};
+        }
+
+        mBackground.setBounds(kDisplayBounds);
+        mWindow.setBounds(Rect(10, 10, 60, 60));
+        mTranslucentWindow.setBounds(Rect(30, 30, 90, 120));
+        mTranslucentWindow.layerFEState.isOpaque = false;
+        mTranslucentWindow.layerFEState.transparentRegionHint = Region(Rect(0, 0, 20, 20));
+        mTranslucentWindow.layerFEState.shadowSettings.length = 4;
+        mSmallLayer.setBounds(Rect(70, 150, 90, 170));
+        mOverlay.setBounds(Rect(0, 180, 100, 200));
+        mOverlay.layerFEState.outputFilter.toInternalDisplay = true;
+
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+        mRefreshArgs.layers = {mBackground.layerFE, mWindow.layerFE, mTranslucentWindow.layerFE,
+                               mSmallLayer.layerFE};
+    }
+
+    void clearContentDirty() {
+        for (auto* layer : {&mBackground, &mWindow, &mTranslucentWindow, &mSmallLayer, &mOverlay}) {
+            layer->layerFEState.contentDirty = false;
+        }
+    }
+
+    static void expectSameOutputLayerState(const OutputLayer& expected, const OutputLayer& actual) {
+        const auto& expectedState = expected.getState();
+        const auto& actualState = actual.getState();
+        EXPECT_THAT(actualState.visibleRegion, RegionEq(expectedState.visibleRegion));
+        EXPECT_THAT(actualState.visibleNonTransparentRegion,
+                    RegionEq(expectedState.visibleNonTransparentRegion));
+        EXPECT_THAT(actualState.coveredRegion, RegionEq(expectedState.coveredRegion));
+        EXPECT_THAT(actualState.outputSpaceVisibleRegion,
+                    RegionEq(expectedState.outputSpaceVisibleRegion));
+        EXPECT_THAT(actualState.shadowRegion, RegionEq(expectedState.shadowRegion));
+        EXPECT_THAT(actualState.outputSpaceBlockingRegionHint,
+                    RegionEq(expectedState.outputSpaceBlockingRegionHint));
+        EXPECT_EQ(expectedState.coveredRegionExcludingDisplayOverlays.has_value(),
+                  actualState.coveredRegionExcludingDisplayOverlays.has_value());
+        if (expectedState.coveredRegionExcludingDisplayOverlays &&
+            actualState.coveredRegionExcludingDisplayOverlays) {
+            EXPECT_THAT(*actualState.coveredRegionExcludingDisplayOverlays,
+                        RegionEq(*expectedState.coveredRegionExcludingDisplayOverlays));
+        }
+    }
+
+    void rebuildLayerStacksAndCompare() {
+        for (auto* output : {mOutput.get(), mIncrementalOutput.get()}) {
+            output->editState().dirtyRegion.clear();
+            LayerFESet layerFESet;
+            output->rebuildLayerStacks(mRefreshArgs, layerFESet);
+        }
+
+        // The dirty region is what the coverage state accumulated for the frame.
+        EXPECT_THAT(mIncrementalOutput->getState().dirtyRegion,
+                    RegionEq(mOutput->getState().dirtyRegion));
+        EXPECT_THAT(mIncrementalOutput->getState().undefinedRegion,
+                    RegionEq(mOutput->getState().undefinedRegion));
+
+        ASSERT_EQ(mOutput->getOutputLayerCount(), mIncrementalOutput->getOutputLayerCount());
+        for (size_t i = 0; i < mOutput->getOutputLayerCount(); i++) {
+            const auto* expected = mOutput->getOutputLayerOrderedByZByIndex(i);
+            const auto* actual = mIncrementalOutput->getOutputLayerOrderedByZByIndex(i);
+            ASSERT_NE(nullptr, expected);
+            ASSERT_NE(nullptr, actual);
+            EXPECT_EQ(&expected->getLayerFE(), &actual->getLayerFE()) << i;
+            expectSameOutputLayerState(*expected, *actual);
+        }
+    }
+
+    static constexpr ui::LayerStack kLayerStack{1u};
+    static const Rect kDisplayBounds;
+
+    StrictMock<mock::CompositionEngine> mCompositionEngine;
+    std::shared_ptr<OutputTest::Output> mOutput = OutputTest::createOutput(mCompositionEngine);
+    std::shared_ptr<OutputTest::Output> mIncrementalOutput =
+            OutputTest::createOutput(mCompositionEngine);
+    CompositionRefreshArgs mRefreshArgs;
+
+    // From bottom to top
+    Layer mBackground;
+    Layer mWindow;
+    Layer mTranslucentWindow;
+    Layer mSmallLayer;
+    Layer mOverlay;
+};
+
+const Rect OutputIncrementalVisibleRegionTest::kDisplayBounds{0, 0, 100, 200};
+
+TEST_F(OutputIncrementalVisibleRegionTest, matchesFullComputationAcrossFrames) {
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // Nothing changed, so every layer can be reused.
+    clearContentDirty();
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // A layer moves over other layers.
+    mSmallLayer.setBounds(Rect(20, 40, 40, 60));
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // Only the content of a layer changes.
+    mWindow.layerFEState.contentDirty = true;
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+    clearContentDirty();
+
+    // A layer is hidden, and then shown again.
+    mTranslucentWindow.layerFEState.isVisible = false;
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+    mTranslucentWindow.layerFEState.isVisible = true;
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // A layer is added on top, and two layers change places in z.
+    mRefreshArgs.layers = {mBackground.layerFE, mTranslucentWindow.layerFE, mWindow.layerFE,
+                           mSmallLayer.layerFE, mOverlay.layerFE};
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // The shadow and transparent region of a layer change.
+    mTranslucentWindow.layerFEState.shadowSettings.length = 10;
+    mTranslucentWindow.layerFEState.transparentRegionHint = Region(Rect(10, 10, 40, 40));
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // A layer is removed.
+    mRefreshArgs.layers = {mBackground.layerFE, mTranslucentWindow.layerFE, mSmallLayer.layerFE,
+                           mOverlay.layerFE};
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+
+    // Tracking the regions covered by layers other than overlays drops the cached coverage.
+    mRefreshArgs.hasTrustedPresentationListener = true;
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+    clearContentDirty();
+    ASSERT_NO_FATAL_FAILURE(rebuildLayerStacksAndCompare());
+}
+
 /*
  * Output::present()
  */
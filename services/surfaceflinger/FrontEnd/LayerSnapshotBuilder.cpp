@@ -32,6 +32,7 @@
 #include "Layer.h" // eFrameRateSelectionPriority constants
 #include "LayerLog.h"
 #include "LayerSnapshotBuilder.h"
+#include "SnapshotWorkerPool.h"
 #include "TimeStats/TimeStats.h"
 #include "Tracing/TransactionTracing.h"
 
@@ -313,6 +314,27 @@ void updateMetadata(LayerSnapshot& snapshot, const RequestedLayerState& requeste
     }
 }
 
+// A layer with a relative parent is reached both through its parent and through its relative
+// parent, and both paths update the same snapshot.
+bool hasRelativeLayers(const LayerHierarchy& hierarchy, LayerHierarchy::Variant variant) {
+    if (variant == LayerHierarchy::Variant::Relative ||
+        variant == LayerHierarchy::Variant::Detached) {
+        return true;
+    }
+    for (const auto& [childHierarchy, childVariant] : hierarchy.mChildren) {
+        if (hasRelativeLayers(*childHierarchy, childVariant)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hasChanges(const LayerSnapshot& snapshot) {
+    return snapshot.changes.get() != 0 || snapshot.clientChanges != 0 || snapshot.contentDirty ||
+            snapshot.hasReadyFrame || snapshot.sidebandStreamHasFrame ||
+            !snapshot.surfaceDamage.isEmpty();
+}
+
 void clearChanges(LayerSnapshot& snapshot) {
     snapshot.changes.clear();
     snapshot.clientChanges = 0;
@@ -370,6 +392,7 @@ LayerSnapshotBuilder::LayerSnapshotBuilder() {}
 LayerSnapshotBuilder::LayerSnapshotBuilder(Args args) : LayerSnapshotBuilder() {
     args.forceUpdate = ForceUpdateFlags::ALL;
     updateSnapshots(args);
+    updateFrameStates();
 }
 
 bool LayerSnapshotBuilder::tryFastUpdate(const Args& args) {
@@ -402,6 +425,7 @@ bool LayerSnapshotBuilder::tryFastUpdate(const Args& args) {
         for (auto it = range.first; it != range.second; it++) {
             it->second->merge(*requested, forceUpdate, args.displayChanges, args.forceFullDamage,
                               primaryDisplayRotationFlags);
+            updateFrameState(it->second->globalZ);
         }
     }
 
@@ -439,20 +463,18 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
         }
     }
 
-    LayerHierarchy::TraversalPath root = LayerHierarchy::TraversalPath::ROOT;
     if (args.root.getLayer()) {
         // The hierarchy can have a root layer when used for screenshots otherwise, it will have
         // multiple children.
+        LayerHierarchy::TraversalPath root = LayerHierarchy::TraversalPath::ROOT;
         LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root, args.root.getLayer()->id,
                                                                 LayerHierarchy::Variant::Attached);
-        updateSnapshotsInHierarchy(args, args.root, root, rootSnapshot, /*depth=*/0);
+        SubtreeUpdate subtreeUpdate;
+        updateSnapshotsInHierarchy(args, args.root, root, rootSnapshot, /*depth=*/0,
+                                   subtreeUpdate);
+        mergeSubtreeUpdate(subtreeUpdate);
     } else {
-        for (auto& [childHierarchy, variant] : args.root.mChildren) {
-            LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root,
-                                                                    childHierarchy->getLayer()->id,
-                                                                    variant);
-            updateSnapshotsInHierarchy(args, *childHierarchy, root, rootSnapshot, /*depth=*/0);
-        }
+        updateTopLevelSnapshots(args, rootSnapshot);
     }
 
     // Update touchable region crops outside the main update pass. This is because a layer could be
@@ -503,31 +525,139 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
     }
 }
 
+void LayerSnapshotBuilder::updateTopLevelSnapshots(const Args& args,
+                                                   const LayerSnapshot& rootSnapshot) {
+    const auto& children = args.root.mChildren;
+
+    // Split the children of the root, usually one per display, into groups that can be updated
+    // independently of each other. The snapshots of a subtree only depend on its ancestors, except
+    // when relative layers tie it to another subtree. Those subtrees are updated together, in
+    // order, by a single task. Finding the relative layers walks the whole hierarchy, so the groups
+    // are only rebuilt when the hierarchy changes.
+    const bool parallel = args.workerPool && children.size() > 1;
+    if (&args.root != mTopLevelGroupsRoot || parallel != mTopLevelGroupsParallel ||
+        mTopLevelGroupsChildCount != children.size() ||
+        args.forceUpdate != ForceUpdateFlags::NONE ||
+        args.layerLifecycleManager.getGlobalChanges().test(
+                RequestedLayerState::Changes::Hierarchy)) {
+        mTopLevelGroupsRoot = &args.root;
+        mTopLevelGroupsParallel = parallel;
+        mTopLevelGroupsChildCount = children.size();
+        mTopLevelGroups.clear();
+        if (parallel) {
+            std::optional<size_t> relativeGroup;
+            for (size_t i = 0; i < children.size(); i++) {
+                const auto& [childHierarchy, variant] = children[i];
+                if (!hasRelativeLayers(*childHierarchy, variant)) {
+                    mTopLevelGroups.push_back({i});
+                } else if (relativeGroup) {
+                    mTopLevelGroups[*relativeGroup].push_back(i);
+                } else {
+                    relativeGroup = mTopLevelGroups.size();
+                    mTopLevelGroups.push_back({i});
+                }
+            }
+        } else {
+            mTopLevelGroups.emplace_back(children.size());
+            std::iota(mTopLevelGroups.back().begin(), mTopLevelGroups.back().end(), 0);
+        }
+    }
+    const std::vector<std::vector<size_t>>& groups = mTopLevelGroups;
+
+    std::vector<SubtreeUpdate> subtreeUpdates(groups.size());
+    auto updateGroup = [&](size_t group) {
+        LayerHierarchy::TraversalPath root = LayerHierarchy::TraversalPath::ROOT;
+        for (size_t i : groups[group]) {
+            const auto& [childHierarchy, variant] = children[i];
+            LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root,
+                                                                    childHierarchy->getLayer()->id,
+                                                                    variant);
+            updateSnapshotsInHierarchy(args, *childHierarchy, root, rootSnapshot, /*depth=*/0,
+                                       subtreeUpdates[group]);
+        }
+    };
+
+    if (groups.size() == 1) {
+        updateGroup(0);
+    } else {
+        ATRACE_FORMAT("UpdateSnapshotsInParallel subtrees=%zu", groups.size());
+        std::vector<std::function<void()>> tasks;
+        tasks.reserve(groups.size());
+        for (size_t group = 0; group < groups.size(); group++) {
+            tasks.emplace_back([&updateGroup, group]() { updateGroup(group); });
+        }
+        args.workerPool->run(tasks);
+    }
+
+    // Merging in the order of the children keeps the snapshots in the same order as when they are
+    // updated on a single thread.
+    for (SubtreeUpdate& subtreeUpdate : subtreeUpdates) {
+        mergeSubtreeUpdate(subtreeUpdate);
+    }
+}
+
+void LayerSnapshotBuilder::mergeSubtreeUpdate(SubtreeUpdate& subtreeUpdate) {
+    for (std::unique_ptr<LayerSnapshot>& snapshot : subtreeUpdate.createdSnapshots) {
+        snapshot->globalZ = mSnapshots.size();
+        mPathToSnapshot[snapshot->path] = snapshot.get();
+        mIdToSnapshots.emplace(snapshot->path.id, snapshot.get());
+        mSnapshots.emplace_back(std::move(snapshot));
+    }
+    mNeedsTouchableRegionCrop.insert(subtreeUpdate.needsTouchableRegionCrop.begin(),
+                                     subtreeUpdate.needsTouchableRegionCrop.end());
+    mResortSnapshots |= subtreeUpdate.resortSnapshots;
+}
+
 void LayerSnapshotBuilder::update(const Args& args) {
-    for (auto& snapshot : mSnapshots) {
-        clearChanges(*snapshot);
+    for (size_t i = 0; i < mSnapshots.size(); i++) {
+        if (mFrameStates[i].test(FrameState::Dirty)) {
+            clearChanges(*mSnapshots[i]);
+            mFrameStates[i].clear(FrameState::Dirty);
+        }
     }
 
     if (tryFastUpdate(args)) {
         return;
     }
     updateSnapshots(args);
+    updateFrameStates();
+}
+
+void LayerSnapshotBuilder::updateFrameState(size_t index) {
+    const LayerSnapshot& snapshot = *mSnapshots[index];
+    ftl::Flags<FrameState> state;
+    if (snapshot.isVisible) state |= FrameState::Visible;
+    if (snapshot.hasInputInfo()) state |= FrameState::HasInputInfo;
+    if (hasChanges(snapshot)) state |= FrameState::Dirty;
+    if (snapshot.hasSomethingToDraw()) state |= FrameState::HasSomethingToDraw;
+    if (snapshot.compositionType ==
+        aidl::android::hardware::graphics::composer3::Composition::CURSOR) {
+        state |= FrameState::Cursor;
+    }
+    mFrameStates[index] = state;
+}
+
+void LayerSnapshotBuilder::updateFrameStates() {
+    mFrameStates.resize(mSnapshots.size());
+    for (size_t i = 0; i < mSnapshots.size(); i++) {
+        updateFrameState(i);
+    }
 }
 
 const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
         const Args& args, const LayerHierarchy& hierarchy,
         LayerHierarchy::TraversalPath& traversalPath, const LayerSnapshot& parentSnapshot,
-        int depth) {
+        int depth, SubtreeUpdate& subtreeUpdate) {
     LLOG_ALWAYS_FATAL_WITH_TRACE_IF(depth > 50,
                                     "Cycle detected in LayerSnapshotBuilder. See "
                                     "builder_stack_overflow_transactions.winscope");
 
     const RequestedLayerState* layer = hierarchy.getLayer();
-    LayerSnapshot* snapshot = getSnapshot(traversalPath);
+    LayerSnapshot* snapshot = getSnapshot(traversalPath, subtreeUpdate);
     const bool newSnapshot = snapshot == nullptr;
     uint32_t primaryDisplayRotationFlags = getPrimaryDisplayRotationFlags(args.displays);
     if (newSnapshot) {
-        snapshot = createSnapshot(traversalPath, *layer, parentSnapshot);
+        snapshot = createSnapshot(traversalPath, *layer, parentSnapshot, subtreeUpdate);
         snapshot->merge(*layer, /*forceUpdate=*/true, /*displayChanges=*/true, args.forceFullDamage,
                         primaryDisplayRotationFlags);
         snapshot->changes |= RequestedLayerState::Changes::Created;
@@ -540,7 +670,7 @@ const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
         if (traversalPath.isAttached()) {
             resetRelativeState(*snapshot);
         }
-        updateSnapshot(*snapshot, args, *layer, parentSnapshot, traversalPath);
+        updateSnapshot(*snapshot, args, *layer, parentSnapshot, traversalPath, subtreeUpdate);
     }
 
     for (auto& [childHierarchy, variant] : hierarchy.mChildren) {
@@ -549,7 +679,7 @@ const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
                                                                 variant);
         const LayerSnapshot& childSnapshot =
                 updateSnapshotsInHierarchy(args, *childHierarchy, traversalPath, *snapshot,
-                                           depth + 1);
+                                           depth + 1, subtreeUpdate);
         updateFrameRateFromChildSnapshot(*snapshot, childSnapshot, args);
     }
 
@@ -569,18 +699,25 @@ LayerSnapshot* LayerSnapshotBuilder::getSnapshot(const LayerHierarchy::Traversal
     return it == mPathToSnapshot.end() ? nullptr : it->second;
 }
 
+LayerSnapshot* LayerSnapshotBuilder::getSnapshot(const LayerHierarchy::TraversalPath& id,
+                                                 const SubtreeUpdate& subtreeUpdate) const {
+    if (LayerSnapshot* snapshot = getSnapshot(id)) {
+        return snapshot;
+    }
+    auto it = subtreeUpdate.createdPathToSnapshot.find(id);
+    return it == subtreeUpdate.createdPathToSnapshot.end() ? nullptr : it->second;
+}
+
 LayerSnapshot* LayerSnapshotBuilder::createSnapshot(const LayerHierarchy::TraversalPath& path,
                                                     const RequestedLayerState& layer,
-                                                    const LayerSnapshot& parentSnapshot) {
-    mSnapshots.emplace_back(std::make_unique<LayerSnapshot>(layer, path));
-    LayerSnapshot* snapshot = mSnapshots.back().get();
-    snapshot->globalZ = static_cast<size_t>(mSnapshots.size()) - 1;
+                                                    const LayerSnapshot& parentSnapshot,
+                                                    SubtreeUpdate& subtreeUpdate) {
+    subtreeUpdate.createdSnapshots.emplace_back(std::make_unique<LayerSnapshot>(layer, path));
+    LayerSnapshot* snapshot = subtreeUpdate.createdSnapshots.back().get();
     if (path.isClone() && path.variant != LayerHierarchy::Variant::Mirror) {
         snapshot->mirrorRootPath = parentSnapshot.mirrorRootPath;
     }
-    mPathToSnapshot[path] = snapshot;
-
-    mIdToSnapshots.emplace(path.id, snapshot);
+    subtreeUpdate.createdPathToSnapshot[path] = snapshot;
     return snapshot;
 }
 
@@ -703,7 +840,8 @@ void LayerSnapshotBuilder::resetRelativeState(LayerSnapshot& snapshot) {
 void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& args,
                                           const RequestedLayerState& requested,
                                           const LayerSnapshot& parentSnapshot,
-                                          const LayerHierarchy::TraversalPath& path) {
+                                          const LayerHierarchy::TraversalPath& path,
+                                          SubtreeUpdate& subtreeUpdate) {
     // Always update flags and visibility
     ftl::Flags<RequestedLayerState::Changes> parentChanges = parentSnapshot.changes &
             (RequestedLayerState::Changes::Hierarchy | RequestedLayerState::Changes::Geometry |
@@ -741,7 +879,7 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
             snapshot.changes.any(RequestedLayerState::Changes::Geometry |
                                  RequestedLayerState::Changes::BufferSize |
                                  RequestedLayerState::Changes::Input)) {
-            updateInput(snapshot, requested, parentSnapshot, path, args);
+            updateInput(snapshot, requested, parentSnapshot, path, args, subtreeUpdate);
         }
         return;
     }
@@ -864,7 +1002,8 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
 
     if (forceUpdate || snapshot.changes.any(RequestedLayerState::Changes::Geometry)) {
         uint32_t primaryDisplayRotationFlags = getPrimaryDisplayRotationFlags(args.displays);
-        updateLayerBounds(snapshot, requested, parentSnapshot, primaryDisplayRotationFlags);
+        updateLayerBounds(snapshot, requested, parentSnapshot, primaryDisplayRotationFlags,
+                          subtreeUpdate);
     }
 
     if (forceUpdate || snapshot.clientChanges & layer_state_t::eCornerRadiusChanged ||
@@ -881,7 +1020,7 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
     if (forceUpdate ||
         snapshot.changes.any(RequestedLayerState::Changes::Geometry |
                              RequestedLayerState::Changes::Input)) {
-        updateInput(snapshot, requested, parentSnapshot, path, args);
+        updateInput(snapshot, requested, parentSnapshot, path, args, subtreeUpdate);
     }
 
     // computed snapshot properties
@@ -944,7 +1083,8 @@ void LayerSnapshotBuilder::updateRoundedCorner(LayerSnapshot& snapshot,
 void LayerSnapshotBuilder::updateLayerBounds(LayerSnapshot& snapshot,
                                              const RequestedLayerState& requested,
                                              const LayerSnapshot& parentSnapshot,
-                                             uint32_t primaryDisplayRotationFlags) {
+                                             uint32_t primaryDisplayRotationFlags,
+                                             SubtreeUpdate& subtreeUpdate) {
     snapshot.geomLayerTransform = parentSnapshot.geomLayerTransform * snapshot.localTransform;
     const bool transformWasInvalid = snapshot.invalidTransform;
     snapshot.invalidTransform = !LayerSnapshot::isTransformValid(snapshot.geomLayerTransform);
@@ -973,7 +1113,7 @@ void LayerSnapshotBuilder::updateLayerBounds(LayerSnapshot& snapshot,
     }
     if (transformWasInvalid != snapshot.invalidTransform) {
         // If transform is invalid, the layer will be hidden.
-        mResortSnapshots = true;
+        subtreeUpdate.resortSnapshots = true;
     }
     snapshot.geomInverseLayerTransform = snapshot.geomLayerTransform.inverse();
 
@@ -1027,7 +1167,7 @@ void LayerSnapshotBuilder::updateInput(LayerSnapshot& snapshot,
                                        const RequestedLayerState& requested,
                                        const LayerSnapshot& parentSnapshot,
                                        const LayerHierarchy::TraversalPath& path,
-                                       const Args& args) {
+                                       const Args& args, SubtreeUpdate& subtreeUpdate) {
     if (requested.windowInfoHandle) {
         snapshot.inputInfo = *requested.windowInfoHandle->getInfo();
     } else {
@@ -1089,9 +1229,17 @@ void LayerSnapshotBuilder::updateInput(LayerSnapshot& snapshot,
     }
 
     if (requested.touchCropId != UNASSIGNED_LAYER_ID || path.isClone()) {
-        mNeedsTouchableRegionCrop.insert(path);
+        subtreeUpdate.needsTouchableRegionCrop.push_back(path);
+    }
+    LayerSnapshot* cropLayerSnapshot = nullptr;
+    if (requested.touchCropId != UNASSIGNED_LAYER_ID) {
+        // When the subtrees are updated in parallel, this only sees the snapshots that existed
+        // before the update and the ones created in this subtree, so a crop layer in another
+        // subtree may be missing or not updated yet. updateTouchableRegionCrop fixes the crop up
+        // once all of the subtrees are merged.
+        cropLayerSnapshot = getSnapshot(LayerHierarchy::TraversalPath{.id = requested.touchCropId},
+                                        subtreeUpdate);
     }
-    auto cropLayerSnapshot = getSnapshot(requested.touchCropId);
     if (!cropLayerSnapshot && snapshot.inputInfo.replaceTouchableRegionWithCrop) {
         FloatRect inputBounds = getInputBounds(snapshot, /*fillParentBounds=*/true).first;
         Rect inputBoundsInDisplaySpace =
@@ -1123,9 +1271,8 @@ std::vector<std::unique_ptr<LayerSnapshot>>& LayerSnapshotBuilder::getSnapshots(
 
 void LayerSnapshotBuilder::forEachVisibleSnapshot(const ConstVisitor& visitor) const {
     for (int i = 0; i < mNumInterestingSnapshots; i++) {
-        LayerSnapshot& snapshot = *mSnapshots[(size_t)i];
-        if (!snapshot.isVisible) continue;
-        visitor(snapshot);
+        if (!mFrameStates[(size_t)i].test(FrameState::Visible)) continue;
+        visitor(*mSnapshots[(size_t)i]);
     }
 }
 
@@ -1145,17 +1292,33 @@ void LayerSnapshotBuilder::forEachVisibleSnapshot(const ConstVisitor& visitor,
 
 void LayerSnapshotBuilder::forEachVisibleSnapshot(const Visitor& visitor) {
     for (int i = 0; i < mNumInterestingSnapshots; i++) {
-        std::unique_ptr<LayerSnapshot>& snapshot = mSnapshots.at((size_t)i);
-        if (!snapshot->isVisible) continue;
-        visitor(snapshot);
+        if (!mFrameStates[(size_t)i].test(FrameState::Visible)) continue;
+        visitor(mSnapshots.at((size_t)i));
     }
 }
 
 void LayerSnapshotBuilder::forEachInputSnapshot(const ConstVisitor& visitor) const {
     for (int i = mNumInterestingSnapshots - 1; i >= 0; i--) {
-        LayerSnapshot& snapshot = *mSnapshots[(size_t)i];
-        if (!snapshot.hasInputInfo()) continue;
-        visitor(snapshot);
+        if (!mFrameStates[(size_t)i].test(FrameState::HasInputInfo)) continue;
+        visitor(*mSnapshots[(size_t)i]);
+    }
+}
+
+void LayerSnapshotBuilder::forEachChangedSnapshot(const Visitor& visitor) {
+    for (size_t i = 0; i < mSnapshots.size(); i++) {
+        if (!mFrameStates[i].test(FrameState::Dirty)) continue;
+        visitor(mSnapshots[i]);
+    }
+}
+
+void LayerSnapshotBuilder::forEachSnapshotToComposite(bool cursorOnly, const Visitor& visitor) {
+    ftl::Flags<FrameState> required = FrameState::Visible | FrameState::HasSomethingToDraw;
+    if (cursorOnly) {
+        required |= FrameState::Cursor;
+    }
+    for (int i = 0; i < mNumInterestingSnapshots; i++) {
+        if (!mFrameStates[(size_t)i].all(required)) continue;
+        visitor(mSnapshots.at((size_t)i));
     }
 }
 
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <ftl/flags.h>
+
 #include "FrontEnd/DisplayInfo.h"
 #include "FrontEnd/LayerLifecycleManager.h"
 #include "LayerHierarchy.h"
@@ -24,6 +26,8 @@
 
 namespace android::surfaceflinger::frontend {
 
+class SnapshotWorkerPool;
+
 // Walks through the layer hierarchy to build an ordered list
 // of LayerSnapshots that can be passed on to CompositionEngine.
 // This builder does a minimum amount of work to update
@@ -59,6 +63,9 @@ public:
         const std::unordered_map<std::string, uint32_t>& genericLayerMetadataKeyMap;
         bool skipRoundCornersWhenProtected = false;
         LayerSnapshot rootSnapshot = getRootSnapshot();
+        // If set, the top level subtrees of the hierarchy that don't share snapshots with each
+        // other are updated in parallel on this pool.
+        SnapshotWorkerPool* workerPool = nullptr;
     };
     LayerSnapshotBuilder();
 
@@ -89,6 +96,13 @@ public:
     // Visit each snapshot interesting to input reverse z-order
     void forEachInputSnapshot(const ConstVisitor& visitor) const;
 
+    // Visit each snapshot that has changes from the last update, in no particular order
+    void forEachChangedSnapshot(const Visitor& visitor);
+
+    // Visit each visible snapshot that has something to draw in z-order, or only the ones that are
+    // composited as a cursor, and move the snapshot if needed
+    void forEachSnapshotToComposite(bool cursorOnly, const Visitor& visitor);
+
 private:
     friend class LayerSnapshotTest;
 
@@ -96,33 +110,66 @@ private:
     // the fast path.
     bool tryFastUpdate(const Args& args);
 
+    // The builder state that changes while a subtree of the hierarchy is updated. Subtrees that
+    // are updated in parallel each get their own, and they are merged into the builder, in
+    // traversal order, once all of them are done.
+    struct SubtreeUpdate {
+        std::vector<std::unique_ptr<LayerSnapshot>> createdSnapshots;
+        std::unordered_map<LayerHierarchy::TraversalPath, LayerSnapshot*,
+                           LayerHierarchy::TraversalPathHash>
+                createdPathToSnapshot;
+        std::vector<LayerHierarchy::TraversalPath> needsTouchableRegionCrop;
+        bool resortSnapshots = false;
+    };
+
     void updateSnapshots(const Args& args);
+    void updateTopLevelSnapshots(const Args& args, const LayerSnapshot& rootSnapshot);
+    void mergeSubtreeUpdate(SubtreeUpdate&);
 
     const LayerSnapshot& updateSnapshotsInHierarchy(const Args&, const LayerHierarchy& hierarchy,
                                                     LayerHierarchy::TraversalPath& traversalPath,
-                                                    const LayerSnapshot& parentSnapshot, int depth);
+                                                    const LayerSnapshot& parentSnapshot, int depth,
+                                                    SubtreeUpdate&);
     void updateSnapshot(LayerSnapshot&, const Args&, const RequestedLayerState&,
-                        const LayerSnapshot& parentSnapshot, const LayerHierarchy::TraversalPath&);
+                        const LayerSnapshot& parentSnapshot, const LayerHierarchy::TraversalPath&,
+                        SubtreeUpdate&);
     static void updateRelativeState(LayerSnapshot& snapshot, const LayerSnapshot& parentSnapshot,
                                     bool parentIsRelative, const Args& args);
     static void resetRelativeState(LayerSnapshot& snapshot);
     static void updateRoundedCorner(LayerSnapshot& snapshot, const RequestedLayerState& layerState,
                                     const LayerSnapshot& parentSnapshot, const Args& args);
-    void updateLayerBounds(LayerSnapshot& snapshot, const RequestedLayerState& layerState,
-                           const LayerSnapshot& parentSnapshot, uint32_t displayRotationFlags);
+    static void updateLayerBounds(LayerSnapshot& snapshot, const RequestedLayerState& layerState,
+                                  const LayerSnapshot& parentSnapshot,
+                                  uint32_t displayRotationFlags, SubtreeUpdate&);
     static void updateShadows(LayerSnapshot& snapshot, const RequestedLayerState& requested,
                               const ShadowSettings& globalShadowSettings);
     void updateInput(LayerSnapshot& snapshot, const RequestedLayerState& requested,
                      const LayerSnapshot& parentSnapshot, const LayerHierarchy::TraversalPath& path,
-                     const Args& args);
+                     const Args& args, SubtreeUpdate&);
     // Return true if there are unreachable snapshots
     bool sortSnapshotsByZ(const Args& args);
-    LayerSnapshot* createSnapshot(const LayerHierarchy::TraversalPath& id,
-                                  const RequestedLayerState& layer,
-                                  const LayerSnapshot& parentSnapshot);
+    // Snapshots that are created while a subtree is updated are only added to the builder once the
+    // update is done, so they are looked up in the SubtreeUpdate until then.
+    LayerSnapshot* getSnapshot(const LayerHierarchy::TraversalPath& id,
+                               const SubtreeUpdate&) const;
+    static LayerSnapshot* createSnapshot(const LayerHierarchy::TraversalPath& id,
+                                         const RequestedLayerState& layer,
+                                         const LayerSnapshot& parentSnapshot, SubtreeUpdate&);
     void updateFrameRateFromChildSnapshot(LayerSnapshot& snapshot,
                                           const LayerSnapshot& childSnapshot, const Args& args);
     void updateTouchableRegionCrop(const Args& args);
+    void updateFrameState(size_t index);
+    void updateFrameStates();
+
+    // The state of a snapshot that the passes over all of the snapshots check every frame.
+    enum class FrameState : uint8_t {
+        Visible = 1 << 0,
+        HasInputInfo = 1 << 1,
+        // The snapshot has changes that need to be cleared before the next update.
+        Dirty = 1 << 2,
+        HasSomethingToDraw = 1 << 3,
+        Cursor = 1 << 4,
+    };
 
     std::unordered_map<LayerHierarchy::TraversalPath, LayerSnapshot*,
                        LayerHierarchy::TraversalPathHash>
@@ -133,8 +180,20 @@ private:
     std::unordered_set<LayerHierarchy::TraversalPath, LayerHierarchy::TraversalPathHash>
             mNeedsTouchableRegionCrop;
     std::vector<std::unique_ptr<LayerSnapshot>> mSnapshots;
+    // Indexed like mSnapshots, by globalZ. Kept apart from the snapshots, in one contiguous array,
+    // so that the passes can skip the snapshots they don't need without loading them.
+    // The fields these states are derived from are only written by update(), which refreshes the
+    // states of every snapshot it changes before returning: all of them after a full update, and
+    // the merged ones on the fast path.
+    std::vector<ftl::Flags<FrameState>> mFrameStates;
     bool mResortSnapshots = false;
     int mNumInterestingSnapshots = 0;
+    // The children of the root, by index, that updateTopLevelSnapshots updates together, and what
+    // they were computed from.
+    std::vector<std::vector<size_t>> mTopLevelGroups;
+    const LayerHierarchy* mTopLevelGroupsRoot = nullptr;
+    size_t mTopLevelGroupsChildCount = 0;
+    bool mTopLevelGroupsParallel = false;
 };
 
 } // namespace android::surfaceflinger::frontend
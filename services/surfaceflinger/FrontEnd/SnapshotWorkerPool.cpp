@@ -0,0 +1,57 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SnapshotWorkerPool.h"
+
+#include <android-base/stringprintf.h>
+#include <processgroup/sched_policy.h>
+#include <pthread.h>
+#include <sched.h>
+
+namespace android::surfaceflinger::frontend {
+
+SnapshotWorkerPool::SnapshotWorkerPool(size_t numWorkers) {
+    for (size_t i = 0; i < numWorkers; i++) {
+        std::thread& worker = mWorkers.emplace_back(&SnapshotWorkerPool::workerLoop, this);
+        pthread_setname_np(worker.native_handle(),
+                           base::StringPrintf("SnapshotWorker%zu", i + 1).c_str());
+    }
+}
+
+SnapshotWorkerPool::~SnapshotWorkerPool() {
+    mTasks.stop();
+    for (std::thread& worker : mWorkers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void SnapshotWorkerPool::run(const std::vector<std::function<void()>>& tasks) {
+    mTasks.run(tasks);
+}
+
+void SnapshotWorkerPool::workerLoop() {
+    // The workers do the work of the main thread, so they run with the same priority.
+    set_sched_policy(0, SP_FOREGROUND);
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    sched_setscheduler(0, SCHED_FIFO, &param);
+
+    mTasks.workerLoop();
+}
+
+} // namespace android::surfaceflinger::frontend
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <paralleltasks/ParallelTasks.h>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace android::surfaceflinger::frontend {
+
+// A small, fixed set of threads that LayerSnapshotBuilder uses to update independent subtrees of
+// the layer hierarchy at the same time.
+//
+// The pool does not keep a queue. run() hands out a set of tasks and the calling thread takes part
+// in executing them. Idle threads take the next task that was not started yet, so a large subtree
+// does not hold up the smaller ones. run() only returns once all of the tasks are done.
+class SnapshotWorkerPool {
+public:
+    explicit SnapshotWorkerPool(size_t numWorkers);
+    ~SnapshotWorkerPool();
+
+    SnapshotWorkerPool(const SnapshotWorkerPool&) = delete;
+    SnapshotWorkerPool& operator=(const SnapshotWorkerPool&) = delete;
+
+    // Run all the tasks, in no particular order, and wait until they have all finished. Must not be
+    // called from more than one thread at a time.
+    void run(const std::vector<std::function<void()>>& tasks);
+
+    size_t getNumWorkers() const { return mWorkers.size(); }
+
+private:
+    ParallelTasks mTasks;
+    std::vector<std::thread> mWorkers;
+
+    void workerLoop();
+};
+
+} // namespace android::surfaceflinger::frontend
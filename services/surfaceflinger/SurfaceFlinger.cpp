@@ -498,6 +498,9 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.treat_170m_as_sRGB", value, "0");
     mTreat170mAsSrgb = atoi(value);
 
+    property_get("debug.sf.incremental_visible_region", value, "0");
+    mIncrementalVisibleRegion = atoi(value);
+
     property_get("debug.sf.dim_in_gamma_in_enhanced_screenshots", value, 0);
     mDimInGammaSpaceForEnhancedScreenshots = atoi(value);
 
@@ -537,6 +540,10 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
             base::GetBoolProperty("persist.debug.sf.enable_layer_lifecycle_manager"s, true);
     mLegacyFrontEndEnabled = !mLayerLifecycleManagerEnabled ||
             base::GetBoolProperty("persist.debug.sf.enable_legacy_frontend"s, false);
+    if (mLayerLifecycleManagerEnabled && FlagManager::getInstance().parallel_snapshot_update()) {
+        // The main thread takes part in the update as well.
+        mSnapshotWorkerPool = std::make_unique<frontend::SnapshotWorkerPool>(/*numWorkers=*/2);
+    }
 
     // These are set by the HWC implementation to indicate that they will use the workarounds.
     mIsHotplugErrViaNegVsync =
@@ -2265,10 +2272,10 @@ bool SurfaceFlinger::updateLayerSnapshotsLegacy(VsyncId vsyncId, nsecs_t frameTi
 }
 
 void SurfaceFlinger::updateLayerHistory(nsecs_t now) {
-    for (const auto& snapshot : mLayerSnapshotBuilder.getSnapshots()) {
+    mLayerSnapshotBuilder.forEachChangedSnapshot([&](auto& snapshot) {
         using Changes = frontend::RequestedLayerState::Changes;
         if (snapshot->path.isClone()) {
-            continue;
+            return;
         }
 
         const bool updateSmallDirty = FlagManager::getInstance().enable_small_area_detection() &&
@@ -2282,7 +2289,7 @@ void SurfaceFlinger::updateLayerHistory(nsecs_t now) {
                         0;
 
         if (!updateSmallDirty && !hasChanges) {
-            continue;
+            return;
         }
 
         auto it = mLegacyLayers.find(snapshot->sequence);
@@ -2296,7 +2303,7 @@ void SurfaceFlinger::updateLayerHistory(nsecs_t now) {
         }
 
         if (!hasChanges) {
-            continue;
+            return;
         }
 
         const auto layerProps = scheduler::LayerProps{
@@ -2329,7 +2336,7 @@ void SurfaceFlinger::updateLayerHistory(nsecs_t now) {
         if (snapshot->changes.test(Changes::Buffer)) {
             it->second->recordLayerHistoryBufferUpdate(layerProps, now);
         }
-    }
+    });
 }
 
 bool SurfaceFlinger::updateLayerSnapshots(VsyncId vsyncId, nsecs_t frameTimeNs,
@@ -2397,7 +2404,8 @@ bool SurfaceFlinger::updateLayerSnapshots(VsyncId vsyncId, nsecs_t frameTimeNs,
                              getHwComposer().getSupportedLayerGenericMetadata(),
                      .genericLayerMetadataKeyMap = getGenericLayerMetadataKeyMap(),
                      .skipRoundCornersWhenProtected =
-                             !getRenderEngine().supportsProtectedContent()};
+                             !getRenderEngine().supportsProtectedContent(),
+                     .workerPool = mSnapshotWorkerPool.get()};
         mLayerSnapshotBuilder.update(args);
     }
 
@@ -9119,18 +9127,8 @@ std::vector<std::pair<Layer*, LayerFE*>> SurfaceFlinger::moveSnapshotsToComposit
     std::vector<std::pair<Layer*, LayerFE*>> layers;
     if (mLayerLifecycleManagerEnabled) {
         nsecs_t currentTime = systemTime();
-        mLayerSnapshotBuilder.forEachVisibleSnapshot(
-                [&](std::unique_ptr<frontend::LayerSnapshot>& snapshot) {
-                    if (cursorOnly &&
-                        snapshot->compositionType !=
-                                aidl::android::hardware::graphics::composer3::Composition::CURSOR) {
-                        return;
-                    }
-
-                    if (!snapshot->hasSomethingToDraw()) {
-                        return;
-                    }
-
+        mLayerSnapshotBuilder.forEachSnapshotToComposite(
+                cursorOnly, [&](std::unique_ptr<frontend::LayerSnapshot>& snapshot) {
                     auto it = mLegacyLayers.find(snapshot->sequence);
                     LLOG_ALWAYS_FATAL_WITH_TRACE_IF(it == mLegacyLayers.end(),
                                                     "Couldnt find layer object for %s",
@@ -77,6 +77,7 @@
 #include "FrontEnd/LayerLifecycleManager.h"
 #include "FrontEnd/LayerSnapshot.h"
 #include "FrontEnd/LayerSnapshotBuilder.h"
+#include "FrontEnd/SnapshotWorkerPool.h"
 #include "FrontEnd/TransactionHandler.h"
 #include "LayerVector.h"
 #include "MutexUtils.h"
@@ -321,6 +322,10 @@ public:
     // on this behavior to increase contrast for some media sources.
     bool mTreat170mAsSrgb = false;
 
+    // If true, composition engine only recomputes the visible regions of the layers that changed,
+    // or that overlap the layers above them that changed, when the geometry is updated.
+    bool mIncrementalVisibleRegion = false;
+
     // If true, then screenshots with an enhanced render intent will dim in gamma space.
     // The purpose is to ensure that screenshots appear correct during system animations for devices
     // that require that dimming must occur in gamma space.
@@ -1453,6 +1458,8 @@ private:
     frontend::LayerLifecycleManager mLayerLifecycleManager;
     frontend::LayerHierarchyBuilder mLayerHierarchyBuilder;
     frontend::LayerSnapshotBuilder mLayerSnapshotBuilder;
+    // Updates independent subtrees of the hierarchy in parallel, if enabled.
+    std::unique_ptr<frontend::SnapshotWorkerPool> mSnapshotWorkerPool;
 
     std::vector<std::pair<uint32_t, std::string>> mDestroyedHandles;
     std::vector<std::unique_ptr<frontend::RequestedLayerState>> mNewLayers;
@@ -48,6 +48,49 @@ public:
 };
 } // namespace
 
+LayerTraceGenerator::Entry LayerTraceGenerator::parseEntry(
+        TransactionProtoParser& parser, const perfetto::protos::TransactionTraceEntry& entry) {
+    Entry parsedEntry;
+    parsedEntry.addedLayers.reserve((size_t)entry.added_layers_size());
+    for (int j = 0; j < entry.added_layers_size(); j++) {
+        LayerCreationArgs& args = parsedEntry.addedLayers.emplace_back();
+        parser.fromProto(entry.added_layers(j), args);
+        ALOGV("       %s", args.getDebugString().c_str());
+    }
+
+    parsedEntry.transactions.reserve((size_t)entry.transactions_size());
+    for (int j = 0; j < entry.transactions_size(); j++) {
+        // apply transactions
+        TransactionState transaction = parser.fromProto(entry.transactions(j));
+        for (auto& resolvedComposerState : transaction.states) {
+            if (resolvedComposerState.state.what & layer_state_t::eInputInfoChanged) {
+                if (!resolvedComposerState.state.windowInfoHandle->getInfo()->inputConfig.test(
+                            gui::WindowInfo::InputConfig::NO_INPUT_CHANNEL)) {
+                    // create a fake token since the FE expects a valid token
+                    resolvedComposerState.state.windowInfoHandle->editInfo()->token =
+                            sp<BBinder>::make();
+                }
+            }
+        }
+        parsedEntry.transactions.emplace_back(std::move(transaction));
+    }
+
+    for (int j = 0; j < entry.destroyed_layers_size(); j++) {
+        ALOGV("       destroyedHandles=%d", entry.destroyed_layers(j));
+    }
+
+    parsedEntry.destroyedHandles.reserve((size_t)entry.destroyed_layer_handles_size());
+    for (int j = 0; j < entry.destroyed_layer_handles_size(); j++) {
+        ALOGV("       destroyedHandles=%d", entry.destroyed_layer_handles(j));
+        parsedEntry.destroyedHandles.push_back({entry.destroyed_layer_handles(j), ""});
+    }
+
+    if (entry.displays_changed()) {
+        parser.fromProto(entry.displays(), parsedEntry.displayInfos.emplace());
+    }
+    return parsedEntry;
+}
+
 bool LayerTraceGenerator::generate(const perfetto::protos::TransactionTraceFile& traceFile,
                                    std::uint32_t traceFlags, LayerTracing& layerTracing,
                                    bool onlyLastEntry) {
@@ -86,47 +129,20 @@ bool LayerTraceGenerator::generate(const perfetto::protos::TransactionTraceFile&
               entry.added_layers_size(), entry.destroyed_layers_size(),
               entry.destroyed_layer_handles_size(), entry.transactions_size());
 
+        LayerTraceGenerator::Entry parsedEntry = parseEntry(parser, entry);
+
         std::vector<std::unique_ptr<frontend::RequestedLayerState>> addedLayers;
-        addedLayers.reserve((size_t)entry.added_layers_size());
-        for (int j = 0; j < entry.added_layers_size(); j++) {
-            LayerCreationArgs args;
-            parser.fromProto(entry.added_layers(j), args);
-            ALOGV("       %s", args.getDebugString().c_str());
+        addedLayers.reserve(parsedEntry.addedLayers.size());
+        for (const LayerCreationArgs& args : parsedEntry.addedLayers) {
             addedLayers.emplace_back(std::make_unique<frontend::RequestedLayerState>(args));
         }
+        std::vector<TransactionState>& transactions = parsedEntry.transactions;
+        std::vector<std::pair<uint32_t, std::string>>& destroyedHandles =
+                parsedEntry.destroyedHandles;
 
-        std::vector<TransactionState> transactions;
-        transactions.reserve((size_t)entry.transactions_size());
-        for (int j = 0; j < entry.transactions_size(); j++) {
-            // apply transactions
-            TransactionState transaction = parser.fromProto(entry.transactions(j));
-            for (auto& resolvedComposerState : transaction.states) {
-                if (resolvedComposerState.state.what & layer_state_t::eInputInfoChanged) {
-                    if (!resolvedComposerState.state.windowInfoHandle->getInfo()->inputConfig.test(
-                                gui::WindowInfo::InputConfig::NO_INPUT_CHANNEL)) {
-                        // create a fake token since the FE expects a valid token
-                        resolvedComposerState.state.windowInfoHandle->editInfo()->token =
-                                sp<BBinder>::make();
-                    }
-                }
-            }
-            transactions.emplace_back(std::move(transaction));
-        }
-
-        for (int j = 0; j < entry.destroyed_layers_size(); j++) {
-            ALOGV("       destroyedHandles=%d", entry.destroyed_layers(j));
-        }
-
-        std::vector<std::pair<uint32_t, std::string>> destroyedHandles;
-        destroyedHandles.reserve((size_t)entry.destroyed_layer_handles_size());
-        for (int j = 0; j < entry.destroyed_layer_handles_size(); j++) {
-            ALOGV("       destroyedHandles=%d", entry.destroyed_layer_handles(j));
-            destroyedHandles.push_back({entry.destroyed_layer_handles(j), ""});
-        }
-
-        bool displayChanged = entry.displays_changed();
+        bool displayChanged = parsedEntry.displayInfos.has_value();
         if (displayChanged) {
-            parser.fromProto(entry.displays(), displayInfos);
+            displayInfos = std::move(*parsedEntry.displayInfos);
         }
 
         // apply updates
@@ -22,6 +22,8 @@
 #include <optional>
 #include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace android {
 
@@ -29,6 +31,18 @@ class LayerTracing;
 
 class LayerTraceGenerator {
 public:
+    // The changes made by one entry of a transaction trace, in the form that the frontend takes
+    // them.
+    struct Entry {
+        std::vector<LayerCreationArgs> addedLayers;
+        std::vector<TransactionState> transactions;
+        std::vector<std::pair<uint32_t, std::string>> destroyedHandles;
+        // Only set if the displays changed.
+        std::optional<frontend::DisplayInfos> displayInfos;
+    };
+
+    static Entry parseEntry(TransactionProtoParser&, const perfetto::protos::TransactionTraceEntry&);
+
     bool generate(const perfetto::protos::TransactionTraceFile&, std::uint32_t traceFlags,
                   LayerTracing& layerTracing, bool onlyLastEntry = false);
 };
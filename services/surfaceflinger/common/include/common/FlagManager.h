@@ -72,6 +72,7 @@ public:
     bool restore_blur_step() const;
     bool dont_skip_on_early_ro() const;
     bool protected_if_client() const;
+    bool parallel_snapshot_update() const;
 
 protected:
     // overridden for unit tests
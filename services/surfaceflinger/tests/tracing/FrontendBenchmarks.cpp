@@ -0,0 +1,432 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays transaction traces through the frontend, the same way that LayerTraceGenerator does, and
+// reports how long each stage takes per frame. The traces in testdata/ are always replayed. Other
+// traces can be added by listing their paths, separated by ':', in the
+// SURFACEFLINGER_BENCHMARK_TRACES environment variable.
+//
+// benchmarkLargeScene measures the work that is done for every frame, when only the content of a
+// layer changes, in scenes with hundreds of layers. It goes over the snapshots either through the
+// per-frame states that the builder keeps in a contiguous array, or by loading every snapshot like
+// before the builder had them, so that one run compares both.
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <FrontEnd/LayerCreationArgs.h>
+#include <FrontEnd/LayerHierarchy.h>
+#include <FrontEnd/LayerLifecycleManager.h>
+#include <FrontEnd/LayerSnapshotBuilder.h>
+#include <FrontEnd/TransactionHandler.h>
+#include <Tracing/TransactionProtoParser.h>
+#include <Tracing/TransactionTracing.h>
+#include <Tracing/tools/LayerTraceGenerator.h>
+#include <allocationcounter/HeapAllocations.h>
+#include <log/log.h>
+
+namespace android {
+
+namespace {
+
+constexpr std::string_view TRANSACTION_TRACE_PREFIX = "transactions_trace_";
+constexpr std::string_view TRACE_POSTFIX = ".winscope";
+constexpr const char* TRACES_ENV = "SURFACEFLINGER_BENCHMARK_TRACES";
+
+using Trace = std::vector<LayerTraceGenerator::Entry>;
+
+// The time and the heap allocations spent in one stage of the frontend, summed over all frames.
+struct StageStats {
+    nsecs_t time = 0;
+    size_t allocations = 0;
+
+    template <typename F>
+    void measure(F&& stage) {
+        const size_t startAllocations = getHeapAllocations();
+        const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        stage();
+        time += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+        allocations += getHeapAllocations() - startAllocations;
+    }
+
+    void report(benchmark::State& state, const std::string& name, size_t frames) const {
+        state.counters[name + "_us"] = frames == 0 ? 0 : time * 1E-3 / frames;
+        state.counters[name + "_allocs"] =
+                frames == 0 ? 0 : static_cast<double>(allocations) / frames;
+    }
+};
+
+struct ReplayStats {
+    StageStats flushTransactions;
+    StageStats applyTransactions;
+    StageStats updateHierarchy;
+    StageStats updateSnapshots;
+    size_t frames = 0;
+    size_t snapshots = 0;
+
+    void report(benchmark::State& state) const {
+        flushTransactions.report(state, "flush_transactions", frames);
+        applyTransactions.report(state, "apply_transactions", frames);
+        updateHierarchy.report(state, "update_hierarchy", frames);
+        updateSnapshots.report(state, "update_snapshots", frames);
+        state.counters["snapshots"] = frames == 0 ? 0 : static_cast<double>(snapshots) / frames;
+    }
+};
+
+// The frontend of SurfaceFlinger, without anything that needs a display or a GPU.
+struct Frontend {
+    surfaceflinger::frontend::TransactionHandler transactionHandler;
+    frontend::LayerLifecycleManager lifecycleManager;
+    frontend::LayerHierarchyBuilder hierarchyBuilder;
+    frontend::LayerSnapshotBuilder snapshotBuilder;
+    frontend::DisplayInfos displayInfos;
+    const ShadowSettings globalShadowSettings{.ambientColor = {1, 1, 1, 1}};
+};
+
+// The layers are created ahead of time, since SurfaceFlinger creates them when the client asks
+// for them, and not as part of a frame.
+struct PreparedEntry {
+    std::vector<std::unique_ptr<frontend::RequestedLayerState>> addedLayers;
+    LayerTraceGenerator::Entry entry;
+};
+
+std::vector<PreparedEntry> prepare(const Trace& trace) {
+    std::vector<PreparedEntry> preparedEntries;
+    preparedEntries.reserve(trace.size());
+    for (const LayerTraceGenerator::Entry& entry : trace) {
+        PreparedEntry& preparedEntry = preparedEntries.emplace_back();
+        preparedEntry.entry = entry;
+        for (const LayerCreationArgs& args : entry.addedLayers) {
+            preparedEntry.addedLayers.emplace_back(
+                    std::make_unique<frontend::RequestedLayerState>(args));
+        }
+    }
+    return preparedEntries;
+}
+
+void updateSnapshots(Frontend& frontEnd, bool displayChanged) {
+    frontend::LayerSnapshotBuilder::Args args{.root = frontEnd.hierarchyBuilder.getHierarchy(),
+                                              .layerLifecycleManager = frontEnd.lifecycleManager,
+                                              .displays = frontEnd.displayInfos,
+                                              .displayChanges = displayChanged,
+                                              .globalShadowSettings = frontEnd.globalShadowSettings,
+                                              .supportsBlur = false,
+                                              .forceFullDamage = false,
+                                              .supportedLayerGenericMetadata = {},
+                                              .genericLayerMetadataKeyMap = {}};
+    frontEnd.snapshotBuilder.update(args);
+}
+
+void replayEntry(Frontend& frontEnd, PreparedEntry& preparedEntry, ReplayStats& stats) {
+    LayerTraceGenerator::Entry& entry = preparedEntry.entry;
+    std::vector<TransactionState> transactions;
+    stats.flushTransactions.measure([&]() {
+        for (TransactionState& transaction : entry.transactions) {
+            frontEnd.transactionHandler.queueTransaction(std::move(transaction));
+        }
+        frontEnd.transactionHandler.collectTransactions();
+        transactions = frontEnd.transactionHandler.flushTransactions();
+    });
+
+    const bool displayChanged = entry.displayInfos.has_value();
+    if (displayChanged) {
+        frontEnd.displayInfos = std::move(*entry.displayInfos);
+    }
+
+    stats.applyTransactions.measure([&]() {
+        frontEnd.lifecycleManager.addLayers(std::move(preparedEntry.addedLayers));
+        frontEnd.lifecycleManager.applyTransactions(transactions, /*ignoreUnknownHandles=*/true);
+        frontEnd.lifecycleManager.onHandlesDestroyed(entry.destroyedHandles,
+                                                     /*ignoreUnknownHandles=*/true);
+    });
+
+    stats.updateHierarchy.measure(
+            [&]() { frontEnd.hierarchyBuilder.update(frontEnd.lifecycleManager); });
+
+    stats.updateSnapshots.measure([&]() { updateSnapshots(frontEnd, displayChanged); });
+
+    // Committing the changes resets the state for the next frame, which SurfaceFlinger also does
+    // as part of applying the transactions.
+    stats.applyTransactions.measure([&]() { frontEnd.lifecycleManager.commitChanges(); });
+
+    stats.frames++;
+    stats.snapshots += frontEnd.snapshotBuilder.getSnapshots().size();
+}
+
+void benchmarkReplay(benchmark::State& state, const Trace& trace) {
+    ReplayStats stats;
+    std::unique_ptr<Frontend> frontEnd;
+    for (auto _ : state) {
+        // Each replay starts from scratch, since the trace creates its layers with fixed ids.
+        state.PauseTiming();
+        frontEnd = std::make_unique<Frontend>();
+        std::vector<PreparedEntry> preparedEntries = prepare(trace);
+        state.ResumeTiming();
+
+        for (PreparedEntry& preparedEntry : preparedEntries) {
+            replayEntry(*frontEnd, preparedEntry, stats);
+        }
+
+        state.PauseTiming();
+        preparedEntries.clear();
+        frontEnd.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(stats.frames));
+    stats.report(state);
+}
+
+std::optional<Trace> readTrace(const std::string& path) {
+    std::fstream input(path, std::ios::in | std::ios::binary);
+    perfetto::protos::TransactionTraceFile traceFile;
+    if (!input || !traceFile.ParseFromIstream(&input)) {
+        std::cerr << "Could not parse " << path << "\n";
+        return std::nullopt;
+    }
+    TransactionProtoParser parser(std::make_unique<TransactionProtoParser::FlingerDataMapper>());
+    Trace trace;
+    trace.reserve(static_cast<size_t>(traceFile.entry_size()));
+    for (const perfetto::protos::TransactionTraceEntry& entry : traceFile.entry()) {
+        trace.push_back(LayerTraceGenerator::parseEntry(parser, entry));
+    }
+    return trace;
+}
+
+// Counts the hardware cache misses of the calling thread. The counter is not available when the
+// kernel doesn't let the process read the performance counters.
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        mFd.reset(static_cast<int>(syscall(__NR_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                                           /*group_fd=*/-1, /*flags=*/0)));
+    }
+
+    bool isAvailable() const { return mFd.ok(); }
+
+    void start() {
+        ioctl(mFd.get(), PERF_EVENT_IOC_RESET, 0);
+        ioctl(mFd.get(), PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t stop() {
+        ioctl(mFd.get(), PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(mFd.get(), &count, sizeof(count)) != sizeof(count)) {
+            return 0;
+        }
+        return count;
+    }
+
+private:
+    base::unique_fd mFd;
+};
+
+constexpr uint32_t LARGE_SCENE_CHILDREN_PER_LAYER = 8;
+
+TransactionState makeTransaction(std::vector<ResolvedComposerState> states) {
+    TransactionState transaction;
+    transaction.states = std::move(states);
+    return transaction;
+}
+
+// Two displays, each with a tree of layers below a root layer. A quarter of the layers are hidden,
+// along with their children, like the windows of apps in the background.
+void createLargeScene(Frontend& frontEnd, uint32_t numLayers) {
+    for (int32_t layerStack = 0; layerStack < 2; layerStack++) {
+        frontend::DisplayInfo display;
+        display.info.logicalWidth = 1080;
+        display.info.logicalHeight = 2400;
+        display.isPrimary = layerStack == 0;
+        frontEnd.displayInfos.emplace_or_replace(ui::LayerStack::fromValue(layerStack), display);
+    }
+
+    std::vector<std::unique_ptr<frontend::RequestedLayerState>> layers;
+    std::vector<ResolvedComposerState> states;
+    for (uint32_t i = 0; i < numLayers; i++) {
+        const uint32_t id = i + 1;
+        LayerCreationArgs args(std::make_optional(id));
+        args.name = "layer";
+        if (i < 2) {
+            args.addToRoot = true;
+            ResolvedComposerState& state = states.emplace_back();
+            state.layerId = id;
+            state.state.what = layer_state_t::eLayerStackChanged;
+            state.state.layerStack = ui::LayerStack::fromValue(i);
+        } else {
+            args.addToRoot = false;
+            args.parentId = (i - 2) / LARGE_SCENE_CHILDREN_PER_LAYER + 1;
+        }
+        layers.emplace_back(std::make_unique<frontend::RequestedLayerState>(args));
+
+        ResolvedComposerState& color = states.emplace_back();
+        color.layerId = id;
+        color.state.what = layer_state_t::eColorChanged;
+        color.state.color.rgb = {1._hf, 1._hf, 1._hf};
+        if (i % 4 == 3) {
+            ResolvedComposerState& hidden = states.emplace_back();
+            hidden.layerId = id;
+            hidden.state.what = layer_state_t::eFlagsChanged;
+            hidden.state.flags = layer_state_t::eLayerHidden;
+            hidden.state.mask = layer_state_t::eLayerHidden;
+        }
+    }
+    frontEnd.lifecycleManager.addLayers(std::move(layers));
+    std::vector<TransactionState> transactions;
+    transactions.push_back(makeTransaction(std::move(states)));
+    frontEnd.lifecycleManager.applyTransactions(transactions);
+    frontEnd.hierarchyBuilder.update(frontEnd.lifecycleManager);
+    updateSnapshots(frontEnd, /*displayChanged=*/true);
+    frontEnd.lifecycleManager.commitChanges();
+}
+
+// Goes over the snapshots like the passes did before the builder kept their per-frame states apart,
+// by loading every snapshot.
+void visitSnapshotsWithoutFrameStates(frontend::LayerSnapshotBuilder& builder,
+                                      size_t& visitedSnapshots) {
+    std::vector<std::unique_ptr<frontend::LayerSnapshot>>& snapshots = builder.getSnapshots();
+    for (const auto& snapshot : snapshots) {
+        if (snapshot->changes.get() != 0 || snapshot->clientChanges != 0) visitedSnapshots++;
+    }
+    for (const auto& snapshot : snapshots) {
+        if (snapshot->isVisible) visitedSnapshots++;
+    }
+    for (auto it = snapshots.rbegin(); it != snapshots.rend(); it++) {
+        if ((*it)->hasInputInfo()) visitedSnapshots++;
+    }
+}
+
+void benchmarkLargeScene(benchmark::State& state) {
+    const auto numLayers = static_cast<uint32_t>(state.range(0));
+    const bool useFrameStates = state.range(1) != 0;
+    Frontend frontEnd;
+    createLargeScene(frontEnd, numLayers);
+
+    CacheMissCounter cacheMisses;
+    uint64_t totalCacheMisses = 0;
+    size_t visitedSnapshots = 0;
+    size_t allocations = 0;
+    // The roots are never hidden, so the frames change the color of the first display's root.
+    float red = 0;
+    for (auto _ : state) {
+        red = red == 0 ? 1 : 0;
+        ResolvedComposerState color;
+        color.layerId = 1;
+        color.state.what = layer_state_t::eColorChanged;
+        color.state.color.rgb = {static_cast<half>(red), 1._hf, 1._hf};
+        std::vector<TransactionState> transactions;
+        transactions.push_back(makeTransaction({color}));
+
+        const size_t startAllocations = getHeapAllocations();
+        if (cacheMisses.isAvailable()) cacheMisses.start();
+        frontEnd.lifecycleManager.applyTransactions(transactions);
+        updateSnapshots(frontEnd, /*displayChanged=*/false);
+        // SurfaceFlinger goes over the snapshots like this every frame, to update the layer
+        // history, to composite and to update the input windows.
+        if (useFrameStates) {
+            frontEnd.snapshotBuilder.forEachChangedSnapshot(
+                    [&](std::unique_ptr<frontend::LayerSnapshot>&) { visitedSnapshots++; });
+            frontEnd.snapshotBuilder.forEachVisibleSnapshot(
+                    [&](const frontend::LayerSnapshot&) { visitedSnapshots++; });
+            frontEnd.snapshotBuilder.forEachInputSnapshot(
+                    [&](const frontend::LayerSnapshot&) { visitedSnapshots++; });
+        } else {
+            visitSnapshotsWithoutFrameStates(frontEnd.snapshotBuilder, visitedSnapshots);
+        }
+        frontEnd.lifecycleManager.commitChanges();
+        if (cacheMisses.isAvailable()) totalCacheMisses += cacheMisses.stop();
+        allocations += getHeapAllocations() - startAllocations;
+    }
+
+    const auto frames = static_cast<double>(state.iterations());
+    state.SetItemsProcessed(state.iterations());
+    state.counters["snapshots"] =
+            static_cast<double>(frontEnd.snapshotBuilder.getSnapshots().size());
+    state.counters["visited_snapshots"] = static_cast<double>(visitedSnapshots) / frames;
+    state.counters["allocs"] = static_cast<double>(allocations) / frames;
+    if (cacheMisses.isAvailable()) {
+        state.counters["cache_misses"] = static_cast<double>(totalCacheMisses) / frames;
+    }
+}
+BENCHMARK(benchmarkLargeScene)
+        ->ArgNames({"layers", "frame_states"})
+        ->ArgsProduct({{500, 1000, 2000}, {0, 1}});
+
+void registerTrace(const std::filesystem::path& path) {
+    std::optional<Trace> trace = readTrace(path);
+    if (!trace) {
+        return;
+    }
+    std::string name = path.stem().string();
+    if (name.starts_with(TRANSACTION_TRACE_PREFIX)) {
+        name = name.substr(TRANSACTION_TRACE_PREFIX.length());
+    }
+    benchmark::RegisterBenchmark(("benchmarkReplay/" + name).c_str(),
+                                 [trace = std::move(*trace)](benchmark::State& state) {
+                                     benchmarkReplay(state, trace);
+                                 });
+}
+
+} // namespace
+
+} // namespace android
+
+int main(int argc, char** argv) {
+    // Unexpected states in the traces would otherwise write a transaction trace of their own.
+    android::TransactionTraceWriter::getInstance().disable();
+
+    const std::filesystem::path testdata = android::base::GetExecutableDirectory() + "/testdata/";
+    if (std::filesystem::is_directory(testdata)) {
+        for (const auto& entry : std::filesystem::directory_iterator(testdata)) {
+            const std::string filename = entry.path().filename().string();
+            if (entry.is_regular_file() &&
+                filename.starts_with(android::TRANSACTION_TRACE_PREFIX) &&
+                filename.ends_with(android::TRACE_POSTFIX)) {
+                android::registerTrace(entry.path());
+            }
+        }
+    }
+    if (const char* paths = getenv(android::TRACES_ENV)) {
+        for (const std::string& path : android::base::Split(paths, ":")) {
+            if (!path.empty()) {
+                android::registerTrace(path);
+            }
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
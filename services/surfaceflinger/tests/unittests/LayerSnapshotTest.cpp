@@ -22,6 +22,7 @@
 #include "FrontEnd/LayerHierarchy.h"
 #include "FrontEnd/LayerLifecycleManager.h"
 #include "FrontEnd/LayerSnapshotBuilder.h"
+#include "FrontEnd/SnapshotWorkerPool.h"
 #include "Layer.h"
 #include "LayerHierarchyTest.h"
 #include "ui/GraphicTypes.h"
@@ -101,6 +102,65 @@ protected:
                     actualVisibleLayerIdsInZOrder.push_back(snapshot.path.id);
                 });
         EXPECT_EQ(expectedVisibleLayerIdsInZOrder, actualVisibleLayerIdsInZOrder);
+        verifyFrameStates(actualBuilder);
+    }
+
+    // The states that the builder keeps next to the snapshots must match the snapshots.
+    void verifyFrameStates(const LayerSnapshotBuilder& builder) {
+        ASSERT_EQ(builder.mSnapshots.size(), builder.mFrameStates.size());
+        for (size_t i = 0; i < builder.mSnapshots.size(); i++) {
+            const LayerSnapshot& snapshot = *builder.mSnapshots[i];
+            const auto& state = builder.mFrameStates[i];
+            using FrameState = LayerSnapshotBuilder::FrameState;
+            EXPECT_EQ(snapshot.isVisible, state.test(FrameState::Visible))
+                    << snapshot.getDebugString();
+            EXPECT_EQ(snapshot.hasInputInfo(), state.test(FrameState::HasInputInfo))
+                    << snapshot.getDebugString();
+            EXPECT_EQ(snapshot.hasSomethingToDraw(), state.test(FrameState::HasSomethingToDraw))
+                    << snapshot.getDebugString();
+            const bool hasChanges = snapshot.changes.get() != 0 || snapshot.clientChanges != 0 ||
+                    snapshot.contentDirty || snapshot.hasReadyFrame ||
+                    snapshot.sidebandStreamHasFrame || !snapshot.surfaceDamage.isEmpty();
+            EXPECT_EQ(hasChanges, state.test(FrameState::Dirty)) << snapshot.getDebugString();
+        }
+    }
+
+    std::vector<uint32_t> getChangedLayerIds() {
+        std::vector<uint32_t> ids;
+        mSnapshotBuilder.forEachChangedSnapshot(
+                [&ids](std::unique_ptr<LayerSnapshot>& snapshot) {
+                    ids.push_back(snapshot->path.id);
+                });
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    // Updates serialBuilder on the test thread and parallelBuilder on the pool, and expects both of
+    // them to end up with the same snapshots.
+    void updateInParallelAndVerify(LayerSnapshotBuilder& serialBuilder,
+                                   LayerSnapshotBuilder& parallelBuilder,
+                                   SnapshotWorkerPool& workerPool) {
+        LayerSnapshotBuilder::Args args{.root = mHierarchyBuilder.getHierarchy(),
+                                        .layerLifecycleManager = mLifecycleManager,
+                                        .includeMetadata = false,
+                                        .displays = mFrontEndDisplayInfos,
+                                        .globalShadowSettings = globalShadowSettings,
+                                        .supportsBlur = true,
+                                        .supportedLayerGenericMetadata = {},
+                                        .genericLayerMetadataKeyMap = {}};
+        update(serialBuilder, args);
+        args.workerPool = &workerPool;
+        parallelBuilder.update(args);
+        mLifecycleManager.commitChanges();
+
+        ASSERT_EQ(serialBuilder.getSnapshots().size(), parallelBuilder.getSnapshots().size());
+        for (const auto& expected : serialBuilder.getSnapshots()) {
+            const LayerSnapshot* actual = parallelBuilder.getSnapshot(expected->path);
+            ASSERT_NE(actual, nullptr) << expected->getDebugString();
+            EXPECT_EQ(expected->getDebugString(), actual->getDebugString());
+            EXPECT_EQ(expected->globalZ, actual->globalZ) << expected->getDebugString();
+            EXPECT_EQ(expected->color.a, actual->color.a) << expected->getDebugString();
+        }
     }
 
     LayerSnapshot* getSnapshot(uint32_t layerId) { return mSnapshotBuilder.getSnapshot(layerId); }
@@ -264,6 +324,55 @@ TEST_F(LayerSnapshotTest, FastPathSetsChangeFlagToContent) {
     EXPECT_EQ(getSnapshot(1)->clientChanges, layer_state_t::eColorChanged);
 }
 
+TEST_F(LayerSnapshotTest, ForEachChangedSnapshotVisitsChangedSnapshots) {
+    setCrop(12, Rect(1, 2, 3, 4));
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getChangedLayerIds(), (std::vector<uint32_t>{12, 121, 122, 1221}));
+
+    // The next update clears the changes of only these snapshots, and the fast path visits only the
+    // snapshot it merged.
+    setColor(2, {1._hf, 0._hf, 0._hf});
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getChangedLayerIds(), std::vector<uint32_t>{2});
+    EXPECT_EQ(getSnapshot(12)->changes.get(), 0u);
+    EXPECT_EQ(getSnapshot(1221)->changes.get(), 0u);
+
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_TRUE(getChangedLayerIds().empty());
+    EXPECT_EQ(getSnapshot(2)->changes.get(), 0u);
+    EXPECT_EQ(getSnapshot(2)->clientChanges, 0u);
+}
+
+TEST_F(LayerSnapshotTest, ForEachSnapshotToCompositeSkipsSnapshotsWithNothingToDraw) {
+    setColor(11);
+    setBuffer(122);
+    hideLayer(13);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 111, 12, 121, 122, 1221, 2});
+
+    std::vector<uint32_t> expected;
+    mSnapshotBuilder.forEachVisibleSnapshot([&expected](const LayerSnapshot& snapshot) {
+        if (snapshot.hasSomethingToDraw()) {
+            expected.push_back(snapshot.path.id);
+        }
+    });
+    std::vector<uint32_t> actual;
+    mSnapshotBuilder.forEachSnapshotToComposite(/*cursorOnly=*/false,
+                                                [&actual](std::unique_ptr<LayerSnapshot>& snapshot) {
+                                                    actual.push_back(snapshot->path.id);
+                                                });
+    EXPECT_EQ(expected, actual);
+    EXPECT_THAT(actual, testing::Contains(11u));
+    EXPECT_THAT(actual, testing::Contains(122u));
+
+    // None of the layers are cursors.
+    actual.clear();
+    mSnapshotBuilder.forEachSnapshotToComposite(/*cursorOnly=*/true,
+                                                [&actual](std::unique_ptr<LayerSnapshot>& snapshot) {
+                                                    actual.push_back(snapshot->path.id);
+                                                });
+    EXPECT_TRUE(actual.empty());
+}
+
 TEST_F(LayerSnapshotTest, GameMode) {
     std::vector<TransactionState> transactions;
     transactions.emplace_back();
@@ -1258,4 +1367,63 @@ TEST_F(LayerSnapshotTest, canOccludePresentation) {
     EXPECT_EQ(getSnapshot(1221)->inputInfo.canOccludePresentation, true);
 }
 
+TEST_F(LayerSnapshotTest, parallelUpdateMatchesSerialUpdate) {
+    // ROOT
+    // ├── 1
+    // │   ├── 11
+    // │   │   └── 111
+    // │   ├── 12
+    // │   │   ├── 121
+    // │   │   └── 122
+    // │   │       └── 1221
+    // │   └── 13
+    // ├── 2
+    // └── 3 (layer stack 1)
+    //     └── 31
+    //         └── 32 (mirrors 12)
+    SnapshotWorkerPool workerPool(/*numWorkers=*/2);
+    LayerSnapshotBuilder serialBuilder;
+    LayerSnapshotBuilder parallelBuilder;
+    createRootLayer(3);
+    setLayerStack(3, 1);
+    createLayer(31, 3);
+    mirrorLayer(/*layer*/ 32, /*parent*/ 31, /*layerToMirror*/ 12);
+    setCrop(31, Rect{10, 10, 100, 100});
+    setAlpha(2, 0.5f);
+    setRoundedCorners(1, 10.f);
+    updateInParallelAndVerify(serialBuilder, parallelBuilder, workerPool);
+
+    setAlpha(3, 0.5f);
+    setMatrix(12, 2.f, 0.f, 0.f, 2.f);
+    Region touch{Rect{0, 0, 1000, 1000}};
+    setTouchableRegionCrop(111, touch, /*touchCropId=*/13, /*replaceTouchableRegionWithCrop=*/true);
+    updateInParallelAndVerify(serialBuilder, parallelBuilder, workerPool);
+
+    hideLayer(1);
+    reparentLayer(31, UNASSIGNED_LAYER_ID);
+    updateInParallelAndVerify(serialBuilder, parallelBuilder, workerPool);
+}
+
+TEST_F(LayerSnapshotTest, parallelUpdateWithRelativeLayersAcrossSubtrees) {
+    SnapshotWorkerPool workerPool(/*numWorkers=*/2);
+    LayerSnapshotBuilder serialBuilder;
+    LayerSnapshotBuilder parallelBuilder;
+    createRootLayer(3);
+    setLayerStack(3, 1);
+    createLayer(31, 3);
+    updateInParallelAndVerify(serialBuilder, parallelBuilder, workerPool);
+
+    // 11 is reached through both 1 and 2, so they must be updated by the same task.
+    reparentRelativeLayer(11, 2);
+    hideLayer(2);
+    setAlpha(31, 0.5f);
+    updateInParallelAndVerify(serialBuilder, parallelBuilder, workerPool);
+    EXPECT_FALSE(parallelBuilder.getSnapshot(11)->isVisible);
+
+    showLayer(2);
+    removeRelativeZ(11);
+    updateInParallelAndVerify(serialBuilder, parallelBuilder, workerPool);
+    EXPECT_TRUE(parallelBuilder.getSnapshot(11)->isVisible);
+}
+
 } // namespace android::surfaceflinger::frontend